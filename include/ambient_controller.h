@@ -0,0 +1,160 @@
+#ifndef AMBIENT_CONTROLLER_H
+#define AMBIENT_CONTROLLER_H
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// Lux -> brightness mapping for one display: points sorted by lux,
+// interpolated linearly in log10(lux) (the eye adapts roughly
+// logarithmically), clamped at both ends
+struct AmbientCurve {
+    std::vector<std::pair<double, int>> points;     // (lux, brightness 0-100)
+
+    int BrightnessAt(double lux) const;
+
+    bool operator==(const AmbientCurve& other) const { return points == other.points; }
+};
+
+// Parse "0:10, 50:30, 400:70, 2000:100"; false if empty, malformed, out of
+// range or the lux values are not increasing
+bool ParseAmbientCurve(const std::string& text, AmbientCurve& curve);
+
+// CIE 1976 lightness (0-100) of a brightness setting, treating the setting as
+// relative luminance. Equal steps in L* look roughly equal.
+double PerceivedLightness(int brightness);
+
+// AMBIENT_* keys of config.env
+struct AmbientSettings {
+    std::string source;             // "udp:<port>", "udp:<host>:<port>" or "file:<path>" (empty = off)
+    int filter_ms = 5000;           // Time constant of the low-pass filter on the readings
+    double hysteresis = 0.2;        // Relative lux change needed before the target is reconsidered
+    double min_change = 3.0;        // Smallest change in perceived lightness (L*) worth a write
+    int poll_ms = 500;              // File source: how often the file is read
+    std::map<int, AmbientCurve> curves;     // AMBIENT_CURVE_<display>; displays without one are left alone
+
+    bool IsEnabled() const { return !source.empty() && !curves.empty(); }
+
+    bool operator==(const AmbientSettings& other) const;
+    bool operator!=(const AmbientSettings& other) const { return !(*this == other); }
+};
+
+struct AmbientDisplayStats {
+    int display_index = 0;
+    int target = -1;                // Curve value for the filtered lux (-1 before the first reading)
+    int written = -1;               // Last brightness written
+    uint64_t writes = 0;            // Writes issued
+    uint64_t naive_writes = 0;      // Writes a client posting every reading's curve value would have sent
+};
+
+struct AmbientStats {
+    bool running = false;
+    uint64_t readings = 0;          // Readings accepted
+    uint64_t malformed = 0;         // Datagrams/lines that were not a lux value
+    double lux = 0;                 // Last raw reading
+    double filtered_lux = 0;
+    std::vector<AmbientDisplayStats> displays;
+};
+
+// Closed-loop automatic brightness from an ambient light sensor
+//
+// A sensor process feeds lux readings through a local source: plain-text
+// UDP datagrams ("312.5") or a file whose last line holds the current value
+// (re-read every poll_ms; a sensor daemon can overwrite or append to it).
+// Each reading goes through
+//   1. a median over the last AMBIENT_MEDIAN_WINDOW_MS, so a shadow shorter
+//      than half of it (a hand passing the sensor) never gets through, then
+//      a low-pass filter (exponential moving average of log10 lux with time
+//      constant filter_ms) that smooths out noise and flicker;
+//   2. hysteresis: nothing happens until the filtered lux has moved more
+//      than the hysteresis fraction from the lux of the last write;
+//   3. each display's curve, and a write only if the new brightness differs
+//      from the one last written by at least min_change in perceived
+//      lightness (L*). Small steps at the bright end, where the eye barely
+//      notices them, are skipped; the same step at the dark end is not.
+// A manual change stays until the room changes enough to pass both checks.
+// Writes go to the writer callback (normally ThreadSafeMonitorControl::
+// WriteLatest on the bulk lane) from the source thread.
+class AmbientController {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Writer = std::function<void(int display_index, int brightness)>;
+
+    explicit AmbientController(Writer writer);
+    ~AmbientController();
+
+    AmbientController(const AmbientController&) = delete;
+    AmbientController& operator=(const AmbientController&) = delete;
+
+    // Start the source thread; false if disabled or the source cannot be opened
+    bool Start(const AmbientSettings& settings);
+    void Stop();
+    bool IsRunning() const { return running; }
+
+    // Feed one reading taken at now (source thread, or a simulation without Start)
+    void Ingest(double lux, Clock::time_point now);
+    // Same, for a reading that came in as text; counted as malformed if it is not a number
+    void IngestText(const std::string& text, Clock::time_point now);
+
+    // Use settings without a source thread (simulations)
+    void Configure(const AmbientSettings& settings);
+
+    AmbientStats GetStats();
+
+private:
+    struct DisplayLoop {
+        int target = -1;
+        int written = -1;
+        double written_lux = 0;         // Filtered lux the last write was based on
+        int naive_last = -1;
+        uint64_t writes = 0;
+        uint64_t naive_writes = 0;
+    };
+
+    Writer writer;
+    std::thread source_thread;
+    std::atomic<bool> running;
+    std::atomic<bool> stopping;
+
+    // Filter and per-display state (guarded by loop_mutex)
+    std::mutex loop_mutex;
+    AmbientSettings settings;
+    bool has_reading;
+    std::deque<std::pair<Clock::time_point, double>> recent;    // log10 lux within the median window
+    double filtered_log_lux;
+    Clock::time_point last_reading;
+    double last_lux;
+    uint64_t readings;
+    uint64_t malformed;
+    std::map<int, DisplayLoop> loops;
+
+    // Source
+    uintptr_t socket_handle;
+    std::string bound_host;
+    int bound_port;
+    std::mutex wait_mutex;
+    std::condition_variable wait_cv;
+
+    bool OpenUdp(const std::string& spec);
+    void UdpThreadFunc();
+    void FileThreadFunc(std::string path);
+};
+
+// Readings below this are treated as this (log10 needs a positive value, and
+// sensors report 0 in a dark room)
+constexpr double AMBIENT_MIN_LUX = 0.1;
+
+// Span of the median prefilter, and the most readings it holds (fast sources)
+constexpr int AMBIENT_MEDIAN_WINDOW_MS = 5000;
+constexpr size_t AMBIENT_MEDIAN_MAX_SAMPLES = 255;
+
+#endif // AMBIENT_CONTROLLER_H
@@ -0,0 +1,34 @@
+#ifndef CLI_BATCH_H
+#define CLI_BATCH_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstdint>
+
+// One line of a writeValueToDisplay batch script
+//
+// Script format (one command per line, '#' starts a comment; value, code and
+// register are hex like on the command line):
+//   write <display_index> <value> <code> [register]
+//   <display_index> <value> <code> [register]      same as write (single-shot argument order)
+//   read <display_index> <code> [register]
+//   delay <milliseconds>
+struct CliCommand {
+    enum class Type { Write, Read, Delay };
+    Type type = Type::Write;
+    int display_index = 0;
+    uint16_t value = 0;
+    uint8_t command_code = 0;
+    uint8_t register_address = 0x51;
+    int delay_ms = 0;
+    int line = 0;           // Source line for error and timing output
+};
+
+// Parse a whole script; on failure error names the offending line
+bool ParseCliScript(std::istream& input, std::vector<CliCommand>& commands, std::string& error);
+
+// Human-readable form used in timing output ("write display 0 code 0x10 value 0x32")
+std::string DescribeCliCommand(const CliCommand& command);
+
+#endif // CLI_BATCH_H
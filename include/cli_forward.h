@@ -0,0 +1,43 @@
+#ifndef CLI_FORWARD_H
+#define CLI_FORWARD_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "cli_batch.h"
+
+namespace httplib { class Client; }
+
+// Forwarding of writeValueToDisplay commands to a running monitor_control_gui
+//
+// If the GUI is running it already owns an NvAPI session and a serialized
+// command queue per display. The CLI then sends its commands to /api/vcp
+// instead of initializing NvAPI and writing to the I2C bus in parallel.
+class ServerForwarder {
+public:
+    enum class Result {
+        Ok,
+        Failed,         // Server answered and the command failed, or it was sent and got no answer
+        Unavailable     // Server unreachable or too old to have /api/vcp: run the command directly
+    };
+
+    ServerForwarder();
+    ~ServerForwarder();
+
+    // Read config.env (current directory, then the executable's directory) and
+    // probe /health on the local socket, then TCP; false if nothing answers
+    bool Connect(const std::string& exe_path);
+
+    // "unix socket <path>" or "<host>:<port>"
+    std::string Describe() const { return description; }
+
+    // Send one write or read over the kept-alive connection; for reads
+    // current/maximum are filled on Ok
+    Result Send(const CliCommand& command, uint16_t& current_value, uint16_t& maximum_value, std::string& error);
+
+private:
+    std::unique_ptr<httplib::Client> client;
+    std::string description;
+};
+
+#endif // CLI_FORWARD_H
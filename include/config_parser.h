@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 // Simple .env file parser for configuration
 class ConfigParser {
@@ -28,6 +29,9 @@ public:
 
     // Check if key exists
     bool HasKey(const std::string& key) const;
+
+    // All keys in sorted order (used for structured files such as presets.env)
+    std::vector<std::string> GetKeys() const;
 };
 
 #endif // CONFIG_PARSER_H
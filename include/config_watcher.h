@@ -0,0 +1,84 @@
+#ifndef CONFIG_WATCHER_H
+#define CONFIG_WATCHER_H
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <chrono>
+#include <cstdint>
+#include "http_api_server.h"
+
+// Watches config.env and keeps an immutable, typed snapshot of it
+//
+// The file is parsed into a ServerConfig once per change and published by
+// swapping a shared_ptr, so readers call Current() and keep using their
+// snapshot without taking a lock or re-reading keys. The directory holding
+// the file is watched (ReadDirectoryChangesW on Windows, inotify on Linux)
+// because editors usually save by writing a temp file and renaming it.
+//
+// The files config.env names (PRESETS_FILE, SCHEDULE_FILE) can live in any
+// directory, so their contents are checked by size and modification time
+// every FILE_CHECK_MS instead.
+class ConfigWatcher {
+public:
+    using ChangeHandler = std::function<void(const ServerConfig& old_config, const ServerConfig& new_config)>;
+    using FileHandler = std::function<void(const ServerConfig& config, const std::string& path)>;
+
+    explicit ConfigWatcher(const std::string& config_path);
+    ~ConfigWatcher();
+
+    // Current snapshot (never null)
+    std::shared_ptr<const ServerConfig> Current() const;
+
+    // Start watching; on_change runs on the watcher thread after each reload that
+    // changed something, on_file_change after a file config.env names was edited
+    bool Start(ChangeHandler on_change, FileHandler on_file_change = nullptr);
+    void Stop();
+
+    // Re-read the file now; returns true if the snapshot changed
+    bool Reload();
+
+private:
+    std::string config_path;
+    std::string directory;
+    std::string file_name;
+
+    std::shared_ptr<const ServerConfig> snapshot;   // Accessed with std::atomic_load/store
+    ChangeHandler on_change;
+    FileHandler on_file_change;
+
+    struct FileStamp {
+        bool exists = false;
+        int64_t size = 0;
+        int64_t modified = 0;
+
+        bool operator==(const FileStamp& other) const {
+            return exists == other.exists && size == other.size && modified == other.modified;
+        }
+    };
+    std::map<std::string, FileStamp> file_stamps;   // Watcher thread only
+
+    static FileStamp StampOf(const std::string& path);
+    // Compare the named files with their last stamps and report the edited ones
+    void CheckFiles(bool report);
+    int CheckFilesIfDue(std::chrono::steady_clock::time_point& next_check);
+
+    std::thread watcher_thread;
+    std::atomic<bool> stopping;
+
+#ifdef _WIN32
+    void* stop_event;       // HANDLE
+#else
+    int stop_pipe[2];
+#endif
+
+    void WatcherThreadFunc();
+};
+
+// Interval of the checks of the files config.env names
+constexpr int FILE_CHECK_MS = 1000;
+
+#endif // CONFIG_WATCHER_H
@@ -0,0 +1,134 @@
+#ifndef DDC_LOG_H
+#define DDC_LOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ddc_transport.h"
+
+// Binary record of bus transactions, for reproducing monitor bugs and
+// benchmarking the command queues without the monitor
+//
+// RecordingTransport sits between a DisplayExecutor and the real transport
+// and appends one fixed-size record per transaction to a DdcRecorder. A log
+// is a 16-byte header ("DDCLOG01", format version, record size) followed by
+// DDC_LOG_RECORD_SIZE-byte records, all integers little-endian:
+//
+//   u64 start_us     transaction start, microseconds since recording began
+//   u32 latency_us   time the transport took to return
+//   u8  bus          display index
+//   u8  op           0 = write, 1 = read
+//   u8  status       0 = ok, 1 = failed
+//   u8  register     register address (0x51 for VCP codes)
+//   u8  data[6]      write packet bytes; for reads only the command code is set
+//   u16 current      read reply (0 for writes)
+//   u16 maximum
+//
+// ReplayTransport answers from a loaded log instead of a monitor, with the
+// recorded results and (optionally scaled) latency. ddc_replay drives it on
+// any platform.
+
+constexpr char DDC_LOG_MAGIC[8] = { 'D', 'D', 'C', 'L', 'O', 'G', '0', '1' };
+constexpr uint32_t DDC_LOG_VERSION = 1;
+constexpr size_t DDC_LOG_HEADER_SIZE = 16;
+constexpr size_t DDC_LOG_RECORD_SIZE = 26;
+
+struct DdcLogRecord {
+    enum class Op : uint8_t { Write = 0, Read = 1 };
+
+    uint64_t start_us = 0;
+    uint32_t latency_us = 0;
+    uint8_t bus = 0;
+    Op op = Op::Write;
+    bool ok = false;
+    DdcPacket packet;           // For reads: register and command code only
+    uint16_t current_value = 0;
+    uint16_t maximum_value = 0;
+};
+
+// Append-only log writer shared by every display's RecordingTransport
+class DdcRecorder {
+public:
+    DdcRecorder();
+    ~DdcRecorder();
+
+    DdcRecorder(const DdcRecorder&) = delete;
+    DdcRecorder& operator=(const DdcRecorder&) = delete;
+
+    // Create (truncate) the log and start the clock
+    bool Open(const std::string& path);
+    void Close();
+
+    // Microseconds since Open()
+    uint64_t Now() const;
+
+    // Write and flush one record, so a crash loses at most the transaction on the bus
+    void Append(const DdcLogRecord& record);
+
+    uint64_t GetRecordCount();
+
+private:
+    std::mutex file_mutex;
+    FILE* file;
+    std::chrono::steady_clock::time_point start;
+    uint64_t record_count;
+};
+
+// Records every transaction that passes through to the wrapped transport
+class RecordingTransport : public DdcTransport {
+public:
+    RecordingTransport(int bus, std::unique_ptr<DdcTransport> inner, std::shared_ptr<DdcRecorder> recorder);
+
+    bool Write(const DdcPacket& packet) override;
+    bool Read(uint8_t command_code, uint8_t register_address,
+              uint16_t* current_value, uint16_t* maximum_value) override;
+
+private:
+    uint8_t bus;
+    std::unique_ptr<DdcTransport> inner;
+    std::shared_ptr<DdcRecorder> recorder;
+};
+
+// Read a whole log; false (with a message) if it is not a DDC log or is truncated
+// mid-record (the complete records before the damage are still returned)
+bool LoadDdcLog(const std::string& path, std::vector<DdcLogRecord>& records, std::string& error);
+
+// Plays back one bus of a log. Each call consumes the first unused record
+// that has the same operation, register and bytes, looking up to
+// REPLAY_LOOKAHEAD records past the last one consumed, and returns its status, read values and latency (times time_scale,
+// 0 = no delay). The lookahead lets the code under test reorder commands a
+// little (priority lanes do) and stay in step. A call with no matching record
+// fails at once and counts as a divergence: the code under test no longer
+// issues the recorded sequence.
+class ReplayTransport : public DdcTransport {
+public:
+    ReplayTransport(std::vector<DdcLogRecord> records, double time_scale);
+
+    bool Write(const DdcPacket& packet) override;
+    bool Read(uint8_t command_code, uint8_t register_address,
+              uint16_t* current_value, uint16_t* maximum_value) override;
+
+    uint64_t GetDivergenceCount();
+    size_t GetUnusedCount();            // Records no call has consumed (yet)
+
+private:
+    // Consume the record matching the call and sleep for its latency; false
+    // (without delay) if none matches
+    bool Next(const DdcLogRecord& call, DdcLogRecord& recorded);
+
+    std::mutex replay_mutex;
+    std::vector<DdcLogRecord> records;
+    std::vector<bool> used;
+    size_t position;                    // First unused record
+    size_t last_used;                   // One past the last record consumed
+    double time_scale;
+    uint64_t divergences;
+};
+
+constexpr size_t REPLAY_LOOKAHEAD = 64;
+
+#endif // DDC_LOG_H
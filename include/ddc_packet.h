@@ -0,0 +1,158 @@
+#ifndef DDC_PACKET_H
+#define DDC_PACKET_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time DDC/CI packet builder
+//
+// A "set VCP feature" write on the display's I2C bus looks like:
+//   0x6E - display write address (7-bit 0x37 shifted left, R/W bit = 0)
+//   0x?? - register address (0x51 for VCP codes, vendor specific otherwise)
+//   0x84 - 0x80 OR n where n = 4 bytes for "modify a value" request
+//   0x03 - change a value flag
+//   0x?? - command code
+//   0x?? - value high byte
+//   0x?? - value low byte
+//   0x?? - checksum, xor'ing all the above bytes
+//
+// The device address and register address are passed to NvAPI separately,
+// so the packet only stores the register address and the six data bytes.
+// Everything except the two value bytes is fixed per command, which lets the
+// checksum of fixed commands (input switches, presets) be computed and
+// validated entirely at compile time.
+
+constexpr uint8_t DDC_DISPLAY_ADDRESS = 0x37;
+constexpr uint8_t DDC_WRITE_ADDRESS = DDC_DISPLAY_ADDRESS << 1;   // 0x6E
+constexpr uint8_t DDC_READ_ADDRESS = DDC_WRITE_ADDRESS | 1;       // 0x6F
+constexpr uint8_t DDC_VCP_REGISTER = 0x51;
+constexpr uint8_t DDC_SET_VCP_LENGTH = 0x84;
+constexpr uint8_t DDC_SET_VCP_OPCODE = 0x03;
+constexpr uint32_t DDC_I2C_SPEED = 27;   // Legacy NvAPI speed value used by the NVidia sample
+
+// Byte offsets inside DdcPacket::data
+constexpr size_t DDC_LENGTH_OFFSET = 0;
+constexpr size_t DDC_OPCODE_OFFSET = 1;
+constexpr size_t DDC_CODE_OFFSET = 2;
+constexpr size_t DDC_VALUE_HIGH_OFFSET = 3;
+constexpr size_t DDC_VALUE_LOW_OFFSET = 4;
+constexpr size_t DDC_CHECKSUM_OFFSET = 5;
+constexpr size_t DDC_PACKET_SIZE = 6;
+
+// Fully encoded "set VCP feature" packet
+struct DdcPacket {
+    uint8_t register_address = DDC_VCP_REGISTER;
+    uint8_t data[DDC_PACKET_SIZE] = { 0 };
+
+    constexpr uint8_t CommandCode() const { return data[DDC_CODE_OFFSET]; }
+    constexpr uint16_t Value() const {
+        return static_cast<uint16_t>((data[DDC_VALUE_HIGH_OFFSET] << 8) | data[DDC_VALUE_LOW_OFFSET]);
+    }
+};
+
+// XOR of the write address, register address and every data byte except the checksum
+constexpr uint8_t DdcChecksum(const DdcPacket& packet) {
+    uint8_t checksum = DDC_WRITE_ADDRESS ^ packet.register_address;
+    for (size_t i = 0; i < DDC_CHECKSUM_OFFSET; ++i) {
+        checksum ^= packet.data[i];
+    }
+    return checksum;
+}
+
+// Structural validation: header bytes and checksum must be consistent
+constexpr bool IsValidDdcPacket(const DdcPacket& packet) {
+    return packet.data[DDC_LENGTH_OFFSET] == DDC_SET_VCP_LENGTH &&
+           packet.data[DDC_OPCODE_OFFSET] == DDC_SET_VCP_OPCODE &&
+           packet.data[DDC_CHECKSUM_OFFSET] == DdcChecksum(packet);
+}
+
+// Encode a complete packet (usable both at compile time and at runtime)
+constexpr DdcPacket MakeDdcPacket(uint8_t command_code, uint16_t value,
+                                  uint8_t register_address = DDC_VCP_REGISTER) {
+    DdcPacket packet;
+    packet.register_address = register_address;
+    packet.data[DDC_LENGTH_OFFSET] = DDC_SET_VCP_LENGTH;
+    packet.data[DDC_OPCODE_OFFSET] = DDC_SET_VCP_OPCODE;
+    packet.data[DDC_CODE_OFFSET] = command_code;
+    packet.data[DDC_VALUE_HIGH_OFFSET] = static_cast<uint8_t>(value >> 8);
+    packet.data[DDC_VALUE_LOW_OFFSET] = static_cast<uint8_t>(value & 0xFF);
+    packet.data[DDC_CHECKSUM_OFFSET] = DdcChecksum(packet);
+    return packet;
+}
+
+// Command template for a VCP code whose value is only known at runtime.
+// The packet for value 0 (including its checksum) is built at compile time;
+// Encode() only patches the two value bytes and folds them into the checksum.
+template <uint8_t CommandCode, uint8_t RegisterAddress = DDC_VCP_REGISTER>
+struct DdcCommand {
+    static constexpr uint8_t command_code = CommandCode;
+    static constexpr uint8_t register_address = RegisterAddress;
+    static constexpr DdcPacket base_packet = MakeDdcPacket(CommandCode, 0, RegisterAddress);
+    static_assert(IsValidDdcPacket(base_packet), "DDC command template failed validation");
+
+    static constexpr DdcPacket Encode(uint16_t value) {
+        DdcPacket packet = base_packet;
+        const uint8_t high = static_cast<uint8_t>(value >> 8);
+        const uint8_t low = static_cast<uint8_t>(value & 0xFF);
+        packet.data[DDC_VALUE_HIGH_OFFSET] = high;
+        packet.data[DDC_VALUE_LOW_OFFSET] = low;
+        packet.data[DDC_CHECKSUM_OFFSET] = static_cast<uint8_t>(base_packet.data[DDC_CHECKSUM_OFFSET] ^ high ^ low);
+        return packet;
+    }
+};
+
+// Command whose value is fixed as well - the whole packet is a compile-time constant
+template <uint8_t CommandCode, uint16_t Value, uint8_t RegisterAddress = DDC_VCP_REGISTER>
+struct DdcFixedCommand {
+    static constexpr DdcPacket packet = DdcCommand<CommandCode, RegisterAddress>::Encode(Value);
+    static_assert(IsValidDdcPacket(packet), "DDC fixed command failed validation");
+};
+
+// "Get VCP feature" request and reply
+//
+// Request (written like a set packet): 0x82 length, 0x01 opcode, VCP code, checksum.
+// After at least 40 ms the display answers with 11 bytes:
+//   0x6E source, 0x88 length, 0x02 reply opcode, result (0 = supported),
+//   VCP code, type, max high, max low, current high, current low, checksum
+// The reply checksum XORs the 0x50 "virtual host" address with bytes 0-9.
+constexpr uint8_t DDC_GET_VCP_LENGTH = 0x82;
+constexpr uint8_t DDC_GET_VCP_OPCODE = 0x01;
+constexpr uint8_t DDC_VCP_REPLY_OPCODE = 0x02;
+constexpr uint8_t DDC_REPLY_CHECKSUM_SEED = 0x50;
+constexpr size_t DDC_GET_VCP_REQUEST_SIZE = 4;
+constexpr size_t DDC_VCP_REPLY_SIZE = 11;
+constexpr unsigned DDC_REPLY_DELAY_MS = 40;
+
+struct DdcGetVcpRequest {
+    uint8_t register_address = DDC_VCP_REGISTER;
+    uint8_t data[DDC_GET_VCP_REQUEST_SIZE] = { 0 };
+};
+
+constexpr DdcGetVcpRequest MakeDdcGetVcpRequest(uint8_t command_code,
+                                                uint8_t register_address = DDC_VCP_REGISTER) {
+    DdcGetVcpRequest request;
+    request.register_address = register_address;
+    request.data[0] = DDC_GET_VCP_LENGTH;
+    request.data[1] = DDC_GET_VCP_OPCODE;
+    request.data[2] = command_code;
+    request.data[3] = static_cast<uint8_t>(DDC_WRITE_ADDRESS ^ register_address ^
+                                           DDC_GET_VCP_LENGTH ^ DDC_GET_VCP_OPCODE ^ command_code);
+    return request;
+}
+
+// Validate a reply to a get request for command_code and extract its values
+constexpr bool ParseDdcVcpReply(const uint8_t* reply, uint8_t command_code, uint16_t& current, uint16_t& maximum) {
+    uint8_t checksum = DDC_REPLY_CHECKSUM_SEED;
+    for (size_t i = 0; i < DDC_VCP_REPLY_SIZE - 1; ++i) {
+        checksum ^= reply[i];
+    }
+    if (checksum != reply[DDC_VCP_REPLY_SIZE - 1] || reply[2] != DDC_VCP_REPLY_OPCODE ||
+        reply[3] != 0 || reply[4] != command_code) {
+        return false;
+    }
+    maximum = static_cast<uint16_t>((reply[6] << 8) | reply[7]);
+    current = static_cast<uint16_t>((reply[8] << 8) | reply[9]);
+    return true;
+}
+
+#endif // DDC_PACKET_H
@@ -0,0 +1,218 @@
+#ifndef DDC_SEQUENCE_H
+#define DDC_SEQUENCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "display_executor.h"
+
+// Comparison of an "if" guard
+enum class SequenceComparison {
+    Equal,
+    NotEqual,
+    Less,
+    Greater
+};
+
+// One step of a multi-step DDC operation on one display
+struct SequenceStep {
+    enum class Type { Write, Read, Delay, Add };
+    Type type = Type::Write;
+    uint8_t command_code = 0;
+    uint8_t register_address = DDC_VCP_REGISTER;
+    uint16_t value = 0;
+    int value_from = -1;            // Write the value last read from this code instead (-1 = value)
+    int delay_ms = 0;
+    int delta = 0;                  // Add: change to the last read of command_code
+
+    // Run only if the value last read from guard_code compares true against guard_value
+    bool guarded = false;
+    uint8_t guard_code = 0;
+    SequenceComparison guard_op = SequenceComparison::Equal;
+    uint16_t guard_value = 0;
+};
+
+// Parse a sequence. Steps are separated by newlines or ';', '#' starts a
+// comment, and values, codes and registers are hex as in batch scripts:
+//   write <value> <code> [register]      $<code> as value writes what the last read of <code> returned
+//   read <code> [register]
+//   delay <milliseconds>                 (0-60000)
+//   add <code> <delta>                   change the last read of <code> by a hex delta, e.g. -A
+//   if <code> <==|!=|<|>> <value> <step> the step runs only if the last read of <code> compares true
+// A $ value, add or guard must follow a read of its code. At most MAX_SEQUENCE_STEPS steps.
+bool ParseDdcSequence(const std::string& text, std::vector<SequenceStep>& steps, std::string& error);
+
+// Bytecode that sequences and macros are compiled to
+enum class DdcOp : uint8_t {
+    Display,        // Following bus steps go to display operand
+    Write,          // Write operand to code/reg
+    WriteRead,      // Write the value last read from code arg to code/reg
+    Read,           // Read code/reg; the value becomes what "the last read of code" returns
+    Add,            // Add (int16_t)operand to the last read of code, clamped to 0-65535
+    Delay,          // Wait operand ms
+    JumpUnless,     // Jump to target unless the last read of code compares (arg) true against operand
+    Jump,           // Jump to target
+    Repeat,         // Set loop counter arg to operand
+    Next,           // Count down loop counter arg; jump to target while it is above zero
+    Each,           // Start loop counter arg on display list operand and go to its first display
+    NextDisplay     // Move loop counter arg to the next display of list operand and jump to target, if any
+};
+
+struct DdcInstruction {
+    DdcOp op = DdcOp::Jump;
+    uint8_t code = 0;
+    uint8_t reg = DDC_VCP_REGISTER;
+    uint8_t arg = 0;
+    uint16_t operand = 0;
+    uint16_t target = 0;
+};
+
+// A compiled sequence or macro. Validated once when compiled, so running it
+// only steps through instructions. The compiler also works out the bus
+// access up front; loops count at their full length and both branches of an
+// "if" count, so these are upper bounds.
+struct DdcProgram {
+    std::vector<DdcInstruction> code;
+    std::vector<uint16_t> steps;                // Source step of each instruction (for failed_step)
+    std::vector<std::vector<int>> display_lists;    // Operands of Each
+    std::vector<int> displays;                  // Displays named by the program, ascending
+    bool uses_default_display = false;          // Has bus steps before any "display" or "each"
+    int bus_steps = 0;                          // Most reads and writes it can send
+    int delay_ms = 0;                           // Most time it can spend in delays
+};
+
+// Compile parsed sequence steps; its bus steps go to the display it is run on
+void CompileDdcSequence(const std::vector<SequenceStep>& steps, DdcProgram& program);
+
+// Compile a macro: the sequence syntax above plus statements that pick
+// displays and blocks for conditionals and loops, each closed by "end":
+//   display <n>                          following steps go to display n
+//   each <n> [<n>...]                    run the block once on each listed display
+//   repeat <count>                       run the block count times (1-1000)
+//   if <code> <==|!=|<|>> <value>        a block, with an optional "else" part
+// Steps before any "display" or "each" go to the display the macro is run
+// on. Blocks nest up to MAX_MACRO_LOOP_DEPTH loops deep.
+bool CompileDdcMacro(const std::string& text, DdcProgram& program, std::string& error);
+
+struct SequenceRead {
+    int display = 0;
+    uint8_t command_code = 0;
+    uint8_t register_address = DDC_VCP_REGISTER;
+    uint16_t current_value = 0;
+    uint16_t maximum_value = 0;
+};
+
+struct SequenceResult {
+    bool success = false;
+    int steps_run = 0;
+    int steps_skipped = 0;          // Guard was false
+    int failed_step = -1;           // Index of the step (or macro statement) that failed (-1 = none)
+    std::vector<SequenceRead> reads;
+    int elapsed_ms = 0;
+};
+
+constexpr int MAX_SEQUENCE_STEPS = 64;
+constexpr int MAX_SEQUENCE_DELAY_MS = 60000;
+
+// Limits of a macro: source steps, loop nesting, repeat count, and the bus
+// steps, delay time and instructions run (loop and jump instructions
+// included) its plan may add up to
+constexpr int MAX_MACRO_STEPS = 256;
+constexpr int MAX_MACRO_LOOP_DEPTH = 8;
+constexpr int MAX_MACRO_REPEAT = 1000;
+constexpr int MAX_MACRO_BUS_STEPS = 10000;
+constexpr int MAX_MACRO_DELAY_MS = 60 * 60 * 1000;
+constexpr int MAX_MACRO_INSTRUCTIONS = 100000;
+
+// Runs DDC sequences and macros (write, wait, read back, conditional write)
+// without tying up a thread per sequence
+//
+// A running program is a small state machine advanced by continuations.
+// Each bus step is queued on the display's DisplayExecutor and the next step
+// is started from its completion, on that display's worker thread. A delay
+// parks the sequence on the runner's timer thread, which serves every
+// sequence. Between steps a sequence holds no thread, no lock and not the
+// bus, so other commands for the display run during its delays and any
+// number of displays' sequences interleave on the display workers plus one
+// timer thread. A step that fails ends the sequence.
+class SequenceRunner {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Done = std::function<void(const SequenceResult&)>;
+
+    // How a sequence reaches one display's bus. Completions may run on any
+    // thread, including inline when the command fails at once.
+    struct Bus {
+        std::function<void(const DdcPacket& packet, DisplayExecutor::Completion on_complete)> write;
+        std::function<void(uint8_t command_code, uint8_t register_address, uint16_t* current_value,
+                           uint16_t* maximum_value, DisplayExecutor::Completion on_complete)> read;
+    };
+
+    // Bus for each display a program names (and the one it runs on)
+    using BusFor = std::function<Bus(int display_index)>;
+
+    // Bus that submits straight to an executor; with no executor every step fails
+    static Bus ExecutorBus(DisplayExecutor* executor, DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                           DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+
+    SequenceRunner();
+    ~SequenceRunner();
+
+    SequenceRunner(const SequenceRunner&) = delete;
+    SequenceRunner& operator=(const SequenceRunner&) = delete;
+
+    // Start a sequence; done runs once, on whichever thread finished it
+    void Run(const Bus& bus, const std::vector<SequenceStep>& steps, Done done);
+    std::future<SequenceResult> Run(const Bus& bus, const std::vector<SequenceStep>& steps);
+
+    // Start a compiled program; its bus steps go to display_index until it picks another
+    void Run(const BusFor& buses, std::shared_ptr<const DdcProgram> program, int display_index, Done done);
+    std::future<SequenceResult> Run(const BusFor& buses, std::shared_ptr<const DdcProgram> program, int display_index);
+
+    // Sequences started and not yet finished
+    int GetActiveCount();
+
+    // Fail sequences that are waiting or start their next step from now on,
+    // and join the timer thread
+    void Stop();
+
+private:
+    struct Sequence {
+        BusFor buses;
+        std::map<int, Bus> bus_by_display;
+        std::shared_ptr<const DdcProgram> program;
+        Done done;
+        size_t next = 0;                           // Next instruction
+        int display = 0;
+        uint16_t last_read[256] = {};              // By command code
+        uint16_t counters[MAX_MACRO_LOOP_DEPTH] = {};
+        uint16_t read_current = 0;                 // Outputs of the read in progress
+        uint16_t read_maximum = 0;
+        SequenceResult result;
+        Clock::time_point start;
+    };
+
+    // Run instructions from sequence->next until a step is in progress, or finish
+    void Advance(std::shared_ptr<Sequence> sequence);
+    Bus& CurrentBus(Sequence& sequence);    // Bus of the sequence's current display
+    void Finish(std::shared_ptr<Sequence> sequence, bool success);
+
+    void TimerThreadFunc();
+
+    std::mutex runner_mutex;
+    std::condition_variable timer_cv;
+    std::multimap<Clock::time_point, std::shared_ptr<Sequence>> timers;
+    std::thread timer_thread;
+    bool stopping;
+    int active;
+};
+
+#endif // DDC_SEQUENCE_H
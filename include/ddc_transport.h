@@ -0,0 +1,66 @@
+#ifndef DDC_TRANSPORT_H
+#define DDC_TRANSPORT_H
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include "ddc_packet.h"
+
+// Bus access for one display
+//
+// DisplayExecutor only talks to a monitor through this interface, so the
+// NvAPI I2C path (NvApiTransport, monitor_control.h) can be swapped for
+// SimulatedTransport to exercise timeouts and the circuit breaker without
+// hardware. Calls are made from the display's worker thread only.
+class DdcTransport {
+public:
+    virtual ~DdcTransport() = default;
+
+    // Send a "set VCP feature" packet; false on NACK / driver error
+    virtual bool Write(const DdcPacket& packet) = 0;
+
+    // "Get VCP feature"; false on NACK, bad reply or driver error
+    virtual bool Read(uint8_t command_code, uint8_t register_address,
+                      uint16_t* current_value, uint16_t* maximum_value) = 0;
+};
+
+// Faults a SimulatedTransport injects into each transaction
+struct SimulatedFaults {
+    int latency_ms = 50;        // Normal transaction time (DDC writes take ~50 ms)
+    double nack_rate = 0.0;     // Probability a transaction fails
+    double spike_rate = 0.0;    // Probability of a latency spike
+    int spike_ms = 0;           // Extra time added by a spike
+    bool hang = false;          // Block every transaction until hang is cleared
+};
+
+// In-memory monitor: keeps the VCP values it is sent and answers reads
+// with them (maximum 100), after the configured latency and faults
+class SimulatedTransport : public DdcTransport {
+public:
+    explicit SimulatedTransport(uint32_t seed = 1);
+    ~SimulatedTransport() override;
+
+    bool Write(const DdcPacket& packet) override;
+    bool Read(uint8_t command_code, uint8_t register_address,
+              uint16_t* current_value, uint16_t* maximum_value) override;
+
+    // Change faults at runtime; clearing hang releases blocked transactions
+    // (a hung transport must be released before its executor is stopped)
+    void SetFaults(const SimulatedFaults& faults);
+
+    uint64_t GetTransactionCount();
+
+private:
+    // Apply latency and faults; false if the transaction should fail
+    bool Transact();
+
+    std::mutex sim_mutex;
+    std::condition_variable hang_cv;
+    SimulatedFaults faults;
+    std::mt19937 rng;
+    uint16_t values[256][256] = {};     // [register][code]
+    uint64_t transactions = 0;
+};
+
+#endif // DDC_TRANSPORT_H
@@ -0,0 +1,308 @@
+#ifndef DISPLAY_EXECUTOR_H
+#define DISPLAY_EXECUTOR_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ddc_packet.h"
+#include "ddc_transport.h"
+#include "vcp_commands.h"
+
+// Outcome of a group commit (see CommitBarrier)
+struct GroupCommitResult {
+    int members = 0;
+    int succeeded = 0;
+    int failed = 0;
+    bool barrier_timed_out = false;     // Released before every member arrived
+    int64_t release_skew_us = 0;        // Spread of the moments the members' writes started
+    double completion_skew_ms = 0;      // Spread of the moments the successful writes finished
+};
+
+// How a display's model switches inputs (see monitor_profiles.h)
+struct InputSwitchCommand {
+    uint8_t register_address = LG_INPUT_REGISTER;
+    uint8_t command_code = LG_INPUT_COMMAND;
+    int quiet_ms = 0;               // 0 = INPUT_SWITCH_QUIET_MS
+};
+
+// Lines up one command per display so they hit their buses together
+//
+// Each member's worker stops at the barrier with its command at the head of
+// its queue, and all are released at once when every member has arrived or
+// dropped out (failed or completed without reaching the bus). A member that
+// is held up longer than timeout_ms (e.g. behind a long queue) does not hold
+// the others any further: they are released and the skew shows it.
+class CommitBarrier {
+public:
+    CommitBarrier(int members, int timeout_ms);
+
+    // Worker side: wait for the release, then note when the write starts
+    void ArriveAndWait(int member);
+
+    // Completion side: record a member's result; a member that never
+    // arrived drops out of the barrier
+    void Finish(int member, bool result);
+
+    // Caller side: block until every member has finished
+    GroupCommitResult Wait();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex barrier_mutex;
+    std::condition_variable barrier_cv;
+    int members;
+    int arrived;
+    int withdrawn;
+    int finished;
+    bool released;
+    bool timed_out;
+    Clock::time_point deadline;
+    std::vector<bool> member_arrived;
+    std::vector<bool> member_ok;
+    std::vector<Clock::time_point> started;
+    std::vector<Clock::time_point> completed;
+};
+
+// Per-display command queue
+//
+// Each display gets its own worker thread that drains a FIFO of DDC packets,
+// so writes to one monitor are serialized while different monitors are
+// written in parallel. Callers get a future (or a completion callback run on
+// the worker thread) that reports whether the packet was sent. VCP reads go
+// through the same FIFO so they never interleave with a write on the bus.
+//
+// Input switches (LG register 0x50, code 0xF4 unless the monitor's profile
+// says otherwise) make the monitor re-sync and
+// ignore DDC for a while. After one, the worker enters the Switching state:
+// queued commands stay queued until a VCP read gets an answer again, instead
+// of being sent into a monitor that drops them. A switch to the input that is
+// already active is completed without touching the bus, but only for
+// INPUT_SWITCH_CACHE_MS after the monitor settled from our own switch (or
+// answered a read of the input on the standard VCP register): the OSD
+// buttons, a KVM or another host can change the input at any time, and a
+// real switch must never be swallowed. Opening or closing the breaker
+// forgets the active input too.
+//
+// A watchdog thread gives every bus transaction DDC_TRANSACTION_TIMEOUT_MS.
+// A transaction that outlives it fails its caller and opens the display's
+// circuit breaker, as do BREAKER_FAILURE_THRESHOLD failures in a row. While
+// the breaker is open, commands for this display fail immediately instead of
+// queuing behind a hung bus; the worker probes the monitor with a VCP read
+// (backing off up to BREAKER_PROBE_MAX_MS) and closes the breaker once it answers.
+//
+// Commands may carry a deadline (e.g. from an HTTP client that gives up after
+// a second). One still queued when its deadline passes is failed and counted
+// instead of being sent late.
+//
+// The queue has two lanes. Interactive commands (GUI, hotkeys, API calls a
+// user is waiting on) go ahead of bulk work (transition steps, scheduled
+// rules) at the next transaction boundary. After LANE_INTERACTIVE_BURST
+// interactive commands in a row, one waiting bulk command is let through so
+// bulk work never starves.
+class DisplayExecutor {
+public:
+    using Completion = std::function<void(bool)>;
+    using Deadline = std::chrono::steady_clock::time_point;
+    static constexpr Deadline NO_DEADLINE = Deadline::max();
+
+    enum class Lane {
+        Interactive,
+        Bulk
+    };
+    static constexpr int LANE_COUNT = 2;
+
+    enum class LinkState {
+        Ready,
+        Switching       // Input switch sent, waiting for the monitor to answer again
+    };
+
+    enum class BreakerState {
+        Closed,         // Healthy, commands are queued
+        Open,           // Unhealthy, commands fail fast until the next probe
+        HalfOpen        // Probe in progress
+    };
+
+    struct LaneStats {
+        size_t depth = 0;                // Commands queued now
+        size_t peak_depth = 0;           // Most commands ever queued at once
+        uint64_t dequeued = 0;           // Commands taken off the lane by the worker
+    };
+
+    struct Stats {
+        uint64_t input_switches = 0;     // Input switches sent
+        uint64_t switches_skipped = 0;   // Switches to the already active input
+        uint64_t commands_deferred = 0;  // Commands held back while Switching
+        int last_settle_ms = 0;          // How long the last switch kept the monitor unavailable
+        uint64_t failed_on_stop = 0;     // Queued commands failed because the drain deadline passed
+        uint64_t timeouts = 0;           // Transactions that outlived DDC_TRANSACTION_TIMEOUT_MS
+        uint64_t breaker_opens = 0;      // Closed -> Open transitions
+        uint64_t fast_failed = 0;        // Commands failed without reaching the bus (breaker open)
+        int consecutive_failures = 0;
+        uint64_t expired = 0;            // Commands dropped because their deadline passed in the queue
+        LaneStats lanes[LANE_COUNT];     // Indexed by Lane
+        uint64_t bulk_promoted = 0;      // Bulk commands run ahead of waiting interactive ones
+    };
+
+private:
+    struct PendingWrite {
+        DdcPacket packet;           // For reads: command code and register to query
+        bool is_read = false;
+        uint16_t* current_value = nullptr;
+        uint16_t* maximum_value = nullptr;
+        Deadline deadline = NO_DEADLINE;
+        Lane lane = Lane::Interactive;
+        std::shared_ptr<CommitBarrier> barrier;     // Group commit this command belongs to
+        int barrier_member = 0;
+        Completion on_complete;
+    };
+
+    // The transaction on the bus. The worker and the watchdog both try to
+    // complete it; whichever comes first reports the result (guarded by queue_mutex).
+    struct InFlight {
+        PendingWrite pending;
+        bool completed = false;
+        bool expect_failure = false;    // Input-switch settle probes: only a timeout counts
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void Enqueue(PendingWrite pending);
+
+    // Lane helpers (queue_mutex held)
+    bool QueueEmpty() const;
+    size_t QueuedCount() const;
+    std::deque<PendingWrite> TakeQueued();
+    PendingWrite PopNext();
+
+    int display_index;
+    std::unique_ptr<DdcTransport> transport;
+    InputSwitchCommand input_switch;
+
+    std::thread worker;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable exit_cv;    // Signalled when the worker returns
+    bool worker_exited;
+    std::deque<PendingWrite> lane_queues[LANE_COUNT];
+    int interactive_streak;     // Interactive commands run in a row while bulk work waited
+    bool stopping;
+    std::chrono::steady_clock::time_point drain_deadline;
+
+    // Input-switch state (guarded by queue_mutex)
+    LinkState link_state;
+    int active_input;           // Raw LG input value last switched to, -1 if unknown
+    std::chrono::steady_clock::time_point active_input_until;  // Trusted until then
+    Stats stats;
+
+    // Health (guarded by queue_mutex)
+    BreakerState breaker_state;
+    int probe_backoff_ms;
+    std::chrono::steady_clock::time_point next_probe;
+    std::shared_ptr<InFlight> in_flight;
+
+    std::thread watchdog;
+    std::condition_variable watchdog_cv;
+    bool watchdog_stopping;
+
+    bool IsInputSwitch(const DdcPacket& packet) const;
+
+    // Worker thread function
+    void WorkerThreadFunc();
+    void WatchdogThreadFunc();
+
+    // Run one transaction under the watchdog; true if it succeeded in time
+    bool Execute(PendingWrite pending, bool expect_failure = false);
+
+    // Update the breaker after a transaction (queue_mutex held); returns the
+    // queued commands to fail if the breaker opened
+    std::deque<PendingWrite> RecordOutcome(bool success, bool timed_out);
+    std::deque<PendingWrite> OpenBreaker();
+
+    // Hold the queue after an input switch until the monitor answers a VCP read
+    // (or the switch window expires); returns early when stopping
+    void WaitForMonitor();
+
+    // Sleep on queue_cv until deadline or Stop(); false if stopping
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline);
+
+public:
+    DisplayExecutor(int display_index, std::unique_ptr<DdcTransport> transport,
+                    const InputSwitchCommand& input_switch = InputSwitchCommand());
+    ~DisplayExecutor();
+
+    DisplayExecutor(const DisplayExecutor&) = delete;
+    DisplayExecutor& operator=(const DisplayExecutor&) = delete;
+
+    // Queue a packet for this display
+    std::future<bool> Submit(const DdcPacket& packet, Deadline deadline = NO_DEADLINE,
+                             Lane lane = Lane::Interactive);
+
+    // Queue a packet; on_complete runs on the worker thread with the result
+    void Submit(const DdcPacket& packet, Completion on_complete, Deadline deadline = NO_DEADLINE,
+                Lane lane = Lane::Interactive);
+
+    // Queue one member of a group commit; its worker holds the packet at the
+    // barrier until the other members are ready (see CommitBarrier)
+    void SubmitGroupMember(const DdcPacket& packet, std::shared_ptr<CommitBarrier> barrier, int member,
+                           Completion on_complete, Deadline deadline = NO_DEADLINE, Lane lane = Lane::Interactive);
+
+    // Queue a "get VCP feature" read; the outputs are valid once the future reports true
+    std::future<bool> SubmitRead(uint8_t command_code, uint8_t register_address,
+                                 uint16_t* current_value, uint16_t* maximum_value,
+                                 Deadline deadline = NO_DEADLINE, Lane lane = Lane::Interactive);
+
+    // Queue a read; on_complete runs on the worker thread, after the outputs are written
+    void SubmitRead(uint8_t command_code, uint8_t register_address, uint16_t* current_value,
+                    uint16_t* maximum_value, Completion on_complete, Deadline deadline = NO_DEADLINE,
+                    Lane lane = Lane::Interactive);
+
+    // Stop accepting commands without waiting. Queued commands still run until
+    // drain_deadline; whatever is left then fails. The command on the bus is
+    // never interrupted.
+    void RequestStop(std::chrono::steady_clock::time_point drain_deadline);
+
+    // Finish queued writes (or up to the deadline set by RequestStop) and join
+    // the worker. A worker still inside a bus transaction at join_deadline is
+    // abandoned: its transaction and queued commands fail, the thread is
+    // detached and false is returned. An executor whose worker was abandoned
+    // must never be destroyed, since the thread still uses it.
+    bool Stop(std::chrono::steady_clock::time_point join_deadline = std::chrono::steady_clock::time_point::max());
+
+    int GetDisplayIndex() const { return display_index; }
+    LinkState GetLinkState();
+    BreakerState GetBreakerState();
+    Stats GetStats();
+};
+
+const char* BreakerStateName(DisplayExecutor::BreakerState state);
+const char* LaneName(DisplayExecutor::Lane lane);
+bool ParseLane(const std::string& name, DisplayExecutor::Lane& lane);
+
+// Monitor silence after an input switch: no probe before the quiet period,
+// then a VCP read every probe interval until one succeeds or the window ends
+constexpr int INPUT_SWITCH_QUIET_MS = 1500;
+constexpr int INPUT_SWITCH_PROBE_INTERVAL_MS = 250;
+constexpr int INPUT_SWITCH_MAX_MS = 10000;
+// How long a known active input is trusted to skip a repeated switch
+constexpr int INPUT_SWITCH_CACHE_MS = 2000;
+
+// A DDC write takes ~50 ms and a read ~100 ms; anything near a second means a hung bus
+constexpr int DDC_TRANSACTION_TIMEOUT_MS = 1000;
+constexpr int BREAKER_FAILURE_THRESHOLD = 3;
+constexpr int BREAKER_PROBE_INITIAL_MS = 1000;
+constexpr int BREAKER_PROBE_MAX_MS = 30000;
+
+// Interactive commands run back to back before a waiting bulk command gets a turn
+constexpr int LANE_INTERACTIVE_BURST = 4;
+
+// Longest a group member's worker waits at the barrier for the slowest member
+constexpr int GROUP_BARRIER_TIMEOUT_MS = 2000;
+
+#endif // DISPLAY_EXECUTOR_H
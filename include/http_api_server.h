@@ -8,25 +8,48 @@
 #include <fstream>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "server_logger.h"
+#include "ambient_controller.h"
+#include "monitor_gateway.h"
+#include "idempotency_table.h"
+#include "startup_profile.h"
 
-class ThreadSafeMonitorControl;
+namespace httplib { class Server; struct Response; }
 
-// Simple file logger for debugging HTTP server issues
-class ServerLogger {
-public:
-    static void Init(const std::string& log_path);
-    static void Log(const char* level, const char* format, ...);
-    static void Close();
-private:
-    static std::ofstream log_file;
-    static std::mutex log_mutex;
-};
+class ThreadSafeMonitorControl;
+class PresetManager;
+class RuleScheduler;
+class UdpControlServer;
+class AmbientController;
 
 // Server configuration
 struct ServerConfig {
     std::string host = "127.0.0.1";
     int port = 45678;
     bool enabled = true;
+    std::string presets_file = "presets.env";
+    std::string schedule_file = "schedule.env";
+    double latitude = 0.0;          // Needed for sunrise/sunset rules
+    double longitude = 0.0;
+    bool has_location = false;
+    std::string log_level = "INFO";
+    std::string unix_socket;        // Optional AF_UNIX socket path for local clients (empty = off)
+    std::string udp_host = "127.0.0.1";
+    int udp_port = 0;               // Binary UDP control protocol (0 = off)
+    int shutdown_timeout_ms = 3000; // How long queued monitor commands may run on exit
+    std::string ddc_record_file;    // Log every bus transaction here (empty = off, read at startup)
+    std::string profile_db = "monitor_profiles.bin";   // Compiled monitor profiles (read at startup)
+    std::string state_file = "monitor_state.bin";      // Last known settings per display (empty = off, read at startup)
+    std::map<std::string, std::vector<int>> display_groups;    // GROUP_<name>=<display>,<display>,...
+    std::map<std::string, std::string> macros;     // MACRO_<name>=<macro steps separated by ';'>
+    AmbientSettings ambient;        // AMBIENT_* automatic brightness from a light sensor
+    GatewaySettings gateway;        // GATEWAY_* downstream instances for /api/gateway (empty = off)
+
+    bool operator==(const ServerConfig& other) const;
+    bool operator!=(const ServerConfig& other) const { return !(*this == other); }
 
     // Load configuration from file
     static ServerConfig LoadConfig(const std::string& config_path);
@@ -43,27 +66,75 @@ private:
     std::condition_variable bind_cv;
     std::mutex bind_mutex;
     ServerConfig config;
+    std::unique_ptr<httplib::Server> http_server;
+
+    // Local (AF_UNIX) listener, independent of the TCP one so a port conflict
+    // does not take local clients down with it
+    std::unique_ptr<httplib::Server> local_server;
+    std::unique_ptr<std::thread> local_thread;
+    std::atomic<bool> local_running;
+
     ThreadSafeMonitorControl* monitor_control;
+    PresetManager* preset_manager;
+    RuleScheduler* rule_scheduler;
+    UdpControlServer* udp_control;  // May be null
+    AmbientController* ambient;     // May be null
+    MonitorGateway* gateway;        // May be null
+
+    // Responses of recent mutating requests by Idempotency-Key header, shared
+    // by both listeners so a retry over the other transport is caught too
+    IdempotencyTable idempotency;
+
+    // GET /api/status?wait_version=N requests currently waiting for a change
+    std::atomic<int> parked_status_polls;
+
+    // Startup timing (may be null): the first server thread records the bind
+    // phases, and the first request handled records "first request served",
+    // timed from when Start() was called
+    StartupProfile* startup_profile;
+    StartupProfile::Clock::time_point server_started;
+    std::atomic<bool> first_request_served;
+    bool startup_bind_recorded;     // Only touched by the server thread
 
     // Server thread function
     void ServerThreadFunc();
 
+    // Install the API handlers on a listener
+    void RegisterRoutes(httplib::Server& server);
+
+    bool StartLocalListener();
+    void StopLocalListener();
+
     // Helper function to create JSON response
     static std::string CreateJsonResponse(bool success, const std::string& message,
                                          const std::string& additional_fields = "");
 
+    // Failed-command response: 504 if the client's deadline has passed (the
+    // command was most likely dropped from the queue unsent), 500 otherwise
+    static void SetCommandFailure(httplib::Response& res, std::chrono::steady_clock::time_point deadline,
+                                  const std::string& message, const std::string& additional_fields = "");
+
 public:
-    HttpApiServer(ThreadSafeMonitorControl* control);
+    HttpApiServer(ThreadSafeMonitorControl* control, PresetManager* presets, RuleScheduler* scheduler,
+                  UdpControlServer* udp, AmbientController* ambient, MonitorGateway* gateway = nullptr,
+                  StartupProfile* startup = nullptr);
     ~HttpApiServer();
 
     // Start the HTTP server
     bool Start(const ServerConfig& cfg);
 
-    // Stop the HTTP server
+    // Close the listeners without waiting; requests in progress keep running
+    void StopAccepting();
+
+    // Stop the HTTP server and wait for requests in progress to finish
     void Stop();
 
-    // Check if server is running
+    // Stop and start again with a new host/port (config hot-reload)
+    bool Restart(const ServerConfig& cfg);
+
+    // Check if server is running (on TCP or the local socket)
     bool IsRunning() const;
+    bool IsTcpRunning() const;
 
     // Get current configuration
     ServerConfig GetConfig() const;
@@ -0,0 +1,89 @@
+#ifndef IDEMPOTENCY_TABLE_H
+#define IDEMPOTENCY_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Responses of recent requests by client-chosen idempotency key
+//
+// Clients that retry on timeout (I2C writes take 50-200 ms, more behind a
+// queue) often retry while the original is still running. A retry with the
+// same key must not reach the bus again: if the original is in flight the
+// retry waits for it and gets its response, if it has completed the retry
+// gets the stored response straight away.
+//
+// Entries expire IDEMPOTENCY_TTL_MS after they complete and the table holds at
+// most IDEMPOTENCY_MAX_KEYS, dropping the oldest completed entry when full.
+// Server errors (5xx) are handed to the retries that were waiting for them and
+// then forgotten, so a later retry runs the command again: a dropped or failed
+// command is the one result a client retries on purpose.
+class IdempotencyTable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Response {
+        int status = 0;
+        std::string body;
+        std::string content_type;
+    };
+
+    enum class Claim {
+        New,            // First request with this key: run it, then Complete()
+        Replay,         // Duplicate; response holds the original's response
+        Mismatch,       // Key was used for a different request
+        Busy,           // Original still running after max_wait
+        Full            // Table full of requests in flight; run it without a key
+    };
+
+    struct Stats {
+        size_t keys = 0;                // Entries held (in flight and completed)
+        size_t in_flight = 0;
+        uint64_t replayed = 0;          // Duplicates answered from a completed entry
+        uint64_t joined = 0;            // Duplicates that waited for the original
+        uint64_t mismatched = 0;
+        uint64_t evicted = 0;           // Completed entries dropped before expiry because the table was full
+    };
+
+    IdempotencyTable();
+
+    // Look up key for a request with the given fingerprint (hash of what makes
+    // it the same request). Waits up to max_wait for an original in flight.
+    Claim Begin(const std::string& key, uint64_t fingerprint, Clock::duration max_wait, Response& response);
+
+    // Store the response of a request that got Claim::New and wake its duplicates
+    void Complete(const std::string& key, const Response& response);
+
+    Stats GetStats();
+
+private:
+    struct Entry {
+        uint64_t fingerprint = 0;
+        bool done = false;
+        Response response;
+        Clock::time_point completed;
+    };
+
+    std::mutex table_mutex;
+    std::condition_variable done_cv;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+    Stats stats;
+
+    void Expire(Clock::time_point now);
+    bool EvictOldest();
+};
+
+// Keys are 1-255 printable ASCII characters (a UUID in practice)
+bool IsValidIdempotencyKey(const std::string& key);
+
+// How long a completed response is kept, and the most keys held
+constexpr int IDEMPOTENCY_TTL_MS = 10 * 60 * 1000;
+constexpr size_t IDEMPOTENCY_MAX_KEYS = 1024;
+constexpr size_t IDEMPOTENCY_MAX_KEY_LENGTH = 255;
+
+#endif // IDEMPOTENCY_TABLE_H
@@ -3,12 +3,32 @@
 
 #include <windows.h>
 #include "nvapi.h"
+#include "ddc_packet.h"
+#include "ddc_transport.h"
 
 // Function declarations for monitor control functionality
 BOOL WriteValueToMonitor(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, BYTE input_value, BYTE command_code, BYTE register_address);
 
-// Helper function for I2C checksum calculation
-void CalculateI2cChecksum(const NV_I2C_INFO& i2cInfo);
+// Send a pre-encoded DDC packet (see ddc_packet.h / vcp_commands.h)
+BOOL WriteDdcPacket(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, const DdcPacket& packet);
+
+// Read a VCP feature's current and maximum value ("get VCP feature" + reply)
+BOOL ReadVcpFeature(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, BYTE command_code,
+                    WORD* current_value, WORD* maximum_value, BYTE register_address = DDC_VCP_REGISTER);
+
+// DdcTransport over NvAPI I2C for one display output (used by DisplayExecutor)
+class NvApiTransport : public DdcTransport {
+public:
+    NvApiTransport(NvPhysicalGpuHandle gpu, NvU32 output_id) : gpu(gpu), output_id(output_id) {}
+
+    bool Write(const DdcPacket& packet) override;
+    bool Read(uint8_t command_code, uint8_t register_address,
+              uint16_t* current_value, uint16_t* maximum_value) override;
+
+private:
+    NvPhysicalGpuHandle gpu;
+    NvU32 output_id;
+};
 
 // Initialization and cleanup functions
 bool InitializeNvidiaAPI();
@@ -19,5 +39,7 @@ bool EnumerateDisplays(NvDisplayHandle* displays, int* count);
 bool GetGpuFromDisplay(NvDisplayHandle display, NvPhysicalGpuHandle* gpu, NvU32* outputId);
 bool SelectDisplay(int display_index);
 
-#endif // MONITOR_CONTROL_H
+// Copy the first EDID block (up to NV_EDID_DATA_SIZE bytes) of the monitor on an output
+bool ReadDisplayEdid(NvPhysicalGpuHandle gpu, NvU32 outputId, NvU8* edid, NvU32* size);
 
+#endif // MONITOR_CONTROL_H
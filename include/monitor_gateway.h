@@ -0,0 +1,120 @@
+#ifndef MONITOR_GATEWAY_H
+#define MONITOR_GATEWAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Extra wait for a link's reply past its deadline before it is reported as
+// timed out; the link enforces the deadline itself with socket timeouts
+constexpr int GATEWAY_REPLY_GRACE_MS = 250;
+constexpr int GATEWAY_MAX_TIMEOUT_MS = 60000;
+constexpr int GATEWAY_DEFAULT_PORT = 45678;
+
+// One downstream monitor-control instance
+struct GatewayHost {
+    std::string name;               // "<host>:<port>", as reported
+    std::string host;
+    int port = GATEWAY_DEFAULT_PORT;
+
+    bool operator==(const GatewayHost& other) const { return host == other.host && port == other.port; }
+};
+
+// Parse GATEWAY_HOSTS: "<host>[:<port>], ..." with the default port 45678.
+// False with a message naming the first bad or repeated entry.
+bool ParseGatewayHosts(const std::string& text, std::vector<GatewayHost>& hosts, std::string& error);
+
+// GATEWAY_* keys of config.env
+struct GatewaySettings {
+    std::vector<GatewayHost> hosts;     // GATEWAY_HOSTS (empty = off)
+    int timeout_ms = 2000;              // GATEWAY_TIMEOUT_MS: longest wait for one host's reply
+
+    bool IsEnabled() const { return !hosts.empty(); }
+
+    bool operator==(const GatewaySettings& other) const {
+        return hosts == other.hosts && timeout_ms == other.timeout_ms;
+    }
+    bool operator!=(const GatewaySettings& other) const { return !(*this == other); }
+};
+
+// A request to send to several hosts
+struct GatewayRequest {
+    std::string method = "GET";
+    std::string path;                   // Downstream path with any query string, e.g. "/api/status"
+    std::string body;
+    std::string content_type = "application/json";
+    std::vector<std::pair<std::string, std::string>> headers;  // Sent as is (Idempotency-Key, X-Priority)
+    std::vector<std::string> hosts;     // Names or host parts of the hosts to send to (empty = all)
+    int timeout_ms = 0;                 // Per host (0 = the configured timeout)
+};
+
+// What one host answered
+struct GatewayReply {
+    std::string host;                   // GatewayHost::name, or the unknown name asked for
+    int status = 0;                     // HTTP status, 0 if the host did not answer
+    std::string body;
+    std::string error;                  // Why the host did not answer
+    bool timed_out = false;
+    int elapsed_ms = 0;
+
+    bool Succeeded() const { return status >= 200 && status < 300; }
+};
+
+struct GatewayHostStats {
+    std::string host;
+    bool connected = false;             // A kept-alive connection is open
+    int queued = 0;                     // Requests waiting behind the one in progress
+    uint64_t requests = 0;              // Requests sent or failed
+    uint64_t failures = 0;              // No answer (connection refused, timeout, ...)
+    uint64_t timeouts = 0;              // Of the failures: no answer in time
+    int consecutive_failures = 0;
+    int last_elapsed_ms = 0;
+    std::string last_error;
+};
+
+// Gateway that sends one request to many monitor-control instances at once
+//
+// For facility-wide actions (dim every floor display at 19:00) without a
+// script looping over hosts. Every host has a link: a worker thread that owns
+// one kept-alive HTTP connection to it and sends the link's requests in turn,
+// so a slow or unreachable host only holds up its own link. A fan-out queues
+// the request on every link at once and waits for all of them, each bounded
+// by the timeout: a request still queued at its deadline is never sent, and
+// the deadline is passed on as X-Deadline-Ms so the host drops the command
+// too if its monitor queue cannot run it in time. Replies come back in the
+// order the hosts are configured.
+class MonitorGateway {
+public:
+    MonitorGateway();
+    ~MonitorGateway();
+
+    MonitorGateway(const MonitorGateway&) = delete;
+    MonitorGateway& operator=(const MonitorGateway&) = delete;
+
+    // Open a link to every host, replacing any from an earlier Start();
+    // false if there are no hosts
+    bool Start(const GatewaySettings& settings);
+    // Fail queued requests, close the connections and join the links
+    void Stop();
+    bool IsRunning();
+
+    GatewaySettings GetSettings();
+
+    // Send the request to every host (or the ones named) and wait for every
+    // reply or timeout. A name that matches no host gets a reply with an error.
+    std::vector<GatewayReply> FanOut(const GatewayRequest& request);
+
+    std::vector<GatewayHostStats> GetHostStats();
+
+private:
+    class HostLink;
+
+    std::mutex gateway_mutex;
+    GatewaySettings settings;
+    std::vector<std::shared_ptr<HostLink>> links;   // In settings.hosts order
+};
+
+#endif // MONITOR_GATEWAY_H
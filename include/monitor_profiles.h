@@ -0,0 +1,145 @@
+#ifndef MONITOR_PROFILES_H
+#define MONITOR_PROFILES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include "vcp_commands.h"
+
+// Per-model monitor profiles
+//
+// Input codes, the input-switch register, value ranges and timing quirks
+// differ between brands. A profile holds them for one model, keyed by the
+// EDID manufacturer ID and product code; product MONITOR_PROFILE_ANY_PRODUCT
+// matches every model of a manufacturer that has no entry of its own.
+// Displays without a matching profile use the built-in LG Ultragear profile
+// (INPUT_SOURCES in vcp_commands.h).
+//
+// Profiles are written as a .env-style source file
+//   <id>.edid=GSM:5BBF | GSM:*
+//   <id>.model=LG Ultragear 27GP850-B
+//   <id>.input_register=0x50, <id>.input_code=0xF4
+//   <id>.inputs=HDMI 1:0x90, HDMI 2:0x91, DisplayPort:0xD0, USB-C:0xD1
+//   <id>.brightness=0-100, <id>.contrast=0-100     (raw VCP values for 0% and 100%)
+//   <id>.input_quiet_ms=1500                       (silence after an input switch)
+// and compiled by profile_compiler into a binary database that the app maps
+// into memory at startup (MonitorProfileDb). Finding a profile hashes into
+// the mapped table and decodes one record, so the number of models costs
+// nothing at startup.
+
+constexpr int MAX_PROFILE_INPUTS = 8;
+constexpr size_t PROFILE_MODEL_SIZE = 32;          // Including the terminating NUL
+constexpr size_t PROFILE_INPUT_NAME_SIZE = 15;
+constexpr uint16_t MONITOR_PROFILE_ANY_PRODUCT = 0xFFFF;
+
+struct ProfileInput {
+    char name[PROFILE_INPUT_NAME_SIZE + 1] = {};
+    uint8_t value = 0;                  // Raw value written to the input register
+};
+
+struct MonitorProfile {
+    uint16_t manufacturer = 0;          // EDID manufacturer ID (packed PNP letters), 0 = built-in
+    uint16_t product = 0;
+    char model[PROFILE_MODEL_SIZE] = {};
+    uint8_t input_register = LG_INPUT_REGISTER;
+    uint8_t input_code = LG_INPUT_COMMAND;
+    int input_count = 0;
+    ProfileInput inputs[MAX_PROFILE_INPUTS];    // API input value = index + 1
+    uint16_t brightness_min = 0;        // Raw VCP values sent for 0% and 100%
+    uint16_t brightness_max = 100;
+    uint16_t contrast_min = 0;
+    uint16_t contrast_max = 100;
+    uint16_t input_quiet_ms = 1500;     // Matches INPUT_SWITCH_QUIET_MS for the built-in profile
+
+    // API input value (1-based) -> input, or nullptr
+    const ProfileInput* FindInput(int api_value) const;
+    // Raw input register value -> API input value, or 0 if unknown
+    int FindApiValue(uint16_t raw_value) const;
+};
+
+// The LG Ultragear profile built from INPUT_SOURCES
+const MonitorProfile& BuiltInMonitorProfile();
+
+// EDID identity of a monitor
+struct EdidId {
+    uint16_t manufacturer = 0;
+    uint16_t product = 0;
+};
+
+// Read the identity from an EDID base block; false if it is too short or the header is wrong
+bool ParseEdidId(const uint8_t* edid, size_t size, EdidId& id);
+
+// "GSM" <-> packed manufacturer ID
+std::string ManufacturerCode(uint16_t manufacturer);
+bool ParseManufacturerCode(const std::string& code, uint16_t& manufacturer);
+
+// "GSM:5BBF", or "GSM:*" for MONITOR_PROFILE_ANY_PRODUCT
+std::string FormatEdidId(uint16_t manufacturer, uint16_t product);
+
+// Parse a profile source file; false with a message naming the first bad key
+bool LoadProfileSource(const std::string& path, std::vector<MonitorProfile>& profiles, std::string& error);
+
+// Write the binary database; false if two profiles share an EDID ID or the file cannot be written
+bool WriteProfileDb(const std::string& path, const std::vector<MonitorProfile>& profiles, std::string& error);
+
+// Read-only view of a compiled profile database mapped into memory
+//
+// File layout, all integers little-endian:
+//   header (32 bytes): "MONPROF1", u32 version, u32 record size,
+//                      u32 bucket count (power of two), u32 record count, 8 reserved
+//   buckets:           u32 per bucket, 0 = empty, otherwise record index + 1
+//                      (open addressing with linear probing, at most half full)
+//   records:           PROFILE_RECORD_SIZE bytes each (see EncodeProfile)
+class MonitorProfileDb {
+public:
+    MonitorProfileDb();
+    ~MonitorProfileDb();
+
+    MonitorProfileDb(const MonitorProfileDb&) = delete;
+    MonitorProfileDb& operator=(const MonitorProfileDb&) = delete;
+
+    // Map a database file; false (with a message) if missing or not a valid database
+    bool Open(const std::string& path, std::string& error);
+    void Close();
+    bool IsOpen() const { return data != nullptr; }
+
+    // Exact model first, then the manufacturer-wide entry; false if neither exists
+    bool Find(uint16_t manufacturer, uint16_t product, MonitorProfile& profile) const;
+
+    size_t GetProfileCount() const { return record_count; }
+
+private:
+    bool FindExact(uint32_t key, MonitorProfile& profile) const;
+
+    const uint8_t* data;
+    size_t size;
+    uint32_t bucket_count;
+    uint32_t record_count;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+};
+
+// Profile of each display, set once the displays are identified and read by
+// everything that encodes a command (MakeVcpWrite, the GUI, the executors)
+class DisplayProfiles {
+public:
+    static void Set(int display_index, const MonitorProfile& profile);
+    // The display's profile, or the built-in one if it has not been identified
+    static std::shared_ptr<const MonitorProfile> Get(int display_index);
+
+private:
+    static std::mutex profiles_mutex;
+    static std::vector<std::shared_ptr<const MonitorProfile>> profiles;
+};
+
+constexpr char PROFILE_DB_MAGIC[8] = { 'M', 'O', 'N', 'P', 'R', 'O', 'F', '1' };
+constexpr uint32_t PROFILE_DB_VERSION = 1;
+constexpr size_t PROFILE_DB_HEADER_SIZE = 32;
+constexpr size_t PROFILE_RECORD_SIZE = 180;
+
+#endif // MONITOR_PROFILES_H
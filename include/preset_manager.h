@@ -0,0 +1,76 @@
+#ifndef PRESET_MANAGER_H
+#define PRESET_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+// Marks a setting as unknown (display state) or "leave unchanged" (presets)
+constexpr int VCP_VALUE_UNSET = -1;
+
+// Settings tracked per display
+enum class VcpSetting {
+    Brightness,
+    Contrast,
+    Input
+};
+
+// Brightness/contrast (0-100) and input source (1-based API value) of one display
+struct DisplaySettings {
+    int brightness = VCP_VALUE_UNSET;
+    int contrast = VCP_VALUE_UNSET;
+    int input = VCP_VALUE_UNSET;
+
+    int Get(VcpSetting setting) const;
+    void Set(VcpSetting setting, int value);
+    bool IsEmpty() const;
+};
+
+// Target settings for one display inside a preset
+struct PresetEntry {
+    int display_index = 0;
+    DisplaySettings settings;
+};
+
+// Named multi-display preset
+struct Preset {
+    std::string name;
+    std::vector<PresetEntry> displays;
+};
+
+// Named presets persisted in a .env-style file:
+//   <name>.<display_index>.<brightness|contrast|input>=<value>
+class PresetManager {
+private:
+    std::mutex presets_mutex;
+    std::string file_path;
+    std::map<std::string, Preset> presets;
+
+    // Rewrite the presets file from the in-memory map (presets_mutex held)
+    bool SaveLocked();
+
+public:
+    PresetManager();
+
+    // Load presets from file; built-in quick presets are used if the file doesn't exist
+    bool LoadFromFile(const std::string& filename);
+
+    // Lookup / enumeration
+    bool GetPreset(const std::string& name, Preset& preset);
+    std::vector<Preset> ListPresets();
+
+    // Create or replace a preset and persist it
+    bool SavePreset(const Preset& preset, std::string& error);
+
+    // Delete a preset and persist the change
+    bool DeletePreset(const std::string& name);
+
+    // Names are used in file keys and URLs: letters, digits, '-' and '_'
+    static bool IsValidName(const std::string& name);
+
+    // Range checks for every entry
+    static bool ValidatePreset(const Preset& preset, std::string& error);
+};
+
+#endif // PRESET_MANAGER_H
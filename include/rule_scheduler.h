@@ -0,0 +1,129 @@
+#ifndef RULE_SCHEDULER_H
+#define RULE_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <cstdint>
+#include "timer_wheel.h"
+#include "display_executor.h"
+#include "preset_manager.h"
+#include "transition_engine.h"
+
+class ThreadSafeMonitorControl;
+
+// When a rule fires
+struct RuleTrigger {
+    enum class Type { Cron, Sunrise, Sunset };
+    Type type = Type::Cron;
+
+    // Cron fields as bitmasks: minute 0-59, hour 0-23, day 1-31, month 1-12, weekday 0-6 (0 = Sunday)
+    uint64_t minutes = 0;
+    uint32_t hours = 0;
+    uint32_t days = 0;
+    uint16_t months = 0;
+    uint8_t weekdays = 0;
+    bool any_day = true;        // Day-of-month field was '*'
+    bool any_weekday = true;    // Day-of-week field was '*'
+
+    // Sunrise/sunset offset
+    int offset_minutes = 0;
+};
+
+// What a rule does when it fires
+struct RuleAction {
+    enum class Type { Preset, Brightness, Contrast, Input };
+    Type type = Type::Preset;
+    std::string preset;
+    int value = 0;
+    int display_index = 0;
+    int duration_ms = 0;        // Brightness/contrast only: fade instead of jumping
+    Easing easing = Easing::Linear;
+};
+
+struct ScheduleRule {
+    std::string name;
+    std::string trigger_text;
+    std::string action_text;
+    RuleTrigger trigger;
+    RuleAction action;
+    bool enabled = true;
+
+    time_t next_fire = 0;       // 0 = not scheduled
+    time_t last_fire = 0;
+    bool last_result = false;
+    int fire_count = 0;
+};
+
+// Parse "cron <min> <hour> <dom> <month> <dow>", "sunrise [+-minutes]", "sunset [+-minutes]"
+bool ParseRuleTrigger(const std::string& text, RuleTrigger& trigger, std::string& error);
+
+// Parse "preset <name>", "brightness <0-100>", "contrast <0-100>", "input <1-MAX_PROFILE_INPUTS>"
+bool ParseRuleAction(const std::string& text, RuleAction& action, std::string& error);
+
+// In-process scheduler for time-based rules
+//
+// Rules are loaded from a .env-style file:
+//   <rule>.trigger=cron 0 20 * * 1-5 | sunrise +15 | sunset -30
+//   <rule>.action=preset dark | brightness 30 | contrast 40 | input 3
+//   <rule>.display=0, <rule>.duration_ms=600000, <rule>.easing=ease-in-out, <rule>.enabled=true
+//
+// Each enabled rule has exactly one timer (its next fire time, in seconds) in
+// a hierarchical timer wheel. The scheduler thread sleeps until the wheel's
+// next expiry, so thousands of idle rules cost no CPU.
+class RuleScheduler {
+private:
+    ThreadSafeMonitorControl* monitor_control;
+    PresetManager* preset_manager;
+
+    std::thread scheduler_thread;
+    std::mutex scheduler_mutex;
+    std::condition_variable scheduler_cv;
+    bool stopping;
+    bool running;
+
+    std::vector<ScheduleRule> rules;   // Timer id = index into rules
+    TimerWheel wheel;
+
+    double latitude;
+    double longitude;
+    bool has_location;
+
+    // Scheduler thread function
+    void SchedulerThreadFunc();
+
+    // Compute and arm the next fire time after 'after' (scheduler_mutex held)
+    void ScheduleNext(size_t index, time_t after);
+
+    // Earliest time strictly after 'after' at which the trigger matches; 0 if none within a year
+    time_t NextFireTime(const RuleTrigger& trigger, time_t after) const;
+
+    // Execute a rule's action (called without scheduler_mutex). Rules fired by
+    // the timer run in the bulk lane, manual triggers in the interactive one.
+    bool RunAction(const RuleAction& action, DisplayExecutor::Lane lane);
+
+public:
+    RuleScheduler(ThreadSafeMonitorControl* control, PresetManager* presets);
+    ~RuleScheduler();
+
+    // Load rules; latitude/longitude are needed only for sunrise/sunset rules
+    bool LoadFromFile(const std::string& filename, double lat, double lon, bool location_known);
+
+    void Start();
+    void Stop();
+
+    // Snapshot of all rules with their next/last fire times
+    std::vector<ScheduleRule> ListRules();
+
+    // Run a rule's action now (does not change its schedule)
+    bool TriggerRule(const std::string& name, std::string& error);
+};
+
+// Local sunrise/sunset for the calendar day containing 'day' (local time);
+// false during polar day/night
+bool ComputeSunEvent(time_t day, double latitude, double longitude, bool sunrise, time_t& event_time);
+
+#endif // RULE_SCHEDULER_H
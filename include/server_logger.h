@@ -0,0 +1,24 @@
+#ifndef SERVER_LOGGER_H
+#define SERVER_LOGGER_H
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// Simple file logger for debugging HTTP server issues
+class ServerLogger {
+public:
+    static void Init(const std::string& log_path);
+    static void Log(const char* level, const char* format, ...);
+    static void Close();
+
+    // Drop messages below level ("DEBUG", "INFO", "WARN", "ERROR"); checked without locking
+    static void SetLevel(const std::string& level);
+private:
+    static std::ofstream log_file;
+    static std::mutex log_mutex;
+    static std::atomic<int> min_level;
+};
+
+#endif // SERVER_LOGGER_H
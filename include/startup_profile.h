@@ -0,0 +1,67 @@
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+// Timing of the phases of one startup
+//
+// Startup stalls have come from WSAStartup, getaddrinfo, bind, NvAPI_Initialize
+// and display enumeration, and the log alone never said which. Every phase is
+// timed with the steady clock against the moment the profile was created (the
+// process start, for a static instance), so phases on other threads, such as
+// the HTTP bind, line up with the rest. Phases may overlap and may be recorded
+// from any thread.
+class StartupProfile {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase {
+        std::string name;
+        double start_ms = 0.0;          // Since the profile was created
+        double duration_ms = 0.0;
+        bool ok = true;
+        std::string detail;             // Why it failed, or what it found
+    };
+
+    // Times a phase from construction until End() or destruction. A null
+    // profile records nothing, so callers need no checks.
+    class Timer {
+    public:
+        Timer(StartupProfile* profile, const std::string& name);
+        ~Timer();
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        void End(bool ok = true, const std::string& detail = "");
+
+    private:
+        StartupProfile* profile;
+        std::string name;
+        Clock::time_point start;
+        bool ended;
+    };
+
+    StartupProfile();
+
+    void Record(const std::string& name, Clock::time_point start, Clock::time_point end, bool ok = true,
+                const std::string& detail = "");
+
+    // Phases ordered by start time
+    std::vector<Phase> GetPhases();
+
+    // End of the last phase to finish, since the profile was created
+    double GetElapsedMs();
+
+    Clock::time_point GetStart() const { return start; }
+
+private:
+    std::mutex profile_mutex;
+    Clock::time_point start;
+    std::vector<Phase> phases;
+};
+
+#endif // STARTUP_PROFILE_H
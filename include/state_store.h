@@ -0,0 +1,69 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include "preset_manager.h"
+
+// Last known settings of each display, kept in a small file mapped into memory
+//
+// Reading every VCP value back over DDC takes seconds, so the app restores
+// the last values it wrote from here at startup instead. Saving only stores
+// into the mapping and starts an asynchronous flush; the OS writes the page
+// back even if the process crashes right after.
+//
+// Every display has two record slots written alternately, each with a
+// sequence number and a checksum. A save overwrites the older slot and a
+// load takes the valid slot with the higher sequence, so a save cut short
+// by a power loss leaves the previous value readable.
+//
+// File layout, all integers little-endian:
+//   header (16 bytes): "MCSTATE1", u32 version, u32 slots per file (STATE_MAX_DISPLAYS)
+//   records:           2 per display, STATE_RECORD_SIZE bytes each:
+//                      u32 sequence (0 = never written), i32 brightness, i32 contrast,
+//                      i32 input (VCP_VALUE_UNSET if unknown), u64 saved at (Unix time),
+//                      u32 FNV-1a of the preceding 24 bytes, 4 reserved
+class StateStore {
+public:
+    StateStore();
+    ~StateStore();
+
+    StateStore(const StateStore&) = delete;
+    StateStore& operator=(const StateStore&) = delete;
+
+    // Map the state file, creating it if missing; a file that is not a state
+    // file of this version is started afresh. False with a message if it
+    // cannot be created or mapped.
+    bool Open(const std::string& path, std::string& error);
+    void Close();
+    bool IsOpen() const { return data != nullptr; }
+
+    // Newest intact record of a display; false if it has none
+    bool Load(int display_index, DisplaySettings& settings, time_t& saved_at) const;
+
+    // Store a display's settings; false if closed or the display is out of range
+    bool Save(int display_index, const DisplaySettings& settings);
+
+private:
+    // Index of the display's newest intact slot (0 or 1), or -1 if neither is
+    int NewestSlot(int display_index, uint32_t& sequence) const;
+    uint8_t* Record(int display_index, int slot) const;
+
+    uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+};
+
+constexpr char STATE_FILE_MAGIC[8] = { 'M', 'C', 'S', 'T', 'A', 'T', 'E', '1' };
+constexpr uint32_t STATE_FILE_VERSION = 1;
+constexpr size_t STATE_FILE_HEADER_SIZE = 16;
+constexpr size_t STATE_RECORD_SIZE = 32;
+constexpr int STATE_MAX_DISPLAYS = 16;
+constexpr size_t STATE_FILE_SIZE = STATE_FILE_HEADER_SIZE + STATE_MAX_DISPLAYS * 2 * STATE_RECORD_SIZE;
+
+#endif // STATE_STORE_H
@@ -3,19 +3,84 @@
 
 #include <mutex>
 #include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <windows.h>
 #include "nvapi.h"
+#include "vcp_commands.h"
+#include "preset_manager.h"
+#include "display_executor.h"
+#include "transition_engine.h"
+#include "monitor_profiles.h"
+#include "ddc_sequence.h"
+#include "state_store.h"
+
+class DdcRecorder;
 
 // Forward declaration
 struct AppState;
 
-// Input source mapping for LG Ultragear monitors
-struct InputSourceMapping {
-    int api_value;          // 1-4 from API
-    const char* name;       // Display name
-    BYTE input_value;       // Value to send to monitor
-    BYTE command_code;      // Command code (0xF4 for LG)
-    BYTE register_address;  // Register address (0x50 for LG)
+// One VCP write targeting a specific display
+struct VcpWrite {
+    int display_index = 0;
+    VcpSetting setting = VcpSetting::Brightness;
+    int value = 0;
+    DdcPacket packet;
+    DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE;  // Dropped if still queued after this
+    DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive;
+};
+
+// Encode a write for a setting/value pair; false if the value is out of range
+bool MakeVcpWrite(int display_index, VcpSetting setting, int value, VcpWrite& write);
+
+// Outcome of a diffed multi-display apply
+struct ApplyResult {
+    int writes_sent = 0;      // VCP writes that reached the monitor
+    int writes_skipped = 0;   // Already at the target value
+    int writes_failed = 0;    // I2C write failed or display unavailable
+};
+
+// Input-switch activity summed over all displays
+struct InputSwitchStatus {
+    int switching_displays = 0;     // Displays currently waiting for the monitor to answer
+    DisplayExecutor::Stats totals;  // last_settle_ms is the longest of any display
+};
+
+// Circuit breaker state of one display that has been written to
+struct DisplayHealth {
+    int display_index = 0;
+    DisplayExecutor::BreakerState breaker = DisplayExecutor::BreakerState::Closed;
+    DisplayExecutor::Stats stats;
+};
+
+// How one display was identified (see IdentifyDisplays)
+struct DisplayProfileInfo {
+    int display_index = 0;
+    bool edid_read = false;         // False if the monitor's EDID could not be read
+    EdidId edid;
+    bool matched = false;           // A database profile matched; otherwise the built-in one is used
+    std::shared_ptr<const MonitorProfile> profile;
+};
+
+// A named macro (see CompileDdcMacro)
+struct StoredMacro {
+    std::string name;
+    std::string source;
+    bool from_config = false;       // MACRO_<name> in config.env: replaced on reload, read-only through the API
+    std::shared_ptr<const DdcProgram> program;
+};
+
+// Outcome of ThreadSafeMonitorControl::Shutdown
+struct ShutdownReport {
+    int displays = 0;               // Display queues stopped
+    uint64_t failed_commands = 0;   // Queued commands failed at the deadline
+    int elapsed_ms = 0;
+    int abandoned = 0;              // Display queues left on a bus transaction at the deadline
+    bool met_deadline = true;       // False if a bus transaction outlived the deadline
 };
 
 // Thread-safe wrapper for monitor control operations
@@ -24,22 +89,216 @@ private:
     std::mutex state_mutex;
     AppState* app_state;
 
-    static const InputSourceMapping input_mappings[4];
+    // Last value successfully written to each display, or restored from the
+    // state file at startup (guarded by state_mutex)
+    std::vector<DisplaySettings> known_state;
+
+    // Restored values not yet confirmed by a write or a read: one bit per
+    // VcpSetting (guarded by state_mutex)
+    std::vector<uint8_t> unverified;
+
+    // Where known_state is persisted (guarded by state_mutex)
+    StateStore state_store;
+
+    // Result of IdentifyDisplays (guarded by state_mutex)
+    std::vector<DisplayProfileInfo> display_profiles;
+
+    // Bumped after anything GET /api/status reports as state changes
+    std::mutex version_mutex;
+    std::condition_variable version_cv;
+    uint64_t state_version;
+    uint64_t wake_generation;       // WakeStateWaiters() calls
+
+    // One command queue per display, created on first use
+    std::mutex executor_mutex;
+    std::vector<std::unique_ptr<DisplayExecutor>> executors;
+    std::shared_ptr<DdcRecorder> recorder;     // Set by StartRecording (guarded by executor_mutex)
+
+    // Named display groups from config.env (guarded by groups_mutex)
+    std::mutex groups_mutex;
+    std::map<std::string, std::vector<int>> display_groups;
+
+    // Timed brightness/contrast transitions
+    std::unique_ptr<TransitionEngine> transitions;
+
+    // Multi-step DDC sequences and macros (RunProgram)
+    std::unique_ptr<SequenceRunner> sequences;
+
+    // Compiled macros by name (guarded by macros_mutex)
+    std::mutex macros_mutex;
+    std::map<std::string, StoredMacro> macros;
+
+    // WriteLatest: at most one write in flight per display/setting, newer
+    // values replace the pending one (guarded by latest_mutex)
+    struct LatestSlot {
+        bool in_flight = false;
+        bool has_pending = false;
+        VcpWrite pending;
+        DisplayExecutor::Completion pending_done;
+    };
+    std::mutex latest_mutex;
+    std::map<std::pair<int, VcpSetting>, LatestSlot> latest_slots;
+    bool latest_stopping = false;
+
+    // Set by Shutdown(); no executor is created or fed afterwards
+    std::atomic<bool> shutting_down;
+
+    void SendLatest(const VcpWrite& write, DisplayExecutor::Completion on_complete);
+
+    DisplayExecutor* GetExecutor(int display_index);
+
+    // Encode a raw write that sets brightness, contrast or a profile input as a VcpWrite; false otherwise
+    bool MatchSettingWrite(int display_index, uint8_t command_code, uint16_t value, uint8_t register_address,
+                           VcpWrite& write);
+
+    // Update known_state (and the GUI mirror for the selected display) after a successful write
+    void RecordWrite(const VcpWrite& write);
+
+    // Set a confirmed value in known_state, the state file and the GUI mirror (state_mutex held)
+    void SetKnownValueLocked(int display_index, VcpSetting setting, int value);
 
 public:
     ThreadSafeMonitorControl(AppState* state);
+    ~ThreadSafeMonitorControl();
+
+    // Thread-safe monitor control operations; a command still queued at its
+    // deadline is dropped and the call returns false
+    bool SetBrightness(float brightness, DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                       DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+    bool SetContrast(float contrast, DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                     DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+    bool SetInputSource(int source, DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                        DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive); // 1=HDMI 1, 2=HDMI 2, 3=DisplayPort, 4=USB-C
+
+    // Send a single write through the display's queue and record it.
+    // Cancels any transition running on the same display/setting.
+    bool Write(const VcpWrite& write);
+
+    // Queue a write without waiting; the known state is updated before on_complete runs.
+    // Does not cancel transitions (the transition engine itself uses this).
+    void SubmitWrite(const VcpWrite& write, DisplayExecutor::Completion on_complete);
+
+    // Arbitrary VCP access (CLI forwarding via /api/vcp). Writes that match a
+    // known setting go through Write() so known state and transitions stay consistent.
+    bool WriteRaw(int display_index, uint8_t command_code, uint16_t value, uint8_t register_address,
+                  DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                  DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+    bool ReadRaw(int display_index, uint8_t command_code, uint8_t register_address,
+                 uint16_t& current_value, uint16_t& maximum_value,
+                 DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                 DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+
+    // Run a multi-step sequence (see ddc_sequence.h) on a display's queue and
+    // wait for it. Only the caller waits: between steps the sequence holds no
+    // thread and other commands for the display run. False if the display is
+    // unavailable; result says how far the sequence got.
+    bool RunSequence(int display_index, const std::vector<SequenceStep>& steps, SequenceResult& result,
+                     DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                     DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+
+    // Run a compiled sequence or macro the same way. Its bus steps go to
+    // display_index until it picks a display; false if that or any display
+    // the program names is unavailable.
+    bool RunProgram(std::shared_ptr<const DdcProgram> program, int display_index, SequenceResult& result,
+                    DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                    DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+
+    // Replace the macros from config.env (MACRO_<name>=<steps separated by ';'>);
+    // macros stored through the API are kept unless config.env defines the name.
+    // Sources that do not compile are skipped.
+    void SetConfigMacros(const std::map<std::string, std::string>& sources);
+
+    // Compile and store a macro. False with error if it does not compile or
+    // config.env defines the name.
+    bool StoreMacro(const std::string& name, const std::string& source, std::string& error);
+    bool DeleteMacro(const std::string& name);     // False if missing or from config.env
+    bool GetMacro(const std::string& name, StoredMacro& macro);
+    std::vector<StoredMacro> GetMacros();
 
-    // Thread-safe monitor control operations
-    bool SetBrightness(float brightness);
-    bool SetContrast(float contrast);
-    bool SetInputSource(int source); // 1=HDMI 1, 2=HDMI 2, 3=DisplayPort, 4=USB-C
+    // For high-rate sources (control surfaces, sensors): cancel any transition and
+    // queue the write, but keep only the newest value while one is in flight so a
+    // slow bus never builds a backlog. Returns false if it replaced a pending value.
+    // on_complete runs on the executor thread once the value was sent; it is
+    // dropped without running if a newer value replaces it first.
+    bool WriteLatest(const VcpWrite& write, DisplayExecutor::Completion on_complete = nullptr);
+
+    // Move a brightness/contrast setting of a display to target over duration_ms
+    bool StartTransition(int display_index, VcpSetting setting, int target, int duration_ms, Easing easing);
+    int GetActiveTransitionCount();
+
+    InputSwitchStatus GetInputSwitchStatus();
+    std::vector<DisplayHealth> GetDisplayHealth();
+
+    // Replace the named display groups (GROUP_<name>=0,1,... in config.env)
+    void SetDisplayGroups(const std::map<std::string, std::vector<int>>& groups);
+    std::map<std::string, std::vector<int>> GetDisplayGroups();
+
+    // Write one setting to every display of a group at the same moment: all
+    // packets are encoded and queued first, then released together behind a
+    // CommitBarrier. Returns once every member has completed or failed;
+    // false if the group does not exist or the value is out of range.
+    bool CommitGroup(const std::string& group, VcpSetting setting, int value, GroupCommitResult& result,
+                     DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                     DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+
+    // Read every display's EDID and pick its profile from db (exact model,
+    // then manufacturer-wide, else built-in) for DisplayProfiles. Call before
+    // any I/O: a display's queue takes its input-switch quirks from the
+    // profile when it is created. Returns the number of displays matched.
+    int IdentifyDisplays(const MonitorProfileDb& db);
+    std::vector<DisplayProfileInfo> GetDisplayProfiles();
+
+    // Log every bus transaction to path (see ddc_log.h). Only displays whose
+    // queue is created afterwards are recorded, so call it before any I/O.
+    bool StartRecording(const std::string& path);
+
+    // Stop all monitor I/O within timeout_ms (< 0 = drain everything): new commands
+    // fail at once, queued ones run until the deadline and the rest fail, then the
+    // display workers are joined. Only the first call does anything.
+    ShutdownReport Shutdown(int timeout_ms);
+    bool IsShuttingDown() const { return shutting_down; }
+
+    // Send only the writes whose value differs from the known state;
+    // writes for different displays run in parallel
+    ApplyResult ApplyWrites(const std::vector<VcpWrite>& writes);
+    ApplyResult ApplyPreset(const Preset& preset, DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE,
+                            DisplayExecutor::Lane lane = DisplayExecutor::Lane::Interactive);
+
+    // Version of the state reported by GET /api/status: settings, selected
+    // display, status message, transitions and display health. Incremented
+    // after every change made through this class; code that changes the GUI
+    // state directly calls NotifyStateChanged() itself.
+    void NotifyStateChanged();
+    uint64_t GetStateVersion();
+    // Block until the version differs from version, until passes or
+    // WakeStateWaiters() is called; returns the current version
+    uint64_t WaitForStateChange(uint64_t version, std::chrono::steady_clock::time_point until);
+    void WakeStateWaiters();
 
     // Thread-safe getters
     float GetBrightness();
     float GetContrast();
     int GetSelectedDisplay();
+    int GetDisplayCount();
     bool IsInitialized();
     std::string GetStatusMessage();
+    void SetStatusMessage(const std::string& message);   // Notifies state waiters
+    DisplaySettings GetKnownSettings(int display_index);
+
+    // Restored settings of a display that no write or read has confirmed yet
+    std::vector<VcpSetting> GetUnverifiedSettings(int display_index);
+
+    // Open the state file (STATE_FILE in config.env) and take every display's
+    // last known settings from it, marked unverified. Writes made from now on
+    // are saved to it. Returns the number of displays restored, or -1 with
+    // error if the file cannot be opened.
+    int RestoreState(const std::string& path, std::string& error);
+
+    // Read brightness and contrast (and the input, where the profile reads
+    // it from the standard VCP register) of every display on the bulk lane
+    // without waiting. Each value read replaces a restored one that no write
+    // has confirmed yet and is saved. Returns the number of reads queued.
+    int RefreshState();
 };
 
 #endif // THREAD_SAFE_CONTROL_H
@@ -0,0 +1,64 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+// Hierarchical timing wheel
+//
+// Five levels of 64 slots each. Level 0 slots are one tick wide, level 1 slots
+// are 64 ticks wide and so on, which covers 64^5 ticks (~34 years at one tick
+// per second). Timers far in the future sit in a coarse slot and cascade down
+// as time approaches them, so schedule/cancel are O(1) and the owner can sleep
+// until NextExpiry() instead of polling: idle timers cost nothing.
+//
+// Cancellation is lazy: a cancelled (or rescheduled) timer stays in its slot
+// and is discarded when its slot is processed.
+class TimerWheel {
+public:
+    static const int LEVELS = 5;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    explicit TimerWheel(uint64_t start_tick = 0);
+
+    // Schedule (or reschedule) timer id to expire at the given tick
+    void Schedule(uint64_t id, uint64_t expires);
+
+    // Cancel a timer; unknown ids are ignored
+    void Cancel(uint64_t id);
+
+    // Advance time to tick and append every timer that expired to expired
+    void Advance(uint64_t tick, std::vector<uint64_t>& expired);
+
+    // Earliest tick at which Advance() may produce or cascade something;
+    // UINT64_MAX when no timers are scheduled
+    uint64_t NextExpiry() const;
+
+    // Drop every timer and restart at start_tick (used when the clock jumps backwards)
+    void Reset(uint64_t start_tick);
+
+    uint64_t CurrentTick() const { return current_tick; }
+    size_t Size() const { return active.size(); }
+
+private:
+    struct Entry {
+        uint64_t id;
+        uint64_t expires;
+    };
+
+    uint64_t current_tick;
+    std::vector<Entry> slots[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS];                       // Bit per non-empty slot
+    std::vector<Entry> due;                          // Already expired when scheduled
+    std::unordered_map<uint64_t, uint64_t> active;   // id -> expires (authoritative)
+
+    void Insert(const Entry& entry);
+    void Cascade(int level);
+    void Collect(std::vector<Entry>& entries, std::vector<uint64_t>& expired);
+    bool IsCurrent(const Entry& entry) const;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,87 @@
+#ifndef TRANSITION_ENGINE_H
+#define TRANSITION_ENGINE_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <map>
+#include <string>
+#include <utility>
+#include "preset_manager.h"
+
+class ThreadSafeMonitorControl;
+
+// Easing curves for timed transitions
+enum class Easing {
+    Linear,
+    EaseIn,
+    EaseOut,
+    EaseInOut
+};
+
+// Parse "linear", "ease-in", "ease-out", "ease-in-out"; false if unknown
+bool ParseEasing(const std::string& name, Easing& easing);
+const char* EasingName(Easing easing);
+
+// Server-side brightness/contrast transitions
+//
+// Each (display, setting) pair has at most one active transition. The engine
+// keeps at most one write in flight per transition and, whenever the previous
+// write completes, sends the value for the *current* time. A fast bus therefore
+// gets a step per integer value, a slow bus simply skips intermediate values,
+// and the last write is always the exact target. Starting a new transition on
+// the same pair retargets it from wherever it currently is.
+class TransitionEngine {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Transition {
+        int start_value = 0;
+        int target_value = 0;
+        int last_sent = VCP_VALUE_UNSET;
+        Clock::time_point start_time;
+        Clock::time_point end_time;
+        Easing easing = Easing::Linear;
+        bool write_in_flight = false;
+        unsigned generation = 0;      // New per transition so completions of a cancelled one are ignored
+    };
+
+    using Key = std::pair<int, VcpSetting>;
+
+    ThreadSafeMonitorControl* control;
+    std::thread engine_thread;
+    std::mutex engine_mutex;
+    std::condition_variable engine_cv;
+    std::map<Key, Transition> transitions;
+    unsigned next_generation;
+    bool stopping;
+
+    // Engine thread function
+    void EngineThreadFunc();
+
+    // Eased value of a transition at time now
+    static int ValueAt(const Transition& transition, Clock::time_point now);
+
+public:
+    TransitionEngine(ThreadSafeMonitorControl* control);
+    ~TransitionEngine();
+
+    // Start (or retarget) a transition from current_value to target_value
+    void Start(int display_index, VcpSetting setting, int current_value, int target_value,
+               int duration_ms, Easing easing);
+
+    // Cancel a transition (used when an immediate write arrives for the same setting)
+    void Cancel(int display_index, VcpSetting setting);
+
+    // Current in-progress value, or VCP_VALUE_UNSET when no transition is active
+    int GetCurrentValue(int display_index, VcpSetting setting);
+
+    int GetActiveCount();
+
+    // Cancel everything and join the engine thread
+    void Stop();
+};
+
+#endif // TRANSITION_ENGINE_H
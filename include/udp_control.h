@@ -0,0 +1,107 @@
+#ifndef UDP_CONTROL_H
+#define UDP_CONTROL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// Compact binary control protocol for high-rate control surfaces
+//
+// One fixed-size 12-byte datagram per value update, multi-byte fields in
+// network byte order:
+//
+//   offset  size  field
+//   0       2     magic 'M' 'C'
+//   2       1     version (1)
+//   3       1     display index
+//   4       1     VCP code (0x10 brightness, 0x12 contrast, 0xF4 input)
+//   5       1     reserved (0)
+//   6       2     value (brightness/contrast 0-100, input source as in /api/input)
+//   8       4     sequence number
+//
+// Sequence numbers are per sender and per display/VCP code, compared with
+// wrap-around (serial number) arithmetic: an update that is not newer than the
+// last one accepted for the same stream is dropped. Sequence 0 restarts a
+// stream, so a control surface that reboots is accepted immediately.
+const size_t UDP_CONTROL_PACKET_SIZE = 12;
+const uint8_t UDP_CONTROL_VERSION = 1;
+
+struct UdpControlMessage {
+    uint8_t display_index = 0;
+    uint8_t vcp_code = 0;
+    uint16_t value = 0;
+    uint32_t sequence = 0;
+};
+
+// Validate and decode a datagram; false for wrong size, magic or version
+bool ParseUdpControlPacket(const uint8_t* data, size_t length, UdpControlMessage& message);
+
+// Encode a message into a UDP_CONTROL_PACKET_SIZE buffer
+void EncodeUdpControlPacket(const UdpControlMessage& message, uint8_t* data);
+
+// Drops out-of-order and duplicate updates per (sender, display, VCP code) stream
+class SequenceFilter {
+public:
+    // True if the message is newer than anything accepted on its stream
+    bool Accept(uint64_t sender, const UdpControlMessage& message);
+    void Clear() { last_sequence.clear(); }
+
+private:
+    struct StreamKey {
+        uint64_t sender;
+        uint8_t display_index;
+        uint8_t vcp_code;
+        bool operator<(const StreamKey& other) const {
+            if (sender != other.sender) return sender < other.sender;
+            if (display_index != other.display_index) return display_index < other.display_index;
+            return vcp_code < other.vcp_code;
+        }
+    };
+    std::map<StreamKey, uint32_t> last_sequence;
+};
+
+struct UdpControlStats {
+    uint64_t received = 0;      // Datagrams read from the socket
+    uint64_t accepted = 0;      // Passed to the handler
+    uint64_t stale = 0;         // Dropped as out of order or duplicate
+    uint64_t malformed = 0;     // Wrong size, magic or version
+};
+
+// UDP listener that decodes datagrams, filters them by sequence number and
+// hands accepted messages to a callback on its receive thread
+class UdpControlServer {
+public:
+    using Handler = std::function<void(const UdpControlMessage& message)>;
+
+    explicit UdpControlServer(Handler handler);
+    ~UdpControlServer();
+
+    bool Start(const std::string& host, int port);
+    void Stop();
+    bool IsRunning() const { return running; }
+    int GetPort() const { return bound_port; }
+
+    UdpControlStats GetStats() const;
+
+private:
+    Handler handler;
+    std::thread receive_thread;
+    std::atomic<bool> running;
+    std::atomic<bool> stopping;
+    uintptr_t socket_handle;
+    std::string bound_host;
+    int bound_port;
+
+    std::atomic<uint64_t> received;
+    std::atomic<uint64_t> accepted;
+    std::atomic<uint64_t> stale;
+    std::atomic<uint64_t> malformed;
+
+    void ReceiveThreadFunc();
+};
+
+#endif // UDP_CONTROL_H
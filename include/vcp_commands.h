@@ -0,0 +1,105 @@
+#ifndef VCP_COMMANDS_H
+#define VCP_COMMANDS_H
+
+#include "ddc_packet.h"
+
+// VCP command table
+//
+// Every fixed monitor command used by the GUI, the HTTP API and the thread-safe
+// control layer is defined exactly once here. The tables below are constexpr,
+// so each entry's DDC packet is encoded, checksummed and validated by the
+// compiler; callers only ever patch value bytes for the variable commands.
+
+// Standard MCCS VCP codes
+constexpr uint8_t VCP_BRIGHTNESS = 0x10;
+constexpr uint8_t VCP_CONTRAST = 0x12;
+
+using BrightnessCommand = DdcCommand<VCP_BRIGHTNESS>;
+using ContrastCommand = DdcCommand<VCP_CONTRAST>;
+
+// LG Ultragear input switching uses a vendor register and command code
+constexpr uint8_t LG_INPUT_REGISTER = 0x50;
+constexpr uint8_t LG_INPUT_COMMAND = 0xF4;
+
+using LgInputCommand = DdcCommand<LG_INPUT_COMMAND, LG_INPUT_REGISTER>;
+
+// Input source mapping for LG Ultragear monitors (the built-in monitor profile, see monitor_profiles.h)
+struct InputSourceMapping {
+    int api_value;          // 1-4 from API
+    const char* name;       // Display name
+    uint8_t input_value;    // Value to send to monitor
+    DdcPacket packet;       // Fully encoded write packet
+};
+
+constexpr InputSourceMapping MakeInputSource(int api_value, const char* name, uint8_t input_value) {
+    return { api_value, name, input_value, LgInputCommand::Encode(input_value) };
+}
+
+constexpr InputSourceMapping INPUT_SOURCES[] = {
+    MakeInputSource(1, "HDMI 1",      0x90),
+    MakeInputSource(2, "HDMI 2",      0x91),   // estimated
+    MakeInputSource(3, "DisplayPort", 0xD0),
+    MakeInputSource(4, "USB-C",       0xD1),   // estimated
+};
+
+constexpr int INPUT_SOURCE_COUNT = static_cast<int>(sizeof(INPUT_SOURCES) / sizeof(INPUT_SOURCES[0]));
+
+// Quick presets offered by the GUI (brightness/contrast pairs)
+struct QuickPreset {
+    const char* name;
+    uint8_t brightness;
+    uint8_t contrast;
+    DdcPacket brightness_packet;
+    DdcPacket contrast_packet;
+};
+
+constexpr QuickPreset MakeQuickPreset(const char* name, uint8_t brightness, uint8_t contrast) {
+    return { name, brightness, contrast,
+             BrightnessCommand::Encode(brightness), ContrastCommand::Encode(contrast) };
+}
+
+constexpr QuickPreset QUICK_PRESETS[] = {
+    MakeQuickPreset("Bright", 100, 75),
+    MakeQuickPreset("Normal", 75, 50),
+    MakeQuickPreset("Dark",   20, 40),
+};
+
+constexpr int QUICK_PRESET_COUNT = static_cast<int>(sizeof(QUICK_PRESETS) / sizeof(QUICK_PRESETS[0]));
+
+// Compile-time validation of the tables above
+constexpr bool ValidateInputSources() {
+    for (int i = 0; i < INPUT_SOURCE_COUNT; ++i) {
+        const InputSourceMapping& mapping = INPUT_SOURCES[i];
+        if (mapping.api_value != i + 1) return false;             // API values are 1-based and dense
+        if (!IsValidDdcPacket(mapping.packet)) return false;
+        if (mapping.packet.Value() != mapping.input_value) return false;
+        for (int j = 0; j < i; ++j) {
+            if (INPUT_SOURCES[j].input_value == mapping.input_value) return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool ValidateQuickPresets() {
+    for (int i = 0; i < QUICK_PRESET_COUNT; ++i) {
+        const QuickPreset& preset = QUICK_PRESETS[i];
+        if (preset.brightness > 100 || preset.contrast > 100) return false;
+        if (!IsValidDdcPacket(preset.brightness_packet)) return false;
+        if (!IsValidDdcPacket(preset.contrast_packet)) return false;
+    }
+    return true;
+}
+
+static_assert(ValidateInputSources(), "INPUT_SOURCES table is inconsistent");
+static_assert(ValidateQuickPresets(), "QUICK_PRESETS table is inconsistent");
+static_assert(INPUT_SOURCES[0].packet.data[DDC_CHECKSUM_OFFSET] ==
+              (DDC_WRITE_ADDRESS ^ LG_INPUT_REGISTER ^ DDC_SET_VCP_LENGTH ^ DDC_SET_VCP_OPCODE ^
+               LG_INPUT_COMMAND ^ 0x00 ^ 0x90),
+              "DDC checksum does not match the NVidia I2C sample layout");
+
+// Lookup by API value (1-based); returns nullptr when out of range
+constexpr const InputSourceMapping* FindInputSource(int api_value) {
+    return (api_value >= 1 && api_value <= INPUT_SOURCE_COUNT) ? &INPUT_SOURCES[api_value - 1] : nullptr;
+}
+
+#endif // VCP_COMMANDS_H
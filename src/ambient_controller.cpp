@@ -0,0 +1,385 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define INVALID_SOCKET ((uintptr_t)-1)
+#define closesocket close
+#endif
+
+#include "ambient_controller.h"
+#include "server_logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+// Bytes read from the end of a file source; enough for the last line of an appended log
+static const long AMBIENT_FILE_TAIL_BYTES = 4096;
+
+static double LogLux(double lux) {
+    return std::log10(std::max(lux, AMBIENT_MIN_LUX));
+}
+
+int AmbientCurve::BrightnessAt(double lux) const {
+    if (points.empty()) {
+        return 0;
+    }
+    if (lux <= points.front().first) {
+        return points.front().second;
+    }
+    if (lux >= points.back().first) {
+        return points.back().second;
+    }
+
+    size_t upper = 1;
+    while (points[upper].first <= lux) {
+        upper++;
+    }
+    const std::pair<double, int>& a = points[upper - 1];
+    const std::pair<double, int>& b = points[upper];
+    double span = LogLux(b.first) - LogLux(a.first);
+    if (span <= 0) {
+        return b.second;    // Both ends below AMBIENT_MIN_LUX
+    }
+    double t = (LogLux(lux) - LogLux(a.first)) / span;
+    return static_cast<int>(std::lround(a.second + t * (b.second - a.second)));
+}
+
+bool ParseAmbientCurve(const std::string& text, AmbientCurve& curve) {
+    curve.points.clear();
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        try {
+            size_t used = 0;
+            std::string lux_text = item.substr(0, colon);
+            std::string brightness_text = item.substr(colon + 1);
+            double lux = std::stod(lux_text, &used);
+            if (lux_text.find_first_not_of(" \t", used) != std::string::npos) {
+                return false;
+            }
+            int brightness = std::stoi(brightness_text, &used);
+            if (brightness_text.find_first_not_of(" \t", used) != std::string::npos) {
+                return false;
+            }
+            if (lux < 0 || brightness < 0 || brightness > 100 ||
+                (!curve.points.empty() && lux <= curve.points.back().first)) {
+                return false;
+            }
+            curve.points.emplace_back(lux, brightness);
+        } catch (...) {
+            return false;
+        }
+    }
+    return !curve.points.empty();
+}
+
+double PerceivedLightness(int brightness) {
+    double y = std::min(std::max(brightness, 0), 100) / 100.0;
+    if (y > 216.0 / 24389.0) {
+        return 116.0 * std::cbrt(y) - 16.0;
+    }
+    return y * 24389.0 / 27.0;
+}
+
+bool AmbientSettings::operator==(const AmbientSettings& other) const {
+    return source == other.source && filter_ms == other.filter_ms && hysteresis == other.hysteresis &&
+           min_change == other.min_change && poll_ms == other.poll_ms && curves == other.curves;
+}
+
+AmbientController::AmbientController(Writer w)
+    : writer(w), running(false), stopping(false), has_reading(false), filtered_log_lux(0), last_lux(0),
+      readings(0), malformed(0), socket_handle(INVALID_SOCKET), bound_port(0) {
+}
+
+AmbientController::~AmbientController() {
+    Stop();
+}
+
+void AmbientController::Configure(const AmbientSettings& new_settings) {
+    std::lock_guard<std::mutex> lock(loop_mutex);
+    for (auto it = loops.begin(); it != loops.end();) {
+        auto curve = new_settings.curves.find(it->first);
+        if (curve == new_settings.curves.end()) {
+            it = loops.erase(it);
+            continue;
+        }
+        // A new curve is applied on the next reading instead of waiting for the light to change
+        auto old_curve = settings.curves.find(it->first);
+        if (old_curve == settings.curves.end() || !(old_curve->second == curve->second)) {
+            it->second.written = -1;
+        }
+        ++it;
+    }
+    settings = new_settings;
+}
+
+void AmbientController::Ingest(double lux, Clock::time_point now) {
+    std::vector<std::pair<int, int>> writes;
+    {
+        std::lock_guard<std::mutex> lock(loop_mutex);
+        readings++;
+        last_lux = lux;
+
+        recent.emplace_back(now, LogLux(lux));
+        while (recent.size() > AMBIENT_MEDIAN_MAX_SAMPLES ||
+               now - recent.front().first > std::chrono::milliseconds(AMBIENT_MEDIAN_WINDOW_MS)) {
+            recent.pop_front();
+        }
+        std::vector<double> window;
+        for (const auto& sample : recent) {
+            window.push_back(sample.second);
+        }
+        std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+        double log_lux = window[window.size() / 2];
+
+        if (!has_reading) {
+            filtered_log_lux = log_lux;
+            has_reading = true;
+        } else {
+            double elapsed_ms = std::chrono::duration<double, std::milli>(now - last_reading).count();
+            double alpha = settings.filter_ms > 0 ? 1.0 - std::exp(-std::max(elapsed_ms, 0.0) / settings.filter_ms) : 1.0;
+            filtered_log_lux += alpha * (log_lux - filtered_log_lux);
+        }
+        last_reading = now;
+
+        double filtered_lux = std::pow(10.0, filtered_log_lux);
+        double hysteresis_band = std::log10(1.0 + std::max(settings.hysteresis, 0.0));
+        for (const auto& entry : settings.curves) {
+            DisplayLoop& loop = loops[entry.first];
+
+            int naive = entry.second.BrightnessAt(lux);
+            if (naive != loop.naive_last) {
+                loop.naive_writes++;
+                loop.naive_last = naive;
+            }
+
+            loop.target = entry.second.BrightnessAt(filtered_lux);
+            if (loop.written >= 0) {
+                if (std::fabs(filtered_log_lux - LogLux(loop.written_lux)) <= hysteresis_band) {
+                    continue;
+                }
+                if (std::fabs(PerceivedLightness(loop.target) - PerceivedLightness(loop.written)) < settings.min_change) {
+                    continue;
+                }
+            }
+            loop.written = loop.target;
+            loop.written_lux = filtered_lux;
+            loop.writes++;
+            writes.emplace_back(entry.first, loop.target);
+        }
+    }
+
+    for (const auto& write : writes) {
+        writer(write.first, write.second);
+    }
+}
+
+void AmbientController::IngestText(const std::string& text, Clock::time_point now) {
+    const char* start = text.c_str();
+    char* end = nullptr;
+    double lux = strtod(start, &end);
+    bool valid = end != start && std::isfinite(lux) && lux >= 0;
+    for (; valid && *end; end++) {
+        valid = *end == ' ' || *end == '\t' || *end == '\r' || *end == '\n';
+    }
+    if (!valid) {
+        std::lock_guard<std::mutex> lock(loop_mutex);
+        malformed++;
+        return;
+    }
+    Ingest(lux, now);
+}
+
+AmbientStats AmbientController::GetStats() {
+    std::lock_guard<std::mutex> lock(loop_mutex);
+    AmbientStats stats;
+    stats.running = running;
+    stats.readings = readings;
+    stats.malformed = malformed;
+    stats.lux = last_lux;
+    stats.filtered_lux = has_reading ? std::pow(10.0, filtered_log_lux) : 0;
+    for (const auto& entry : loops) {
+        AmbientDisplayStats display;
+        display.display_index = entry.first;
+        display.target = entry.second.target;
+        display.written = entry.second.written;
+        display.writes = entry.second.writes;
+        display.naive_writes = entry.second.naive_writes;
+        stats.displays.push_back(display);
+    }
+    return stats;
+}
+
+bool AmbientController::Start(const AmbientSettings& new_settings) {
+    if (running || !new_settings.IsEnabled()) {
+        return false;
+    }
+    Configure(new_settings);
+
+    stopping = false;
+    const std::string& source = new_settings.source;
+    if (source.compare(0, 4, "udp:") == 0) {
+        if (!OpenUdp(source.substr(4))) {
+            return false;
+        }
+        source_thread = std::thread(&AmbientController::UdpThreadFunc, this);
+    } else if (source.compare(0, 5, "file:") == 0 && source.size() > 5) {
+        source_thread = std::thread(&AmbientController::FileThreadFunc, this, source.substr(5));
+        ServerLogger::Log("INFO", "Ambient light: reading %s every %d ms", source.c_str() + 5, new_settings.poll_ms);
+    } else {
+        ServerLogger::Log("ERROR", "Ambient light: unknown source \"%s\" (expected udp:<port> or file:<path>)",
+                          source.c_str());
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void AmbientController::Stop() {
+    if (!source_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        stopping = true;
+    }
+    wait_cv.notify_all();
+
+    // Wake a blocking recvfrom with an empty datagram to our own port
+    bool udp = socket_handle != static_cast<uintptr_t>(INVALID_SOCKET);
+    if (udp) {
+        uintptr_t waker = static_cast<uintptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+        if (waker != static_cast<uintptr_t>(INVALID_SOCKET)) {
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(bound_port));
+            inet_pton(AF_INET, bound_host.c_str(), &addr.sin_addr);
+            sendto(waker, "", 0, 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            closesocket(waker);
+        }
+    }
+
+    source_thread.join();
+    if (udp) {
+        closesocket(socket_handle);
+        socket_handle = INVALID_SOCKET;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+    running = false;
+    ServerLogger::Log("INFO", "Ambient light controller stopped");
+}
+
+bool AmbientController::OpenUdp(const std::string& spec) {
+    std::string host = "127.0.0.1";
+    std::string port_text = spec;
+    size_t colon = spec.rfind(':');
+    if (colon != std::string::npos) {
+        host = spec.substr(0, colon);
+        port_text = spec.substr(colon + 1);
+    }
+    int port = atoi(port_text.c_str());
+    if (port <= 0 || port > 65535) {
+        ServerLogger::Log("ERROR", "Ambient light: invalid UDP port \"%s\"", port_text.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    uintptr_t sock = static_cast<uintptr_t>(INVALID_SOCKET);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        ServerLogger::Log("ERROR", "Ambient light: invalid host %s", host.c_str());
+    } else if ((sock = static_cast<uintptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP))) ==
+               static_cast<uintptr_t>(INVALID_SOCKET)) {
+        ServerLogger::Log("ERROR", "Ambient light: socket() failed");
+    } else if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ServerLogger::Log("ERROR", "Ambient light: failed to bind %s:%d", host.c_str(), port);
+        closesocket(sock);
+        sock = static_cast<uintptr_t>(INVALID_SOCKET);
+    }
+    if (sock == static_cast<uintptr_t>(INVALID_SOCKET)) {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    socket_handle = sock;
+    bound_port = port;
+    bound_host = (addr.sin_addr.s_addr == htonl(INADDR_ANY)) ? "127.0.0.1" : host;
+    ServerLogger::Log("INFO", "Ambient light: listening for readings on %s:%d", host.c_str(), port);
+    return true;
+}
+
+void AmbientController::UdpThreadFunc() {
+    char buffer[128];
+    while (!stopping) {
+        int length = static_cast<int>(recvfrom(socket_handle, buffer, sizeof(buffer) - 1, 0, nullptr, nullptr));
+        if (stopping) {
+            break;
+        }
+        if (length < 0) {
+            continue;
+        }
+        IngestText(std::string(buffer, static_cast<size_t>(length)), Clock::now());
+    }
+}
+
+void AmbientController::FileThreadFunc(std::string path) {
+    int poll_ms;
+    {
+        std::lock_guard<std::mutex> lock(loop_mutex);
+        poll_ms = std::max(settings.poll_ms, 10);
+    }
+
+    bool reported_missing = false;
+    while (!stopping) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            if (!reported_missing) {
+                ServerLogger::Log("WARN", "Ambient light: cannot open %s, retrying", path.c_str());
+                reported_missing = true;
+            }
+        } else {
+            reported_missing = false;
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            long offset = std::max(0L, size - AMBIENT_FILE_TAIL_BYTES);
+            fseek(file, offset, SEEK_SET);
+            std::string tail(static_cast<size_t>(size - offset), '\0');
+            tail.resize(fread(&tail[0], 1, tail.size(), file));
+            fclose(file);
+
+            // Last non-empty line; an empty file (sensor daemon mid-rewrite) is skipped
+            size_t end = tail.find_last_not_of(" \t\r\n");
+            if (end != std::string::npos) {
+                size_t begin = tail.find_last_of("\r\n", end);
+                begin = begin == std::string::npos ? 0 : begin + 1;
+                IngestText(tail.substr(begin, end + 1 - begin), Clock::now());
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        wait_cv.wait_for(lock, std::chrono::milliseconds(poll_ms), [this]() { return stopping.load(); });
+    }
+}
@@ -0,0 +1,148 @@
+// Stand-in ambient light sensor and write-minimization check for
+// AmbientController (no monitor or NvAPI needed)
+//
+// Usage: ambient_sim                      simulate two hours of readings
+//        ambient_sim --send <port> [host] forward lux values from stdin as datagrams
+//
+// The simulation feeds a synthetic evening (daylight fading from 800 to
+// 5 lux, with sensor noise, passing clouds and a hand over the sensor) at
+// 10 readings per second into a controller with the default settings and
+// two displays. It reports how many writes a client posting every reading's
+// curve value would have sent against the writes the controller issued, and
+// how far the written brightness strayed from the curve at the noise-free
+// light level, in perceived lightness (L*). Exits with 1 if the controller
+// saved nothing or tracked the light worse than twice the minimum change.
+//
+// Builds outside the (Windows-only) CMake project as well:
+//   g++ -std=c++17 -O2 -pthread -Iinclude src/ambient_sim.cpp src/ambient_controller.cpp src/server_logger.cpp
+//
+// --send turns any sensor script into a UDP source for a running app
+// (AMBIENT_SOURCE=udp:<port>): read_sensor | ambient_sim --send 45680
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define closesocket close
+#endif
+
+#include "ambient_controller.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <map>
+#include <random>
+
+static const int READINGS_PER_SECOND = 10;
+static const int SIMULATED_SECONDS = 2 * 60 * 60;
+
+// Noise-free light level t seconds into the evening
+static double TrueLux(int t) {
+    double fade = static_cast<double>(t) / SIMULATED_SECONDS;
+    double lux = 800.0 * std::pow(5.0 / 800.0, fade);
+    if (t % 900 >= 600 && t % 900 < 660) {
+        lux *= 0.5;     // A cloud every 15 minutes for a minute
+    }
+    return lux;
+}
+
+static int Send(int port, const char* host) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        printf("Invalid host %s\n", host);
+        return 2;
+    }
+    auto sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    char line[128];
+    int sent = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        size_t length = strcspn(line, "\r\n");
+        if (length > 0) {
+            sendto(sock, line, static_cast<int>(length), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            sent++;
+        }
+    }
+    closesocket(sock);
+    printf("Sent %d readings to %s:%d\n", sent, host, port);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "--send") == 0 && atoi(argv[2]) > 0) {
+        return Send(atoi(argv[2]), argc >= 4 ? argv[3] : "127.0.0.1");
+    }
+    if (argc > 1) {
+        printf("Usage: ambient_sim [--send <port> [host]]\n");
+        return 2;
+    }
+
+    AmbientSettings settings;
+    settings.source = "sim";
+    ParseAmbientCurve("0:5, 10:20, 100:45, 500:75, 2000:100", settings.curves[0]);
+    ParseAmbientCurve("0:0, 20:15, 300:60, 1000:90", settings.curves[1]);
+
+    std::map<int, int> written;
+    AmbientController controller([&written](int display_index, int brightness) {
+        written[display_index] = brightness;
+    });
+    controller.Configure(settings);
+
+    std::mt19937 random(42);
+    std::normal_distribution<double> noise(0.0, 0.08);
+    std::map<int, double> error_sum, error_max;
+    int samples = 0;
+
+    AmbientController::Clock::time_point start;
+    for (int i = 0; i < SIMULATED_SECONDS * READINGS_PER_SECOND; i++) {
+        int t = i / READINGS_PER_SECOND;
+        double lux = TrueLux(t) * (1.0 + noise(random));
+        if (t % 1200 >= 300 && t % 1200 < 302) {
+            lux = 2.0;  // Hand over the sensor for two seconds every 20 minutes
+        }
+        controller.Ingest(std::max(lux, 0.0),
+                          start + std::chrono::milliseconds(i * 1000 / READINGS_PER_SECOND));
+
+        // Tracking error once a second, after the filter has settled on the first reading
+        if (i % READINGS_PER_SECOND == 0 && t >= 30) {
+            samples++;
+            for (const auto& curve : settings.curves) {
+                double error = std::fabs(PerceivedLightness(written[curve.first]) -
+                                         PerceivedLightness(curve.second.BrightnessAt(TrueLux(t))));
+                error_sum[curve.first] += error;
+                error_max[curve.first] = std::max(error_max[curve.first], error);
+            }
+        }
+    }
+
+    AmbientStats stats = controller.GetStats();
+    bool pass = true;
+    printf("%llu readings over %d minutes, filter %d ms, hysteresis %.0f%%, min change %.1f L*\n",
+           (unsigned long long)stats.readings, SIMULATED_SECONDS / 60, settings.filter_ms,
+           settings.hysteresis * 100, settings.min_change);
+    for (const AmbientDisplayStats& display : stats.displays) {
+        double saved = display.naive_writes > 0
+            ? 100.0 * (static_cast<double>(display.naive_writes) - display.writes) / display.naive_writes : 0.0;
+        double mean_error = samples > 0 ? error_sum[display.display_index] / samples : 0.0;
+        printf("  display %d: %llu writes instead of %llu (%.1f%% saved), final brightness %d\n",
+               display.display_index, (unsigned long long)display.writes,
+               (unsigned long long)display.naive_writes, saved, display.written);
+        printf("    error against the noise-free curve: mean %.2f L*, max %.2f L*\n", mean_error,
+               error_max[display.display_index]);
+        pass = pass && display.writes < display.naive_writes && mean_error <= 2 * settings.min_change;
+    }
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include "cli_batch.h"
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+
+// Longest delay a script may request (10 minutes)
+static const int MAX_DELAY_MS = 600000;
+
+static bool ParseHex(const std::string& text, unsigned long max_value, unsigned long& value) {
+    char* end = nullptr;
+    value = strtoul(text.c_str(), &end, 16);
+    return !text.empty() && *end == '\0' && value <= max_value;
+}
+
+static bool ParseDecimal(const std::string& text, int min_value, int max_value, int& value) {
+    char* end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || parsed < min_value || parsed > max_value) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Parse "<display> <value> <code> [register]" or "<display> <code> [register]" (reads)
+static bool ParseTarget(const std::vector<std::string>& args, bool has_value, CliCommand& command, std::string& error) {
+    size_t expected = has_value ? 3 : 2;
+    if (args.size() != expected && args.size() != expected + 1) {
+        error = has_value ? "expected <display_index> <value> <code> [register]"
+                          : "expected <display_index> <code> [register]";
+        return false;
+    }
+
+    unsigned long value = 0, code = 0, reg = 0x51;
+    size_t next = 1;
+    if (!ParseDecimal(args[0], 0, 255, command.display_index)) {
+        error = "invalid display index '" + args[0] + "'";
+        return false;
+    }
+    if (has_value) {
+        if (!ParseHex(args[next], 0xFFFF, value)) {
+            error = "invalid hex value '" + args[next] + "'";
+            return false;
+        }
+        next++;
+    }
+    if (!ParseHex(args[next], 0xFF, code)) {
+        error = "invalid hex code '" + args[next] + "'";
+        return false;
+    }
+    next++;
+    if (next < args.size() && !ParseHex(args[next], 0xFF, reg)) {
+        error = "invalid hex register '" + args[next] + "'";
+        return false;
+    }
+
+    command.value = static_cast<uint16_t>(value);
+    command.command_code = static_cast<uint8_t>(code);
+    command.register_address = static_cast<uint8_t>(reg);
+    return true;
+}
+
+bool ParseCliScript(std::istream& input, std::vector<CliCommand>& commands, std::string& error) {
+    std::string line;
+    int line_number = 0;
+    while (std::getline(input, line)) {
+        line_number++;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
+
+        std::istringstream words(line);
+        std::vector<std::string> args;
+        std::string word;
+        while (words >> word) {
+            args.push_back(word);
+        }
+        if (args.empty()) {
+            continue;
+        }
+
+        CliCommand command;
+        command.line = line_number;
+        std::string keyword = args[0];
+        std::string line_error;
+        bool ok;
+
+        if (keyword == "write") {
+            command.type = CliCommand::Type::Write;
+            ok = ParseTarget(std::vector<std::string>(args.begin() + 1, args.end()), true, command, line_error);
+        } else if (keyword == "read") {
+            command.type = CliCommand::Type::Read;
+            ok = ParseTarget(std::vector<std::string>(args.begin() + 1, args.end()), false, command, line_error);
+        } else if (keyword == "delay") {
+            command.type = CliCommand::Type::Delay;
+            ok = args.size() == 2 && ParseDecimal(args[1], 0, MAX_DELAY_MS, command.delay_ms);
+            if (!ok) {
+                line_error = "expected delay <milliseconds> (0-600000)";
+            }
+        } else {
+            // Bare single-shot argument order: <display> <value> <code> [register]
+            command.type = CliCommand::Type::Write;
+            ok = ParseTarget(args, true, command, line_error);
+        }
+
+        if (!ok) {
+            error = "line " + std::to_string(line_number) + ": " + line_error;
+            return false;
+        }
+        commands.push_back(command);
+    }
+    return true;
+}
+
+std::string DescribeCliCommand(const CliCommand& command) {
+    char text[96];
+    switch (command.type) {
+    case CliCommand::Type::Write:
+        snprintf(text, sizeof(text), "write display %d code 0x%02X value 0x%02X reg 0x%02X",
+                 command.display_index, command.command_code, command.value, command.register_address);
+        break;
+    case CliCommand::Type::Read:
+        snprintf(text, sizeof(text), "read  display %d code 0x%02X reg 0x%02X",
+                 command.display_index, command.command_code, command.register_address);
+        break;
+    case CliCommand::Type::Delay:
+        snprintf(text, sizeof(text), "delay %d ms", command.delay_ms);
+        break;
+    }
+    return text;
+}
@@ -0,0 +1,157 @@
+#include "httplib.h"
+#include "cli_forward.h"
+#include "config_parser.h"
+#include <sstream>
+
+// The probe must not make the direct fallback noticeably slower
+static const int PROBE_TIMEOUT_MS = 150;
+
+// A forwarded read or write waits behind the display's queue (DDC writes take ~50 ms)
+static const int COMMAND_TIMEOUT_SEC = 10;
+
+static bool LoadConfigNear(const std::string& exe_path, ConfigParser& parser) {
+    if (parser.LoadFromFile("config.env")) {
+        return true;
+    }
+    size_t last_slash = exe_path.find_last_of("\\/");
+    if (last_slash == std::string::npos) {
+        return false;
+    }
+    return parser.LoadFromFile(exe_path.substr(0, last_slash + 1) + "config.env");
+}
+
+static std::unique_ptr<httplib::Client> Probe(std::unique_ptr<httplib::Client> candidate) {
+    candidate->set_connection_timeout(0, PROBE_TIMEOUT_MS * 1000);
+    candidate->set_read_timeout(0, PROBE_TIMEOUT_MS * 1000);
+    candidate->set_keep_alive(true);
+
+    auto result = candidate->Get("/health");
+    if (!result || result->status != 200) {
+        return nullptr;
+    }
+
+    candidate->set_read_timeout(COMMAND_TIMEOUT_SEC, 0);
+    candidate->set_write_timeout(COMMAND_TIMEOUT_SEC, 0);
+    return candidate;
+}
+
+ServerForwarder::ServerForwarder() {
+}
+
+ServerForwarder::~ServerForwarder() {
+}
+
+bool ServerForwarder::Connect(const std::string& exe_path) {
+    ConfigParser parser;
+    if (!LoadConfigNear(exe_path, parser) || !parser.GetBool("API_ENABLED", true)) {
+        return false;
+    }
+
+    // Prefer the local socket: no port, no loopback TCP stack
+    std::string unix_socket = parser.GetString("UNIX_SOCKET", "");
+    if (!unix_socket.empty()) {
+        auto candidate = std::make_unique<httplib::Client>(unix_socket);
+        candidate->set_address_family(AF_UNIX);
+        client = Probe(std::move(candidate));
+        if (client) {
+            description = "unix socket " + unix_socket;
+            return true;
+        }
+    }
+
+    std::string host = parser.GetString("HTTP_HOST", "127.0.0.1");
+    if (host == "0.0.0.0") {
+        host = "127.0.0.1";
+    }
+    int port = parser.GetInt("HTTP_PORT", 45678);
+    auto candidate = std::make_unique<httplib::Client>(host, port);
+    candidate->set_tcp_nodelay(true);
+    client = Probe(std::move(candidate));
+    if (client) {
+        description = host + ":" + std::to_string(port);
+        return true;
+    }
+    return false;
+}
+
+// Pull an integer field out of the server's flat JSON response
+static bool ExtractInt(const std::string& body, const std::string& key, int& value) {
+    size_t pos = body.find("\"" + key + "\"");
+    if (pos == std::string::npos || (pos = body.find(':', pos)) == std::string::npos) {
+        return false;
+    }
+    try {
+        value = std::stoi(body.substr(pos + 1));
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+static std::string ExtractMessage(const std::string& body) {
+    size_t pos = body.find("\"message\"");
+    if (pos == std::string::npos || (pos = body.find('"', body.find(':', pos))) == std::string::npos) {
+        return body;
+    }
+    size_t end = body.find('"', pos + 1);
+    return body.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+}
+
+ServerForwarder::Result ServerForwarder::Send(const CliCommand& command, uint16_t& current_value,
+                                              uint16_t& maximum_value, std::string& error) {
+    if (!client) {
+        return Result::Unavailable;
+    }
+
+    httplib::Result result;
+    if (command.type == CliCommand::Type::Read) {
+        std::ostringstream path;
+        path << "/api/vcp?display=" << command.display_index << "&code=" << (int)command.command_code
+             << "&register=" << (int)command.register_address;
+        result = client->Get(path.str());
+    } else {
+        std::ostringstream body;
+        body << "{\"display\": " << command.display_index << ", \"code\": " << (int)command.command_code
+             << ", \"value\": " << command.value << ", \"register\": " << (int)command.register_address << "}";
+        result = client->Post("/api/vcp", body.str(), "application/json");
+    }
+
+    if (!result) {
+        // Only a failed connect proves the server never saw the command. Once
+        // it was sent, it may be queued behind a long switch or macro and still
+        // run, so running it directly as well could apply it twice.
+        httplib::Error failure = result.error();
+        if (failure == httplib::Error::Connection || failure == httplib::Error::ConnectionTimeout) {
+            error = "server stopped responding (" + httplib::to_string(failure) + ")";
+            return Result::Unavailable;
+        }
+        error = "no reply from the server (" + httplib::to_string(failure) + "); the command may still run there";
+        return Result::Failed;
+    }
+    // Nothing was written in either case, so falling back cannot apply a command twice.
+    // A 503 without "sent": false is a command failed during shutdown, which
+    // may have been on the bus.
+    if (result->status == 404) {
+        error = "server does not support /api/vcp";
+        return Result::Unavailable;
+    }
+    if (result->status == 503 && result->body.find("\"sent\": false") != std::string::npos) {
+        error = "server cannot run the command (" + ExtractMessage(result->body) + ")";
+        return Result::Unavailable;
+    }
+    if (result->status != 200) {
+        error = ExtractMessage(result->body);
+        return Result::Failed;
+    }
+
+    if (command.type == CliCommand::Type::Read) {
+        int current = 0, maximum = 0;
+        if (!ExtractInt(result->body, "current", current) || !ExtractInt(result->body, "maximum", maximum)) {
+            error = "unexpected response: " + result->body;
+            return Result::Failed;
+        }
+        current_value = static_cast<uint16_t>(current);
+        maximum_value = static_cast<uint16_t>(maximum);
+    }
+    return Result::Ok;
+}
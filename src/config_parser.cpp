@@ -95,3 +95,12 @@ bool ConfigParser::GetBool(const std::string& key, bool default_value) const {
 bool ConfigParser::HasKey(const std::string& key) const {
     return config_map.find(key) != config_map.end();
 }
+
+std::vector<std::string> ConfigParser::GetKeys() const {
+    std::vector<std::string> keys;
+    keys.reserve(config_map.size());
+    for (const auto& entry : config_map) {
+        keys.push_back(entry.first);
+    }
+    return keys;
+}
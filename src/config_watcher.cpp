@@ -0,0 +1,308 @@
+#include "config_watcher.h"
+#include <fstream>
+#include <vector>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// Editors often write a file in several steps; reload once things settle
+static const int DEBOUNCE_MS = 200;
+
+// Check the named files if their interval is up (other files in the watched
+// directory may change all the time); returns how long to wait for the next check
+int ConfigWatcher::CheckFilesIfDue(std::chrono::steady_clock::time_point& next_check) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_check) {
+        CheckFiles(true);
+        next_check = now + std::chrono::milliseconds(FILE_CHECK_MS);
+    }
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next_check - now).count()) + 1;
+}
+
+ConfigWatcher::ConfigWatcher(const std::string& path)
+    : config_path(path), stopping(false) {
+    size_t last_slash = path.find_last_of("\\/");
+    if (last_slash == std::string::npos) {
+        directory = ".";
+        file_name = path;
+    } else {
+        directory = path.substr(0, last_slash + 1);
+        file_name = path.substr(last_slash + 1);
+    }
+
+#ifdef _WIN32
+    stop_event = nullptr;
+#else
+    stop_pipe[0] = -1;
+    stop_pipe[1] = -1;
+#endif
+
+    std::atomic_store(&snapshot, std::shared_ptr<const ServerConfig>(
+        std::make_shared<ServerConfig>(ServerConfig::LoadConfig(config_path))));
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    Stop();
+}
+
+std::shared_ptr<const ServerConfig> ConfigWatcher::Current() const {
+    return std::atomic_load(&snapshot);
+}
+
+bool ConfigWatcher::Reload() {
+    // A missing file is usually an editor mid-save; keep the current snapshot
+    if (!std::ifstream(config_path).good()) {
+        ServerLogger::Log("WARN", "%s not readable, keeping current configuration", config_path.c_str());
+        return false;
+    }
+
+    std::shared_ptr<const ServerConfig> updated = std::make_shared<ServerConfig>(ServerConfig::LoadConfig(config_path));
+    std::shared_ptr<const ServerConfig> previous = std::atomic_load(&snapshot);
+    if (*updated == *previous) {
+        return false;
+    }
+
+    std::atomic_store(&snapshot, updated);
+    ServerLogger::Log("INFO", "Reloaded %s", config_path.c_str());
+    if (on_change) {
+        on_change(*previous, *updated);
+    }
+    return true;
+}
+
+ConfigWatcher::FileStamp ConfigWatcher::StampOf(const std::string& path) {
+    // Sub-second modification times, so two saves within a second are told apart
+    FileStamp stamp;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    stamp.exists = GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info) != 0;
+    if (stamp.exists) {
+        stamp.size = (static_cast<int64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        stamp.modified = (static_cast<int64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                         info.ftLastWriteTime.dwLowDateTime;
+    }
+#else
+    struct stat info;
+    stamp.exists = stat(path.c_str(), &info) == 0;
+    if (stamp.exists) {
+        stamp.size = static_cast<int64_t>(info.st_size);
+        stamp.modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    }
+#endif
+    return stamp;
+}
+
+void ConfigWatcher::CheckFiles(bool report) {
+    std::shared_ptr<const ServerConfig> current = Current();
+    std::map<std::string, FileStamp> stamps;
+    for (const std::string& path : { current->presets_file, current->schedule_file }) {
+        if (path.empty() || stamps.count(path)) {
+            continue;
+        }
+        FileStamp stamp = StampOf(path);
+        stamps[path] = stamp;
+
+        // A newly named file was loaded with the config change; a missing
+        // one is usually an editor mid-save and keeps what was loaded
+        auto previous = file_stamps.find(path);
+        if (report && on_file_change && previous != file_stamps.end() && stamp.exists && !(stamp == previous->second)) {
+            ServerLogger::Log("INFO", "Reloading %s", path.c_str());
+            on_file_change(*current, path);
+        }
+    }
+    file_stamps.swap(stamps);
+}
+
+bool ConfigWatcher::Start(ChangeHandler handler, FileHandler file_handler) {
+    if (watcher_thread.joinable()) {
+        return false;
+    }
+    on_change = handler;
+    on_file_change = file_handler;
+    stopping = false;
+    CheckFiles(false);
+
+#ifdef _WIN32
+    stop_event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (!stop_event) {
+        ServerLogger::Log("ERROR", "Config watcher: CreateEvent failed (%lu)", GetLastError());
+        return false;
+    }
+#else
+    if (pipe(stop_pipe) != 0) {
+        ServerLogger::Log("ERROR", "Config watcher: pipe() failed");
+        return false;
+    }
+#endif
+
+    watcher_thread = std::thread(&ConfigWatcher::WatcherThreadFunc, this);
+    return true;
+}
+
+void ConfigWatcher::Stop() {
+    if (!watcher_thread.joinable()) {
+        return;
+    }
+
+    stopping = true;
+#ifdef _WIN32
+    SetEvent(stop_event);
+#else
+    char byte = 0;
+    (void)!write(stop_pipe[1], &byte, 1);
+#endif
+    watcher_thread.join();
+
+#ifdef _WIN32
+    CloseHandle(stop_event);
+    stop_event = nullptr;
+#else
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    stop_pipe[0] = -1;
+    stop_pipe[1] = -1;
+#endif
+}
+
+#ifdef _WIN32
+
+void ConfigWatcher::WatcherThreadFunc() {
+    HANDLE dir = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                             FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (dir == INVALID_HANDLE_VALUE) {
+        ServerLogger::Log("ERROR", "Config watcher: cannot open directory %s (%lu)", directory.c_str(), GetLastError());
+        return;
+    }
+
+    std::wstring wide_name(file_name.begin(), file_name.end());
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    std::vector<DWORD> buffer(4096); // DWORD-aligned as ReadDirectoryChangesW requires
+    const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+
+    ServerLogger::Log("INFO", "Watching %s for changes", config_path.c_str());
+
+    bool read_pending = false;
+    bool change_pending = false;
+    auto next_check = std::chrono::steady_clock::now() + std::chrono::milliseconds(FILE_CHECK_MS);
+    while (!stopping) {
+        if (!read_pending) {
+            ResetEvent(overlapped.hEvent);
+            if (!ReadDirectoryChangesW(dir, buffer.data(), (DWORD)(buffer.size() * sizeof(DWORD)), FALSE,
+                                       filter, NULL, &overlapped, NULL)) {
+                ServerLogger::Log("ERROR", "Config watcher: ReadDirectoryChangesW failed (%lu)", GetLastError());
+                break;
+            }
+            read_pending = true;
+        }
+
+        HANDLE handles[2] = { overlapped.hEvent, (HANDLE)stop_event };
+        // A file check due before the debounce ends only shortens this wait
+        int check_in_ms = CheckFilesIfDue(next_check);
+        bool settling = change_pending && DEBOUNCE_MS <= check_in_ms;
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, settling ? DEBOUNCE_MS : check_in_ms);
+        if (wait == WAIT_OBJECT_0 + 1) {
+            break;
+        }
+        if (wait == WAIT_TIMEOUT) {
+            if (settling) {
+                change_pending = false;
+                Reload();
+            }
+            continue;
+        }
+
+        DWORD bytes = 0;
+        read_pending = false;
+        if (!GetOverlappedResult(dir, &overlapped, &bytes, FALSE)) {
+            continue;
+        }
+        if (bytes == 0) {
+            change_pending = true; // Buffer overflowed; assume our file was among the changes
+            continue;
+        }
+
+        const BYTE* entry = reinterpret_cast<const BYTE*>(buffer.data());
+        for (;;) {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry);
+            std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+            if (_wcsicmp(name.c_str(), wide_name.c_str()) == 0) {
+                change_pending = true;
+            }
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            entry += info->NextEntryOffset;
+        }
+    }
+
+    if (read_pending) {
+        DWORD bytes = 0;
+        CancelIoEx(dir, &overlapped);
+        GetOverlappedResult(dir, &overlapped, &bytes, TRUE);
+    }
+    CloseHandle(overlapped.hEvent);
+    CloseHandle(dir);
+}
+
+#else
+
+void ConfigWatcher::WatcherThreadFunc() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        ServerLogger::Log("ERROR", "Config watcher: inotify_init1 failed");
+        return;
+    }
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        ServerLogger::Log("ERROR", "Config watcher: cannot watch directory %s", directory.c_str());
+        close(fd);
+        return;
+    }
+
+    ServerLogger::Log("INFO", "Watching %s for changes", config_path.c_str());
+
+    alignas(struct inotify_event) char buffer[4096];
+    bool change_pending = false;
+    auto next_check = std::chrono::steady_clock::now() + std::chrono::milliseconds(FILE_CHECK_MS);
+    while (!stopping) {
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+        // A file check due before the debounce ends only shortens this wait
+        int check_in_ms = CheckFilesIfDue(next_check);
+        bool settling = change_pending && DEBOUNCE_MS <= check_in_ms;
+        int ready = poll(fds, 2, settling ? DEBOUNCE_MS : check_in_ms);
+        if (ready < 0 || (fds[1].revents & POLLIN)) {
+            break;
+        }
+        if (ready == 0) {
+            if (settling) {
+                change_pending = false;
+                Reload();
+            }
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length; ) {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+                if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && file_name == event->name)) {
+                    change_pending = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+
+    close(fd);
+}
+
+#endif
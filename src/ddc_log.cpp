@@ -0,0 +1,256 @@
+#include "ddc_log.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+static void PutLe(uint8_t* out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint64_t GetLe(const uint8_t* in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+static void EncodeRecord(const DdcLogRecord& record, uint8_t* out) {
+    PutLe(out, record.start_us, 8);
+    PutLe(out + 8, record.latency_us, 4);
+    out[12] = record.bus;
+    out[13] = static_cast<uint8_t>(record.op);
+    out[14] = record.ok ? 0 : 1;
+    out[15] = record.packet.register_address;
+    memcpy(out + 16, record.packet.data, DDC_PACKET_SIZE);
+    PutLe(out + 22, record.current_value, 2);
+    PutLe(out + 24, record.maximum_value, 2);
+}
+
+static void DecodeRecord(const uint8_t* in, DdcLogRecord& record) {
+    record.start_us = GetLe(in, 8);
+    record.latency_us = static_cast<uint32_t>(GetLe(in + 8, 4));
+    record.bus = in[12];
+    record.op = in[13] == 1 ? DdcLogRecord::Op::Read : DdcLogRecord::Op::Write;
+    record.ok = in[14] == 0;
+    record.packet.register_address = in[15];
+    memcpy(record.packet.data, in + 16, DDC_PACKET_SIZE);
+    record.current_value = static_cast<uint16_t>(GetLe(in + 22, 2));
+    record.maximum_value = static_cast<uint16_t>(GetLe(in + 24, 2));
+}
+
+// Reads are logged with only the register and command code of the packet set
+static DdcPacket ReadRequestPacket(uint8_t command_code, uint8_t register_address) {
+    DdcPacket packet;
+    packet.register_address = register_address;
+    packet.data[DDC_CODE_OFFSET] = command_code;
+    return packet;
+}
+
+DdcRecorder::DdcRecorder() : file(nullptr), start(std::chrono::steady_clock::now()), record_count(0) {
+}
+
+DdcRecorder::~DdcRecorder() {
+    Close();
+}
+
+bool DdcRecorder::Open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (file) {
+        fclose(file);
+    }
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t header[DDC_LOG_HEADER_SIZE];
+    memcpy(header, DDC_LOG_MAGIC, sizeof(DDC_LOG_MAGIC));
+    PutLe(header + 8, DDC_LOG_VERSION, 4);
+    PutLe(header + 12, DDC_LOG_RECORD_SIZE, 4);
+    fwrite(header, 1, sizeof(header), file);
+    fflush(file);
+
+    start = std::chrono::steady_clock::now();
+    record_count = 0;
+    return true;
+}
+
+void DdcRecorder::Close() {
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+uint64_t DdcRecorder::Now() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void DdcRecorder::Append(const DdcLogRecord& record) {
+    uint8_t bytes[DDC_LOG_RECORD_SIZE];
+    EncodeRecord(record, bytes);
+
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (!file) {
+        return;
+    }
+    fwrite(bytes, 1, sizeof(bytes), file);
+    fflush(file);
+    record_count++;
+}
+
+uint64_t DdcRecorder::GetRecordCount() {
+    std::lock_guard<std::mutex> lock(file_mutex);
+    return record_count;
+}
+
+RecordingTransport::RecordingTransport(int bus_index, std::unique_ptr<DdcTransport> transport,
+                                       std::shared_ptr<DdcRecorder> log)
+    : bus(static_cast<uint8_t>(bus_index)), inner(std::move(transport)), recorder(std::move(log)) {
+}
+
+bool RecordingTransport::Write(const DdcPacket& packet) {
+    DdcLogRecord record;
+    record.bus = bus;
+    record.op = DdcLogRecord::Op::Write;
+    record.packet = packet;
+    record.start_us = recorder->Now();
+    record.ok = inner->Write(packet);
+    record.latency_us = static_cast<uint32_t>(recorder->Now() - record.start_us);
+    recorder->Append(record);
+    return record.ok;
+}
+
+bool RecordingTransport::Read(uint8_t command_code, uint8_t register_address,
+                              uint16_t* current_value, uint16_t* maximum_value) {
+    DdcLogRecord record;
+    record.bus = bus;
+    record.op = DdcLogRecord::Op::Read;
+    record.packet = ReadRequestPacket(command_code, register_address);
+    record.start_us = recorder->Now();
+    record.ok = inner->Read(command_code, register_address, current_value, maximum_value);
+    record.latency_us = static_cast<uint32_t>(recorder->Now() - record.start_us);
+    if (record.ok) {
+        record.current_value = *current_value;
+        record.maximum_value = *maximum_value;
+    }
+    recorder->Append(record);
+    return record.ok;
+}
+
+bool LoadDdcLog(const std::string& path, std::vector<DdcLogRecord>& records, std::string& error) {
+    records.clear();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    uint8_t header[DDC_LOG_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, DDC_LOG_MAGIC, sizeof(DDC_LOG_MAGIC)) != 0) {
+        fclose(file);
+        error = path + " is not a DDC transaction log";
+        return false;
+    }
+    if (GetLe(header + 8, 4) != DDC_LOG_VERSION || GetLe(header + 12, 4) != DDC_LOG_RECORD_SIZE) {
+        fclose(file);
+        error = path + " was written by an incompatible version";
+        return false;
+    }
+
+    uint8_t bytes[DDC_LOG_RECORD_SIZE];
+    size_t read;
+    while ((read = fread(bytes, 1, sizeof(bytes), file)) == sizeof(bytes)) {
+        DdcLogRecord record;
+        DecodeRecord(bytes, record);
+        records.push_back(record);
+    }
+    fclose(file);
+
+    if (read != 0) {
+        error = path + " ends with a partial record";
+        return false;
+    }
+    return true;
+}
+
+ReplayTransport::ReplayTransport(std::vector<DdcLogRecord> log, double scale)
+    : records(std::move(log)), used(records.size(), false), position(0), last_used(0),
+      time_scale(scale), divergences(0) {
+}
+
+static bool SameTransaction(const DdcLogRecord& a, const DdcLogRecord& b) {
+    return a.op == b.op && a.packet.register_address == b.packet.register_address &&
+           memcmp(a.packet.data, b.packet.data, DDC_PACKET_SIZE) == 0;
+}
+
+bool ReplayTransport::Next(const DdcLogRecord& call, DdcLogRecord& recorded) {
+    {
+        std::lock_guard<std::mutex> lock(replay_mutex);
+        size_t found = records.size();
+        // Records the code under test skipped stay unused without blocking the window
+        size_t end = std::min(records.size(), std::max(position, last_used) + REPLAY_LOOKAHEAD);
+        for (size_t i = position; i < end; i++) {
+            if (!used[i] && SameTransaction(call, records[i])) {
+                found = i;
+                break;
+            }
+        }
+        if (found == records.size()) {
+            divergences++;
+            return false;
+        }
+
+        recorded = records[found];
+        used[found] = true;
+        last_used = std::max(last_used, found + 1);
+        while (position < records.size() && used[position]) {
+            position++;
+        }
+    }
+
+    if (time_scale > 0.0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(recorded.latency_us * time_scale)));
+    }
+    return true;
+}
+
+bool ReplayTransport::Write(const DdcPacket& packet) {
+    DdcLogRecord call, recorded;
+    call.op = DdcLogRecord::Op::Write;
+    call.packet = packet;
+    return Next(call, recorded) && recorded.ok;
+}
+
+bool ReplayTransport::Read(uint8_t command_code, uint8_t register_address,
+                           uint16_t* current_value, uint16_t* maximum_value) {
+    DdcLogRecord call, recorded;
+    call.op = DdcLogRecord::Op::Read;
+    call.packet = ReadRequestPacket(command_code, register_address);
+    if (!Next(call, recorded) || !recorded.ok) {
+        return false;
+    }
+    *current_value = recorded.current_value;
+    *maximum_value = recorded.maximum_value;
+    return true;
+}
+
+uint64_t ReplayTransport::GetDivergenceCount() {
+    std::lock_guard<std::mutex> lock(replay_mutex);
+    return divergences;
+}
+
+size_t ReplayTransport::GetUnusedCount() {
+    std::lock_guard<std::mutex> lock(replay_mutex);
+    size_t unused = 0;
+    for (bool consumed : used) {
+        unused += consumed ? 0 : 1;
+    }
+    return unused;
+}
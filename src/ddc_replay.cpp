@@ -0,0 +1,177 @@
+// Re-run a recorded DDC session without the monitor
+//
+// Usage: ddc_replay <log> [--speed N] [--dump]
+//
+// The log comes from DDC_RECORD_FILE (config.env). --dump prints every
+// transaction. Otherwise each recorded write is submitted to a
+// DisplayExecutor for its display at its recorded time divided by --speed
+// (default 1, 0 = all at once with no bus delay), and a ReplayTransport
+// answers with the recorded results and latencies. Recorded reads are left
+// for the executor's own probes (input-switch settling, circuit breaker) to
+// consume; reads made by API clients are not re-issued.
+//
+// The report shows, per display, how many writes came out differently from
+// the recording, transactions the executor issued that the log does not
+// contain (divergences), recorded transactions it never issued, and the
+// caller-side latency, so scheduling changes can be compared on a real
+// session. Exits with 1 if any write's result or any transaction diverged.
+
+#include "ddc_log.h"
+#include "display_executor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayedWrite {
+    const DdcLogRecord* record = nullptr;
+    Clock::time_point submitted;
+    double latency_ms = 0;
+    bool result = false;
+};
+
+static void Dump(const std::vector<DdcLogRecord>& records) {
+    printf("%12s %4s %5s %4s %4s %6s %6s %10s\n", "time_ms", "bus", "op", "reg", "code", "value", "status", "latency_ms");
+    for (const DdcLogRecord& record : records) {
+        bool read = record.op == DdcLogRecord::Op::Read;
+        printf("%12.3f %4u %5s 0x%02X 0x%02X %6u %6s %10.3f\n", record.start_us / 1000.0, record.bus,
+               read ? "read" : "write", record.packet.register_address, record.packet.CommandCode(),
+               read ? record.current_value : record.packet.Value(), record.ok ? "ok" : "FAIL",
+               record.latency_us / 1000.0);
+    }
+}
+
+static double Percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: ddc_replay <log> [--speed N] [--dump]\n");
+        return 2;
+    }
+
+    double speed = 1.0;
+    bool dump = false;
+    for (int arg = 2; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--dump") == 0) {
+            dump = true;
+        } else if (strcmp(argv[arg], "--speed") == 0 && arg + 1 < argc && atof(argv[arg + 1]) >= 0) {
+            speed = atof(argv[++arg]);
+        } else {
+            printf("Unknown option: %s\n", argv[arg]);
+            return 2;
+        }
+    }
+
+    std::vector<DdcLogRecord> records;
+    std::string error;
+    if (!LoadDdcLog(argv[1], records, error)) {
+        printf("%s\n", error.c_str());
+        if (records.empty()) {
+            return 2;
+        }
+        printf("Replaying the %zu complete records\n", records.size());
+    }
+
+    if (dump) {
+        Dump(records);
+        return 0;
+    }
+
+    // One executor per recorded bus, each with its own slice of the log
+    double time_scale = speed > 0 ? 1.0 / speed : 0.0;
+    std::map<int, std::vector<DdcLogRecord>> by_bus;
+    for (const DdcLogRecord& record : records) {
+        by_bus[record.bus].push_back(record);
+    }
+    std::map<int, ReplayTransport*> transports;
+    std::map<int, std::unique_ptr<DisplayExecutor>> executors;
+    for (auto& bus : by_bus) {
+        ReplayTransport* transport = new ReplayTransport(bus.second, time_scale);
+        transports[bus.first] = transport;
+        executors[bus.first] = std::make_unique<DisplayExecutor>(bus.first, std::unique_ptr<DdcTransport>(transport));
+    }
+
+    std::vector<ReplayedWrite> writes;
+    for (const DdcLogRecord& record : records) {
+        if (record.op == DdcLogRecord::Op::Write) {
+            ReplayedWrite write;
+            write.record = &record;
+            writes.push_back(write);
+        }
+    }
+    // Records are appended as transactions finish, so displays interleave out of start order
+    std::stable_sort(writes.begin(), writes.end(), [](const ReplayedWrite& a, const ReplayedWrite& b) {
+        return a.record->start_us < b.record->start_us;
+    });
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t done = 0;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < writes.size(); i++) {
+        if (speed > 0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                static_cast<int64_t>(writes[i].record->start_us / speed)));
+        }
+        ReplayedWrite* write = &writes[i];
+        write->submitted = Clock::now();
+        executors[write->record->bus]->Submit(write->record->packet, [write, &done_mutex, &done_cv, &done](bool result) {
+            write->result = result;
+            write->latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - write->submitted).count();
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done++;
+            done_cv.notify_one();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&]() { return done == writes.size(); });
+    }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    bool identical = true;
+    printf("Replayed %zu writes in %.0f ms (speed %g)\n", writes.size(), elapsed_ms, speed);
+    for (auto& executor : executors) {
+        int bus = executor.first;
+        executor.second->Stop();
+
+        int sent = 0, changed = 0;
+        std::vector<double> latencies;
+        for (const ReplayedWrite& write : writes) {
+            if (write.record->bus == bus) {
+                sent++;
+                changed += write.result != write.record->ok ? 1 : 0;
+                latencies.push_back(write.latency_ms);
+            }
+        }
+        uint64_t divergences = transports[bus]->GetDivergenceCount();
+        size_t unused = transports[bus]->GetUnusedCount();
+        DisplayExecutor::Stats stats = executor.second->GetStats();
+        printf("  display %d: %d writes, %d results differ, %llu divergences, %zu recorded transactions unused\n",
+               bus, sent, changed, (unsigned long long)divergences, unused);
+        printf("    caller latency p50 %.1f ms, p95 %.1f ms, max %.1f ms\n", Percentile(latencies, 0.5),
+               Percentile(latencies, 0.95), Percentile(latencies, 1.0));
+        printf("    %llu timeouts, %llu breaker opens, %llu fast-failed, %llu switches skipped\n",
+               (unsigned long long)stats.timeouts, (unsigned long long)stats.breaker_opens,
+               (unsigned long long)stats.fast_failed, (unsigned long long)stats.switches_skipped);
+        identical = identical && changed == 0 && divergences == 0;
+    }
+
+    printf("%s\n", identical ? "Replay matches the recording" : "Replay differs from the recording");
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,707 @@
+#include "ddc_sequence.h"
+#include <sstream>
+#include <cstdlib>
+#include <set>
+#include <algorithm>
+
+static bool ParseHex(const std::string& text, unsigned long max_value, unsigned long& value) {
+    char* end = nullptr;
+    value = strtoul(text.c_str(), &end, 16);
+    return !text.empty() && *end == '\0' && value <= max_value;
+}
+
+static bool ParseComparison(const std::string& text, SequenceComparison& op) {
+    if (text == "==") op = SequenceComparison::Equal;
+    else if (text == "!=") op = SequenceComparison::NotEqual;
+    else if (text == "<") op = SequenceComparison::Less;
+    else if (text == ">") op = SequenceComparison::Greater;
+    else return false;
+    return true;
+}
+
+static bool Compare(uint16_t value, SequenceComparison op, uint16_t operand) {
+    switch (op) {
+    case SequenceComparison::Equal: return value == operand;
+    case SequenceComparison::NotEqual: return value != operand;
+    case SequenceComparison::Less: return value < operand;
+    case SequenceComparison::Greater: return value > operand;
+    }
+    return false;
+}
+
+static bool ParseDecimal(const std::string& text, long min_value, long max_value, long& value) {
+    char* end = nullptr;
+    value = strtol(text.c_str(), &end, 10);
+    return !text.empty() && *end == '\0' && value >= min_value && value <= max_value;
+}
+
+// Parse one step (without an "if" prefix); read_codes holds the codes read by earlier steps
+static bool ParseStep(const std::vector<std::string>& args, const std::set<uint8_t>& read_codes,
+                      SequenceStep& step, std::string& error) {
+    unsigned long value = 0, code = 0, reg = DDC_VCP_REGISTER;
+    const std::string& keyword = args[0];
+
+    if (keyword == "delay") {
+        long delay = 0;
+        if (args.size() != 2 || !ParseDecimal(args[1], 0, MAX_SEQUENCE_DELAY_MS, delay)) {
+            error = "expected delay <milliseconds> (0-60000)";
+            return false;
+        }
+        step.type = SequenceStep::Type::Delay;
+        step.delay_ms = static_cast<int>(delay);
+        return true;
+    }
+
+    if (keyword == "add") {
+        bool negative = args.size() == 3 && args[2][0] == '-';
+        if (args.size() != 3 || !ParseHex(args[1], 0xFF, code) ||
+            !ParseHex(args[2].substr(negative ? 1 : 0), 0x7FFF, value)) {
+            error = "expected add <code> <delta>";
+            return false;
+        }
+        if (!read_codes.count(static_cast<uint8_t>(code))) {
+            error = "'add " + args[1] + "' must follow a read of that code";
+            return false;
+        }
+        step.type = SequenceStep::Type::Add;
+        step.command_code = static_cast<uint8_t>(code);
+        step.delta = negative ? -static_cast<int>(value) : static_cast<int>(value);
+        return true;
+    }
+
+    size_t first_code;
+    if (keyword == "write") {
+        if (args.size() != 3 && args.size() != 4) {
+            error = "expected write <value> <code> [register]";
+            return false;
+        }
+        step.type = SequenceStep::Type::Write;
+        if (args[1][0] == '$') {
+            unsigned long from = 0;
+            if (!ParseHex(args[1].substr(1), 0xFF, from) || !read_codes.count(static_cast<uint8_t>(from))) {
+                error = "'" + args[1] + "' must name a code read by an earlier step";
+                return false;
+            }
+            step.value_from = static_cast<int>(from);
+        } else if (!ParseHex(args[1], 0xFFFF, value)) {
+            error = "invalid hex value '" + args[1] + "'";
+            return false;
+        }
+        first_code = 2;
+    } else if (keyword == "read") {
+        if (args.size() != 2 && args.size() != 3) {
+            error = "expected read <code> [register]";
+            return false;
+        }
+        step.type = SequenceStep::Type::Read;
+        first_code = 1;
+    } else {
+        error = "unknown step '" + keyword + "'";
+        return false;
+    }
+
+    if (!ParseHex(args[first_code], 0xFF, code)) {
+        error = "invalid hex code '" + args[first_code] + "'";
+        return false;
+    }
+    if (first_code + 1 < args.size() && !ParseHex(args[first_code + 1], 0xFF, reg)) {
+        error = "invalid hex register '" + args[first_code + 1] + "'";
+        return false;
+    }
+    step.value = static_cast<uint16_t>(value);
+    step.command_code = static_cast<uint8_t>(code);
+    step.register_address = static_cast<uint8_t>(reg);
+    return true;
+}
+
+// Parse the "if <code> <op> <value>" part of args into step's guard
+static bool ParseGuard(const std::vector<std::string>& args, const std::set<uint8_t>& read_codes,
+                       SequenceStep& step, std::string& error) {
+    unsigned long code = 0, operand = 0;
+    if (args.size() < 4 || !ParseHex(args[1], 0xFF, code) || !ParseComparison(args[2], step.guard_op) ||
+        !ParseHex(args[3], 0xFFFF, operand)) {
+        error = "expected if <code> <==|!=|<|>> <value> <step>";
+        return false;
+    }
+    if (!read_codes.count(static_cast<uint8_t>(code))) {
+        error = "'if " + args[1] + "' must test a code read by an earlier step";
+        return false;
+    }
+    step.guarded = true;
+    step.guard_code = static_cast<uint8_t>(code);
+    step.guard_value = static_cast<uint16_t>(operand);
+    return true;
+}
+
+struct Statement {
+    std::string text;               // For error messages
+    std::vector<std::string> args;
+};
+
+// Split text into statements: one per line or ';', without comments or blank ones
+static std::vector<Statement> SplitStatements(const std::string& text) {
+    std::string normalized = text;
+    for (char& c : normalized) {
+        if (c == ';') c = '\n';
+    }
+
+    std::vector<Statement> statements;
+    std::istringstream input(normalized);
+    std::string line;
+    while (std::getline(input, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
+        Statement statement;
+        std::istringstream words(line);
+        std::string word;
+        while (words >> word) {
+            statement.args.push_back(word);
+        }
+        if (statement.args.empty()) {
+            continue;
+        }
+        size_t text_start = line.find_first_not_of(" \t\r");
+        statement.text = line.substr(text_start, line.find_last_not_of(" \t\r") - text_start + 1);
+        statements.push_back(statement);
+    }
+    return statements;
+}
+
+static std::string StepError(size_t index, const Statement& statement, const std::string& error) {
+    return "step " + std::to_string(index + 1) + " (" + statement.text + "): " + error;
+}
+
+bool ParseDdcSequence(const std::string& text, std::vector<SequenceStep>& steps, std::string& error) {
+    std::vector<Statement> statements = SplitStatements(text);
+    if (statements.size() > static_cast<size_t>(MAX_SEQUENCE_STEPS)) {
+        error = "more than " + std::to_string(MAX_SEQUENCE_STEPS) + " steps";
+        return false;
+    }
+
+    std::set<uint8_t> read_codes;
+    for (const Statement& statement : statements) {
+        std::vector<std::string> args = statement.args;
+        SequenceStep step;
+        std::string step_error;
+        if (args[0] == "if") {
+            if (args.size() < 5) {
+                step_error = "expected if <code> <==|!=|<|>> <value> <step>";
+            } else if (ParseGuard(args, read_codes, step, step_error)) {
+                args.erase(args.begin(), args.begin() + 4);
+            }
+        }
+        if (step_error.empty()) {
+            ParseStep(args, read_codes, step, step_error);
+        }
+        if (!step_error.empty()) {
+            error = StepError(steps.size(), statement, step_error);
+            return false;
+        }
+
+        if (step.type == SequenceStep::Type::Read) {
+            read_codes.insert(step.command_code);
+        }
+        steps.push_back(step);
+    }
+
+    if (steps.empty()) {
+        error = "no steps";
+        return false;
+    }
+    return true;
+}
+
+// Bus steps, delay time and instructions run that a program adds up to
+// while it is compiled. Every emitted instruction runs at most as often as
+// the loops around it multiply out to, and that multiplier is capped at
+// MAX_MACRO_INSTRUCTIONS before it grows, so none of the sums can overflow.
+struct ProgramPlan {
+    int64_t bus_steps = 0;
+    int64_t delay_ms = 0;
+    int64_t instructions = 0;
+};
+
+// Append an instruction that runs `runs` times
+static void Emit(DdcProgram& program, const DdcInstruction& instruction, size_t source, int64_t runs,
+                 ProgramPlan& plan) {
+    plan.instructions += runs;
+    program.code.push_back(instruction);
+    program.steps.push_back(static_cast<uint16_t>(source));
+}
+
+// Emit one step (and its guard), run multiplier times by the loops around it
+static void EmitStep(DdcProgram& program, const SequenceStep& step, size_t source, int64_t multiplier,
+                     ProgramPlan& plan) {
+    if (step.guarded) {
+        DdcInstruction guard;
+        guard.op = DdcOp::JumpUnless;
+        guard.code = step.guard_code;
+        guard.arg = static_cast<uint8_t>(step.guard_op);
+        guard.operand = step.guard_value;
+        guard.target = static_cast<uint16_t>(program.code.size() + 2);
+        Emit(program, guard, source, multiplier, plan);
+    }
+
+    DdcInstruction instruction;
+    instruction.code = step.command_code;
+    instruction.reg = step.register_address;
+    switch (step.type) {
+    case SequenceStep::Type::Write:
+        instruction.op = step.value_from >= 0 ? DdcOp::WriteRead : DdcOp::Write;
+        instruction.arg = static_cast<uint8_t>(step.value_from);
+        instruction.operand = step.value;
+        plan.bus_steps += multiplier;
+        break;
+    case SequenceStep::Type::Read:
+        instruction.op = DdcOp::Read;
+        plan.bus_steps += multiplier;
+        break;
+    case SequenceStep::Type::Delay:
+        instruction.op = DdcOp::Delay;
+        instruction.operand = static_cast<uint16_t>(step.delay_ms);
+        plan.delay_ms += multiplier * step.delay_ms;
+        break;
+    case SequenceStep::Type::Add:
+        instruction.op = DdcOp::Add;
+        instruction.operand = static_cast<uint16_t>(static_cast<int16_t>(step.delta));
+        break;
+    }
+    Emit(program, instruction, source, multiplier, plan);
+}
+
+static bool IsBusStep(const SequenceStep& step) {
+    return step.type == SequenceStep::Type::Write || step.type == SequenceStep::Type::Read;
+}
+
+void CompileDdcSequence(const std::vector<SequenceStep>& steps, DdcProgram& program) {
+    program = DdcProgram();
+    ProgramPlan plan;
+    for (size_t i = 0; i < steps.size(); i++) {
+        EmitStep(program, steps[i], i, 1, plan);
+        program.uses_default_display = program.uses_default_display || IsBusStep(steps[i]);
+    }
+    program.bus_steps = static_cast<int>(plan.bus_steps);
+    program.delay_ms = static_cast<int>(plan.delay_ms);
+}
+
+bool CompileDdcMacro(const std::string& text, DdcProgram& program, std::string& error) {
+    // An open block. Bus steps in it run multiplier times, and display_known
+    // says whether a display was picked before it.
+    struct Block {
+        enum class Kind { If, Else, Repeat, Each };
+        Kind kind;
+        size_t jump;                // If/Else: jump to patch at the end; loops: first instruction of the body
+        uint8_t counter;
+        uint16_t list;
+        int64_t multiplier;
+        bool display_known;
+    };
+
+    program = DdcProgram();
+    std::vector<Statement> statements = SplitStatements(text);
+    if (statements.empty()) {
+        error = "no steps";
+        return false;
+    }
+    if (statements.size() > static_cast<size_t>(MAX_MACRO_STEPS)) {
+        error = "more than " + std::to_string(MAX_MACRO_STEPS) + " steps";
+        return false;
+    }
+
+    std::set<uint8_t> read_codes;
+    std::set<int> displays;
+    std::vector<Block> blocks;
+    ProgramPlan plan;
+    int64_t multiplier = 1;
+    uint8_t loops = 0;
+    bool display_known = false;
+    for (size_t index = 0; index < statements.size(); index++) {
+        const std::vector<std::string>& args = statements[index].args;
+        const std::string& keyword = args[0];
+        std::string step_error;
+        long number = 0;
+        DdcInstruction instruction;
+
+        if (keyword == "display") {
+            if (args.size() != 2 || !ParseDecimal(args[1], 0, 255, number)) {
+                step_error = "expected display <index>";
+            } else {
+                instruction.op = DdcOp::Display;
+                instruction.operand = static_cast<uint16_t>(number);
+                Emit(program, instruction, index, multiplier, plan);
+                displays.insert(static_cast<int>(number));
+                display_known = true;
+            }
+        } else if (keyword == "each" || keyword == "repeat") {
+            std::vector<int> list;
+            bool each = keyword == "each";
+            if (loops == MAX_MACRO_LOOP_DEPTH) {
+                step_error = "loops nested more than " + std::to_string(MAX_MACRO_LOOP_DEPTH) + " deep";
+            } else if (each) {
+                for (size_t i = 1; i < args.size() && step_error.empty(); i++) {
+                    if (!ParseDecimal(args[i], 0, 255, number) ||
+                        std::find(list.begin(), list.end(), static_cast<int>(number)) != list.end()) {
+                        step_error = "invalid or repeated display '" + args[i] + "'";
+                    }
+                    list.push_back(static_cast<int>(number));
+                }
+                if (list.empty()) {
+                    step_error = "expected each <display> [<display>...]";
+                }
+            } else if (args.size() != 2 || !ParseDecimal(args[1], 1, MAX_MACRO_REPEAT, number)) {
+                step_error = "expected repeat <count> (1-" + std::to_string(MAX_MACRO_REPEAT) + ")";
+            }
+            if (step_error.empty()) {
+                instruction.op = each ? DdcOp::Each : DdcOp::Repeat;
+                instruction.arg = loops;
+                instruction.operand = static_cast<uint16_t>(each ? program.display_lists.size() : number);
+                Emit(program, instruction, index, multiplier, plan);
+                blocks.push_back({ each ? Block::Kind::Each : Block::Kind::Repeat, program.code.size(), loops,
+                                   instruction.operand, multiplier, display_known });
+                if (each) {
+                    program.display_lists.push_back(list);
+                    displays.insert(list.begin(), list.end());
+                    display_known = true;
+                }
+                // multiplier <= MAX_MACRO_INSTRUCTIONS here, so the product fits easily
+                multiplier *= each ? static_cast<int64_t>(list.size()) : number;
+                loops++;
+                if (multiplier > MAX_MACRO_INSTRUCTIONS) {
+                    step_error = "the macro could run more than " + std::to_string(MAX_MACRO_INSTRUCTIONS) +
+                                 " instructions";
+                }
+            }
+        } else if (keyword == "if" && args.size() == 4) {
+            SequenceStep guard;
+            if (ParseGuard(args, read_codes, guard, step_error)) {
+                instruction.op = DdcOp::JumpUnless;
+                instruction.code = guard.guard_code;
+                instruction.arg = static_cast<uint8_t>(guard.guard_op);
+                instruction.operand = guard.guard_value;
+                Emit(program, instruction, index, multiplier, plan);
+                blocks.push_back({ Block::Kind::If, program.code.size() - 1, 0, 0, multiplier, display_known });
+            }
+        } else if (keyword == "else") {
+            if (args.size() != 1 || blocks.empty() || blocks.back().kind != Block::Kind::If) {
+                step_error = "'else' without 'if'";
+            } else {
+                Block& block = blocks.back();
+                instruction.op = DdcOp::Jump;
+                Emit(program, instruction, index, multiplier, plan);
+                program.code[block.jump].target = static_cast<uint16_t>(program.code.size());
+                block.kind = Block::Kind::Else;
+                block.jump = program.code.size() - 1;
+                display_known = block.display_known;
+            }
+        } else if (keyword == "end") {
+            if (args.size() != 1 || blocks.empty()) {
+                step_error = "'end' without a block";
+            } else {
+                Block block = blocks.back();
+                blocks.pop_back();
+                if (block.kind == Block::Kind::If || block.kind == Block::Kind::Else) {
+                    // A display picked in only one branch may not have been picked
+                    program.code[block.jump].target = static_cast<uint16_t>(program.code.size());
+                    display_known = block.display_known;
+                } else {
+                    instruction.op = block.kind == Block::Kind::Each ? DdcOp::NextDisplay : DdcOp::Next;
+                    instruction.arg = block.counter;
+                    instruction.operand = block.list;
+                    instruction.target = static_cast<uint16_t>(block.jump);
+                    Emit(program, instruction, index, multiplier, plan);
+                    loops--;
+                }
+                multiplier = block.multiplier;
+            }
+        } else {
+            std::vector<std::string> step_args = args;
+            SequenceStep step;
+            if (keyword == "if" && ParseGuard(args, read_codes, step, step_error)) {
+                step_args.erase(step_args.begin(), step_args.begin() + 4);
+            }
+            if (step_error.empty() && ParseStep(step_args, read_codes, step, step_error)) {
+                EmitStep(program, step, index, multiplier, plan);
+                program.uses_default_display = program.uses_default_display || (IsBusStep(step) && !display_known);
+                if (step.type == SequenceStep::Type::Read) {
+                    read_codes.insert(step.command_code);
+                }
+            }
+        }
+
+        if (step_error.empty() && plan.bus_steps > MAX_MACRO_BUS_STEPS) {
+            step_error = "the macro could send more than " + std::to_string(MAX_MACRO_BUS_STEPS) + " commands";
+        }
+        if (step_error.empty() && plan.instructions > MAX_MACRO_INSTRUCTIONS) {
+            step_error = "the macro could run more than " + std::to_string(MAX_MACRO_INSTRUCTIONS) + " instructions";
+        }
+        if (step_error.empty() && plan.delay_ms > MAX_MACRO_DELAY_MS) {
+            step_error = "the macro could wait longer than " + std::to_string(MAX_MACRO_DELAY_MS / 60000) + " minutes";
+        }
+        if (!step_error.empty()) {
+            error = StepError(index, statements[index], step_error);
+            return false;
+        }
+    }
+
+    if (!blocks.empty()) {
+        error = "missing 'end' for " + std::to_string(blocks.size()) + " block" + (blocks.size() > 1 ? "s" : "");
+        return false;
+    }
+    program.displays.assign(displays.begin(), displays.end());
+    program.bus_steps = static_cast<int>(plan.bus_steps);
+    program.delay_ms = static_cast<int>(plan.delay_ms);
+    return true;
+}
+
+SequenceRunner::Bus SequenceRunner::ExecutorBus(DisplayExecutor* executor, DisplayExecutor::Deadline deadline,
+                                                DisplayExecutor::Lane lane) {
+    Bus bus;
+    if (!executor) {
+        // The display went away (or shutdown began): every step fails
+        bus.write = [](const DdcPacket&, DisplayExecutor::Completion on_complete) { on_complete(false); };
+        bus.read = [](uint8_t, uint8_t, uint16_t*, uint16_t*, DisplayExecutor::Completion on_complete) {
+            on_complete(false);
+        };
+        return bus;
+    }
+    bus.write = [executor, deadline, lane](const DdcPacket& packet, DisplayExecutor::Completion on_complete) {
+        executor->Submit(packet, std::move(on_complete), deadline, lane);
+    };
+    bus.read = [executor, deadline, lane](uint8_t command_code, uint8_t register_address, uint16_t* current_value,
+                                          uint16_t* maximum_value, DisplayExecutor::Completion on_complete) {
+        executor->SubmitRead(command_code, register_address, current_value, maximum_value,
+                             std::move(on_complete), deadline, lane);
+    };
+    return bus;
+}
+
+SequenceRunner::SequenceRunner() : stopping(false), active(0) {
+    timer_thread = std::thread(&SequenceRunner::TimerThreadFunc, this);
+}
+
+SequenceRunner::~SequenceRunner() {
+    Stop();
+}
+
+void SequenceRunner::Run(const Bus& bus, const std::vector<SequenceStep>& steps, Done done) {
+    auto program = std::make_shared<DdcProgram>();
+    CompileDdcSequence(steps, *program);
+    Run([bus](int) { return bus; }, program, 0, std::move(done));
+}
+
+std::future<SequenceResult> SequenceRunner::Run(const Bus& bus, const std::vector<SequenceStep>& steps) {
+    auto promise = std::make_shared<std::promise<SequenceResult>>();
+    std::future<SequenceResult> future = promise->get_future();
+    Run(bus, steps, [promise](const SequenceResult& result) { promise->set_value(result); });
+    return future;
+}
+
+void SequenceRunner::Run(const BusFor& buses, std::shared_ptr<const DdcProgram> program, int display_index, Done done) {
+    auto sequence = std::make_shared<Sequence>();
+    sequence->buses = buses;
+    sequence->program = std::move(program);
+    sequence->display = display_index;
+    sequence->done = std::move(done);
+    sequence->start = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(runner_mutex);
+        active++;
+    }
+    Advance(sequence);
+}
+
+std::future<SequenceResult> SequenceRunner::Run(const BusFor& buses, std::shared_ptr<const DdcProgram> program,
+                                                int display_index) {
+    auto promise = std::make_shared<std::promise<SequenceResult>>();
+    std::future<SequenceResult> future = promise->get_future();
+    Run(buses, std::move(program), display_index, [promise](const SequenceResult& result) { promise->set_value(result); });
+    return future;
+}
+
+SequenceRunner::Bus& SequenceRunner::CurrentBus(Sequence& sequence) {
+    auto found = sequence.bus_by_display.find(sequence.display);
+    if (found == sequence.bus_by_display.end()) {
+        found = sequence.bus_by_display.emplace(sequence.display, sequence.buses(sequence.display)).first;
+    }
+    return found->second;
+}
+
+void SequenceRunner::Advance(std::shared_ptr<Sequence> sequence) {
+    const DdcProgram& program = *sequence->program;
+    while (sequence->next < program.code.size()) {
+        size_t index = sequence->next;
+        {
+            std::lock_guard<std::mutex> lock(runner_mutex);
+            if (stopping) {
+                sequence->result.failed_step = program.steps[index];
+                break;
+            }
+        }
+        sequence->next++;
+
+        const DdcInstruction& instruction = program.code[index];
+        switch (instruction.op) {
+        case DdcOp::Display:
+            sequence->display = instruction.operand;
+            break;
+
+        case DdcOp::Write:
+        case DdcOp::WriteRead: {
+            uint16_t value = instruction.op == DdcOp::WriteRead ? sequence->last_read[instruction.arg] : instruction.operand;
+            sequence->result.steps_run++;
+            CurrentBus(*sequence).write(MakeDdcPacket(instruction.code, value, instruction.reg),
+                                        [this, sequence, index](bool ok) {
+                if (!ok) {
+                    sequence->result.failed_step = sequence->program->steps[index];
+                    Finish(sequence, false);
+                    return;
+                }
+                Advance(sequence);
+            });
+            return;
+        }
+
+        case DdcOp::Read:
+            sequence->result.steps_run++;
+            CurrentBus(*sequence).read(instruction.code, instruction.reg, &sequence->read_current, &sequence->read_maximum,
+                                   [this, sequence, index](bool ok) {
+                const DdcInstruction& read = sequence->program->code[index];
+                if (!ok) {
+                    sequence->result.failed_step = sequence->program->steps[index];
+                    Finish(sequence, false);
+                    return;
+                }
+                sequence->last_read[read.code] = sequence->read_current;
+                SequenceRead value;
+                value.display = sequence->display;
+                value.command_code = read.code;
+                value.register_address = read.reg;
+                value.current_value = sequence->read_current;
+                value.maximum_value = sequence->read_maximum;
+                sequence->result.reads.push_back(value);
+                Advance(sequence);
+            });
+            return;
+
+        case DdcOp::Add: {
+            int value = sequence->last_read[instruction.code] + static_cast<int16_t>(instruction.operand);
+            sequence->last_read[instruction.code] = static_cast<uint16_t>(std::min(std::max(value, 0), 0xFFFF));
+            sequence->result.steps_run++;
+            break;
+        }
+
+        case DdcOp::Delay:
+            sequence->result.steps_run++;
+            if (instruction.operand > 0) {
+                {
+                    std::lock_guard<std::mutex> lock(runner_mutex);
+                    timers.emplace(Clock::now() + std::chrono::milliseconds(instruction.operand), sequence);
+                }
+                timer_cv.notify_one();
+                return;
+            }
+            break;
+
+        case DdcOp::JumpUnless:
+            if (!Compare(sequence->last_read[instruction.code], static_cast<SequenceComparison>(instruction.arg),
+                         instruction.operand)) {
+                sequence->result.steps_skipped++;
+                sequence->next = instruction.target;
+            }
+            break;
+
+        case DdcOp::Jump:
+            sequence->next = instruction.target;
+            break;
+
+        case DdcOp::Repeat:
+            sequence->counters[instruction.arg] = instruction.operand;
+            break;
+
+        case DdcOp::Next:
+            if (--sequence->counters[instruction.arg] > 0) {
+                sequence->next = instruction.target;
+            }
+            break;
+
+        case DdcOp::Each:
+            sequence->counters[instruction.arg] = 0;
+            sequence->display = program.display_lists[instruction.operand][0];
+            break;
+
+        case DdcOp::NextDisplay: {
+            const std::vector<int>& list = program.display_lists[instruction.operand];
+            if (++sequence->counters[instruction.arg] < list.size()) {
+                sequence->display = list[sequence->counters[instruction.arg]];
+                sequence->next = instruction.target;
+            }
+            break;
+        }
+        }
+    }
+    Finish(sequence, sequence->result.failed_step < 0);
+}
+
+void SequenceRunner::Finish(std::shared_ptr<Sequence> sequence, bool success) {
+    sequence->result.success = success;
+    sequence->result.elapsed_ms = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - sequence->start).count());
+    sequence->done(sequence->result);
+
+    std::lock_guard<std::mutex> lock(runner_mutex);
+    active--;
+}
+
+int SequenceRunner::GetActiveCount() {
+    std::lock_guard<std::mutex> lock(runner_mutex);
+    return active;
+}
+
+void SequenceRunner::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(runner_mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    timer_cv.notify_one();
+    if (timer_thread.joinable()) {
+        timer_thread.join();
+    }
+
+    // Sequences parked in a delay fail at that delay
+    std::multimap<Clock::time_point, std::shared_ptr<Sequence>> parked;
+    {
+        std::lock_guard<std::mutex> lock(runner_mutex);
+        parked.swap(timers);
+    }
+    for (auto& entry : parked) {
+        entry.second->result.failed_step = entry.second->program->steps[entry.second->next - 1];
+        Finish(entry.second, false);
+    }
+}
+
+void SequenceRunner::TimerThreadFunc() {
+    std::unique_lock<std::mutex> lock(runner_mutex);
+    while (!stopping) {
+        if (timers.empty()) {
+            timer_cv.wait(lock);
+            continue;
+        }
+        auto first = timers.begin();
+        if (first->first > Clock::now()) {
+            timer_cv.wait_until(lock, first->first);
+            continue;
+        }
+        std::shared_ptr<Sequence> sequence = first->second;
+        timers.erase(first);
+
+        // Queueing the next step is quick; the step itself runs on the display's worker
+        lock.unlock();
+        Advance(sequence);
+        lock.lock();
+    }
+}
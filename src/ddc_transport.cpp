@@ -0,0 +1,58 @@
+#include "ddc_transport.h"
+#include <chrono>
+#include <thread>
+
+SimulatedTransport::SimulatedTransport(uint32_t seed) : rng(seed) {
+}
+
+SimulatedTransport::~SimulatedTransport() {
+}
+
+void SimulatedTransport::SetFaults(const SimulatedFaults& new_faults) {
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    faults = new_faults;
+    hang_cv.notify_all();
+}
+
+uint64_t SimulatedTransport::GetTransactionCount() {
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    return transactions;
+}
+
+bool SimulatedTransport::Transact() {
+    std::unique_lock<std::mutex> lock(sim_mutex);
+    transactions++;
+    hang_cv.wait(lock, [this]() { return !faults.hang; });
+
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    int delay_ms = faults.latency_ms;
+    if (faults.spike_rate > 0.0 && chance(rng) < faults.spike_rate) {
+        delay_ms += faults.spike_ms;
+    }
+    bool nack = faults.nack_rate > 0.0 && chance(rng) < faults.nack_rate;
+
+    // The bus is busy for the whole transaction, including one that is NACKed
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    return !nack;
+}
+
+bool SimulatedTransport::Write(const DdcPacket& packet) {
+    if (!Transact()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    values[packet.register_address][packet.CommandCode()] = packet.Value();
+    return true;
+}
+
+bool SimulatedTransport::Read(uint8_t command_code, uint8_t register_address,
+                              uint16_t* current_value, uint16_t* maximum_value) {
+    if (!Transact()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(sim_mutex);
+    *current_value = values[register_address][command_code];
+    *maximum_value = 100;
+    return true;
+}
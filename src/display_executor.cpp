@@ -0,0 +1,564 @@
+#include "display_executor.h"
+#include "vcp_commands.h"
+#include <algorithm>
+
+const char* BreakerStateName(DisplayExecutor::BreakerState state) {
+    switch (state) {
+    case DisplayExecutor::BreakerState::Closed:   return "closed";
+    case DisplayExecutor::BreakerState::Open:     return "open";
+    case DisplayExecutor::BreakerState::HalfOpen: return "half-open";
+    }
+    return "unknown";
+}
+
+const char* LaneName(DisplayExecutor::Lane lane) {
+    return lane == DisplayExecutor::Lane::Bulk ? "bulk" : "interactive";
+}
+
+bool ParseLane(const std::string& name, DisplayExecutor::Lane& lane) {
+    if (name == "interactive") {
+        lane = DisplayExecutor::Lane::Interactive;
+        return true;
+    }
+    if (name == "bulk") {
+        lane = DisplayExecutor::Lane::Bulk;
+        return true;
+    }
+    return false;
+}
+
+CommitBarrier::CommitBarrier(int count, int timeout_ms)
+    : members(count), arrived(0), withdrawn(0), finished(0), released(false), timed_out(false),
+      deadline(Clock::now() + std::chrono::milliseconds(timeout_ms)),
+      member_arrived(count, false), member_ok(count, false), started(count), completed(count) {
+}
+
+void CommitBarrier::ArriveAndWait(int member) {
+    std::unique_lock<std::mutex> lock(barrier_mutex);
+    member_arrived[member] = true;
+    arrived++;
+    if (arrived + withdrawn == members) {
+        released = true;
+        barrier_cv.notify_all();
+    }
+    if (!barrier_cv.wait_until(lock, deadline, [this]() { return released; })) {
+        released = true;
+        timed_out = true;
+        barrier_cv.notify_all();
+    }
+    started[member] = Clock::now();
+}
+
+void CommitBarrier::Finish(int member, bool result) {
+    std::lock_guard<std::mutex> lock(barrier_mutex);
+    member_ok[member] = result;
+    completed[member] = Clock::now();
+    finished++;
+    if (!member_arrived[member]) {
+        withdrawn++;
+        if (arrived + withdrawn == members) {
+            released = true;
+        }
+    }
+    barrier_cv.notify_all();
+}
+
+GroupCommitResult CommitBarrier::Wait() {
+    std::unique_lock<std::mutex> lock(barrier_mutex);
+    barrier_cv.wait(lock, [this]() { return finished == members; });
+
+    GroupCommitResult result;
+    result.members = members;
+    result.barrier_timed_out = timed_out;
+    bool any_started = false, any_completed = false;
+    Clock::time_point first_start, last_start, first_done, last_done;
+    for (int i = 0; i < members; i++) {
+        if (member_ok[i]) {
+            result.succeeded++;
+        } else {
+            result.failed++;
+        }
+        if (member_arrived[i]) {
+            first_start = any_started ? std::min(first_start, started[i]) : started[i];
+            last_start = any_started ? std::max(last_start, started[i]) : started[i];
+            any_started = true;
+        }
+        if (member_arrived[i] && member_ok[i]) {
+            first_done = any_completed ? std::min(first_done, completed[i]) : completed[i];
+            last_done = any_completed ? std::max(last_done, completed[i]) : completed[i];
+            any_completed = true;
+        }
+    }
+    if (any_started) {
+        result.release_skew_us = std::chrono::duration_cast<std::chrono::microseconds>(last_start - first_start).count();
+    }
+    if (any_completed) {
+        result.completion_skew_ms = std::chrono::duration<double, std::milli>(last_done - first_done).count();
+    }
+    return result;
+}
+
+DisplayExecutor::DisplayExecutor(int index, std::unique_ptr<DdcTransport> bus, const InputSwitchCommand& input)
+    : display_index(index), transport(std::move(bus)), input_switch(input), worker_exited(false), interactive_streak(0), stopping(false),
+      drain_deadline(std::chrono::steady_clock::time_point::max()),
+      link_state(LinkState::Ready), active_input(-1),
+      breaker_state(BreakerState::Closed), probe_backoff_ms(BREAKER_PROBE_INITIAL_MS),
+      watchdog_stopping(false) {
+    watchdog = std::thread(&DisplayExecutor::WatchdogThreadFunc, this);
+    worker = std::thread([this]() {
+        WorkerThreadFunc();
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        worker_exited = true;
+        exit_cv.notify_all();
+    });
+}
+
+bool DisplayExecutor::IsInputSwitch(const DdcPacket& packet) const {
+    return packet.register_address == input_switch.register_address &&
+           packet.CommandCode() == input_switch.command_code;
+}
+
+DisplayExecutor::~DisplayExecutor() {
+    Stop();
+}
+
+std::future<bool> DisplayExecutor::Submit(const DdcPacket& packet, Deadline deadline, Lane lane) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> future = promise->get_future();
+    Submit(packet, [promise](bool result) { promise->set_value(result); }, deadline, lane);
+    return future;
+}
+
+void DisplayExecutor::Submit(const DdcPacket& packet, Completion on_complete, Deadline deadline, Lane lane) {
+    PendingWrite pending;
+    pending.packet = packet;
+    pending.deadline = deadline;
+    pending.lane = lane;
+    pending.on_complete = std::move(on_complete);
+    Enqueue(std::move(pending));
+}
+
+void DisplayExecutor::SubmitGroupMember(const DdcPacket& packet, std::shared_ptr<CommitBarrier> barrier, int member,
+                                        Completion on_complete, Deadline deadline, Lane lane) {
+    PendingWrite pending;
+    pending.packet = packet;
+    pending.deadline = deadline;
+    pending.lane = lane;
+    pending.barrier = std::move(barrier);
+    pending.barrier_member = member;
+    pending.on_complete = std::move(on_complete);
+    Enqueue(std::move(pending));
+}
+
+std::future<bool> DisplayExecutor::SubmitRead(uint8_t command_code, uint8_t register_address,
+                                              uint16_t* current_value, uint16_t* maximum_value,
+                                              Deadline deadline, Lane lane) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> future = promise->get_future();
+    SubmitRead(command_code, register_address, current_value, maximum_value,
+               [promise](bool result) { promise->set_value(result); }, deadline, lane);
+    return future;
+}
+
+void DisplayExecutor::SubmitRead(uint8_t command_code, uint8_t register_address,
+                                 uint16_t* current_value, uint16_t* maximum_value,
+                                 Completion on_complete, Deadline deadline, Lane lane) {
+    PendingWrite pending;
+    pending.packet = MakeDdcPacket(command_code, 0, register_address);
+    pending.is_read = true;
+    pending.current_value = current_value;
+    pending.maximum_value = maximum_value;
+    pending.deadline = deadline;
+    pending.lane = lane;
+    pending.on_complete = std::move(on_complete);
+    Enqueue(std::move(pending));
+}
+
+void DisplayExecutor::Enqueue(PendingWrite pending) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!stopping && breaker_state == BreakerState::Closed) {
+            int lane = static_cast<int>(pending.lane);
+            lane_queues[lane].push_back(std::move(pending));
+            stats.lanes[lane].peak_depth = std::max(stats.lanes[lane].peak_depth, lane_queues[lane].size());
+            queue_cv.notify_one();
+            return;
+        }
+        if (!stopping) {
+            stats.fast_failed++;
+        }
+    }
+    pending.on_complete(false);
+}
+
+bool DisplayExecutor::QueueEmpty() const {
+    return QueuedCount() == 0;
+}
+
+size_t DisplayExecutor::QueuedCount() const {
+    size_t count = 0;
+    for (const auto& lane : lane_queues) {
+        count += lane.size();
+    }
+    return count;
+}
+
+std::deque<DisplayExecutor::PendingWrite> DisplayExecutor::TakeQueued() {
+    std::deque<PendingWrite> taken;
+    for (auto& lane : lane_queues) {
+        for (PendingWrite& pending : lane) {
+            taken.push_back(std::move(pending));
+        }
+        lane.clear();
+    }
+    return taken;
+}
+
+DisplayExecutor::PendingWrite DisplayExecutor::PopNext() {
+    bool bulk_waiting = !lane_queues[static_cast<int>(Lane::Bulk)].empty();
+    Lane lane = Lane::Bulk;
+    if (!lane_queues[static_cast<int>(Lane::Interactive)].empty()) {
+        if (bulk_waiting && interactive_streak >= LANE_INTERACTIVE_BURST) {
+            stats.bulk_promoted++;
+        } else {
+            lane = Lane::Interactive;
+        }
+    }
+    interactive_streak = (lane == Lane::Interactive && bulk_waiting) ? interactive_streak + 1 : 0;
+
+    std::deque<PendingWrite>& queue = lane_queues[static_cast<int>(lane)];
+    PendingWrite pending = std::move(queue.front());
+    queue.pop_front();
+    stats.lanes[static_cast<int>(lane)].dequeued++;
+    return pending;
+}
+
+void DisplayExecutor::RequestStop(std::chrono::steady_clock::time_point deadline) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!stopping || deadline < drain_deadline) {
+            drain_deadline = deadline;
+        }
+        stopping = true;
+    }
+    queue_cv.notify_one();
+}
+
+bool DisplayExecutor::Stop(std::chrono::steady_clock::time_point join_deadline) {
+    bool joined = true;
+    std::shared_ptr<InFlight> stuck;
+    std::deque<PendingWrite> abandoned;
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        stopping = true;
+        queue_cv.notify_one();
+        auto exited = [this]() { return worker_exited; };
+        if (join_deadline == std::chrono::steady_clock::time_point::max()) {
+            exit_cv.wait(lock, exited);
+        } else if (worker.joinable() && !exit_cv.wait_until(lock, join_deadline, exited)) {
+            // Stuck in the transport (a hung driver call cannot be interrupted).
+            // Fail its caller and the queue now; when the call returns, the
+            // worker finds everything completed and exits on its own.
+            joined = false;
+            worker.detach();
+            if (in_flight && !in_flight->completed) {
+                in_flight->completed = true;
+                stuck = in_flight;
+            }
+            abandoned = TakeQueued();
+            stats.failed_on_stop += abandoned.size();
+        }
+    }
+    if (stuck) {
+        stuck->pending.on_complete(false);
+    }
+    for (PendingWrite& write : abandoned) {
+        write.on_complete(false);
+    }
+
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        watchdog_stopping = true;
+    }
+    watchdog_cv.notify_one();
+    if (watchdog.joinable()) {
+        watchdog.join();
+    }
+    return joined;
+}
+
+std::deque<DisplayExecutor::PendingWrite> DisplayExecutor::OpenBreaker() {
+    if (breaker_state == BreakerState::Closed) {
+        stats.breaker_opens++;
+        probe_backoff_ms = BREAKER_PROBE_INITIAL_MS;
+    } else if (breaker_state == BreakerState::HalfOpen) {
+        probe_backoff_ms = std::min(probe_backoff_ms * 2, BREAKER_PROBE_MAX_MS);
+    }
+    breaker_state = BreakerState::Open;
+    // Whatever was on the bus may have changed the input, or the monitor was replaced
+    active_input = -1;
+    next_probe = std::chrono::steady_clock::now() + std::chrono::milliseconds(probe_backoff_ms);
+    queue_cv.notify_one();
+
+    std::deque<PendingWrite> abandoned = TakeQueued();
+    stats.fast_failed += abandoned.size();
+    return abandoned;
+}
+
+std::deque<DisplayExecutor::PendingWrite> DisplayExecutor::RecordOutcome(bool success, bool timed_out) {
+    if (success) {
+        stats.consecutive_failures = 0;
+        if (breaker_state == BreakerState::HalfOpen) {
+            breaker_state = BreakerState::Closed;
+            probe_backoff_ms = BREAKER_PROBE_INITIAL_MS;
+            active_input = -1;
+        }
+        return {};
+    }
+
+    stats.consecutive_failures++;
+    // A timeout means the worker is stuck on the bus, so nothing queued can run anyway
+    if (timed_out || breaker_state == BreakerState::HalfOpen ||
+        stats.consecutive_failures >= BREAKER_FAILURE_THRESHOLD) {
+        return OpenBreaker();
+    }
+    return {};
+}
+
+bool DisplayExecutor::Execute(PendingWrite pending, bool expect_failure) {
+    auto flight = std::make_shared<InFlight>();
+    flight->pending = std::move(pending);
+    flight->expect_failure = expect_failure;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        flight->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DDC_TRANSACTION_TIMEOUT_MS);
+        in_flight = flight;
+    }
+    watchdog_cv.notify_one();
+
+    const PendingWrite& command = flight->pending;
+    uint16_t current = 0, maximum = 0;
+    bool result = command.is_read
+        ? transport->Read(command.packet.CommandCode(), command.packet.register_address, &current, &maximum)
+        : transport->Write(command.packet);
+
+    std::deque<PendingWrite> abandoned;
+    bool in_time;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        in_flight.reset();
+        in_time = !flight->completed;
+        flight->completed = true;
+        if (in_time) {
+            // The caller is still waiting, so its output pointers are still valid
+            if (result && command.is_read) {
+                *command.current_value = current;
+                *command.maximum_value = maximum;
+            }
+            if (result || !expect_failure) {
+                abandoned = RecordOutcome(result, false);
+            }
+            // Monitors that switch through the standard input register report the input too
+            if (result && command.is_read && input_switch.register_address == DDC_VCP_REGISTER &&
+                command.packet.register_address == DDC_VCP_REGISTER &&
+                command.packet.CommandCode() == input_switch.command_code) {
+                active_input = current;
+                active_input_until = std::chrono::steady_clock::now() + std::chrono::milliseconds(INPUT_SWITCH_CACHE_MS);
+            }
+        }
+    }
+
+    if (in_time) {
+        command.on_complete(result);
+    }
+    for (PendingWrite& write : abandoned) {
+        write.on_complete(false);
+    }
+    return in_time && result;
+}
+
+void DisplayExecutor::WatchdogThreadFunc() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (!watchdog_stopping) {
+        std::shared_ptr<InFlight> flight = in_flight;
+        if (!flight || flight->completed) {
+            watchdog_cv.wait(lock);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < flight->deadline) {
+            watchdog_cv.wait_until(lock, flight->deadline);
+            continue;
+        }
+
+        // Still on the bus past its deadline: fail the caller now and stop
+        // queuing behind it. The worker discards the result when it returns.
+        flight->completed = true;
+        stats.timeouts++;
+        std::deque<PendingWrite> abandoned = RecordOutcome(false, true);
+        lock.unlock();
+        flight->pending.on_complete(false);
+        for (PendingWrite& write : abandoned) {
+            write.on_complete(false);
+        }
+        lock.lock();
+    }
+}
+
+void DisplayExecutor::WorkerThreadFunc() {
+    for (;;) {
+        PendingWrite pending;
+        bool probe = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            for (;;) {
+                if (!QueueEmpty()) {
+                    break;
+                }
+                if (stopping) {
+                    return; // stopping and fully drained
+                }
+                if (breaker_state == BreakerState::Open) {
+                    if (std::chrono::steady_clock::now() >= next_probe) {
+                        breaker_state = BreakerState::HalfOpen;
+                        probe = true;
+                        break;
+                    }
+                    queue_cv.wait_until(lock, next_probe);
+                } else {
+                    queue_cv.wait(lock);
+                }
+            }
+
+            if (!probe) {
+                if (stopping && std::chrono::steady_clock::now() >= drain_deadline) {
+                    std::deque<PendingWrite> abandoned = TakeQueued();
+                    stats.failed_on_stop += abandoned.size();
+                    lock.unlock();
+                    for (PendingWrite& write : abandoned) {
+                        write.on_complete(false);
+                    }
+                    return;
+                }
+                pending = PopNext();
+
+                // Checked at the transaction boundary: the client has given up, so spend no bus time on it
+                if (pending.deadline != NO_DEADLINE && std::chrono::steady_clock::now() >= pending.deadline) {
+                    stats.expired++;
+                    lock.unlock();
+                    pending.on_complete(false);
+                    continue;
+                }
+
+                if (active_input >= 0 && std::chrono::steady_clock::now() >= active_input_until) {
+                    active_input = -1;
+                }
+                if (!pending.is_read && IsInputSwitch(pending.packet) && pending.packet.Value() == active_input) {
+                    stats.switches_skipped++;
+                    lock.unlock();
+                    pending.on_complete(true);
+                    continue;
+                }
+            }
+        }
+
+        if (probe) {
+            // Any answer to a VCP read closes the breaker (see RecordOutcome)
+            uint16_t current = 0, maximum = 0;
+            pending.packet = MakeDdcPacket(VCP_BRIGHTNESS, 0, DDC_VCP_REGISTER);
+            pending.is_read = true;
+            pending.current_value = &current;
+            pending.maximum_value = &maximum;
+            pending.on_complete = [](bool) {};
+            Execute(std::move(pending));
+            continue;
+        }
+
+        if (pending.barrier) {
+            pending.barrier->ArriveAndWait(pending.barrier_member);
+        }
+
+        bool is_switch = !pending.is_read && IsInputSwitch(pending.packet);
+        uint16_t input_value = pending.packet.Value();
+        bool result = Execute(std::move(pending));
+
+        bool switched = false;
+        if (is_switch) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            // After a failed switch the active input is unknown, so the next switch is always sent
+            active_input = result ? input_value : -1;
+            switched = result;
+            if (switched) {
+                stats.input_switches++;
+                link_state = LinkState::Switching;
+            }
+        }
+
+        if (switched) {
+            WaitForMonitor();
+        }
+    }
+}
+
+bool DisplayExecutor::WaitUntil(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_cv.wait_until(lock, deadline, [this]() { return stopping; });
+    return !stopping;
+}
+
+void DisplayExecutor::WaitForMonitor() {
+    auto start = std::chrono::steady_clock::now();
+    auto window_end = start + std::chrono::milliseconds(INPUT_SWITCH_MAX_MS);
+    auto next_read = start + std::chrono::milliseconds(input_switch.quiet_ms > 0 ? input_switch.quiet_ms
+                                                                                 : INPUT_SWITCH_QUIET_MS);
+
+    while (WaitUntil(next_read)) {
+        // Unanswered reads are expected here and do not count against the breaker
+        uint16_t current = 0, maximum = 0;
+        PendingWrite probe;
+        probe.packet = MakeDdcPacket(VCP_BRIGHTNESS, 0, DDC_VCP_REGISTER);
+        probe.is_read = true;
+        probe.current_value = &current;
+        probe.maximum_value = &maximum;
+        probe.on_complete = [](bool) {};
+        if (Execute(std::move(probe), true) || GetBreakerState() != BreakerState::Closed) {
+            break;
+        }
+        next_read = std::chrono::steady_clock::now() + std::chrono::milliseconds(INPUT_SWITCH_PROBE_INTERVAL_MS);
+        if (next_read >= window_end) {
+            break; // Give up waiting; queued commands report their own failures
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    link_state = LinkState::Ready;
+    // The window starts once the monitor has settled, not when the switch was sent
+    active_input_until = std::chrono::steady_clock::now() + std::chrono::milliseconds(INPUT_SWITCH_CACHE_MS);
+    stats.commands_deferred += QueuedCount();
+    if (!stopping) {
+        stats.last_settle_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+DisplayExecutor::LinkState DisplayExecutor::GetLinkState() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return link_state;
+}
+
+DisplayExecutor::BreakerState DisplayExecutor::GetBreakerState() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return breaker_state;
+}
+
+DisplayExecutor::Stats DisplayExecutor::GetStats() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    Stats current = stats;
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        current.lanes[lane].depth = lane_queues[lane].size();
+    }
+    return current;
+}
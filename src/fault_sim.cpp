@@ -0,0 +1,549 @@
+// Fault isolation check for the per-display command queues, without hardware
+//
+// Usage: fault_sim
+//
+// Two DisplayExecutors run on SimulatedTransports. Each scenario injects a
+// fault on display 1 (hang, NACK storm, latency spikes) while display 0
+// stays healthy, and checks that display 0's latency is unaffected, that
+// display 1 fails fast once its breaker is open, and that the breaker closes
+// again after the fault clears. The last scenarios check that commands whose
+// client deadline passes while queued are dropped without bus traffic, and
+// that a repeated input switch is only skipped shortly after our own switch,
+// that a stop bounded by a deadline abandons a worker hung on the bus,
+// that interactive commands overtake a bulk backlog without starving it,
+// that a group commit releases its members together and is not held up
+// by a member whose breaker is open, and that multi-step sequences on many
+// displays overlap without a thread each and leave the bus free during their
+// delays, and that a macro compiled to bytecode loops over displays and
+// branches as written. The state file scenario checks that a torn save of
+// the last known settings falls back to the previous value and that a
+// damaged file is started afresh. Exits with 1 if any check fails.
+
+#include "display_executor.h"
+#include "ddc_sequence.h"
+#include "vcp_commands.h"
+#include "state_store.h"
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static int g_failed_checks = 0;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void Check(bool condition, const char* description) {
+    printf("  [%s] %s\n", condition ? " ok " : "FAIL", description);
+    if (!condition) {
+        g_failed_checks++;
+    }
+}
+
+struct TimedWrite {
+    bool result;
+    double ms;
+};
+
+static TimedWrite WriteBrightness(DisplayExecutor& executor, int value) {
+    auto start = Clock::now();
+    bool result = executor.Submit(BrightnessCommand::Encode(static_cast<uint8_t>(value))).get();
+    return { result, MillisecondsSince(start) };
+}
+
+static void PrintStats(DisplayExecutor& executor) {
+    DisplayExecutor::Stats stats = executor.GetStats();
+    printf("  display %d: breaker %s, %llu timeouts, %llu opens, %llu fast-failed, %d consecutive failures\n",
+           executor.GetDisplayIndex(), BreakerStateName(executor.GetBreakerState()),
+           (unsigned long long)stats.timeouts, (unsigned long long)stats.breaker_opens,
+           (unsigned long long)stats.fast_failed, stats.consecutive_failures);
+}
+
+// Wait for the background probe to close the breaker
+static double WaitForRecovery(DisplayExecutor& executor, int limit_ms) {
+    auto start = Clock::now();
+    while (executor.GetBreakerState() != DisplayExecutor::BreakerState::Closed && MillisecondsSince(start) < limit_ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return MillisecondsSince(start);
+}
+
+static void HangScenario() {
+    printf("Hang on display 1\n");
+    auto* healthy_bus = new SimulatedTransport(1);
+    auto* faulty_bus = new SimulatedTransport(2);
+    DisplayExecutor healthy(0, std::unique_ptr<DdcTransport>(healthy_bus));
+    DisplayExecutor faulty(1, std::unique_ptr<DdcTransport>(faulty_bus));
+
+    SimulatedFaults hang;
+    hang.hang = true;
+    faulty_bus->SetFaults(hang);
+
+    // Queue several writes behind the hung transaction
+    std::vector<std::future<bool>> queued;
+    auto start = Clock::now();
+    for (int i = 0; i < 4; i++) {
+        queued.push_back(faulty.Submit(BrightnessCommand::Encode(static_cast<uint8_t>(10 + i))));
+    }
+
+    // Meanwhile display 0 is written from another client
+    double worst_healthy_ms = 0;
+    int healthy_ok = 0;
+    std::thread healthy_client([&]() {
+        for (int i = 0; i < 20; i++) {
+            TimedWrite write = WriteBrightness(healthy, i);
+            healthy_ok += write.result ? 1 : 0;
+            worst_healthy_ms = write.ms > worst_healthy_ms ? write.ms : worst_healthy_ms;
+        }
+    });
+
+    int queued_failed = 0;
+    for (auto& future : queued) {
+        queued_failed += future.get() ? 0 : 1;
+    }
+    double released_ms = MillisecondsSince(start);
+    healthy_client.join();
+    printf("  display 0: %d/20 writes ok, worst %.1f ms\n", healthy_ok, worst_healthy_ms);
+    printf("  display 1: %d/4 queued writes failed after %.0f ms\n", queued_failed, released_ms);
+    Check(healthy_ok == 20 && worst_healthy_ms < 2.0 * SimulatedFaults().latency_ms, "healthy display unaffected");
+    Check(queued_failed == 4 && released_ms < DDC_TRANSACTION_TIMEOUT_MS + 200, "hung display releases its callers at the deadline");
+
+    TimedWrite fast = WriteBrightness(faulty, 50);
+    printf("  display 1 while open: %s in %.2f ms\n", fast.result ? "ok" : "failed", fast.ms);
+    Check(!fast.result && fast.ms < 5.0, "open breaker fails fast");
+
+    faulty_bus->SetFaults(SimulatedFaults());
+    double recovery_ms = WaitForRecovery(faulty, BREAKER_PROBE_MAX_MS);
+    printf("  breaker closed %.0f ms after the hang cleared\n", recovery_ms);
+    Check(faulty.GetBreakerState() == DisplayExecutor::BreakerState::Closed, "probe closes the breaker");
+    Check(WriteBrightness(faulty, 60).result, "display 1 accepts writes again");
+    PrintStats(faulty);
+}
+
+static void NackScenario() {
+    printf("NACK storm on display 1\n");
+    auto* faulty_bus = new SimulatedTransport(3);
+    DisplayExecutor faulty(1, std::unique_ptr<DdcTransport>(faulty_bus));
+
+    SimulatedFaults nack;
+    nack.nack_rate = 1.0;
+    faulty_bus->SetFaults(nack);
+
+    int attempts = 0;
+    while (faulty.GetBreakerState() == DisplayExecutor::BreakerState::Closed && attempts < 10) {
+        WriteBrightness(faulty, 20);
+        attempts++;
+    }
+    printf("  breaker opened after %d failed writes\n", attempts);
+    Check(attempts == BREAKER_FAILURE_THRESHOLD, "opens after BREAKER_FAILURE_THRESHOLD consecutive failures");
+
+    uint64_t bus_before = faulty_bus->GetTransactionCount();
+    for (int i = 0; i < 100; i++) {
+        WriteBrightness(faulty, 20);
+    }
+    Check(faulty_bus->GetTransactionCount() == bus_before, "no bus traffic while open");
+
+    // The first probe fails too: the next one must wait twice as long
+    std::this_thread::sleep_for(std::chrono::milliseconds(BREAKER_PROBE_INITIAL_MS + 200));
+    faulty_bus->SetFaults(SimulatedFaults());
+    double recovery_ms = WaitForRecovery(faulty, BREAKER_PROBE_MAX_MS);
+    printf("  breaker closed %.0f ms after the NACKs stopped\n", recovery_ms);
+    Check(recovery_ms > BREAKER_PROBE_INITIAL_MS, "probe interval backs off after a failed probe");
+    PrintStats(faulty);
+}
+
+static void SpikeScenario() {
+    printf("Latency spikes on display 1 (20%% of transactions +1500 ms)\n");
+    auto* faulty_bus = new SimulatedTransport(4);
+    DisplayExecutor faulty(1, std::unique_ptr<DdcTransport>(faulty_bus));
+
+    SimulatedFaults spikes;
+    spikes.spike_rate = 0.2;
+    spikes.spike_ms = 1500;
+    faulty_bus->SetFaults(spikes);
+
+    int ok = 0, failed = 0;
+    double worst_ms = 0;
+    auto start = Clock::now();
+    while (MillisecondsSince(start) < 6000) {
+        TimedWrite write = WriteBrightness(faulty, 30);
+        (write.result ? ok : failed)++;
+        worst_ms = write.ms > worst_ms ? write.ms : worst_ms;
+        if (!write.result) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    printf("  %d ok, %d failed, worst caller wait %.0f ms\n", ok, failed, worst_ms);
+    Check(worst_ms < DDC_TRANSACTION_TIMEOUT_MS + 200, "no caller waits past the transaction deadline");
+    PrintStats(faulty);
+
+    faulty_bus->SetFaults(SimulatedFaults());
+    WaitForRecovery(faulty, BREAKER_PROBE_MAX_MS);
+}
+
+static void DeadlineScenario() {
+    printf("Deadlines on a slow display (200 ms per transaction)\n");
+    auto* slow_bus = new SimulatedTransport(5);
+    DisplayExecutor slow(0, std::unique_ptr<DdcTransport>(slow_bus));
+
+    SimulatedFaults latency;
+    latency.latency_ms = 200;
+    slow_bus->SetFaults(latency);
+
+    // Ten clients that each give up after 500 ms: only the first few can be served in time
+    auto deadline = Clock::now() + std::chrono::milliseconds(500);
+    std::vector<std::future<bool>> queued;
+    for (int i = 0; i < 10; i++) {
+        queued.push_back(slow.Submit(BrightnessCommand::Encode(static_cast<uint8_t>(i)), deadline));
+    }
+    int ok = 0;
+    for (auto& future : queued) {
+        ok += future.get() ? 1 : 0;
+    }
+    DisplayExecutor::Stats stats = slow.GetStats();
+    printf("  %d/10 sent, %llu expired, %llu bus transactions\n", ok,
+           (unsigned long long)stats.expired, (unsigned long long)slow_bus->GetTransactionCount());
+    Check(ok >= 2 && ok <= 3 && stats.expired == 10u - ok, "commands past their deadline are dropped");
+    Check(slow_bus->GetTransactionCount() == (uint64_t)ok, "expired commands never reach the bus");
+    Check(slow.GetBreakerState() == DisplayExecutor::BreakerState::Closed, "expiry does not count against the breaker");
+    Check(WriteBrightness(slow, 40).result, "commands without a deadline still run");
+}
+
+static void InputSwitchScenario() {
+    printf("Repeated input switches\n");
+    InputSwitchCommand input;
+    input.quiet_ms = 100;
+    DisplayExecutor executor(0, std::unique_ptr<DdcTransport>(new SimulatedTransport(9)), input);
+    const DdcPacket& hdmi = INPUT_SOURCES[0].packet;
+
+    Check(executor.Submit(hdmi).get() && executor.Submit(hdmi).get(), "switches succeed");
+    DisplayExecutor::Stats stats = executor.GetStats();
+    Check(stats.input_switches == 1 && stats.switches_skipped == 1, "a repeat right after the switch is skipped");
+
+    // Meanwhile someone may have used the OSD: the switch back has to reach the bus
+    std::this_thread::sleep_for(std::chrono::milliseconds(INPUT_SWITCH_CACHE_MS + 100));
+    executor.Submit(hdmi).get();
+    stats = executor.GetStats();
+    printf("  %llu switches sent, %llu skipped\n", (unsigned long long)stats.input_switches,
+           (unsigned long long)stats.switches_skipped);
+    Check(stats.input_switches == 2 && stats.switches_skipped == 1, "a repeat after INPUT_SWITCH_CACHE_MS is sent");
+}
+
+static void StopScenario() {
+    printf("Stop with a deadline while display 1 hangs\n");
+    auto* hung_bus = new SimulatedTransport(10);
+    // Never destroyed: an abandoned worker keeps using its executor
+    auto* hung = new DisplayExecutor(1, std::unique_ptr<DdcTransport>(hung_bus));
+
+    SimulatedFaults hang;
+    hang.hang = true;
+    hung_bus->SetFaults(hang);
+    std::vector<std::future<bool>> queued;
+    for (int i = 0; i < 3; i++) {
+        queued.push_back(hung->Submit(BrightnessCommand::Encode(static_cast<uint8_t>(i))));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = Clock::now();
+    bool joined = hung->Stop(start + std::chrono::milliseconds(300));
+    double stop_ms = MillisecondsSince(start);
+    int failed = 0;
+    for (auto& future : queued) {
+        failed += future.get() ? 0 : 1;
+    }
+    printf("  Stop returned after %.0f ms, %d/3 commands failed\n", stop_ms, failed);
+    Check(!joined && stop_ms < 400, "a worker stuck on the bus does not hold up Stop past its deadline");
+    Check(failed == 3, "the transaction on the bus and the queue fail when the worker is abandoned");
+
+    // The hung call returns eventually; the worker must exit without reporting again
+    hung_bus->SetFaults(SimulatedFaults());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+static void LaneScenario() {
+    printf("Interactive writes behind a bulk backlog\n");
+    DisplayExecutor executor(0, std::unique_ptr<DdcTransport>(new SimulatedTransport(6)));
+    const double transaction_ms = SimulatedFaults().latency_ms;
+
+    // A preset sweep queues 20 bulk writes, then a user presses a hotkey
+    std::vector<std::future<bool>> bulk;
+    for (int i = 0; i < 20; i++) {
+        bulk.push_back(executor.Submit(BrightnessCommand::Encode(static_cast<uint8_t>(i)), DisplayExecutor::NO_DEADLINE,
+                                       DisplayExecutor::Lane::Bulk));
+    }
+    TimedWrite hotkey = WriteBrightness(executor, 70);
+    printf("  interactive write done in %.0f ms with 20 bulk writes queued\n", hotkey.ms);
+    Check(hotkey.result && hotkey.ms < 2.5 * transaction_ms, "interactive write overtakes the bulk lane");
+
+    // A stream of interactive writes must still let bulk work through
+    std::thread interactive_client([&]() {
+        for (int i = 0; i < 20; i++) {
+            WriteBrightness(executor, i);
+        }
+    });
+    std::vector<std::future<bool>> interactive;
+    for (int i = 0; i < 20; i++) {
+        interactive.push_back(executor.Submit(BrightnessCommand::Encode(static_cast<uint8_t>(i))));
+    }
+    DisplayExecutor::Stats during = executor.GetStats();
+    interactive_client.join();
+    for (auto& future : interactive) {
+        future.get();
+    }
+    DisplayExecutor::Stats after = executor.GetStats();
+    const DisplayExecutor::LaneStats& bulk_lane = after.lanes[static_cast<int>(DisplayExecutor::Lane::Bulk)];
+    printf("  bulk lane: %llu dequeued, %llu promoted, peak depth %zu (interactive peak %zu)\n",
+           (unsigned long long)bulk_lane.dequeued, (unsigned long long)after.bulk_promoted, bulk_lane.peak_depth,
+           after.lanes[static_cast<int>(DisplayExecutor::Lane::Interactive)].peak_depth);
+    Check(after.bulk_promoted > 0 && after.bulk_promoted > during.bulk_promoted,
+          "bulk work progresses under an interactive flood");
+    // The worker may take the first bulk write before the rest are queued
+    Check(bulk_lane.peak_depth >= 19, "peak depth tracked per lane");
+
+    int bulk_ok = 0;
+    for (auto& future : bulk) {
+        bulk_ok += future.get() ? 1 : 0;
+    }
+    Check(bulk_ok == 20, "every bulk write completes");
+}
+
+// Queue one group commit across executors; returns once every member finished
+static GroupCommitResult CommitToAll(std::vector<DisplayExecutor*>& members, int value) {
+    auto barrier = std::make_shared<CommitBarrier>(static_cast<int>(members.size()), GROUP_BARRIER_TIMEOUT_MS);
+    for (size_t i = 0; i < members.size(); i++) {
+        int member = static_cast<int>(i);
+        members[i]->SubmitGroupMember(BrightnessCommand::Encode(static_cast<uint8_t>(value)), barrier, member,
+                                      [barrier, member](bool ok) { barrier->Finish(member, ok); });
+    }
+    return barrier->Wait();
+}
+
+static void GroupScenario() {
+    printf("Group commit across 4 displays, display 3 with a backlog\n");
+    std::vector<std::unique_ptr<DisplayExecutor>> executors;
+    std::vector<DisplayExecutor*> members;
+    SimulatedTransport* faulty_bus = nullptr;
+    for (int i = 0; i < 4; i++) {
+        auto* bus = new SimulatedTransport(10 + i);
+        faulty_bus = bus;
+        executors.push_back(std::make_unique<DisplayExecutor>(i, std::unique_ptr<DdcTransport>(bus)));
+        members.push_back(executors.back().get());
+    }
+
+    // Three writes ahead of the group command on display 3
+    for (int i = 0; i < 3; i++) {
+        executors[3]->Submit(BrightnessCommand::Encode(static_cast<uint8_t>(i)));
+    }
+    auto start = Clock::now();
+    GroupCommitResult aligned = CommitToAll(members, 50);
+    printf("  %d/%d ok in %.0f ms, release skew %lld us, completion skew %.1f ms\n", aligned.succeeded,
+           aligned.members, MillisecondsSince(start), (long long)aligned.release_skew_us, aligned.completion_skew_ms);
+    Check(aligned.succeeded == 4 && !aligned.barrier_timed_out, "every member written");
+    Check(aligned.release_skew_us < 5000, "members released within 5 ms of each other despite the backlog");
+
+    // Display 3's breaker opens: it drops out and the others are not held
+    SimulatedFaults nack;
+    nack.nack_rate = 1.0;
+    faulty_bus->SetFaults(nack);
+    while (executors[3]->GetBreakerState() == DisplayExecutor::BreakerState::Closed) {
+        WriteBrightness(*executors[3], 1);
+    }
+    start = Clock::now();
+    GroupCommitResult partial = CommitToAll(members, 60);
+    double partial_ms = MillisecondsSince(start);
+    printf("  breaker open on display 3: %d ok, %d failed in %.0f ms\n", partial.succeeded, partial.failed, partial_ms);
+    Check(partial.succeeded == 3 && partial.failed == 1 && !partial.barrier_timed_out &&
+          partial_ms < 2.0 * SimulatedFaults().latency_ms, "failed member does not hold the barrier");
+    faulty_bus->SetFaults(SimulatedFaults());
+    WaitForRecovery(*executors[3], BREAKER_PROBE_MAX_MS);
+}
+
+static void SequenceScenario() {
+    const int displays = 8;
+    const int delay_ms = 300;
+    printf("Sequences on %d displays: save brightness, change it, %d ms delay, restore, verify\n", displays, delay_ms);
+    std::vector<std::unique_ptr<DisplayExecutor>> executors;
+    for (int i = 0; i < displays; i++) {
+        executors.push_back(std::make_unique<DisplayExecutor>(
+            i, std::unique_ptr<DdcTransport>(new SimulatedTransport(20 + i))));
+        WriteBrightness(*executors.back(), 40);
+    }
+
+    std::vector<SequenceStep> steps;
+    std::string error;
+    ParseDdcSequence("read 10; write 5 10; delay " + std::to_string(delay_ms) +
+                     "; write $10 10; read 10; if 10 != 28 write 50 10", steps, error);
+
+    SequenceRunner runner;
+    std::vector<std::future<SequenceResult>> results;
+    auto start = Clock::now();
+    for (auto& executor : executors) {
+        results.push_back(runner.Run(SequenceRunner::ExecutorBus(executor.get()), steps));
+    }
+
+    // Display 0 is free while its sequence waits
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms / 2));
+    TimedWrite during = WriteBrightness(*executors[0], 5);
+
+    bool all_restored = true;
+    int skipped = 0;
+    for (auto& future : results) {
+        SequenceResult result = future.get();
+        all_restored = all_restored && result.success && result.reads.size() == 2 && result.reads[1].current_value == 40;
+        skipped += result.steps_skipped;
+    }
+    double total_ms = MillisecondsSince(start);
+    double one_ms = delay_ms + 4.0 * SimulatedFaults().latency_ms;
+    printf("  %d sequences in %.0f ms (one alone: ~%.0f ms), write during a delay took %.0f ms\n", displays,
+           total_ms, one_ms, during.ms);
+    Check(all_restored && skipped == displays, "every sequence restored the saved brightness and skipped the fix-up");
+    Check(total_ms < 2.0 * one_ms, "sequences overlap: all displays together take about as long as one");
+    Check(during.result && during.ms < 2.0 * SimulatedFaults().latency_ms, "the bus is free during a sequence's delay");
+
+    // A failing step ends the sequence there
+    SimulatedFaults nack;
+    nack.nack_rate = 1.0;
+    auto* failing_bus = new SimulatedTransport(30);
+    DisplayExecutor failing(displays, std::unique_ptr<DdcTransport>(failing_bus));
+    failing_bus->SetFaults(nack);
+    SequenceResult failed = runner.Run(SequenceRunner::ExecutorBus(&failing), steps).get();
+    Check(!failed.success && failed.failed_step == 0 && failed.steps_run == 1, "a failed read ends the sequence at that step");
+    failing_bus->SetFaults(SimulatedFaults());
+
+    // A display with no executor (gone, or shutdown began) fails its first step
+    SequenceResult missing = runner.Run(SequenceRunner::ExecutorBus(nullptr), steps).get();
+    Check(!missing.success && missing.failed_step == 0, "a sequence on a missing display fails instead of crashing");
+
+    // Stopping the runner fails a sequence parked in a delay instead of waiting for it
+    std::vector<SequenceStep> long_wait;
+    ParseDdcSequence("write 10 10; delay 60000; write 20 10", long_wait, error);
+    std::future<SequenceResult> parked = runner.Run(SequenceRunner::ExecutorBus(executors[0].get()), long_wait);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * SimulatedFaults().latency_ms));
+    start = Clock::now();
+    runner.Stop();
+    SequenceResult stopped = parked.get();
+    Check(!stopped.success && stopped.failed_step == 1 && MillisecondsSince(start) < 100, "Stop() fails a waiting sequence at once");
+}
+
+static void MacroScenario() {
+    printf("Macro on 3 displays: fade each down in 4 steps, then a conditional write on display 1\n");
+    std::vector<std::unique_ptr<DisplayExecutor>> executors;
+    for (int i = 0; i < 3; i++) {
+        executors.push_back(std::make_unique<DisplayExecutor>(
+            i, std::unique_ptr<DdcTransport>(new SimulatedTransport(40 + i))));
+        WriteBrightness(*executors.back(), 40);
+    }
+
+    auto program = std::make_shared<DdcProgram>();
+    std::string error;
+    bool compiled = CompileDdcMacro("each 0 1 2; read 10; repeat 4; add 10 -5; write $10 10; delay 20; end; end\n"
+                                    "display 1; read 10; if 10 == 14; write 50 10; else; write 0 10; end", *program, error);
+    printf("  %zu instructions, plan: %d bus steps, %d ms of delays\n", program->code.size(), program->bus_steps,
+           program->delay_ms);
+    Check(compiled && program->bus_steps == 18 && program->delay_ms == 240 && program->displays.size() == 3 &&
+          !program->uses_default_display, "the plan counts loops at their full length and both branches");
+
+    // Nested loops whose product overflows, and a loop with no bus steps that would spin for ever
+    std::string deep, spin = "read 10; ";
+    for (int i = 0; i < 6; i++) {
+        deep += "repeat 1000; ";
+    }
+    deep += "repeat 10; write 1 10; end; end; end; end; end; end; end";
+    for (int i = 0; i < 8; i++) {
+        spin += "repeat 1000; ";
+    }
+    spin += "add 10 1; end; end; end; end; end; end; end; end";
+    DdcProgram rejected;
+    std::string deep_error, spin_error;
+    Check(!CompileDdcMacro(deep, rejected, deep_error) && !CompileDdcMacro(spin, rejected, spin_error),
+          "macros whose loops multiply out past the limits are rejected");
+    printf("  %s\n  %s\n", deep_error.c_str(), spin_error.c_str());
+
+    SequenceRunner runner;
+    auto buses = [&executors](int display) { return SequenceRunner::ExecutorBus(executors[display].get()); };
+    SequenceResult result = runner.Run(buses, program, 0).get();
+    uint16_t values[3] = {}, maximum = 0;
+    for (int i = 0; i < 3; i++) {
+        executors[i]->SubmitRead(0x10, DDC_VCP_REGISTER, &values[i], &maximum).get();
+    }
+    printf("  %d steps run, %d skipped in %d ms; brightness %u, %u, %u\n", result.steps_run, result.steps_skipped,
+           result.elapsed_ms, values[0], values[1], values[2]);
+    Check(result.success && values[0] == 20 && values[1] == 0x50 && values[2] == 20 && result.steps_skipped == 0,
+          "each display was faded and the taken branch wrote display 1");
+
+    std::string unbalanced;
+    Check(!CompileDdcMacro("repeat 2; read 10", *program, unbalanced) &&
+          !CompileDdcMacro("repeat 1000; repeat 1000; write 1 10; end; end", *program, unbalanced),
+          "unclosed blocks and runaway loops are rejected when compiled");
+}
+
+// Overwrite bytes of a closed state file, as a save cut short by power loss would
+static void DamageFile(const char* path, long offset, const char* bytes, size_t length) {
+    FILE* file = fopen(path, "r+b");
+    if (file) {
+        fseek(file, offset, SEEK_SET);
+        fwrite(bytes, 1, length, file);
+        fclose(file);
+    }
+}
+
+static void StateFileScenario() {
+    printf("State file: two saves of display 2, then the newer one torn\n");
+    const char* path = "fault_sim_state.bin";
+    remove(path);
+    std::string error;
+    DisplaySettings settings, loaded;
+    time_t saved_at = 0;
+    {
+        StateStore store;
+        Check(store.Open(path, error), "a missing state file is created");
+        Check(!store.Load(2, loaded, saved_at), "a new file has no settings");
+        settings.brightness = 30;
+        settings.contrast = 55;
+        store.Save(2, settings);
+        settings.brightness = 70;
+        store.Save(2, settings);
+        Check(store.Load(2, loaded, saved_at) && loaded.brightness == 70 && loaded.contrast == 55 &&
+              loaded.input == VCP_VALUE_UNSET && saved_at != 0, "the newest save is loaded");
+        Check(!store.Save(STATE_MAX_DISPLAYS, settings), "displays past STATE_MAX_DISPLAYS are not saved");
+    }
+
+    // The second save went to the second slot of display 2
+    long newer_slot = static_cast<long>(STATE_FILE_HEADER_SIZE + (2 * 2 + 1) * STATE_RECORD_SIZE);
+    DamageFile(path, newer_slot + 4, "\xFF\xFF", 2);
+    {
+        StateStore store;
+        Check(store.Open(path, error) && store.Load(2, loaded, saved_at) && loaded.brightness == 30,
+              "a torn save falls back to the previous value");
+        settings.brightness = 45;
+        store.Save(2, settings);
+        Check(store.Load(2, loaded, saved_at) && loaded.brightness == 45, "the next save replaces the torn slot");
+    }
+
+    DamageFile(path, 0, "GARBAGE!", 8);
+    {
+        StateStore store;
+        Check(store.Open(path, error) && !store.Load(2, loaded, saved_at), "a damaged file is started afresh");
+    }
+    remove(path);
+}
+
+int main() {
+    HangScenario();
+    NackScenario();
+    SpikeScenario();
+    DeadlineScenario();
+    InputSwitchScenario();
+    StopScenario();
+    LaneScenario();
+    GroupScenario();
+    SequenceScenario();
+    MacroScenario();
+    StateFileScenario();
+
+    printf("%s (%d failed checks)\n", g_failed_checks == 0 ? "PASS" : "FAIL", g_failed_checks);
+    return g_failed_checks == 0 ? 0 : 1;
+}
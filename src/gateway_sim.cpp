@@ -0,0 +1,312 @@
+// Fan-out check for the multi-host gateway against stand-in instances with
+// simulated monitors (no NvAPI needed)
+//
+// Usage: gateway_sim [instances]                 run the checks (default 8 instances)
+//        gateway_sim --serve <port> [instances]  keep stand-ins on port, port+1, ... until Enter
+//
+// A stand-in is a minimal monitor-control instance: /health, GET /api/status
+// and POST /api/brightness and /api/contrast ({"value": <0-100>}), each write
+// queued on a DisplayExecutor over a SimulatedTransport
+// and dropped if X-Deadline-Ms passes first, as in the app. With --serve a
+// running app can be pointed at them:
+//   GATEWAY_HOSTS=127.0.0.1:46000, 127.0.0.1:46001, 127.0.0.1:46002
+//
+// The checks start the stand-ins on free loopback ports and a MonitorGateway
+// on them, then check that a write reaches every host in about the time of
+// one write, that each host keeps one connection across many fan-outs, that
+// a wedged host costs the timeout and no more and its late command is
+// dropped rather than applied, that an unreachable host fails fast without
+// holding up the rest, and that requests can name a subset of hosts.
+// Exits with 1 if any check fails.
+
+#include "httplib.h"
+#include "monitor_gateway.h"
+#include "display_executor.h"
+#include "vcp_commands.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static int g_failed_checks = 0;
+
+static void Check(bool condition, const char* description) {
+    printf("  [%s] %s\n", condition ? " ok " : "FAIL", description);
+    if (!condition) {
+        g_failed_checks++;
+    }
+}
+
+static double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// {"value": <int>} (no nesting or escapes, like the app's own parser)
+static bool ParseValue(const std::string& body, int& value) {
+    size_t key = body.find("\"value\"");
+    size_t colon = key == std::string::npos ? key : body.find(':', key);
+    if (colon == std::string::npos) {
+        return false;
+    }
+    char* end = nullptr;
+    long parsed = strtol(body.c_str() + colon + 1, &end, 10);
+    if (end == body.c_str() + colon + 1) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Minimal monitor-control instance on one simulated display
+class StandIn {
+public:
+    explicit StandIn(int index)
+        : executor(0, std::unique_ptr<DdcTransport>(new SimulatedTransport(static_cast<uint32_t>(index + 1)))),
+          brightness(50), contrast(50), version(1), stall_ms(0), port(0) {
+        server.Get("/health", [](const httplib::Request&, httplib::Response& res) {
+            res.set_content("{\"status\": \"ok\"}", "application/json");
+        });
+        server.Get("/api/status", [this](const httplib::Request& req, httplib::Response& res) {
+            Served(req);
+            char body[160];
+            snprintf(body, sizeof(body), "{\"version\": %d, \"brightness\": %d, \"contrast\": %d, \"display_index\": 0, "
+                     "\"nvapi_initialized\": true}", version.load(), brightness.load(), contrast.load());
+            res.set_content(body, "application/json");
+        });
+        server.Post("/api/brightness", [this](const httplib::Request& req, httplib::Response& res) {
+            Write(req, res, VCP_BRIGHTNESS, brightness);
+        });
+        server.Post("/api/contrast", [this](const httplib::Request& req, httplib::Response& res) {
+            Write(req, res, VCP_CONTRAST, contrast);
+        });
+    }
+
+    ~StandIn() {
+        Stop();
+    }
+
+    // Listen on port, or on a free one if 0; returns the port (0 if the bind failed)
+    int Start(int requested_port) {
+        port = requested_port != 0 ? (server.bind_to_port("127.0.0.1", requested_port) ? requested_port : 0)
+                                   : server.bind_to_any_port("127.0.0.1");
+        if (port > 0) {
+            listener = std::thread([this]() { server.listen_after_bind(); });
+            server.wait_until_ready();
+        }
+        return port;
+    }
+
+    void Stop() {
+        if (listener.joinable()) {
+            server.stop();
+            listener.join();
+        }
+    }
+
+    // Handlers wait this long before doing anything, like a wedged process
+    void SetStall(int ms) { stall_ms = ms; }
+
+    int GetBrightness() const { return brightness; }
+    int GetPort() const { return port; }
+
+    // Client connections seen (distinct remote ports)
+    size_t GetConnectionCount() {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        return client_ports.size();
+    }
+
+private:
+    void Served(const httplib::Request& req) {
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            client_ports.insert(req.remote_port);
+        }
+        int stall = stall_ms;
+        if (stall > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(stall));
+        }
+    }
+
+    void Write(const httplib::Request& req, httplib::Response& res, uint8_t code, std::atomic<int>& setting) {
+        auto received = Clock::now();
+        Served(req);
+        int value = 0;
+        if (!ParseValue(req.body, value) || value < 0 || value > 100) {
+            res.status = 400;
+            res.set_content("{\"success\": false, \"message\": \"Value must be between 0 and 100\"}", "application/json");
+            return;
+        }
+        DisplayExecutor::Deadline deadline = DisplayExecutor::NO_DEADLINE;
+        if (req.has_header("X-Deadline-Ms")) {
+            deadline = received + std::chrono::milliseconds(atoi(req.get_header_value("X-Deadline-Ms").c_str()));
+        }
+        if (!executor.Submit(MakeDdcPacket(code, static_cast<uint16_t>(value)), deadline).get()) {
+            res.status = Clock::now() >= deadline ? 504 : 500;
+            res.set_content("{\"success\": false, \"message\": \"Command failed\"}", "application/json");
+            return;
+        }
+        setting = value;
+        version++;
+        res.set_content("{\"success\": true, \"message\": \"Set to " + std::to_string(value) + "%\"}", "application/json");
+    }
+
+    httplib::Server server;
+    std::thread listener;
+    DisplayExecutor executor;
+    std::atomic<int> brightness;
+    std::atomic<int> contrast;
+    std::atomic<int> version;
+    std::atomic<int> stall_ms;
+    int port;
+    std::mutex clients_mutex;
+    std::set<int> client_ports;
+};
+
+static GatewayRequest SetBrightness(int value) {
+    GatewayRequest request;
+    request.method = "POST";
+    request.path = "/api/brightness";
+    request.body = "{\"value\": " + std::to_string(value) + "}";
+    return request;
+}
+
+static int CountSucceeded(const std::vector<GatewayReply>& replies) {
+    return static_cast<int>(std::count_if(replies.begin(), replies.end(),
+                                          [](const GatewayReply& reply) { return reply.Succeeded(); }));
+}
+
+static void PrintReplies(const std::vector<GatewayReply>& replies) {
+    for (const GatewayReply& reply : replies) {
+        printf("    %-22s %3d %5d ms %s\n", reply.host.c_str(), reply.status, reply.elapsed_ms, reply.error.c_str());
+    }
+}
+
+static int Serve(int base_port, int instances) {
+    std::vector<std::unique_ptr<StandIn>> stand_ins;
+    std::string hosts;
+    for (int i = 0; i < instances; i++) {
+        stand_ins.push_back(std::make_unique<StandIn>(i));
+        if (stand_ins.back()->Start(base_port + i) == 0) {
+            printf("Port %d is in use\n", base_port + i);
+            return 1;
+        }
+        hosts += (i ? ", " : "") + std::string("127.0.0.1:") + std::to_string(base_port + i);
+    }
+    printf("%d stand-ins listening\nGATEWAY_HOSTS=%s\nPress Enter to stop\n", instances, hosts.c_str());
+    getchar();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0) {
+        int instances = argc >= 4 ? atoi(argv[3]) : 4;
+        return instances > 0 ? Serve(atoi(argv[2]), instances) : 2;
+    }
+    int instances = argc >= 2 ? atoi(argv[1]) : 8;
+    if (instances < 2) {
+        printf("Usage: gateway_sim [instances (2 or more)]\n"
+               "       gateway_sim --serve <port> [instances]\n");
+        return 2;
+    }
+
+    std::vector<std::unique_ptr<StandIn>> stand_ins;
+    GatewaySettings settings;
+    settings.timeout_ms = 500;
+    for (int i = 0; i < instances; i++) {
+        stand_ins.push_back(std::make_unique<StandIn>(i));
+        GatewayHost host;
+        host.host = "127.0.0.1";
+        host.port = stand_ins.back()->Start(0);
+        host.name = "127.0.0.1:" + std::to_string(host.port);
+        settings.hosts.push_back(host);
+    }
+    MonitorGateway gateway;
+    gateway.Start(settings);
+
+    printf("Brightness to %d hosts\n", instances);
+    gateway.FanOut(SetBrightness(40));   // Opens the connections
+    GatewayRequest one_host = SetBrightness(35);
+    one_host.hosts = { settings.hosts[0].name };
+    auto start = Clock::now();
+    gateway.FanOut(one_host);
+    double one_host_ms = MillisecondsSince(start);
+    start = Clock::now();
+    std::vector<GatewayReply> replies = gateway.FanOut(SetBrightness(30));
+    double fan_out_ms = MillisecondsSince(start);
+    PrintReplies(replies);
+    bool all_set = std::all_of(stand_ins.begin(), stand_ins.end(),
+                               [](const std::unique_ptr<StandIn>& stand_in) { return stand_in->GetBrightness() == 30; });
+    printf("  %.1f ms for all hosts, %.1f ms for one\n", fan_out_ms, one_host_ms);
+    Check(CountSucceeded(replies) == instances && all_set, "every host set the brightness");
+    Check(fan_out_ms < 2.0 * one_host_ms, "hosts are written in parallel, not one after another");
+
+    printf("20 more fan-outs over the same links\n");
+    for (int i = 0; i < 20; i++) {
+        GatewayRequest status;
+        status.path = "/api/status";
+        gateway.FanOut(i % 2 ? status : SetBrightness(30 + i));
+    }
+    std::vector<GatewayHostStats> stats = gateway.GetHostStats();
+    bool one_connection = std::all_of(stand_ins.begin(), stand_ins.end(),
+                                      [](const std::unique_ptr<StandIn>& stand_in) { return stand_in->GetConnectionCount() == 1; });
+    bool connected = std::all_of(stats.begin(), stats.end(), [](const GatewayHostStats& host) {
+        return host.connected && host.requests >= 22 && host.failures == 0;
+    });
+    Check(one_connection && connected, "each host kept one connection for all its requests");
+
+    printf("Host 2 wedged for 1500 ms, gateway timeout %d ms\n", settings.timeout_ms);
+    stand_ins[2]->SetStall(1500);
+    int before = stand_ins[2]->GetBrightness();
+    start = Clock::now();
+    replies = gateway.FanOut(SetBrightness(70));
+    double wedged_ms = MillisecondsSince(start);
+    stand_ins[2]->SetStall(0);
+    PrintReplies(replies);
+    printf("  %.1f ms for all hosts\n", wedged_ms);
+    Check(replies[2].timed_out && CountSucceeded(replies) == instances - 1, "only the wedged host timed out");
+    Check(wedged_ms < settings.timeout_ms + GATEWAY_REPLY_GRACE_MS, "the others were not held up past the timeout");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    Check(stand_ins[2]->GetBrightness() == before, "the wedged host dropped the command once its deadline had passed");
+    replies = gateway.FanOut(SetBrightness(60));
+    Check(CountSucceeded(replies) == instances, "the wedged host answers again on a new connection");
+
+    printf("Unreachable host added\n");
+    StandIn gone(instances);
+    int gone_port = gone.Start(0);
+    gone.Stop();
+    GatewayHost unreachable;
+    unreachable.host = "127.0.0.1";
+    unreachable.port = gone_port;
+    unreachable.name = "127.0.0.1:" + std::to_string(gone_port);
+    settings.hosts.push_back(unreachable);
+    gateway.Start(settings);
+    start = Clock::now();
+    replies = gateway.FanOut(SetBrightness(55));
+    double unreachable_ms = MillisecondsSince(start);
+    PrintReplies({ replies.back() });
+    Check(replies.back().status == 0 && !replies.back().timed_out && CountSucceeded(replies) == instances,
+          "the unreachable host fails and the rest succeed");
+    Check(replies.back().elapsed_ms < settings.timeout_ms / 2 && unreachable_ms < settings.timeout_ms,
+          "a refused connection does not wait for the timeout");
+
+    printf("Subset of hosts\n");
+    GatewayRequest subset = SetBrightness(20);
+    subset.hosts = { settings.hosts[0].name, "nosuchhost" };
+    replies = gateway.FanOut(subset);
+    PrintReplies(replies);
+    Check(replies.size() == 2 && replies[0].Succeeded() && replies[1].error == "not a gateway host" &&
+          stand_ins[0]->GetBrightness() == 20 && stand_ins[1]->GetBrightness() == 55,
+          "only the named host was written, the unknown name reported");
+
+    gateway.Stop();
+    printf("%s (%d failed checks)\n", g_failed_checks == 0 ? "PASS" : "FAIL", g_failed_checks);
+    return g_failed_checks == 0 ? 0 : 1;
+}
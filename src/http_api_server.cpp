@@ -7,60 +7,30 @@
 #include "http_api_server.h"
 #include "thread_safe_control.h"
 #include "config_parser.h"
+#include "vcp_commands.h"
+#include "preset_manager.h"
+#include "rule_scheduler.h"
+#include "udp_control.h"
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
 #include <stdio.h>
-#include <cstdarg>
 
-// ServerLogger implementation
-std::ofstream ServerLogger::log_file;
-std::mutex ServerLogger::log_mutex;
+// Longest transition accepted by /api/brightness and /api/contrast (1 hour)
+static const int MAX_TRANSITION_MS = 3600000;
 
-void ServerLogger::Init(const std::string& log_path) {
-    std::lock_guard<std::mutex> lock(log_mutex);
-    if (log_file.is_open()) {
-        log_file.close();
-    }
-    log_file.open(log_path, std::ios::out | std::ios::app);
-    if (log_file.is_open()) {
-        // Write startup marker
-        SYSTEMTIME st;
-        GetLocalTime(&st);
-        char timestamp[64];
-        snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02d %02d:%02d:%02d.%03d",
-                 st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
-        log_file << "\n=== Log started at " << timestamp << " ===" << std::endl;
-    }
-}
-
-void ServerLogger::Log(const char* level, const char* format, ...) {
-    std::lock_guard<std::mutex> lock(log_mutex);
-    if (!log_file.is_open()) return;
+// Longest client deadline accepted via X-Deadline-Ms / "deadline_ms" (1 minute)
+static const int MAX_DEADLINE_MS = 60000;
 
-    // Get timestamp
-    SYSTEMTIME st;
-    GetLocalTime(&st);
-    char timestamp[64];
-    snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02d %02d:%02d:%02d.%03d",
-             st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
-
-    // Format message
-    char message[512];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(message, sizeof(message), format, args);
-    va_end(args);
-
-    log_file << "[" << timestamp << "] [" << level << "] " << message << std::endl;
-    log_file.flush();
-}
+// Longest a retry waits for the original request with the same Idempotency-Key
+static const int IDEMPOTENCY_WAIT_MS = MAX_DEADLINE_MS;
 
-void ServerLogger::Close() {
-    std::lock_guard<std::mutex> lock(log_mutex);
-    if (log_file.is_open()) {
-        log_file << "=== Log closed ===" << std::endl;
-        log_file.close();
-    }
-}
+// GET /api/status?wait_version=N long polls: default and longest wait, and how
+// many may wait at once. Each holds a server thread (blocked, not spinning), so
+// the thread pools get that many extra threads and commands never queue behind them.
+static const int STATUS_DEFAULT_WAIT_S = 30;
+static const int STATUS_MAX_WAIT_S = 60;
+static const int STATUS_MAX_PARKED_POLLS = 16;
 
 // Helper function to parse JSON-like simple format: {"key": value}
 static bool ParseJsonInt(const std::string& body, const std::string& key, int& value) {
@@ -95,6 +65,208 @@ static bool ParseJsonInt(const std::string& body, const std::string& key, int& v
     }
 }
 
+// Helper function to parse a string field: {"key": "value"} (no escape handling)
+static bool ParseJsonString(const std::string& body, const std::string& key, std::string& value) {
+    std::string search_key = "\"" + key + "\"";
+    size_t key_pos = body.find(search_key);
+    if (key_pos == std::string::npos) {
+        return false;
+    }
+
+    size_t colon_pos = body.find(":", key_pos + search_key.length());
+    if (colon_pos == std::string::npos) {
+        return false;
+    }
+
+    size_t open_quote = body.find_first_not_of(" \t\r\n", colon_pos + 1);
+    if (open_quote == std::string::npos || body[open_quote] != '"') {
+        return false;
+    }
+
+    size_t close_quote = body.find('"', open_quote + 1);
+    if (close_quote == std::string::npos) {
+        return false;
+    }
+
+    value = body.substr(open_quote + 1, close_quote - open_quote - 1);
+    return true;
+}
+
+// Parse the optional "duration_ms"/"easing" fields of a brightness/contrast request.
+// Returns false (with an error message) if they are present but invalid.
+static bool ParseTransitionFields(const std::string& body, int& duration_ms, Easing& easing, std::string& error) {
+    duration_ms = 0;
+    easing = Easing::Linear;
+
+    if (ParseJsonInt(body, "duration_ms", duration_ms) && (duration_ms < 0 || duration_ms > MAX_TRANSITION_MS)) {
+        error = "duration_ms must be between 0 and 3600000";
+        return false;
+    }
+
+    std::string easing_name;
+    if (ParseJsonString(body, "easing", easing_name) && !ParseEasing(easing_name, easing)) {
+        error = "easing must be one of: linear, ease-in, ease-out, ease-in-out";
+        return false;
+    }
+    return true;
+}
+
+// Parse the optional client deadline: the X-Deadline-Ms header, or the "deadline_ms"
+// body field / query parameter, in milliseconds from now. Without one, commands
+// wait in the display queue as long as it takes. Returns false (with an error
+// message) if a deadline is given but invalid.
+static bool ParseDeadline(const httplib::Request& req, DisplayExecutor::Deadline& deadline, std::string& error) {
+    deadline = DisplayExecutor::NO_DEADLINE;
+    auto start = std::chrono::steady_clock::now();
+
+    int deadline_ms = 0;
+    bool present = false;
+    try {
+        if (req.has_header("X-Deadline-Ms")) {
+            present = true;
+            deadline_ms = std::stoi(req.get_header_value("X-Deadline-Ms"));
+        } else if (req.has_param("deadline_ms")) {
+            present = true;
+            deadline_ms = std::stoi(req.get_param_value("deadline_ms"));
+        } else {
+            present = ParseJsonInt(req.body, "deadline_ms", deadline_ms);
+        }
+    } catch (...) {
+        deadline_ms = 0;
+    }
+
+    if (!present) {
+        return true;
+    }
+    if (deadline_ms <= 0 || deadline_ms > MAX_DEADLINE_MS) {
+        error = "deadline_ms must be between 1 and 60000";
+        return false;
+    }
+    deadline = start + std::chrono::milliseconds(deadline_ms);
+    return true;
+}
+
+// Parse the optional queue lane: the X-Priority header, or the "priority" body
+// field / query parameter ("interactive" or "bulk"). Requests default to the
+// interactive lane; automation that sweeps many monitors should ask for bulk.
+static bool ParsePriority(const httplib::Request& req, DisplayExecutor::Lane& lane, std::string& error) {
+    lane = DisplayExecutor::Lane::Interactive;
+
+    std::string name;
+    if (req.has_header("X-Priority")) {
+        name = req.get_header_value("X-Priority");
+    } else if (req.has_param("priority")) {
+        name = req.get_param_value("priority");
+    } else if (!ParseJsonString(req.body, "priority", name)) {
+        return true;
+    }
+
+    if (!ParseLane(name, lane)) {
+        error = "priority must be 'interactive' or 'bulk'";
+        return false;
+    }
+    return true;
+}
+
+// Requests that change something take an Idempotency-Key
+static bool IsMutatingMethod(const std::string& method) {
+    return method == "POST" || method == "PUT" || method == "DELETE";
+}
+
+// What makes two requests with the same Idempotency-Key the same request
+static uint64_t RequestFingerprint(const httplib::Request& req) {
+    return std::hash<std::string>()(req.method + " " + req.path + "\n" + req.body);
+}
+
+// ETag of a state version. Weak: the counters in the status body change
+// without a new version, only the state itself is versioned.
+static std::string StatusETag(uint64_t version) {
+    return "W/\"" + std::to_string(version) + "\"";
+}
+
+// If-None-Match holds "*" or a comma-separated list of ETags, compared weakly
+static bool ETagMatches(const std::string& if_none_match, const std::string& etag) {
+    auto opaque = [](std::string tag) {
+        size_t start = tag.find_first_not_of(" \t");
+        size_t end = tag.find_last_not_of(" \t");
+        tag = start == std::string::npos ? "" : tag.substr(start, end - start + 1);
+        return tag.compare(0, 2, "W/") == 0 ? tag.substr(2) : tag;
+    };
+    std::istringstream list(if_none_match);
+    std::string tag;
+    while (std::getline(list, tag, ',')) {
+        std::string candidate = opaque(tag);
+        if (candidate == "*" || candidate == opaque(etag)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Serialize a preset as {"name": ..., "displays": [...]}
+static std::string PresetToJson(const Preset& preset) {
+    std::ostringstream json;
+    json << "{\"name\": \"" << preset.name << "\", \"displays\": [";
+    for (size_t i = 0; i < preset.displays.size(); i++) {
+        const PresetEntry& entry = preset.displays[i];
+        json << (i > 0 ? ", " : "") << "{\"display\": " << entry.display_index;
+        if (entry.settings.brightness != VCP_VALUE_UNSET) json << ", \"brightness\": " << entry.settings.brightness;
+        if (entry.settings.contrast != VCP_VALUE_UNSET) json << ", \"contrast\": " << entry.settings.contrast;
+        if (entry.settings.input != VCP_VALUE_UNSET) json << ", \"input\": " << entry.settings.input;
+        json << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+// ["brightness", "contrast", "input"], or the subset given
+static std::string SettingListJson(const std::vector<VcpSetting>& settings) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < settings.size(); i++) {
+        json << (i ? ", " : "") << (settings[i] == VcpSetting::Brightness ? "\"brightness\"" :
+                                    settings[i] == VcpSetting::Contrast ? "\"contrast\"" : "\"input\"");
+    }
+    json << "]";
+    return json.str();
+}
+
+// "run", "skipped", "elapsed_ms" and "reads" fields of a sequence or macro run;
+// with_display adds the display of each read
+static std::string SequenceResultFields(const SequenceResult& result, bool with_display) {
+    std::ostringstream fields;
+    fields << "\"run\": " << result.steps_run << ", \"skipped\": " << result.steps_skipped
+           << ", \"elapsed_ms\": " << result.elapsed_ms << ", \"reads\": [";
+    for (size_t i = 0; i < result.reads.size(); i++) {
+        const SequenceRead& read = result.reads[i];
+        fields << (i ? ", " : "") << "{";
+        if (with_display) {
+            fields << "\"display\": " << read.display << ", ";
+        }
+        fields << "\"code\": " << static_cast<int>(read.command_code)
+               << ", \"register\": " << static_cast<int>(read.register_address)
+               << ", \"current\": " << read.current_value << ", \"maximum\": " << read.maximum_value << "}";
+    }
+    fields << "]";
+    return fields.str();
+}
+
+// Local time as "YYYY-MM-DD HH:MM:SS", or null for 0
+static std::string FormatLocalTime(time_t t) {
+    if (t == 0) {
+        return "null";
+    }
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &t);
+#else
+    localtime_r(&t, &local);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "\"%Y-%m-%d %H:%M:%S\"", &local);
+    return buffer;
+}
+
 static bool ParseJsonFloat(const std::string& body, const std::string& key, float& value) {
     int int_value;
     if (ParseJsonInt(body, key, int_value)) {
@@ -104,6 +276,47 @@ static bool ParseJsonFloat(const std::string& body, const std::string& key, floa
     return false;
 }
 
+bool ServerConfig::operator==(const ServerConfig& other) const {
+    return host == other.host && port == other.port && enabled == other.enabled &&
+           presets_file == other.presets_file && schedule_file == other.schedule_file &&
+           latitude == other.latitude && longitude == other.longitude &&
+           has_location == other.has_location && log_level == other.log_level &&
+           unix_socket == other.unix_socket && udp_host == other.udp_host && udp_port == other.udp_port &&
+           shutdown_timeout_ms == other.shutdown_timeout_ms && ddc_record_file == other.ddc_record_file &&
+           profile_db == other.profile_db && state_file == other.state_file &&
+           display_groups == other.display_groups && macros == other.macros && ambient == other.ambient &&
+           gateway == other.gateway;
+}
+
+// "0, 1,2" -> {0, 1, 2}; false if empty, malformed or a display is listed twice
+static bool ParseDisplayList(const std::string& text, std::vector<int>& displays) {
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        try {
+            size_t used = 0;
+            int display = std::stoi(item, &used);
+            if (display < 0 || item.find_first_not_of(" \t", used) != std::string::npos ||
+                std::find(displays.begin(), displays.end(), display) != displays.end()) {
+                return false;
+            }
+            displays.push_back(display);
+        } catch (...) {
+            return false;
+        }
+    }
+    return !displays.empty();
+}
+
+// Optional floating-point key; the default if missing or not a number
+static double GetConfigDouble(const ConfigParser& parser, const std::string& key, double default_value) {
+    try {
+        return parser.HasKey(key) ? std::stod(parser.GetString(key)) : default_value;
+    } catch (...) {
+        return default_value;
+    }
+}
+
 ServerConfig ServerConfig::LoadConfig(const std::string& config_path) {
     ServerConfig config;
 
@@ -112,6 +325,58 @@ ServerConfig ServerConfig::LoadConfig(const std::string& config_path) {
         config.port = parser.GetInt("HTTP_PORT", 45678);
         config.host = parser.GetString("HTTP_HOST", "127.0.0.1");
         config.enabled = parser.GetBool("API_ENABLED", true);
+        config.presets_file = parser.GetString("PRESETS_FILE", "presets.env");
+        config.schedule_file = parser.GetString("SCHEDULE_FILE", "schedule.env");
+        config.log_level = parser.GetString("LOG_LEVEL", "INFO");
+        config.unix_socket = parser.GetString("UNIX_SOCKET", "");
+        config.udp_host = parser.GetString("UDP_HOST", "127.0.0.1");
+        config.udp_port = parser.GetInt("UDP_PORT", 0);
+        config.shutdown_timeout_ms = parser.GetInt("SHUTDOWN_TIMEOUT_MS", 3000);
+        config.ddc_record_file = parser.GetString("DDC_RECORD_FILE", "");
+        config.profile_db = parser.GetString("PROFILE_DB", "monitor_profiles.bin");
+        config.state_file = parser.GetString("STATE_FILE", "monitor_state.bin");
+        for (const std::string& key : parser.GetKeys()) {
+            std::vector<int> displays;
+            if (key.compare(0, 6, "GROUP_") == 0 && PresetManager::IsValidName(key.substr(6)) &&
+                ParseDisplayList(parser.GetString(key), displays)) {
+                config.display_groups[key.substr(6)] = displays;
+            }
+            DdcProgram program;
+            std::string macro_error;
+            if (key.compare(0, 6, "MACRO_") == 0 && PresetManager::IsValidName(key.substr(6))) {
+                if (CompileDdcMacro(parser.GetString(key), program, macro_error)) {
+                    config.macros[key.substr(6)] = parser.GetString(key);
+                } else {
+                    ServerLogger::Log("WARN", "config.env %s: %s", key.c_str(), macro_error.c_str());
+                }
+            }
+            AmbientCurve curve;
+            if (key.compare(0, 14, "AMBIENT_CURVE_") == 0 && key.size() > 14 && key.size() <= 17 &&
+                key.find_first_not_of("0123456789", 14) == std::string::npos &&
+                ParseAmbientCurve(parser.GetString(key), curve)) {
+                config.ambient.curves[std::stoi(key.substr(14))] = curve;
+            }
+        }
+        config.ambient.source = parser.GetString("AMBIENT_SOURCE", "");
+        config.ambient.filter_ms = parser.GetInt("AMBIENT_FILTER_MS", 5000);
+        config.ambient.hysteresis = GetConfigDouble(parser, "AMBIENT_HYSTERESIS", 0.2);
+        config.ambient.min_change = GetConfigDouble(parser, "AMBIENT_MIN_CHANGE", 3.0);
+        config.ambient.poll_ms = parser.GetInt("AMBIENT_POLL_MS", 500);
+        std::string gateway_error;
+        if (!ParseGatewayHosts(parser.GetString("GATEWAY_HOSTS", ""), config.gateway.hosts, gateway_error)) {
+            ServerLogger::Log("WARN", "config.env GATEWAY_HOSTS: %s; gateway mode is off", gateway_error.c_str());
+            config.gateway.hosts.clear();
+        }
+        config.gateway.timeout_ms = parser.GetInt("GATEWAY_TIMEOUT_MS", 2000);
+        if (parser.HasKey("LATITUDE") && parser.HasKey("LONGITUDE")) {
+            try {
+                config.latitude = std::stod(parser.GetString("LATITUDE"));
+                config.longitude = std::stod(parser.GetString("LONGITUDE"));
+                config.has_location = true;
+            } catch (...) {
+                config.has_location = false;
+            }
+        }
     }
     // If file doesn't exist or fails to load, use defaults
 
@@ -133,16 +398,111 @@ std::string HttpApiServer::CreateJsonResponse(bool success, const std::string& m
     return json.str();
 }
 
-HttpApiServer::HttpApiServer(ThreadSafeMonitorControl* control)
-    : running(false), should_stop(false), bind_attempted(false), bind_succeeded(false), monitor_control(control) {
+void HttpApiServer::SetCommandFailure(httplib::Response& res, std::chrono::steady_clock::time_point deadline,
+                                      const std::string& message, const std::string& additional_fields) {
+    if (deadline != DisplayExecutor::NO_DEADLINE && std::chrono::steady_clock::now() >= deadline) {
+        res.status = 504;
+        res.set_content(CreateJsonResponse(false, "Deadline exceeded; command dropped", additional_fields), "application/json");
+    } else {
+        res.status = 500;
+        res.set_content(CreateJsonResponse(false, message, additional_fields), "application/json");
+    }
+}
+
+HttpApiServer::HttpApiServer(ThreadSafeMonitorControl* control, PresetManager* presets, RuleScheduler* scheduler,
+                             UdpControlServer* udp, AmbientController* ambient_controller, MonitorGateway* monitor_gateway,
+                             StartupProfile* startup)
+    : running(false), should_stop(false), bind_attempted(false), bind_succeeded(false),
+      local_running(false), monitor_control(control), preset_manager(presets), rule_scheduler(scheduler),
+      udp_control(udp), ambient(ambient_controller), gateway(monitor_gateway), parked_status_polls(0), startup_profile(startup),
+      server_started(StartupProfile::Clock::now()), first_request_served(false), startup_bind_recorded(false) {
 }
 
 HttpApiServer::~HttpApiServer() {
     Stop();
 }
 
-void HttpApiServer::ServerThreadFunc() {
-    httplib::Server server;
+void HttpApiServer::RegisterRoutes(httplib::Server& server) {
+    // Room for the parked status long polls on top of the default pool
+    server.new_task_queue = [] { return new httplib::ThreadPool(CPPHTTPLIB_THREAD_POOL_COUNT + STATUS_MAX_PARKED_POLLS); };
+
+    // During application shutdown the monitor queues no longer take commands:
+    // answer new requests with 503 before they reach a handler, and report
+    // commands that failed during shutdown as 503 instead of 500. Only the
+    // first case carries "sent": false; a failed command may have been the
+    // one left on a hung bus, whose write can still land.
+    //
+    // A mutating request with an Idempotency-Key header that repeats a recent
+    // one gets the original's response instead of running again; if the
+    // original is still running it waits for it. The request that runs is
+    // marked by echoing the key, and its response is stored once complete.
+    server.set_pre_routing_handler([this](const httplib::Request& req, httplib::Response& res) {
+        if (monitor_control->IsShuttingDown() && req.path != "/health") {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "Server is shutting down", "\"sent\": false"), "application/json");
+            return httplib::Server::HandlerResponse::Handled;
+        }
+        if (!IsMutatingMethod(req.method) || !req.has_header("Idempotency-Key")) {
+            return httplib::Server::HandlerResponse::Unhandled;
+        }
+
+        std::string key = req.get_header_value("Idempotency-Key");
+        if (!IsValidIdempotencyKey(key)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Idempotency-Key must be 1-255 printable ASCII characters"), "application/json");
+            return httplib::Server::HandlerResponse::Handled;
+        }
+
+        IdempotencyTable::Response original;
+        switch (idempotency.Begin(key, RequestFingerprint(req), std::chrono::milliseconds(IDEMPOTENCY_WAIT_MS), original)) {
+        case IdempotencyTable::Claim::New:
+            res.set_header("Idempotency-Key", key);
+            return httplib::Server::HandlerResponse::Unhandled;
+        case IdempotencyTable::Claim::Replay:
+            ServerLogger::Log("INFO", "%s %s - duplicate of Idempotency-Key %s, replaying %d", req.method.c_str(),
+                              req.path.c_str(), key.c_str(), original.status);
+            res.status = original.status;
+            res.set_content(original.body, original.content_type.c_str());
+            res.set_header("Idempotency-Key", key);
+            res.set_header("Idempotent-Replayed", "true");
+            return httplib::Server::HandlerResponse::Handled;
+        case IdempotencyTable::Claim::Mismatch:
+            ServerLogger::Log("WARN", "%s %s - Idempotency-Key %s was used for a different request",
+                              req.method.c_str(), req.path.c_str(), key.c_str());
+            res.status = 422;
+            res.set_content(CreateJsonResponse(false, "Idempotency-Key was already used for a different request"), "application/json");
+            return httplib::Server::HandlerResponse::Handled;
+        case IdempotencyTable::Claim::Busy:
+            res.status = 409;
+            res.set_content(CreateJsonResponse(false, "A request with this Idempotency-Key is still in progress"), "application/json");
+            return httplib::Server::HandlerResponse::Handled;
+        case IdempotencyTable::Claim::Full:
+            ServerLogger::Log("WARN", "Idempotency table full of requests in progress; %s runs without its key", key.c_str());
+            return httplib::Server::HandlerResponse::Unhandled;
+        }
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+    server.set_post_routing_handler([this](const httplib::Request& req, httplib::Response& res) {
+        if (res.status == 500 && monitor_control->IsShuttingDown()) {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "Server is shutting down; the command may not have been applied"), "application/json");
+        }
+        if (res.has_header("Idempotency-Key") && !res.has_header("Idempotent-Replayed")) {
+            IdempotencyTable::Response response;
+            response.status = res.status;
+            response.body = res.body;
+            response.content_type = res.get_header_value("Content-Type");
+            idempotency.Complete(res.get_header_value("Idempotency-Key"), response);
+        }
+        if (startup_profile && !first_request_served.exchange(true)) {
+            auto now = StartupProfile::Clock::now();
+            startup_profile->Record("first request served", server_started, now, true, req.method + " " + req.path);
+            ServerLogger::Log("INFO", "Startup: first request served %.1f ms after the server started, %.1f ms after start (%s %s)",
+                              std::chrono::duration<double, std::milli>(now - server_started).count(),
+                              std::chrono::duration<double, std::milli>(now - startup_profile->GetStart()).count(),
+                              req.method.c_str(), req.path.c_str());
+        }
+    });
 
     // POST /api/brightness - Set brightness (0-100)
     server.Post("/api/brightness", [this](const httplib::Request& req, httplib::Response& res) {
@@ -170,15 +530,50 @@ void HttpApiServer::ServerThreadFunc() {
             return;
         }
 
-        bool success = monitor_control->SetBrightness(brightness);
+        int duration_ms;
+        Easing easing;
+        std::string transition_error;
+        if (!ParseTransitionFields(req.body, duration_ms, easing, transition_error)) {
+            ServerLogger::Log("WARN", "Invalid brightness transition: %s", transition_error.c_str());
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, transition_error), "application/json");
+            return;
+        }
+
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        if (duration_ms > 0) {
+            bool started = monitor_control->StartTransition(monitor_control->GetSelectedDisplay(), VcpSetting::Brightness, static_cast<int>(brightness), duration_ms, easing);
+            ServerLogger::Log("INFO", "StartTransition(brightness, %.0f, %d ms, %s) = %s", brightness, duration_ms,
+                              EasingName(easing), started ? "started" : "failed");
+            if (started) {
+                std::ostringstream fields;
+                fields << "\"brightness\": " << static_cast<int>(brightness) << ", \"duration_ms\": " << duration_ms
+                       << ", \"easing\": \"" << EasingName(easing) << "\"";
+                res.status = 202;
+                res.set_content(CreateJsonResponse(true, "Brightness transition started", fields.str()), "application/json");
+            } else {
+                res.status = 500;
+                res.set_content(CreateJsonResponse(false, "Failed to start brightness transition"), "application/json");
+            }
+            return;
+        }
+
+        bool success = monitor_control->SetBrightness(brightness, deadline, lane);
         ServerLogger::Log("INFO", "SetBrightness(%.0f) = %s", brightness, success ? "success" : "failed");
         if (success) {
             std::ostringstream fields;
             fields << "\"brightness\": " << static_cast<int>(brightness);
             res.set_content(CreateJsonResponse(true, "Brightness set successfully", fields.str()), "application/json");
         } else {
-            res.status = 500;
-            res.set_content(CreateJsonResponse(false, "Failed to set brightness"), "application/json");
+            SetCommandFailure(res, deadline, "Failed to set brightness");
         }
     });
 
@@ -208,15 +603,50 @@ void HttpApiServer::ServerThreadFunc() {
             return;
         }
 
-        bool success = monitor_control->SetContrast(contrast);
+        int duration_ms;
+        Easing easing;
+        std::string transition_error;
+        if (!ParseTransitionFields(req.body, duration_ms, easing, transition_error)) {
+            ServerLogger::Log("WARN", "Invalid contrast transition: %s", transition_error.c_str());
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, transition_error), "application/json");
+            return;
+        }
+
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        if (duration_ms > 0) {
+            bool started = monitor_control->StartTransition(monitor_control->GetSelectedDisplay(), VcpSetting::Contrast, static_cast<int>(contrast), duration_ms, easing);
+            ServerLogger::Log("INFO", "StartTransition(contrast, %.0f, %d ms, %s) = %s", contrast, duration_ms,
+                              EasingName(easing), started ? "started" : "failed");
+            if (started) {
+                std::ostringstream fields;
+                fields << "\"contrast\": " << static_cast<int>(contrast) << ", \"duration_ms\": " << duration_ms
+                       << ", \"easing\": \"" << EasingName(easing) << "\"";
+                res.status = 202;
+                res.set_content(CreateJsonResponse(true, "Contrast transition started", fields.str()), "application/json");
+            } else {
+                res.status = 500;
+                res.set_content(CreateJsonResponse(false, "Failed to start contrast transition"), "application/json");
+            }
+            return;
+        }
+
+        bool success = monitor_control->SetContrast(contrast, deadline, lane);
         ServerLogger::Log("INFO", "SetContrast(%.0f) = %s", contrast, success ? "success" : "failed");
         if (success) {
             std::ostringstream fields;
             fields << "\"contrast\": " << static_cast<int>(contrast);
             res.set_content(CreateJsonResponse(true, "Contrast set successfully", fields.str()), "application/json");
         } else {
-            res.status = 500;
-            res.set_content(CreateJsonResponse(false, "Failed to set contrast"), "application/json");
+            SetCommandFailure(res, deadline, "Failed to set contrast");
         }
     });
 
@@ -232,10 +662,19 @@ void HttpApiServer::ServerThreadFunc() {
             return;
         }
 
-        if (source < 1 || source > 4) {
+        // Inputs differ per model; list the selected display's in the error
+        std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(monitor_control->GetSelectedDisplay());
+        const ProfileInput* input = profile->FindInput(source);
+        if (!input) {
             ServerLogger::Log("WARN", "Invalid input source: %d", source);
+            std::ostringstream message;
+            message << "Source must be between 1 and " << profile->input_count << " (";
+            for (int i = 0; i < profile->input_count; i++) {
+                message << (i ? ", " : "") << i + 1 << "=" << profile->inputs[i].name;
+            }
+            message << ")";
             res.status = 400;
-            res.set_content(CreateJsonResponse(false, "Source must be between 1 and 4 (1=HDMI 1, 2=HDMI 2, 3=DisplayPort, 4=USB-C)"), "application/json");
+            res.set_content(CreateJsonResponse(false, message.str()), "application/json");
             return;
         }
 
@@ -246,52 +685,899 @@ void HttpApiServer::ServerThreadFunc() {
             return;
         }
 
-        const char* input_names[] = {"HDMI 1", "HDMI 2", "DisplayPort", "USB-C"};
-        ServerLogger::Log("INFO", "Switching input to %s (source=%d)", input_names[source - 1], source);
-        bool success = monitor_control->SetInputSource(source);
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        ServerLogger::Log("INFO", "Switching input to %s (source=%d)", input->name, source);
+        bool success = monitor_control->SetInputSource(source, deadline, lane);
         ServerLogger::Log("INFO", "SetInputSource(%d) = %s", source, success ? "success" : "failed");
         if (success) {
             std::ostringstream fields;
-            fields << "\"input\": " << source << ", \"input_name\": \"" << input_names[source - 1] << "\"";
+            fields << "\"input\": " << source << ", \"input_name\": \"" << input->name << "\"";
             res.set_content(CreateJsonResponse(true, "Input switched successfully", fields.str()), "application/json");
         } else {
+            SetCommandFailure(res, deadline, "Failed to switch input");
+        }
+    });
+
+    // POST /api/vcp - Write any VCP code / register (used by writeValueToDisplay to forward commands)
+    server.Post("/api/vcp", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "POST /api/vcp - body: %s", req.body.c_str());
+
+        int display, code, value;
+        int reg = DDC_VCP_REGISTER;
+        if (!ParseJsonInt(req.body, "display", display) || !ParseJsonInt(req.body, "code", code) ||
+            !ParseJsonInt(req.body, "value", value)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid request: 'display', 'code' and 'value' are required"), "application/json");
+            return;
+        }
+        ParseJsonInt(req.body, "register", reg);
+        if (!monitor_control->IsInitialized()) {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "NvAPI not initialized", "\"sent\": false"), "application/json");
+            return;
+        }
+        if (code < 0 || code > 0xFF || reg < 0 || reg > 0xFF || value < 0 || value > 0xFFFF) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "code and register must be 0-255, value 0-65535"), "application/json");
+            return;
+        }
+        if (display < 0 || display >= monitor_control->GetDisplayCount()) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid display index"), "application/json");
+            return;
+        }
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        bool success = monitor_control->WriteRaw(display, static_cast<uint8_t>(code), static_cast<uint16_t>(value),
+                                                 static_cast<uint8_t>(reg), deadline, lane);
+        ServerLogger::Log("INFO", "WriteRaw(%d, 0x%02X, 0x%02X, 0x%02X) = %s", display, code, value, reg,
+                          success ? "success" : "failed");
+        if (success) {
+            res.set_content(CreateJsonResponse(true, "VCP write sent"), "application/json");
+        } else {
+            SetCommandFailure(res, deadline, "VCP write failed");
+        }
+    });
+
+    // GET /api/vcp?display=0&code=16[&register=81] - Read a VCP value through the display's queue
+    server.Get("/api/vcp", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/vcp");
+
+        int display, code;
+        int reg = DDC_VCP_REGISTER;
+        try {
+            display = std::stoi(req.get_param_value("display"));
+            code = std::stoi(req.get_param_value("code"));
+            if (req.has_param("register")) {
+                reg = std::stoi(req.get_param_value("register"));
+            }
+        } catch (...) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid request: 'display' and 'code' query parameters are required"), "application/json");
+            return;
+        }
+        if (!monitor_control->IsInitialized()) {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "NvAPI not initialized", "\"sent\": false"), "application/json");
+            return;
+        }
+        if (code < 0 || code > 0xFF || reg < 0 || reg > 0xFF ||
+            display < 0 || display >= monitor_control->GetDisplayCount()) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid display, code or register"), "application/json");
+            return;
+        }
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        uint16_t current = 0, maximum = 0;
+        if (monitor_control->ReadRaw(display, static_cast<uint8_t>(code), static_cast<uint8_t>(reg), current, maximum, deadline, lane)) {
+            std::ostringstream fields;
+            fields << "\"current\": " << current << ", \"maximum\": " << maximum;
+            res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+        } else {
+            SetCommandFailure(res, deadline, "VCP read failed");
+        }
+    });
+
+    // POST /api/sequence - Run a multi-step DDC sequence on one display (see ddc_sequence.h)
+    server.Post("/api/sequence", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "POST /api/sequence - body: %s", req.body.c_str());
+
+        std::string text;
+        if (!ParseJsonString(req.body, "steps", text)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid request: missing or invalid 'steps' field"), "application/json");
+            return;
+        }
+        std::vector<SequenceStep> steps;
+        std::string error;
+        if (!ParseDdcSequence(text, steps, error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, error), "application/json");
+            return;
+        }
+        if (!monitor_control->IsInitialized()) {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "NvAPI not initialized"), "application/json");
+            return;
+        }
+        int display = monitor_control->GetSelectedDisplay();
+        ParseJsonInt(req.body, "display", display);
+        if (display < 0 || display >= monitor_control->GetDisplayCount()) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid display index"), "application/json");
+            return;
+        }
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        SequenceResult result;
+        bool started = monitor_control->RunSequence(display, steps, result, deadline, lane);
+        ServerLogger::Log("INFO", "RunSequence(%d, %zu steps) = %s, %d run, %d skipped, %d ms", display, steps.size(),
+                          !started ? "unavailable" : result.success ? "success" : "failed",
+                          result.steps_run, result.steps_skipped, result.elapsed_ms);
+
+        std::ostringstream fields;
+        fields << "\"display\": " << display << ", \"steps\": " << steps.size() << ", "
+               << SequenceResultFields(result, false);
+        if (started && result.success) {
+            res.set_content(CreateJsonResponse(true, "Sequence completed", fields.str()), "application/json");
+        } else {
+            fields << ", \"failed_step\": " << (result.failed_step >= 0 ? result.failed_step + 1 : 1);
+            SetCommandFailure(res, deadline, "Sequence failed", fields.str());
+        }
+    });
+
+    // GET /api/macros - List stored macros with their compiled plan
+    server.Get("/api/macros", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/macros");
+        std::vector<StoredMacro> macros = monitor_control->GetMacros();
+        std::ostringstream fields;
+        fields << "\"macros\": [";
+        for (size_t i = 0; i < macros.size(); i++) {
+            const StoredMacro& macro = macros[i];
+            const DdcProgram& program = *macro.program;
+            fields << (i ? ", " : "") << "{\"name\": \"" << macro.name << "\", \"source\": \"" << macro.source
+                   << "\", \"from_config\": " << (macro.from_config ? "true" : "false")
+                   << ", \"instructions\": " << program.code.size() << ", \"displays\": [";
+            for (size_t d = 0; d < program.displays.size(); d++) {
+                fields << (d ? ", " : "") << program.displays[d];
+            }
+            fields << "], \"uses_default_display\": " << (program.uses_default_display ? "true" : "false")
+                   << ", \"max_bus_steps\": " << program.bus_steps << ", \"max_delay_ms\": " << program.delay_ms << "}";
+        }
+        fields << "]";
+        res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+    });
+
+    // POST /api/macros/{name} - Compile and store a macro (see CompileDdcMacro)
+    server.Post("/api/macros/:name", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "POST /api/macros/%s - body: %s", name.c_str(), req.body.c_str());
+
+        std::string source;
+        if (!PresetManager::IsValidName(name)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Macro name may only contain letters, digits, '-' and '_'"), "application/json");
+            return;
+        }
+        if (!ParseJsonString(req.body, "source", source)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid request: missing or invalid 'source' field"), "application/json");
+            return;
+        }
+        StoredMacro existing;
+        if (monitor_control->GetMacro(name, existing) && existing.from_config) {
+            res.status = 409;
+            res.set_content(CreateJsonResponse(false, "Macro is defined in config.env"), "application/json");
+            return;
+        }
+        std::string error;
+        if (!monitor_control->StoreMacro(name, source, error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, error), "application/json");
+            return;
+        }
+        StoredMacro macro;
+        monitor_control->GetMacro(name, macro);
+        std::ostringstream fields;
+        fields << "\"macro\": \"" << name << "\", \"instructions\": " << macro.program->code.size()
+               << ", \"max_bus_steps\": " << macro.program->bus_steps << ", \"max_delay_ms\": " << macro.program->delay_ms;
+        res.set_content(CreateJsonResponse(true, "Macro saved", fields.str()), "application/json");
+    });
+
+    // DELETE /api/macros/{name} - Delete a macro stored through the API
+    server.Delete("/api/macros/:name", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "DELETE /api/macros/%s", name.c_str());
+
+        StoredMacro macro;
+        if (!monitor_control->GetMacro(name, macro)) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Macro not found"), "application/json");
+            return;
+        }
+        if (macro.from_config || !monitor_control->DeleteMacro(name)) {
+            res.status = 409;
+            res.set_content(CreateJsonResponse(false, "Macro is defined in config.env"), "application/json");
+            return;
+        }
+        res.set_content(CreateJsonResponse(true, "Macro deleted"), "application/json");
+    });
+
+    // POST /api/macros/{name}/run - Run a macro; steps before any "display" go to "display" (default: selected)
+    server.Post("/api/macros/:name/run", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "POST /api/macros/%s/run - body: %s", name.c_str(), req.body.c_str());
+
+        StoredMacro macro;
+        if (!monitor_control->GetMacro(name, macro)) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Macro not found"), "application/json");
+            return;
+        }
+        if (!monitor_control->IsInitialized()) {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "NvAPI not initialized"), "application/json");
+            return;
+        }
+        int display = monitor_control->GetSelectedDisplay();
+        ParseJsonInt(req.body, "display", display);
+        int display_count = monitor_control->GetDisplayCount();
+        bool displays_valid = !macro.program->uses_default_display || (display >= 0 && display < display_count);
+        for (int named : macro.program->displays) {
+            displays_valid = displays_valid && named < display_count;
+        }
+        if (!displays_valid) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Invalid display index"), "application/json");
+            return;
+        }
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        SequenceResult result;
+        bool started = monitor_control->RunProgram(macro.program, display, result, deadline, lane);
+        ServerLogger::Log("INFO", "RunProgram(%s) = %s, %d run, %d skipped, %d ms", name.c_str(),
+                          !started ? "unavailable" : result.success ? "success" : "failed",
+                          result.steps_run, result.steps_skipped, result.elapsed_ms);
+
+        std::ostringstream fields;
+        fields << "\"macro\": \"" << name << "\", " << SequenceResultFields(result, true);
+        if (started && result.success) {
+            res.set_content(CreateJsonResponse(true, "Macro completed", fields.str()), "application/json");
+        } else {
+            fields << ", \"failed_step\": " << (result.failed_step >= 0 ? result.failed_step + 1 : 1);
+            SetCommandFailure(res, deadline, "Macro failed", fields.str());
+        }
+    });
+
+    // GET /api/presets - List named presets
+    server.Get("/api/presets", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/presets");
+        std::vector<Preset> presets = preset_manager->ListPresets();
+        std::ostringstream fields;
+        fields << "\"presets\": [";
+        for (size_t i = 0; i < presets.size(); i++) {
+            fields << (i > 0 ? ", " : "") << PresetToJson(presets[i]);
+        }
+        fields << "]";
+        res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+    });
+
+    // POST /api/presets/{name} - Save a preset
+    // With brightness/contrast/input fields: set those for "display" (default: selected display).
+    // Without them: snapshot the known state of every display.
+    server.Post("/api/presets/:name", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "POST /api/presets/%s - body: %s", name.c_str(), req.body.c_str());
+
+        Preset preset;
+        preset.name = name;
+
+        int brightness, contrast, input, display;
+        bool has_brightness = ParseJsonInt(req.body, "brightness", brightness);
+        bool has_contrast = ParseJsonInt(req.body, "contrast", contrast);
+        bool has_input = ParseJsonInt(req.body, "input", input);
+
+        if (has_brightness || has_contrast || has_input) {
+            if (!ParseJsonInt(req.body, "display", display)) {
+                display = monitor_control->GetSelectedDisplay();
+            }
+            // Merge into the existing preset so multi-display presets can be built one display at a time
+            preset_manager->GetPreset(name, preset);
+            PresetEntry* target = nullptr;
+            for (PresetEntry& entry : preset.displays) {
+                if (entry.display_index == display) target = &entry;
+            }
+            if (!target) {
+                preset.displays.push_back(PresetEntry());
+                target = &preset.displays.back();
+                target->display_index = display;
+            }
+            if (has_brightness) target->settings.brightness = brightness;
+            if (has_contrast) target->settings.contrast = contrast;
+            if (has_input) target->settings.input = input;
+        } else {
+            int display_count = monitor_control->GetDisplayCount();
+            for (int i = 0; i < display_count; i++) {
+                DisplaySettings known = monitor_control->GetKnownSettings(i);
+                if (!known.IsEmpty()) {
+                    PresetEntry entry;
+                    entry.display_index = i;
+                    entry.settings = known;
+                    preset.displays.push_back(entry);
+                }
+            }
+            if (preset.displays.empty()) {
+                ServerLogger::Log("WARN", "Preset %s not saved - no known display state", name.c_str());
+                res.status = 400;
+                res.set_content(CreateJsonResponse(false, "No known display state to save; specify brightness, contrast or input"), "application/json");
+                return;
+            }
+        }
+
+        std::string error;
+        if (!PresetManager::ValidatePreset(preset, error)) {
+            ServerLogger::Log("WARN", "Invalid preset %s: %s", name.c_str(), error.c_str());
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, error), "application/json");
+            return;
+        }
+
+        if (!preset_manager->SavePreset(preset, error)) {
+            ServerLogger::Log("ERROR", "Failed to save preset %s: %s", name.c_str(), error.c_str());
             res.status = 500;
-            res.set_content(CreateJsonResponse(false, "Failed to switch input"), "application/json");
+            res.set_content(CreateJsonResponse(false, error), "application/json");
+            return;
+        }
+
+        ServerLogger::Log("INFO", "Preset %s saved (%d displays)", name.c_str(), (int)preset.displays.size());
+        res.set_content(CreateJsonResponse(true, "Preset saved", "\"preset\": " + PresetToJson(preset)), "application/json");
+    });
+
+    // DELETE /api/presets/{name} - Delete a preset
+    server.Delete("/api/presets/:name", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "DELETE /api/presets/%s", name.c_str());
+
+        if (!preset_manager->DeletePreset(name)) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Preset not found"), "application/json");
+            return;
+        }
+        res.set_content(CreateJsonResponse(true, "Preset deleted"), "application/json");
+    });
+
+    // POST /api/presets/{name}/apply - Apply a preset, writing only values that change
+    server.Post("/api/presets/:name/apply", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "POST /api/presets/%s/apply", name.c_str());
+
+        Preset preset;
+        if (!preset_manager->GetPreset(name, preset)) {
+            ServerLogger::Log("WARN", "Preset %s not found", name.c_str());
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Preset not found"), "application/json");
+            return;
+        }
+
+        if (!monitor_control->IsInitialized()) {
+            ServerLogger::Log("ERROR", "NvAPI not initialized for preset request");
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "NvAPI not initialized"), "application/json");
+            return;
+        }
+
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        ApplyResult result = monitor_control->ApplyPreset(preset, deadline, lane);
+        ServerLogger::Log("INFO", "ApplyPreset(%s): %d sent, %d unchanged, %d failed", name.c_str(),
+                          result.writes_sent, result.writes_skipped, result.writes_failed);
+
+        std::ostringstream fields;
+        fields << "\"preset\": \"" << name << "\", \"writes_sent\": " << result.writes_sent
+               << ", \"writes_skipped\": " << result.writes_skipped
+               << ", \"writes_failed\": " << result.writes_failed;
+        if (result.writes_failed == 0) {
+            res.set_content(CreateJsonResponse(true, "Preset applied", fields.str()), "application/json");
+        } else {
+            SetCommandFailure(res, deadline, "Some preset writes failed", fields.str());
+        }
+    });
+
+    // GET /api/groups - List display groups (GROUP_<name> in config.env)
+    server.Get("/api/groups", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/groups");
+        std::map<std::string, std::vector<int>> groups = monitor_control->GetDisplayGroups();
+        std::ostringstream fields;
+        fields << "\"groups\": [";
+        bool first = true;
+        for (const auto& group : groups) {
+            fields << (first ? "" : ", ") << "{\"name\": \"" << group.first << "\", \"displays\": [";
+            for (size_t i = 0; i < group.second.size(); i++) {
+                fields << (i ? ", " : "") << group.second[i];
+            }
+            fields << "]}";
+            first = false;
+        }
+        fields << "]";
+        res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+    });
+
+    // GET /api/profiles - Monitor profile picked for each display (PROFILE_DB in config.env)
+    server.Get("/api/profiles", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/profiles");
+        std::vector<DisplayProfileInfo> displays = monitor_control->GetDisplayProfiles();
+        std::ostringstream fields;
+        fields << "\"displays\": [";
+        for (size_t i = 0; i < displays.size(); i++) {
+            const DisplayProfileInfo& info = displays[i];
+            const MonitorProfile& profile = *info.profile;
+            fields << (i ? ", " : "") << "{\"display\": " << info.display_index << ", \"edid\": ";
+            if (info.edid_read) {
+                fields << "\"" << FormatEdidId(info.edid.manufacturer, info.edid.product) << "\"";
+            } else {
+                fields << "null";
+            }
+            fields << ", \"matched\": " << (info.matched ? "true" : "false")
+                   << ", \"model\": \"" << profile.model << "\""
+                   << ", \"input_register\": " << static_cast<int>(profile.input_register)
+                   << ", \"input_code\": " << static_cast<int>(profile.input_code) << ", \"inputs\": [";
+            for (int input = 0; input < profile.input_count; input++) {
+                fields << (input ? ", " : "") << "{\"source\": " << input + 1 << ", \"name\": \""
+                       << profile.inputs[input].name << "\", \"value\": " << static_cast<int>(profile.inputs[input].value) << "}";
+            }
+            fields << "], \"brightness_range\": [" << profile.brightness_min << ", " << profile.brightness_max << "]"
+                   << ", \"contrast_range\": [" << profile.contrast_min << ", " << profile.contrast_max << "]"
+                   << ", \"input_quiet_ms\": " << profile.input_quiet_ms << "}";
+        }
+        fields << "]";
+        res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+    });
+
+    // POST /api/groups/{name}/{brightness|contrast|input} - Write every display of a group at once
+    auto commit_group = [this](const httplib::Request& req, httplib::Response& res, VcpSetting setting,
+                               const char* setting_name, const char* field) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "POST /api/groups/%s/%s - body: %s", name.c_str(), setting_name, req.body.c_str());
+
+        int value;
+        if (!ParseJsonInt(req.body, field, value)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, std::string("Invalid request: missing or invalid '") + field + "' field"), "application/json");
+            return;
+        }
+        if (!monitor_control->IsInitialized()) {
+            res.status = 503;
+            res.set_content(CreateJsonResponse(false, "NvAPI not initialized"), "application/json");
+            return;
+        }
+        std::map<std::string, std::vector<int>> groups = monitor_control->GetDisplayGroups();
+        if (groups.find(name) == groups.end()) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Group not found"), "application/json");
+            return;
+        }
+        DisplayExecutor::Deadline deadline;
+        DisplayExecutor::Lane lane;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error) || !ParsePriority(req, lane, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        GroupCommitResult result;
+        if (!monitor_control->CommitGroup(name, setting, value, result, deadline, lane)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, "Value out of range"), "application/json");
+            return;
+        }
+        ServerLogger::Log("INFO", "CommitGroup(%s, %s, %d): %d ok, %d failed, release skew %lld us, completion skew %.1f ms%s",
+                          name.c_str(), setting_name, value, result.succeeded, result.failed,
+                          (long long)result.release_skew_us, result.completion_skew_ms,
+                          result.barrier_timed_out ? ", barrier timed out" : "");
+
+        std::ostringstream fields;
+        fields << "\"group\": \"" << name << "\", \"" << setting_name << "\": " << value
+               << ", \"members\": " << result.members << ", \"succeeded\": " << result.succeeded
+               << ", \"failed\": " << result.failed
+               << ", \"release_skew_us\": " << result.release_skew_us
+               << ", \"completion_skew_ms\": " << result.completion_skew_ms
+               << ", \"barrier_timed_out\": " << (result.barrier_timed_out ? "true" : "false");
+        if (result.failed == 0) {
+            res.set_content(CreateJsonResponse(true, "Group updated", fields.str()), "application/json");
+        } else {
+            SetCommandFailure(res, deadline, "Some group writes failed", fields.str());
+        }
+    };
+    server.Post("/api/groups/:name/brightness", [commit_group](const httplib::Request& req, httplib::Response& res) {
+        commit_group(req, res, VcpSetting::Brightness, "brightness", "value");
+    });
+    server.Post("/api/groups/:name/contrast", [commit_group](const httplib::Request& req, httplib::Response& res) {
+        commit_group(req, res, VcpSetting::Contrast, "contrast", "value");
+    });
+    server.Post("/api/groups/:name/input", [commit_group](const httplib::Request& req, httplib::Response& res) {
+        commit_group(req, res, VcpSetting::Input, "input", "source");
+    });
+
+    // GET /api/rules - List schedule rules with their next fire times
+    server.Get("/api/rules", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/rules");
+        std::vector<ScheduleRule> rules = rule_scheduler->ListRules();
+        std::ostringstream fields;
+        fields << "\"rules\": [";
+        for (size_t i = 0; i < rules.size(); i++) {
+            const ScheduleRule& rule = rules[i];
+            fields << (i > 0 ? ", " : "") << "{\"name\": \"" << rule.name << "\""
+                   << ", \"trigger\": \"" << rule.trigger_text << "\""
+                   << ", \"action\": \"" << rule.action_text << "\""
+                   << ", \"enabled\": " << (rule.enabled ? "true" : "false")
+                   << ", \"next_fire\": " << FormatLocalTime(rule.next_fire)
+                   << ", \"last_fire\": " << FormatLocalTime(rule.last_fire)
+                   << ", \"last_result\": " << (rule.last_result ? "true" : "false")
+                   << ", \"fire_count\": " << rule.fire_count << "}";
+        }
+        fields << "]";
+        res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+    });
+
+    // POST /api/rules/{name}/trigger - Run a rule's action now
+    server.Post("/api/rules/:name/trigger", [this](const httplib::Request& req, httplib::Response& res) {
+        const std::string name = req.path_params.at("name");
+        ServerLogger::Log("INFO", "POST /api/rules/%s/trigger", name.c_str());
+
+        std::string error;
+        bool success = rule_scheduler->TriggerRule(name, error);
+        ServerLogger::Log("INFO", "TriggerRule(%s) = %s", name.c_str(), success ? "success" : error.c_str());
+        if (success) {
+            res.set_content(CreateJsonResponse(true, "Rule triggered", "\"rule\": \"" + name + "\""), "application/json");
+        } else {
+            res.status = (error == "Rule not found") ? 404 : 500;
+            res.set_content(CreateJsonResponse(false, error), "application/json");
         }
     });
 
     // GET /api/status - Get current status
     server.Get("/api/status", [this](const httplib::Request& req, httplib::Response& res) {
-        ServerLogger::Log("INFO", "GET /api/status");
+        ServerLogger::Log("INFO", "GET /api/status%s%s", req.has_param("wait_version") ? " - wait_version " : "",
+                          req.get_param_value("wait_version").c_str());
+
+        // Versioned state: If-None-Match with the current ETag gets 304, and
+        // wait_version=N waits (up to timeout seconds) until the version is no
+        // longer N before answering, with 304 if it never changed
+        uint64_t version = monitor_control->GetStateVersion();
+        if (req.has_param("wait_version")) {
+            uint64_t wait_version = 0;
+            int timeout_s = STATUS_DEFAULT_WAIT_S;
+            try {
+                wait_version = std::stoull(req.get_param_value("wait_version"));
+                if (req.has_param("timeout")) {
+                    timeout_s = std::stoi(req.get_param_value("timeout"));
+                }
+            } catch (...) {
+                timeout_s = 0;
+            }
+            if (timeout_s < 1 || timeout_s > STATUS_MAX_WAIT_S) {
+                res.status = 400;
+                res.set_content(CreateJsonResponse(false, "wait_version must be a number and timeout between 1 and 60"), "application/json");
+                return;
+            }
+            if (version == wait_version) {
+                if (parked_status_polls.fetch_add(1) >= STATUS_MAX_PARKED_POLLS) {
+                    parked_status_polls--;
+                    res.status = 503;
+                    res.set_header("Retry-After", "1");
+                    res.set_content(CreateJsonResponse(false, "Too many status long polls waiting"), "application/json");
+                    return;
+                }
+                version = monitor_control->WaitForStateChange(wait_version,
+                    std::chrono::steady_clock::now() + std::chrono::seconds(timeout_s));
+                parked_status_polls--;
+            }
+            if (version == wait_version) {
+                res.status = 304;
+                res.set_header("ETag", StatusETag(version));
+                return;
+            }
+        } else if (req.has_header("If-None-Match") &&
+                   ETagMatches(req.get_header_value("If-None-Match"), StatusETag(version))) {
+            res.status = 304;
+            res.set_header("ETag", StatusETag(version));
+            return;
+        }
+
         std::ostringstream fields;
-        fields << "\"brightness\": " << static_cast<int>(monitor_control->GetBrightness());
+        fields << "\"version\": " << version;
+        fields << ", \"brightness\": " << static_cast<int>(monitor_control->GetBrightness());
         fields << ", \"contrast\": " << static_cast<int>(monitor_control->GetContrast());
-        fields << ", \"display_index\": " << monitor_control->GetSelectedDisplay();
+        int selected_display = monitor_control->GetSelectedDisplay();
+        fields << ", \"display_index\": " << selected_display;
+        // Restored from the state file at startup and not yet read back or written
+        fields << ", \"unverified\": " << SettingListJson(monitor_control->GetUnverifiedSettings(selected_display));
         fields << ", \"nvapi_initialized\": " << (monitor_control->IsInitialized() ? "true" : "false");
+        fields << ", \"active_transitions\": " << monitor_control->GetActiveTransitionCount();
+        InputSwitchStatus input_switch = monitor_control->GetInputSwitchStatus();
+        fields << ", \"input_switch\": {\"switching_displays\": " << input_switch.switching_displays
+               << ", \"sent\": " << input_switch.totals.input_switches
+               << ", \"skipped\": " << input_switch.totals.switches_skipped
+               << ", \"deferred\": " << input_switch.totals.commands_deferred
+               << ", \"last_settle_ms\": " << input_switch.totals.last_settle_ms << "}";
+        fields << ", \"displays\": [";
+        std::vector<DisplayHealth> health = monitor_control->GetDisplayHealth();
+        for (size_t i = 0; i < health.size(); i++) {
+            fields << (i ? ", " : "") << "{\"display\": " << health[i].display_index
+                   << ", \"breaker\": \"" << BreakerStateName(health[i].breaker) << "\""
+                   << ", \"consecutive_failures\": " << health[i].stats.consecutive_failures
+                   << ", \"timeouts\": " << health[i].stats.timeouts
+                   << ", \"breaker_opens\": " << health[i].stats.breaker_opens
+                   << ", \"fast_failed\": " << health[i].stats.fast_failed
+                   << ", \"expired\": " << health[i].stats.expired
+                   << ", \"bulk_promoted\": " << health[i].stats.bulk_promoted << ", \"lanes\": {";
+            for (int lane = 0; lane < DisplayExecutor::LANE_COUNT; lane++) {
+                const DisplayExecutor::LaneStats& lane_stats = health[i].stats.lanes[lane];
+                fields << (lane ? ", " : "") << "\"" << LaneName(static_cast<DisplayExecutor::Lane>(lane)) << "\": "
+                       << "{\"depth\": " << lane_stats.depth << ", \"peak_depth\": " << lane_stats.peak_depth
+                       << ", \"dequeued\": " << lane_stats.dequeued << "}";
+            }
+            fields << "}}";
+        }
+        fields << "]";
+        if (udp_control && udp_control->IsRunning()) {
+            UdpControlStats udp = udp_control->GetStats();
+            fields << ", \"udp\": {\"port\": " << udp_control->GetPort()
+                   << ", \"received\": " << udp.received << ", \"accepted\": " << udp.accepted
+                   << ", \"stale\": " << udp.stale << ", \"malformed\": " << udp.malformed << "}";
+        }
+        if (ambient && ambient->IsRunning()) {
+            AmbientStats light = ambient->GetStats();
+            uint64_t writes = 0, naive_writes = 0;
+            fields << ", \"ambient\": {\"readings\": " << light.readings << ", \"malformed\": " << light.malformed
+                   << ", \"lux\": " << light.lux << ", \"filtered_lux\": " << light.filtered_lux << ", \"displays\": [";
+            for (size_t i = 0; i < light.displays.size(); i++) {
+                const AmbientDisplayStats& display = light.displays[i];
+                writes += display.writes;
+                naive_writes += display.naive_writes;
+                fields << (i ? ", " : "") << "{\"display\": " << display.display_index
+                       << ", \"target\": " << display.target << ", \"written\": " << display.written
+                       << ", \"writes\": " << display.writes << ", \"naive_writes\": " << display.naive_writes << "}";
+            }
+            // Share of the writes a client posting every reading would have sent that were never needed
+            double saved = naive_writes > writes ? 100.0 * (naive_writes - writes) / naive_writes : 0.0;
+            fields << "], \"writes\": " << writes << ", \"naive_writes\": " << naive_writes
+                   << ", \"writes_saved_percent\": " << static_cast<int>(saved) << "}";
+        }
+        IdempotencyTable::Stats keys = idempotency.GetStats();
+        fields << ", \"idempotency\": {\"keys\": " << keys.keys << ", \"in_flight\": " << keys.in_flight
+               << ", \"replayed\": " << keys.replayed << ", \"joined\": " << keys.joined
+               << ", \"mismatched\": " << keys.mismatched << ", \"evicted\": " << keys.evicted << "}";
         fields << ", \"status_message\": \"" << monitor_control->GetStatusMessage() << "\"";
 
+        res.set_header("ETag", StatusETag(version));
+        res.set_header("Cache-Control", "no-cache");
         res.set_content("{" + fields.str() + "}", "application/json");
     });
 
+    // GET /api/diagnostics/startup - How long each startup phase took
+    server.Get("/api/diagnostics/startup", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/diagnostics/startup");
+        if (!startup_profile) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Startup profile not available"), "application/json");
+            return;
+        }
+        std::vector<StartupProfile::Phase> phases = startup_profile->GetPhases();
+        const StartupProfile::Phase* slowest = nullptr;
+        std::ostringstream fields;
+        fields << std::fixed << std::setprecision(3) << "\"total_ms\": " << startup_profile->GetElapsedMs()
+               << ", \"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++) {
+            const StartupProfile::Phase& phase = phases[i];
+            fields << (i ? ", " : "") << "{\"name\": \"" << phase.name << "\", \"start_ms\": " << phase.start_ms
+                   << ", \"duration_ms\": " << phase.duration_ms << ", \"ok\": " << (phase.ok ? "true" : "false")
+                   << ", \"detail\": \"" << phase.detail << "\"}";
+            if (!slowest || phase.duration_ms > slowest->duration_ms) {
+                slowest = &phase;
+            }
+        }
+        fields << "], \"slowest\": " << (slowest ? "\"" + slowest->name + "\"" : std::string("null"));
+        res.set_content(CreateJsonResponse(true, "", fields.str()), "application/json");
+    });
+
+    // GET /api/gateway - Downstream instances of gateway mode and their links (GATEWAY_HOSTS in config.env)
+    server.Get("/api/gateway", [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "GET /api/gateway");
+        if (!gateway || !gateway->IsRunning()) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Gateway mode is off (GATEWAY_HOSTS in config.env)"), "application/json");
+            return;
+        }
+        std::vector<GatewayHostStats> hosts = gateway->GetHostStats();
+        std::ostringstream fields;
+        fields << "\"timeout_ms\": " << gateway->GetSettings().timeout_ms << ", \"hosts\": [";
+        for (size_t i = 0; i < hosts.size(); i++) {
+            const GatewayHostStats& host = hosts[i];
+            fields << (i ? ", " : "") << "{\"host\": \"" << host.host << "\""
+                   << ", \"connected\": " << (host.connected ? "true" : "false") << ", \"queued\": " << host.queued
+                   << ", \"requests\": " << host.requests << ", \"failures\": " << host.failures
+                   << ", \"timeouts\": " << host.timeouts << ", \"consecutive_failures\": " << host.consecutive_failures
+                   << ", \"last_elapsed_ms\": " << host.last_elapsed_ms
+                   << ", \"last_error\": \"" << host.last_error << "\"}";
+        }
+        fields << "]";
+        res.set_content(CreateJsonResponse(true, std::to_string(hosts.size()) + " hosts", fields.str()), "application/json");
+    });
+
+    // /api/gateway/api/... - The same request sent to every downstream instance
+    // (or those in ?hosts=a,b) at once; each host's reply is returned in "hosts"
+    auto fan_out = [this](const httplib::Request& req, httplib::Response& res) {
+        ServerLogger::Log("INFO", "%s %s - body: %s", req.method.c_str(), req.path.c_str(), req.body.c_str());
+        if (!gateway || !gateway->IsRunning()) {
+            res.status = 404;
+            res.set_content(CreateJsonResponse(false, "Gateway mode is off (GATEWAY_HOSTS in config.env)"), "application/json");
+            return;
+        }
+
+        // The client's deadline caps the per-host timeout; the links pass the
+        // time left on to each host as X-Deadline-Ms
+        DisplayExecutor::Deadline deadline;
+        std::string request_error;
+        if (!ParseDeadline(req, deadline, request_error)) {
+            res.status = 400;
+            res.set_content(CreateJsonResponse(false, request_error), "application/json");
+            return;
+        }
+
+        GatewayRequest request;
+        request.method = req.method;
+        request.path = req.matches[1];
+        request.body = req.body;
+        if (req.has_header("Content-Type")) {
+            request.content_type = req.get_header_value("Content-Type");
+        }
+        for (const char* header : { "Idempotency-Key", "X-Priority" }) {
+            if (req.has_header(header)) {
+                request.headers.push_back({ header, req.get_header_value(header) });
+            }
+        }
+        httplib::Params params;
+        for (const auto& param : req.params) {
+            if (param.first == "hosts") {
+                std::stringstream list(param.second);
+                std::string host;
+                while (std::getline(list, host, ',')) {
+                    if (!host.empty()) {
+                        request.hosts.push_back(host);
+                    }
+                }
+            } else {
+                params.insert(param);
+            }
+        }
+        if (!params.empty()) {
+            request.path = httplib::append_query_params(request.path, params);
+        }
+        if (deadline != DisplayExecutor::NO_DEADLINE) {
+            int remaining_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count());
+            request.timeout_ms = std::max(1, std::min(remaining_ms, gateway->GetSettings().timeout_ms));
+        }
+
+        std::vector<GatewayReply> replies = gateway->FanOut(request);
+        int succeeded = 0, elapsed_ms = 0;
+        std::ostringstream fields;
+        fields << "\"hosts\": [";
+        for (size_t i = 0; i < replies.size(); i++) {
+            const GatewayReply& reply = replies[i];
+            succeeded += reply.Succeeded() ? 1 : 0;
+            elapsed_ms = std::max(elapsed_ms, reply.elapsed_ms);
+            fields << (i ? ", " : "") << "{\"host\": \"" << reply.host << "\", \"ok\": "
+                   << (reply.Succeeded() ? "true" : "false") << ", \"status\": " << reply.status
+                   << ", \"elapsed_ms\": " << reply.elapsed_ms;
+            // Replies are embedded as they are; the API only answers JSON objects
+            size_t first = reply.body.find_first_not_of(" \t\r\n");
+            if (first != std::string::npos && reply.body[first] == '{') {
+                fields << ", \"response\": " << reply.body;
+            }
+            if (reply.status == 0) {
+                fields << ", \"error\": \"" << reply.error << "\"";
+                ServerLogger::Log("WARN", "Gateway %s %s to %s: %s", req.method.c_str(), request.path.c_str(),
+                                  reply.host.c_str(), reply.error.c_str());
+            }
+            fields << "}";
+        }
+        int failed = static_cast<int>(replies.size()) - succeeded;
+        fields << "], \"succeeded\": " << succeeded << ", \"failed\": " << failed << ", \"elapsed_ms\": " << elapsed_ms;
+
+        // 207 Multi-Status when only some hosts succeeded
+        res.status = failed == 0 ? 200 : succeeded == 0 ? 502 : 207;
+        std::string message = std::to_string(succeeded) + " of " + std::to_string(replies.size()) + " hosts succeeded";
+        ServerLogger::Log(failed == 0 ? "INFO" : "WARN", "Gateway %s %s: %s in %d ms", req.method.c_str(),
+                          request.path.c_str(), message.c_str(), elapsed_ms);
+        res.set_content(CreateJsonResponse(failed == 0, message, fields.str()), "application/json");
+    };
+    server.Get(R"(/api/gateway(/api/.+))", fan_out);
+    server.Post(R"(/api/gateway(/api/.+))", fan_out);
+    server.Put(R"(/api/gateway(/api/.+))", fan_out);
+    server.Delete(R"(/api/gateway(/api/.+))", fan_out);
+
     // GET /health - Health check
     server.Get("/health", [this](const httplib::Request& req, httplib::Response& res) {
         ServerLogger::Log("INFO", "GET /health");
         res.set_content("{\"status\": \"ok\", \"version\": \"1.0.0\"}", "application/json");
     });
+}
+
+void HttpApiServer::ServerThreadFunc() {
+    httplib::Server& server = *http_server;
+    RegisterRoutes(server);
+
+    // Without this, Nagle + delayed ACK add ~40 ms to every keep-alive response
+    server.set_tcp_nodelay(true);
 
     // Log that we're attempting to bind
     ServerLogger::Log("INFO", "Attempting to bind to %s:%d", config.host.c_str(), config.port);
 
+    // Only the first start is part of startup; a restart after a config edit is not
+    StartupProfile* profile = startup_bind_recorded ? nullptr : startup_profile;
+    startup_bind_recorded = true;
+
     // Ensure WSA is initialized (may be redundant but helps diagnose)
+    StartupProfile::Timer wsa_timer(profile, "WSAStartup");
     WSADATA wsaData;
     int wsa_init_result = WSAStartup(MAKEWORD(2, 2), &wsaData);
     if (wsa_init_result != 0) {
         ServerLogger::Log("ERROR", "WSAStartup failed with error: %d", wsa_init_result);
+        wsa_timer.End(false, "error " + std::to_string(wsa_init_result));
     } else {
         ServerLogger::Log("INFO", "WSAStartup succeeded (or was already initialized)");
+        wsa_timer.End();
     }
 
     // Test getaddrinfo directly
+    StartupProfile::Timer gai_timer(profile, "getaddrinfo");
     struct addrinfo hints = {}, *result = nullptr;
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
@@ -299,15 +1585,19 @@ void HttpApiServer::ServerThreadFunc() {
     int gai_result = getaddrinfo(config.host.c_str(), std::to_string(config.port).c_str(), &hints, &result);
     if (gai_result != 0) {
         ServerLogger::Log("ERROR", "getaddrinfo failed: %d (%s)", gai_result, gai_strerrorA(gai_result));
+        gai_timer.End(false, gai_strerrorA(gai_result));
     } else {
         ServerLogger::Log("INFO", "getaddrinfo succeeded for %s:%d", config.host.c_str(), config.port);
         freeaddrinfo(result);
+        gai_timer.End(true, config.host);
     }
 
     // Try to bind first (this is a non-blocking check)
+    StartupProfile::Timer bind_timer(profile, "HTTP bind");
     if (!server.bind_to_port(config.host.c_str(), config.port)) {
         int wsa_error = WSAGetLastError();
         ServerLogger::Log("ERROR", "Failed to bind to %s:%d - WSA error code: %d", config.host.c_str(), config.port, wsa_error);
+        bind_timer.End(false, "WSA error " + std::to_string(wsa_error));
 
         // Signal bind failure
         {
@@ -322,6 +1612,7 @@ void HttpApiServer::ServerThreadFunc() {
 
     // Bind succeeded - signal and start listening
     ServerLogger::Log("INFO", "Successfully bound to %s:%d, starting to listen", config.host.c_str(), config.port);
+    bind_timer.End(true, config.host + ":" + std::to_string(config.port));
     {
         std::lock_guard<std::mutex> lock(bind_mutex);
         bind_attempted = true;
@@ -340,12 +1631,22 @@ void HttpApiServer::ServerThreadFunc() {
 }
 
 bool HttpApiServer::Start(const ServerConfig& cfg) {
-    if (running) {
+    if (IsRunning()) {
         ServerLogger::Log("WARN", "Server already running");
         return false;
     }
 
+    // Reap the threads of a previous attempt that failed to bind
+    if (server_thread && server_thread->joinable()) {
+        server_thread->join();
+    }
+    StopLocalListener();
+
     config = cfg;
+    if (!first_request_served) {
+        server_started = StartupProfile::Clock::now();
+    }
+    http_server = std::make_unique<httplib::Server>();
     should_stop = false;
     bind_attempted = false;
     bind_succeeded = false;
@@ -362,6 +1663,10 @@ bool HttpApiServer::Start(const ServerConfig& cfg) {
     ServerLogger::Init(log_path);
     ServerLogger::Log("INFO", "Starting HTTP API server on %s:%d", cfg.host.c_str(), cfg.port);
 
+    if (!cfg.unix_socket.empty()) {
+        StartLocalListener();
+    }
+
     try {
         server_thread = std::make_unique<std::thread>(&HttpApiServer::ServerThreadFunc, this);
 
@@ -391,23 +1696,98 @@ bool HttpApiServer::Start(const ServerConfig& cfg) {
     }
 }
 
-void HttpApiServer::Stop() {
-    if (server_thread && server_thread->joinable()) {
-        should_stop = true;
+// A previous run that crashed leaves its socket file behind and bind() fails
+// with "address in use". Only delete AF_UNIX socket files (reparse points),
+// never a regular file that UNIX_SOCKET was pointed at by mistake.
+static void RemoveStaleSocket(const std::string& path) {
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+        DeleteFileA(path.c_str());
+    }
+}
 
-        // Note: cpp-httplib server.listen() is blocking and doesn't have a clean shutdown method
-        // The thread will terminate when the application exits
-        // For a cleaner shutdown, we'd need to send a shutdown request to the server
+bool HttpApiServer::StartLocalListener() {
+#ifdef CPPHTTPLIB_HAVE_AFUNIX_H
+    const std::string path = config.unix_socket;
+    RemoveStaleSocket(path);
 
-        // Wait for thread (with timeout)
-        if (server_thread->joinable()) {
-            server_thread->join();
-        }
+    local_server = std::make_unique<httplib::Server>();
+    local_server->set_address_family(AF_UNIX);
+    RegisterRoutes(*local_server);
+    // The port is ignored for AF_UNIX but must be non-zero (0 means "pick a TCP port")
+    if (!local_server->bind_to_port(path, 1)) {
+        ServerLogger::Log("ERROR", "Failed to bind local socket %s - WSA error code: %d", path.c_str(), WSAGetLastError());
+        local_server.reset();
+        return false;
     }
+
+    local_running = true;
+    local_thread = std::make_unique<std::thread>([this]() {
+        local_server->listen_after_bind();
+        local_running = false;
+    });
+    ServerLogger::Log("INFO", "Listening on local socket %s", path.c_str());
+    return true;
+#else
+    ServerLogger::Log("ERROR", "UNIX_SOCKET requires a Windows SDK with afunix.h (Windows 10 1803 or later)");
+    return false;
+#endif
+}
+
+// Join the local listener; StopAccepting() must have closed it if it was running
+void HttpApiServer::StopLocalListener() {
+    if (!local_thread) {
+        return;
+    }
+    local_thread->join();
+    local_thread.reset();
+    local_server.reset();
+    RemoveStaleSocket(config.unix_socket);
+}
+
+void HttpApiServer::StopAccepting() {
+    if (should_stop.exchange(true)) {
+        return;
+    }
+
+    // Answer waiting status long polls now (304) rather than at their timeout
+    monitor_control->WakeStateWaiters();
+
+    // Closing a listening socket ends listen_after_bind(); wait for the listen
+    // loop to be entered first or stop() would be a no-op. Requests already
+    // being handled run to completion and are joined in Stop().
+    if (local_running) {
+        local_server->wait_until_ready();
+        local_server->stop();
+    }
+    if (running) {
+        http_server->wait_until_ready();
+        http_server->stop();
+    }
+}
+
+void HttpApiServer::Stop() {
+    StopAccepting();
+    StopLocalListener();
+
+    if (server_thread && server_thread->joinable()) {
+        server_thread->join();
+    }
+    http_server.reset();
     running = false;
 }
 
+bool HttpApiServer::Restart(const ServerConfig& cfg) {
+    ServerLogger::Log("INFO", "Restarting HTTP API server on %s:%d", cfg.host.c_str(), cfg.port);
+    Stop();
+    return Start(cfg);
+}
+
 bool HttpApiServer::IsRunning() const {
+    return running || local_running;
+}
+
+bool HttpApiServer::IsTcpRunning() const {
     return running;
 }
 
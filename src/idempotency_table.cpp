@@ -0,0 +1,105 @@
+#include "idempotency_table.h"
+
+IdempotencyTable::IdempotencyTable() {
+}
+
+IdempotencyTable::Claim IdempotencyTable::Begin(const std::string& key, uint64_t fingerprint,
+                                                Clock::duration max_wait, Response& response) {
+    std::unique_lock<std::mutex> lock(table_mutex);
+    Clock::time_point now = Clock::now();
+    Expire(now);
+
+    auto found = entries.find(key);
+    if (found == entries.end()) {
+        if (entries.size() >= IDEMPOTENCY_MAX_KEYS && !EvictOldest()) {
+            return Claim::Full;
+        }
+        auto entry = std::make_shared<Entry>();
+        entry->fingerprint = fingerprint;
+        entries[key] = entry;
+        return Claim::New;
+    }
+
+    // Hold the entry itself: a failed original removes it from the table
+    // before the waiters get to read its response
+    std::shared_ptr<Entry> entry = found->second;
+    if (entry->fingerprint != fingerprint) {
+        stats.mismatched++;
+        return Claim::Mismatch;
+    }
+    if (!entry->done) {
+        if (!done_cv.wait_until(lock, now + max_wait, [&entry] { return entry->done; })) {
+            return Claim::Busy;
+        }
+        stats.joined++;
+    } else {
+        stats.replayed++;
+    }
+    response = entry->response;
+    return Claim::Replay;
+}
+
+void IdempotencyTable::Complete(const std::string& key, const Response& response) {
+    std::lock_guard<std::mutex> lock(table_mutex);
+    auto found = entries.find(key);
+    if (found == entries.end() || found->second->done) {
+        return;
+    }
+    std::shared_ptr<Entry> entry = found->second;
+    entry->done = true;
+    entry->response = response;
+    entry->completed = Clock::now();
+    if (response.status >= 500) {
+        entries.erase(found);
+    }
+    done_cv.notify_all();
+}
+
+IdempotencyTable::Stats IdempotencyTable::GetStats() {
+    std::lock_guard<std::mutex> lock(table_mutex);
+    Expire(Clock::now());
+    Stats result = stats;
+    result.keys = entries.size();
+    result.in_flight = 0;
+    for (const auto& entry : entries) {
+        result.in_flight += entry.second->done ? 0 : 1;
+    }
+    return result;
+}
+
+void IdempotencyTable::Expire(Clock::time_point now) {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second->done && now - it->second->completed >= std::chrono::milliseconds(IDEMPOTENCY_TTL_MS)) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool IdempotencyTable::EvictOldest() {
+    auto oldest = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->second->done && (oldest == entries.end() || it->second->completed < oldest->second->completed)) {
+            oldest = it;
+        }
+    }
+    if (oldest == entries.end()) {
+        return false;
+    }
+    entries.erase(oldest);
+    stats.evicted++;
+    return true;
+}
+
+bool IsValidIdempotencyKey(const std::string& key) {
+    if (key.empty() || key.size() > IDEMPOTENCY_MAX_KEY_LENGTH) {
+        return false;
+    }
+    for (char c : key) {
+        if (c < 0x21 || c > 0x7E) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,97 +1,149 @@
 // Monitor Control Implementation
 #include "monitor_control.h"
 #include <stdio.h>
+#include <string.h>
 
-// This function calculates the (XOR) checksum of the I2C register
-void CalculateI2cChecksum(const NV_I2C_INFO& i2cInfo)
+// This function writes a pre-encoded packet to the display over the I2C bus.
+// Packet layout and checksum are produced by ddc_packet.h, so fixed commands
+// arrive here fully encoded at compile time.
+BOOL WriteDdcPacket(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, const DdcPacket& packet)
 {
-    // Calculate the i2c packet checksum and place the 
-    // value into the packet
+    // NvAPI takes non-const buffers, so send from a local copy
+    DdcPacket buffer = packet;
 
-    // i2c checksum is the result of xor'ing all the bytes in the 
-    // packet (except for the last data byte, which is the checksum 
-    // itself)
+    NV_I2C_INFO i2cInfo = { 0 };
+    i2cInfo.version         = NV_I2C_INFO_VER;
+    i2cInfo.displayMask     = displayId;
+    i2cInfo.bIsDDCPort      = TRUE;
+    i2cInfo.i2cDevAddress   = DDC_WRITE_ADDRESS;
+    i2cInfo.pbI2cRegAddress = &buffer.register_address;
+    i2cInfo.regAddrSize     = sizeof(buffer.register_address);
+    i2cInfo.pbData          = buffer.data;
+    i2cInfo.cbSize          = sizeof(buffer.data);
+    i2cInfo.i2cSpeed        = DDC_I2C_SPEED;
+
+    NvAPI_Status nvapiStatus = NvAPI_I2CWrite(hPhysicalGpu, &i2cInfo);
+    if (nvapiStatus != NVAPI_OK)
+    {
+        printf("  NvAPI_I2CWrite (code 0x%02X) failed with status %d\n", packet.CommandCode(), nvapiStatus);
+        return FALSE;
+    }
 
-    // Packet consists of:
+    return TRUE;
+}
 
-    // The device address...
-    BYTE checksum = i2cInfo.i2cDevAddress;
+// This function writes the input_value to the display over the I2C bus by issuing commands and data
+BOOL WriteValueToMonitor(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, BYTE input_value, BYTE command_code, BYTE register_address)
+{
+    // Arbitrary codes from the command line are only known at runtime,
+    // so this path encodes the whole packet here
+    return WriteDdcPacket(hPhysicalGpu, displayId, MakeDdcPacket(command_code, input_value, register_address));
+}
 
-    // Register address...
-    for (unsigned int i = 0; i < i2cInfo.regAddrSize; ++i)
-    {
-        checksum ^= i2cInfo.pbI2cRegAddress[i];
-    }
+bool NvApiTransport::Write(const DdcPacket& packet)
+{
+    return WriteDdcPacket(gpu, output_id, packet) == TRUE;
+}
 
-    // And data bytes less last byte for checksum...
-    for (unsigned int i = 0; i < i2cInfo.cbSize - 1; ++i)
+bool NvApiTransport::Read(uint8_t command_code, uint8_t register_address,
+                          uint16_t* current_value, uint16_t* maximum_value)
+{
+    WORD current = 0, maximum = 0;
+    if (ReadVcpFeature(gpu, output_id, command_code, &current, &maximum, register_address) != TRUE)
     {
-        checksum ^= i2cInfo.pbData[i];
+        return false;
     }
-
-    // Store calculated checksum in the last byte of i2c packet
-    i2cInfo.pbData[i2cInfo.cbSize - 1] = checksum;
+    *current_value = current;
+    *maximum_value = maximum;
+    return true;
 }
 
-// This macro initializes the i2cinfo structure
-#define  INIT_I2CINFO(i2cInfo, i2cVersion, displayId, isDDCPort,   \
-        i2cDevAddr, regAddr, regSize, dataBuf, bufSize, speed)     \
-do {                                                               \
-    i2cInfo.version         = i2cVersion;                          \
-    i2cInfo.displayMask     = displayId;                           \
-    i2cInfo.bIsDDCPort      = isDDCPort;                           \
-    i2cInfo.i2cDevAddress   = i2cDevAddr;                          \
-    i2cInfo.pbI2cRegAddress = (BYTE*) &regAddr;                    \
-    i2cInfo.regAddrSize     = regSize;                             \
-    i2cInfo.pbData          = (BYTE*) &dataBuf;                    \
-    i2cInfo.cbSize          = bufSize;                             \
-    i2cInfo.i2cSpeed        = speed;                               \
-}while (0)
-
-// This function writes the input_value to the display over the I2C bus by issuing commands and data
-BOOL WriteValueToMonitor(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, BYTE input_value, BYTE command_code, BYTE register_address)
+// This function asks the display for a VCP feature value and parses its reply
+BOOL ReadVcpFeature(NvPhysicalGpuHandle hPhysicalGpu, NvU32 displayId, BYTE command_code,
+                    WORD* current_value, WORD* maximum_value, BYTE register_address)
 {
-    NvAPI_Status nvapiStatus = NVAPI_OK;
+    DdcGetVcpRequest request = MakeDdcGetVcpRequest(command_code, register_address);
 
     NV_I2C_INFO i2cInfo = { 0 };
-    i2cInfo.version = NV_I2C_INFO_VER;
-    //
-    // The 7-bit I2C address for display = Ox37
-    // Since we always use 8bits to address, this 7-bit addr (0x37) is placed on
-    // the upper 7 bits, and the LSB contains the Read/Write flag:
-    // Write = 0 and Read =1;
-    //
-    NvU8 i2cDeviceAddr = 0x37;
-    NvU8 i2cWriteDeviceAddr = i2cDeviceAddr << 1; //0x6E
-    NvU8 i2cReadDeviceAddr = i2cWriteDeviceAddr | 1; //0x6F (unused but kept for documentation)
-
-    //
-    // Now Send a write packet to modify current brightness value to 20 (0x14)
-    // The packet consists of the following bytes
-    // 0x6E - i2cWriteDeviceAddr
-    // Ox?? - register_address
-    // 0x84 - 0x80 OR n where n = 4 bytes for "modify a value" request
-    // 0x03 - change a value flag
-    // 0x?? - command_code
-    // Ox00 - input_value high byte
-    // 0x?? - input_value low byte
-    // 0x?? - checksum, , xor'ing all the above bytes
-    //
-    BYTE registerAddr[] = { register_address };
-    BYTE modifyBytes[] = { 0x84, 0x03, command_code, 0x00, input_value, 0xDD };
-
-    INIT_I2CINFO(i2cInfo, NV_I2C_INFO_VER, displayId, TRUE, i2cWriteDeviceAddr,
-        registerAddr, sizeof(registerAddr), modifyBytes, sizeof(modifyBytes), 27);
-    CalculateI2cChecksum(i2cInfo);
-
-    nvapiStatus = NvAPI_I2CWrite(hPhysicalGpu, &i2cInfo);
+    i2cInfo.version         = NV_I2C_INFO_VER;
+    i2cInfo.displayMask     = displayId;
+    i2cInfo.bIsDDCPort      = TRUE;
+    i2cInfo.i2cDevAddress   = DDC_WRITE_ADDRESS;
+    i2cInfo.pbI2cRegAddress = &request.register_address;
+    i2cInfo.regAddrSize     = sizeof(request.register_address);
+    i2cInfo.pbData          = request.data;
+    i2cInfo.cbSize          = sizeof(request.data);
+    i2cInfo.i2cSpeed        = DDC_I2C_SPEED;
+
+    NvAPI_Status nvapiStatus = NvAPI_I2CWrite(hPhysicalGpu, &i2cInfo);
     if (nvapiStatus != NVAPI_OK)
     {
-        printf("  NvAPI_I2CWrite (revise brightness) failed with status %d\n", nvapiStatus);
+        printf("  NvAPI_I2CWrite (get 0x%02X) failed with status %d\n", command_code, nvapiStatus);
         return FALSE;
     }
 
+    // DDC/CI requires the host to wait before reading the reply
+    Sleep(DDC_REPLY_DELAY_MS);
+
+    BYTE reply[DDC_VCP_REPLY_SIZE] = { 0 };
+    i2cInfo.pbI2cRegAddress = NULL;
+    i2cInfo.regAddrSize     = 0;
+    i2cInfo.pbData          = reply;
+    i2cInfo.cbSize          = sizeof(reply);
+
+    nvapiStatus = NvAPI_I2CRead(hPhysicalGpu, &i2cInfo);
+    if (nvapiStatus != NVAPI_OK)
+    {
+        printf("  NvAPI_I2CRead (get 0x%02X) failed with status %d\n", command_code, nvapiStatus);
+        return FALSE;
+    }
+
+    uint16_t current = 0, maximum = 0;
+    if (!ParseDdcVcpReply(reply, command_code, current, maximum))
+    {
+        printf("  Invalid or unsupported reply for VCP 0x%02X\n", command_code);
+        return FALSE;
+    }
+
+    *current_value = current;
+    *maximum_value = maximum;
     return TRUE;
 }
 
+// Resolve the GPU handle and output id needed for I2C calls on a display
+bool GetGpuFromDisplay(NvDisplayHandle display, NvPhysicalGpuHandle* gpu, NvU32* outputId)
+{
+    NvU32 gpuCount = 0;
+    NvAPI_Status nvapiStatus = NvAPI_GetPhysicalGPUsFromDisplay(display, gpu, &gpuCount);
+    if (nvapiStatus != NVAPI_OK)
+    {
+        printf("NvAPI_GetPhysicalGPUsFromDisplay() failed with status %d\n", nvapiStatus);
+        return false;
+    }
 
+    nvapiStatus = NvAPI_GetAssociatedDisplayOutputId(display, outputId);
+    if (nvapiStatus != NVAPI_OK)
+    {
+        printf("NvAPI_GetAssociatedDisplayOutputId() failed with status %d\n", nvapiStatus);
+        return false;
+    }
+
+    return true;
+}
+
+// First EDID block of the monitor on an output (identity for monitor profiles)
+bool ReadDisplayEdid(NvPhysicalGpuHandle gpu, NvU32 outputId, NvU8* edid, NvU32* size)
+{
+    NV_EDID edidInfo = { 0 };
+    edidInfo.version = NV_EDID_VER;
+    NvAPI_Status nvapiStatus = NvAPI_GPU_GetEDID(gpu, outputId, &edidInfo);
+    if (nvapiStatus != NVAPI_OK)
+    {
+        printf("NvAPI_GPU_GetEDID() failed with status %d\n", nvapiStatus);
+        return false;
+    }
+
+    *size = edidInfo.sizeofEDID < NV_EDID_DATA_SIZE ? edidInfo.sizeofEDID : NV_EDID_DATA_SIZE;
+    memcpy(edid, edidInfo.EDID_Data, *size);
+    return true;
+}
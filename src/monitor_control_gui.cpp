@@ -2,6 +2,8 @@
 // Library linking is now handled by CMake - see CMakeLists.txt
 
 #include <stdio.h>
+#include <chrono>
+#include <algorithm>
 #include <windows.h>
 #include <d3d11.h>
 #include <tchar.h>
@@ -16,10 +18,18 @@
 
 // Monitor control functions
 #include "monitor_control.h"
+#include "vcp_commands.h"
 
 // HTTP API Server
 #include "http_api_server.h"
 #include "thread_safe_control.h"
+#include "preset_manager.h"
+#include "rule_scheduler.h"
+#include "config_watcher.h"
+#include "udp_control.h"
+#include "ambient_controller.h"
+#include "monitor_gateway.h"
+#include "startup_profile.h"
 
 // Data
 static ID3D11Device*            g_pd3dDevice = nullptr;
@@ -55,27 +65,41 @@ struct AppState {
 static AppState g_app_state;
 static ThreadSafeMonitorControl* g_thread_safe_control = nullptr;
 static HttpApiServer* g_http_server = nullptr;
+static PresetManager g_preset_manager;
+static RuleScheduler* g_rule_scheduler = nullptr;
+static ConfigWatcher* g_config_watcher = nullptr;
+static UdpControlServer* g_udp_control = nullptr;
+static AmbientController* g_ambient_controller = nullptr;
+static MonitorGateway* g_gateway = nullptr;
+static StartupProfile g_startup_profile;    // Created with the process; startup phases are timed from here
 
 // GUI-specific initialization wrapper
 bool InitializeGUI()
 {
+    StartupProfile::Timer init_timer(&g_startup_profile, "NvAPI_Initialize");
     NvAPI_Status status = NvAPI_Initialize();
     if (status != NVAPI_OK) {
         snprintf(g_app_state.status_message, sizeof(g_app_state.status_message), 
                 "NvAPI_Initialize failed: %d", status);
+        init_timer.End(false, g_app_state.status_message);
         return false;
     }
+    init_timer.End();
 
     // Enumerate displays
     g_app_state.display_count = 0;
     for (unsigned int i = 0; status == NVAPI_OK && i < NVAPI_MAX_PHYSICAL_GPUS * NVAPI_MAX_DISPLAY_HEADS; i++) {
+        StartupProfile::Timer enum_timer(&g_startup_profile, "enumerate display " + std::to_string(i));
         status = NvAPI_EnumNvidiaDisplayHandle(i, &g_app_state.displays[i]);
         if (status == NVAPI_OK) {
             g_app_state.display_count++;
         } else if (status != NVAPI_END_ENUMERATION) {
             snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
                     "Display enumeration failed: %d", status);
+            enum_timer.End(false, g_app_state.status_message);
             return false;
+        } else {
+            enum_timer.End(true, "end of enumeration");
         }
     }
 
@@ -86,7 +110,27 @@ bool InitializeGUI()
     }
 
     // Initialize with first display
-    return SelectGUIDisplay(0);
+    StartupProfile::Timer lookup_timer(&g_startup_profile, "GPU/output lookup");
+    bool selected = SelectGUIDisplay(0);
+    lookup_timer.End(selected, selected ? "" : g_app_state.status_message);
+    return selected;
+}
+
+// Write the startup phases to the log, slowest marked
+void LogStartupProfile()
+{
+    std::vector<StartupProfile::Phase> phases = g_startup_profile.GetPhases();
+    double slowest = 0.0;
+    for (const StartupProfile::Phase& phase : phases) {
+        slowest = std::max(slowest, phase.duration_ms);
+    }
+    for (const StartupProfile::Phase& phase : phases) {
+        ServerLogger::Log(phase.ok ? "INFO" : "WARN", "Startup: %-24s %9.2f ms at %9.2f ms%s%s%s", phase.name.c_str(),
+                          phase.duration_ms, phase.start_ms, phase.ok ? "" : " FAILED",
+                          phase.detail.empty() ? "" : (" - " + phase.detail).c_str(),
+                          phase.duration_ms == slowest ? " (slowest)" : "");
+    }
+    ServerLogger::Log("INFO", "Startup: %zu phases in %.2f ms", phases.size(), g_startup_profile.GetElapsedMs());
 }
 
 bool SelectGUIDisplay(int display_index)
@@ -118,9 +162,12 @@ bool SelectGUIDisplay(int display_index)
 
     g_app_state.selected_display = display_index;
     
-    // Set default values instead of reading from monitor
-    g_app_state.brightness = 50.0f;
-    g_app_state.contrast = 50.0f;
+    // Last known values (restored from the state file at startup) instead of
+    // reading from the monitor; 50% until anything is known
+    DisplaySettings known = g_thread_safe_control ? g_thread_safe_control->GetKnownSettings(display_index)
+                                                  : DisplaySettings();
+    g_app_state.brightness = known.brightness != VCP_VALUE_UNSET ? (float)known.brightness : 50.0f;
+    g_app_state.contrast = known.contrast != VCP_VALUE_UNSET ? (float)known.contrast : 50.0f;
     
     snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
             "Display %d selected successfully", display_index);
@@ -128,55 +175,197 @@ bool SelectGUIDisplay(int display_index)
     return true;
 }
 
+// GUI writes go through the same per-display queues as the HTTP API so the
+// known monitor state used for preset diffing stays accurate. They are sent
+// newest-value-only without blocking the UI thread; the status message is
+// posted when the monitor has answered (the queue updates the slider values).
 void SetBrightness(float brightness)
 {
     if (!g_app_state.nvapi_initialized) return;
 
-    BYTE value = (BYTE)brightness; // LG monitor uses 0-100 range directly
-    BOOL result = WriteValueToMonitor(g_app_state.current_gpu, g_app_state.current_output_id, 
-                                    value, 0x10, 0x51); // 0x10 = brightness VCP code
-    
-    if (result) {
-        g_app_state.brightness = brightness;
-        snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
-                "Brightness set to %.0f%%", brightness);
-    } else {
-        snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
-                "Failed to set brightness");
-    }
+    // Scaled to the monitor's raw range by its profile
+    VcpWrite write;
+    MakeVcpWrite(g_app_state.selected_display, VcpSetting::Brightness, (int)brightness, write);
+    g_thread_safe_control->WriteLatest(write, [brightness](bool result) {
+        char message[256];
+        if (result) {
+            snprintf(message, sizeof(message), "Brightness set to %.0f%%", brightness);
+        } else {
+            snprintf(message, sizeof(message), "Failed to set brightness");
+        }
+        g_thread_safe_control->SetStatusMessage(message);   // Also wakes GET /api/status pollers
+    });
 }
 
 void SetContrast(float contrast)
 {
     if (!g_app_state.nvapi_initialized) return;
 
-    BYTE value = (BYTE)contrast; // LG monitor uses 0-100 range directly
-    BOOL result = WriteValueToMonitor(g_app_state.current_gpu, g_app_state.current_output_id, 
-                                    value, 0x12, 0x51); // 0x12 = contrast VCP code
-    
-    if (result) {
-        g_app_state.contrast = contrast;
+    // Scaled to the monitor's raw range by its profile
+    VcpWrite write;
+    MakeVcpWrite(g_app_state.selected_display, VcpSetting::Contrast, (int)contrast, write);
+    g_thread_safe_control->WriteLatest(write, [contrast](bool result) {
+        char message[256];
+        if (result) {
+            snprintf(message, sizeof(message), "Contrast set to %.0f%%", contrast);
+        } else {
+            snprintf(message, sizeof(message), "Failed to set contrast");
+        }
+        g_thread_safe_control->SetStatusMessage(message);
+    });
+}
+
+void ApplyQuickPreset(const QuickPreset& preset)
+{
+    if (!g_app_state.nvapi_initialized) return;
+
+    // Encoded for the display's profile; values already on the monitor are skipped
+    std::vector<VcpWrite> writes(2);
+    MakeVcpWrite(g_app_state.selected_display, VcpSetting::Brightness, preset.brightness, writes[0]);
+    MakeVcpWrite(g_app_state.selected_display, VcpSetting::Contrast, preset.contrast, writes[1]);
+
+    ApplyResult result = g_thread_safe_control->ApplyWrites(writes);
+
+    if (result.writes_failed == 0) {
         snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
-                "Contrast set to %.0f%%", contrast);
+                "%s preset applied (%d changed)", preset.name, result.writes_sent);
     } else {
         snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
-                "Failed to set contrast");
+                "Failed to apply %s preset", preset.name);
     }
+    g_thread_safe_control->NotifyStateChanged();
 }
 
-void SetInputSource(const char* input_name, BYTE input_value, BYTE command_code, BYTE register_address)
+void SetInputSource(int api_value, const char* name)
 {
     if (!g_app_state.nvapi_initialized) return;
 
-    BOOL result = WriteValueToMonitor(g_app_state.current_gpu, g_app_state.current_output_id, 
-                                    input_value, command_code, register_address);
-    
-    if (result) {
-        snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
-                "Input switched to %s", input_name);
-    } else {
-        snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
-                "Failed to switch to %s", input_name);
+    VcpWrite write;
+    MakeVcpWrite(g_app_state.selected_display, VcpSetting::Input, api_value, write);
+    std::string input_name = name;   // The profile may be reloaded before the switch finishes
+    g_thread_safe_control->WriteLatest(write, [input_name](bool result) {
+        char message[256];
+        if (result) {
+            snprintf(message, sizeof(message), "Input switched to %s", input_name.c_str());
+        } else {
+            snprintf(message, sizeof(message), "Failed to switch to %s", input_name.c_str());
+        }
+        g_thread_safe_control->SetStatusMessage(message);
+    });
+}
+
+// Binary UDP control messages (rotary encoders, control surfaces). Only the
+// newest value per display/setting is kept while the bus is busy.
+void OnUdpControlMessage(const UdpControlMessage& message)
+{
+    VcpSetting setting;
+    switch (message.vcp_code) {
+    case VCP_BRIGHTNESS: setting = VcpSetting::Brightness; break;
+    case VCP_CONTRAST: setting = VcpSetting::Contrast; break;
+    case LG_INPUT_COMMAND: setting = VcpSetting::Input; break;
+    default:
+        ServerLogger::Log("DEBUG", "UDP control: unsupported VCP code 0x%02X", message.vcp_code);
+        return;
+    }
+
+    VcpWrite write;
+    if (!MakeVcpWrite(message.display_index, setting, message.value, write)) {
+        ServerLogger::Log("DEBUG", "UDP control: value %d out of range for VCP 0x%02X", message.value, message.vcp_code);
+        return;
+    }
+    g_thread_safe_control->WriteLatest(write);
+}
+
+void StartUdpControl(const ServerConfig& config)
+{
+    if (config.udp_port > 0) {
+        g_udp_control->Start(config.udp_host, config.udp_port);
+    }
+}
+
+// Automatic brightness from the ambient light sensor. Bulk lane, newest
+// value only: the user's own changes go first and a slow bus never backs up.
+void OnAmbientBrightness(int display_index, int brightness)
+{
+    VcpWrite write;
+    if (!MakeVcpWrite(display_index, VcpSetting::Brightness, brightness, write)) {
+        return;
+    }
+    write.lane = DisplayExecutor::Lane::Bulk;
+    g_thread_safe_control->WriteLatest(write);
+}
+
+void StartAmbientController(const ServerConfig& config)
+{
+    if (config.ambient.IsEnabled()) {
+        g_ambient_controller->Start(config.ambient);
+    }
+}
+
+// Gateway mode: /api/gateway/... fans requests out to other instances
+void StartGateway(const ServerConfig& config)
+{
+    if (config.gateway.IsEnabled()) {
+        g_gateway->Start(config.gateway);
+        ServerLogger::Log("INFO", "Gateway to %zu hosts, %d ms timeout per host", config.gateway.hosts.size(),
+                          config.gateway.timeout_ms);
+    }
+}
+
+// Reload presets or schedule rules after their file was edited (runs on the watcher thread)
+void OnConfigFileChanged(const ServerConfig& config, const std::string& path)
+{
+    if (path == config.presets_file) {
+        g_preset_manager.LoadFromFile(path);
+    }
+    if (path == config.schedule_file) {
+        g_rule_scheduler->LoadFromFile(path, config.latitude, config.longitude, config.has_location);
+    }
+}
+
+// Apply an edited config.env to the running components (runs on the watcher thread)
+void OnConfigChanged(const ServerConfig& old_config, const ServerConfig& new_config)
+{
+    ServerLogger::SetLevel(new_config.log_level);
+    g_thread_safe_control->SetDisplayGroups(new_config.display_groups);
+    g_thread_safe_control->SetConfigMacros(new_config.macros);
+
+    if (new_config.presets_file != old_config.presets_file) {
+        g_preset_manager.LoadFromFile(new_config.presets_file);
+    }
+
+    if (new_config.schedule_file != old_config.schedule_file ||
+        new_config.has_location != old_config.has_location ||
+        new_config.latitude != old_config.latitude ||
+        new_config.longitude != old_config.longitude) {
+        g_rule_scheduler->LoadFromFile(new_config.schedule_file, new_config.latitude,
+                                       new_config.longitude, new_config.has_location);
+    }
+
+    if (new_config.udp_host != old_config.udp_host || new_config.udp_port != old_config.udp_port) {
+        g_udp_control->Stop();
+        StartUdpControl(new_config);
+    }
+
+    if (new_config.ambient != old_config.ambient) {
+        g_ambient_controller->Stop();
+        StartAmbientController(new_config);
+    }
+
+    if (new_config.gateway != old_config.gateway) {
+        g_gateway->Stop();
+        StartGateway(new_config);
+    }
+
+    if (new_config.host != old_config.host || new_config.port != old_config.port ||
+        new_config.unix_socket != old_config.unix_socket || new_config.enabled != old_config.enabled) {
+        if (!new_config.enabled) {
+            ServerLogger::Log("INFO", "API_ENABLED turned off, stopping HTTP API server");
+            g_http_server->Stop();
+        } else if (!g_http_server->Restart(new_config)) {
+            ServerLogger::Log("ERROR", "HTTP API server failed to rebind to %s:%d",
+                              new_config.host.c_str(), new_config.port);
+        }
     }
 }
 
@@ -184,6 +373,7 @@ void SetInputSource(const char* input_name, BYTE input_value, BYTE command_code,
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
     // Create application window - sized for monitor control interface
+    StartupProfile::Timer window_timer(&g_startup_profile, "window and Direct3D");
     WNDCLASSEXW wc = { sizeof(wc), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(nullptr), nullptr, nullptr, nullptr, nullptr, L"Monitor Control", nullptr };
     ::RegisterClassExW(&wc);
     HWND hwnd = ::CreateWindowW(wc.lpszClassName, L"Monitor Control - NVidia API", WS_OVERLAPPEDWINDOW, 100, 100, 450, 360, nullptr, nullptr, wc.hInstance, nullptr);
@@ -199,8 +389,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     // Show the window
     ::ShowWindow(hwnd, SW_SHOWDEFAULT);
     ::UpdateWindow(hwnd);
+    window_timer.End();
 
     // Setup Dear ImGui context
+    StartupProfile::Timer imgui_timer(&g_startup_profile, "ImGui setup");
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -237,6 +429,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     // Setup Platform/Renderer backends
     ImGui_ImplWin32_Init(hwnd);
     ImGui_ImplDX11_Init(g_pd3dDevice, g_pd3dDeviceContext);
+    imgui_timer.End();
 
     // Initialize NVidia API
     g_app_state.nvapi_initialized = InitializeGUI();
@@ -244,18 +437,99 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     // Initialize HTTP API Server
     g_thread_safe_control = new ThreadSafeMonitorControl(&g_app_state);
 
-    ServerConfig server_config = ServerConfig::LoadConfig("config.env");
-    if (server_config.enabled) {
-        g_http_server = new HttpApiServer(g_thread_safe_control);
-        if (g_http_server->Start(server_config)) {
+    // config.env, the presets file and the schedule file are watched; edits are
+    // applied without restarting (see OnConfigChanged and OnConfigFileChanged)
+    StartupProfile::Timer config_timer(&g_startup_profile, "config load");
+    g_config_watcher = new ConfigWatcher("config.env");
+    std::shared_ptr<const ServerConfig> server_config = g_config_watcher->Current();
+    config_timer.End();
+    ServerLogger::SetLevel(server_config->log_level);
+    StartupProfile::Timer presets_timer(&g_startup_profile, "presets load");
+    g_preset_manager.LoadFromFile(server_config->presets_file);
+    presets_timer.End();
+    g_thread_safe_control->SetDisplayGroups(server_config->display_groups);
+    g_thread_safe_control->SetConfigMacros(server_config->macros);
+
+    // Before anything talks to a monitor, so every display's queue is created
+    // with its model's input-switch quirks. The database is only needed here.
+    {
+        StartupProfile::Timer profiles_timer(&g_startup_profile, "monitor profiles and EDID");
+        MonitorProfileDb profile_db;
+        std::string profile_error;
+        if (!server_config->profile_db.empty() && !profile_db.Open(server_config->profile_db, profile_error)) {
+            ServerLogger::Log("WARN", "Monitor profiles: %s; using the built-in profile", profile_error.c_str());
+        }
+        int matched = g_thread_safe_control->IdentifyDisplays(profile_db);
+        ServerLogger::Log("INFO", "Monitor profiles: %d of %d displays matched (%zu profiles in database)",
+                          matched, g_thread_safe_control->GetDisplayCount(), profile_db.GetProfileCount());
+    }
+
+    // Before anything talks to a monitor, so every display's queue records
+    if (!server_config->ddc_record_file.empty()) {
+        bool recording = g_thread_safe_control->StartRecording(server_config->ddc_record_file);
+        ServerLogger::Log(recording ? "INFO" : "ERROR", "DDC transaction recording to %s %s",
+                          server_config->ddc_record_file.c_str(), recording ? "started" : "failed to start");
+    }
+
+    // Show the last known settings at once instead of guessing; the displays
+    // are read back in the background and each value read replaces its
+    // restored one (until then GET /api/status lists it as unverified)
+    if (!server_config->state_file.empty()) {
+        StartupProfile::Timer state_timer(&g_startup_profile, "state restore");
+        std::string state_error;
+        int restored = g_thread_safe_control->RestoreState(server_config->state_file, state_error);
+        state_timer.End(restored >= 0, restored >= 0 ? std::to_string(restored) + " displays" : state_error);
+        if (restored >= 0) {
+            int reads = g_thread_safe_control->RefreshState();
+            ServerLogger::Log("INFO", "State: %d displays restored from %s, %d reads queued to confirm them",
+                              restored, server_config->state_file.c_str(), reads);
+        } else {
+            ServerLogger::Log("WARN", "State: %s; settings will not be kept across restarts", state_error.c_str());
+        }
+    }
+
+    // Time-based rules run in-process (replaces Task Scheduler + curl jobs)
+    StartupProfile::Timer rules_timer(&g_startup_profile, "rules load");
+    g_rule_scheduler = new RuleScheduler(g_thread_safe_control, &g_preset_manager);
+    g_rule_scheduler->LoadFromFile(server_config->schedule_file, server_config->latitude,
+                                   server_config->longitude, server_config->has_location);
+    g_rule_scheduler->Start();
+    rules_timer.End();
+
+    StartupProfile::Timer udp_timer(&g_startup_profile, "UDP and ambient start");
+    g_udp_control = new UdpControlServer(OnUdpControlMessage);
+    StartUdpControl(*server_config);
+
+    g_ambient_controller = new AmbientController(OnAmbientBrightness);
+    StartAmbientController(*server_config);
+    udp_timer.End();
+
+    // Links to the hosts are opened on first use, so this does not wait on the network
+    g_gateway = new MonitorGateway();
+    StartGateway(*server_config);
+
+    // Created even when disabled so a later API_ENABLED=true can start it
+    g_http_server = new HttpApiServer(g_thread_safe_control, &g_preset_manager, g_rule_scheduler, g_udp_control,
+                                      g_ambient_controller, g_gateway, &g_startup_profile);
+    if (server_config->enabled) {
+        StartupProfile::Timer http_timer(&g_startup_profile, "HTTP start");
+        bool started = g_http_server->Start(*server_config);
+        http_timer.End(started);
+        if (started) {
             snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
                     "HTTP API listening on %s:%d",
-                    server_config.host.c_str(), server_config.port);
+                    server_config->host.c_str(), server_config->port);
+        } else if (g_http_server->IsRunning()) {
+            snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
+                    "HTTP API on %s only (TCP bind failed)",
+                    server_config->unix_socket.c_str());
         } else {
             snprintf(g_app_state.status_message, sizeof(g_app_state.status_message),
                     "Failed to start HTTP API server");
         }
     }
+    g_config_watcher->Start(OnConfigChanged, OnConfigFileChanged);
+    LogStartupProfile();
 
     // Our state
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
@@ -313,13 +587,23 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                                return true;
                            }, nullptr, g_app_state.display_count)) {
                 SelectGUIDisplay(g_app_state.selected_display);
+                g_thread_safe_control->NotifyStateChanged();
             }
             ImGui::Separator();
         }
 
         if (g_app_state.nvapi_initialized) {
+            std::vector<VcpSetting> unverified = g_thread_safe_control->GetUnverifiedSettings(g_app_state.selected_display);
+            auto is_unverified = [&unverified](VcpSetting setting) {
+                return std::find(unverified.begin(), unverified.end(), setting) != unverified.end();
+            };
+
             // Brightness control
             ImGui::Text("Brightness:");
+            if (is_unverified(VcpSetting::Brightness)) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(last known)");
+            }
             if (ImGui::SliderFloat("##brightness", &g_app_state.brightness, 0.0f, 100.0f, "%.0f%%")) {
                 SetBrightness(g_app_state.brightness);
             }
@@ -328,6 +612,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
             // Contrast control
             ImGui::Text("Contrast:");
+            if (is_unverified(VcpSetting::Contrast)) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(last known)");
+            }
             if (ImGui::SliderFloat("##contrast", &g_app_state.contrast, 0.0f, 100.0f, "%.0f%%")) {
                 SetContrast(g_app_state.contrast);
             }
@@ -336,45 +624,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
             // Quick presets
             ImGui::Text("Quick Presets:");
-            if (ImGui::Button("Bright")) {
-                g_app_state.brightness = 100.0f;
-                g_app_state.contrast = 75.0f;
-                SetBrightness(g_app_state.brightness);
-                SetContrast(g_app_state.contrast);
-            }
-            ImGui::SameLine();
-            if (ImGui::Button("Normal")) {
-                g_app_state.brightness = 75.0f;
-                g_app_state.contrast = 50.0f;
-                SetBrightness(g_app_state.brightness);
-                SetContrast(g_app_state.contrast);
-            }
-            ImGui::SameLine();
-            if (ImGui::Button("Dark")) {
-                g_app_state.brightness = 20.0f;
-                g_app_state.contrast = 40.0f;
-                SetBrightness(g_app_state.brightness);
-                SetContrast(g_app_state.contrast);
+            for (int i = 0; i < QUICK_PRESET_COUNT; i++) {
+                const QuickPreset& preset = QUICK_PRESETS[i];
+                if (i > 0) ImGui::SameLine();
+                if (ImGui::Button(preset.name)) {
+                    ApplyQuickPreset(preset);
+                }
             }
 
             ImGui::Separator();
 
-            // Input source selection (LG Ultragear specific)
-            ImGui::Text("Input Source (LG Ultragear):");
-            if (ImGui::Button("HDMI 1")) {
-                SetInputSource("HDMI 1", 0x90, 0xF4, 0x50);  // LG specific: HDMI 1
-            }
-            ImGui::SameLine();
-            if (ImGui::Button("HDMI 2")) {
-                SetInputSource("HDMI 2", 0x91, 0xF4, 0x50);  // LG specific: HDMI 2 (estimated)
-            }
-            
-            if (ImGui::Button("DisplayPort")) {
-                SetInputSource("DisplayPort", 0xD0, 0xF4, 0x50);  // LG specific: DisplayPort
-            }
-            ImGui::SameLine();
-            if (ImGui::Button("USB-C")) {
-                SetInputSource("USB-C", 0xD1, 0xF4, 0x50);  // LG specific: USB-C (estimated)
+            // Input source selection from the display's profile, two buttons per row
+            std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(g_app_state.selected_display);
+            ImGui::Text("Input Source (%s):", profile->model);
+            for (int i = 0; i < profile->input_count; i++) {
+                if (i % 2 == 1) ImGui::SameLine();
+                if (ImGui::Button(profile->inputs[i].name)) {
+                    SetInputSource(i + 1, profile->inputs[i].name);
+                }
             }
         } else {
             ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.5f, 1.0f), "NVidia API not initialized!");
@@ -385,7 +652,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         }
 
         ImGui::Separator();
-        ImGui::Text("Status: %s", g_app_state.status_message);
+        ImGui::Text("Status: %s", g_thread_safe_control->GetStatusMessage().c_str());   // Set from executor threads
 
         // API server status indicator
         ImGui::SameLine();
@@ -407,17 +674,48 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         g_pSwapChain->Present(1, 0); // Present with vsync
     }
 
-    // Cleanup HTTP API Server
-    if (g_http_server) {
-        g_http_server->Stop();
-        delete g_http_server;
-        g_http_server = nullptr;
-    }
-    if (g_thread_safe_control) {
-        delete g_thread_safe_control;
-        g_thread_safe_control = nullptr;
+    // Shutdown: stop every command source, give queued monitor writes up to
+    // SHUTDOWN_TIMEOUT_MS to finish, fail the rest, then join all threads.
+    // Objects are deleted only after the HTTP handlers that use them are joined.
+    auto shutdown_start = std::chrono::steady_clock::now();
+    int shutdown_timeout_ms = g_config_watcher->Current()->shutdown_timeout_ms;
+    ServerLogger::Log("INFO", "Shutting down (deadline %d ms)", shutdown_timeout_ms);
+
+    g_config_watcher->Stop();
+    g_http_server->StopAccepting();
+    g_udp_control->Stop();
+    g_ambient_controller->Stop();
+    g_gateway->Stop();      // Fan-outs in progress get their remaining hosts failed
+    g_rule_scheduler->Stop();
+
+    ShutdownReport report = g_thread_safe_control->Shutdown(shutdown_timeout_ms);
+    ServerLogger::Log(report.met_deadline ? "INFO" : "WARN",
+                      "Display queues stopped: %d displays, %llu queued commands failed, %d ms%s",
+                      report.displays, (unsigned long long)report.failed_commands, report.elapsed_ms,
+                      report.met_deadline ? "" : " (a bus transaction outlived the deadline)");
+    if (report.abandoned > 0) {
+        ServerLogger::Log("WARN", "%d display queue(s) still inside a bus transaction were abandoned", report.abandoned);
     }
 
+    g_http_server->Stop();
+    ServerLogger::Log("INFO", "Shutdown complete in %.0f ms",
+                      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shutdown_start).count());
+
+    delete g_http_server;
+    g_http_server = nullptr;
+    delete g_udp_control;
+    g_udp_control = nullptr;
+    delete g_ambient_controller;
+    g_ambient_controller = nullptr;
+    delete g_gateway;
+    g_gateway = nullptr;
+    delete g_rule_scheduler;
+    g_rule_scheduler = nullptr;
+    delete g_config_watcher;
+    g_config_watcher = nullptr;
+    delete g_thread_safe_control;
+    g_thread_safe_control = nullptr;
+
     // Cleanup
     ImGui_ImplDX11_Shutdown();
     ImGui_ImplWin32_Shutdown();
@@ -0,0 +1,362 @@
+#include "httplib.h"
+#include "monitor_gateway.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static std::string Trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+}
+
+static int MillisecondsSince(Clock::time_point start) {
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+}
+
+bool ParseGatewayHosts(const std::string& text, std::vector<GatewayHost>& hosts, std::string& error) {
+    hosts.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        std::string entry = Trim(text.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        start = comma == std::string::npos ? text.size() + 1 : comma + 1;
+        if (entry.empty()) {
+            continue;
+        }
+
+        // Names and IPv4 addresses; IPv6 literals are not supported
+        GatewayHost host;
+        size_t colon = entry.find(':');
+        host.host = entry.substr(0, colon);
+        bool valid = !host.host.empty() && std::all_of(host.host.begin(), host.host.end(), [](unsigned char c) {
+            return std::isalnum(c) || c == '.' || c == '-' || c == '_';
+        });
+        if (valid && colon != std::string::npos) {
+            std::string port = entry.substr(colon + 1);
+            valid = !port.empty() && port.size() <= 5 && std::all_of(port.begin(), port.end(), ::isdigit);
+            host.port = valid ? std::stoi(port) : 0;
+            valid = valid && host.port >= 1 && host.port <= 65535;
+        }
+        if (!valid) {
+            error = "'" + entry + "' is not <host>[:<port>]";
+            return false;
+        }
+        host.name = host.host + ":" + std::to_string(host.port);
+        if (std::find(hosts.begin(), hosts.end(), host) != hosts.end()) {
+            error = host.name + " is listed twice";
+            return false;
+        }
+        hosts.push_back(host);
+    }
+    return true;
+}
+
+// Worker thread and kept-alive connection of one host
+class MonitorGateway::HostLink {
+public:
+    using Done = std::function<void(const GatewayReply& reply)>;
+
+    explicit HostLink(const GatewayHost& host);
+    ~HostLink();
+
+    HostLink(const HostLink&) = delete;
+    HostLink& operator=(const HostLink&) = delete;
+
+    const GatewayHost& GetHost() const { return host; }
+
+    // Queue a request; done runs once, on the worker (or at once if stopped)
+    void Submit(const GatewayRequest& request, Clock::time_point start, Clock::time_point deadline, Done done);
+
+    // Fail queued requests, cut the one in progress short and join the worker
+    void Stop();
+
+    GatewayHostStats GetStats();
+
+private:
+    struct Job {
+        GatewayRequest request;
+        Clock::time_point start;        // Of the fan-out, for elapsed_ms
+        Clock::time_point deadline;
+        Done done;
+    };
+
+    void WorkerThreadFunc();
+    GatewayReply Send(const Job& job);
+
+    GatewayHost host;
+    httplib::Client client;             // Used by the worker only, except stop()
+
+    std::mutex link_mutex;
+    std::condition_variable link_cv;
+    std::deque<Job> jobs;
+    bool stopping;
+    GatewayHostStats stats;             // Guarded by link_mutex
+    std::thread worker;
+};
+
+MonitorGateway::HostLink::HostLink(const GatewayHost& host)
+    : host(host), client(host.host, host.port), stopping(false) {
+    client.set_keep_alive(true);
+    // Without this, Nagle + delayed ACK add ~40 ms to every kept-alive request
+    client.set_tcp_nodelay(true);
+    stats.host = host.name;
+    worker = std::thread(&HostLink::WorkerThreadFunc, this);
+}
+
+MonitorGateway::HostLink::~HostLink() {
+    Stop();
+}
+
+void MonitorGateway::HostLink::Submit(const GatewayRequest& request, Clock::time_point start,
+                                      Clock::time_point deadline, Done done) {
+    {
+        std::lock_guard<std::mutex> lock(link_mutex);
+        if (!stopping) {
+            jobs.push_back(Job{ request, start, deadline, std::move(done) });
+            link_cv.notify_one();
+            return;
+        }
+    }
+    GatewayReply reply;
+    reply.host = host.name;
+    reply.error = "gateway stopped";
+    done(reply);
+}
+
+void MonitorGateway::HostLink::Stop() {
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(link_mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+        dropped.swap(jobs);
+    }
+    link_cv.notify_all();
+    client.stop();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    for (Job& job : dropped) {
+        GatewayReply reply;
+        reply.host = host.name;
+        reply.error = "gateway stopped";
+        job.done(reply);
+    }
+}
+
+GatewayHostStats MonitorGateway::HostLink::GetStats() {
+    std::lock_guard<std::mutex> lock(link_mutex);
+    GatewayHostStats current = stats;
+    current.queued = static_cast<int>(jobs.size());
+    return current;
+}
+
+void MonitorGateway::HostLink::WorkerThreadFunc() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(link_mutex);
+            link_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;     // Stop() fails what is left in the queue
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        GatewayReply reply = Send(job);
+        {
+            std::lock_guard<std::mutex> lock(link_mutex);
+            stats.requests++;
+            stats.connected = client.is_socket_open() != 0;
+            stats.last_elapsed_ms = reply.elapsed_ms;
+            if (reply.status == 0) {
+                stats.failures++;
+                stats.timeouts += reply.timed_out ? 1 : 0;
+                stats.consecutive_failures++;
+                stats.last_error = reply.error;
+            } else {
+                stats.consecutive_failures = 0;
+            }
+        }
+        job.done(reply);
+    }
+}
+
+GatewayReply MonitorGateway::HostLink::Send(const Job& job) {
+    GatewayReply reply;
+    reply.host = host.name;
+
+    // Requests ahead of this one on the link may have used up its time
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(job.deadline - Clock::now());
+    if (remaining.count() <= 0) {
+        reply.timed_out = true;
+        reply.error = "not sent: earlier requests to this host took the whole timeout";
+        reply.elapsed_ms = MillisecondsSince(job.start);
+        return reply;
+    }
+    client.set_connection_timeout(remaining);
+    client.set_read_timeout(remaining);
+    client.set_write_timeout(remaining);
+
+    httplib::Request request;
+    request.method = job.request.method;
+    request.path = job.request.path;
+    request.body = job.request.body;
+    for (const auto& header : job.request.headers) {
+        request.set_header(header.first, header.second);
+    }
+    if (!job.request.body.empty()) {
+        request.set_header("Content-Type", job.request.content_type);
+    }
+    request.set_header("X-Deadline-Ms", std::to_string(remaining.count()));
+
+    httplib::Result result = client.send(request);
+    reply.elapsed_ms = MillisecondsSince(job.start);
+    if (result) {
+        reply.status = result->status;
+        reply.body = result->body;
+        return reply;
+    }
+
+    httplib::Error error = result.error();
+    reply.timed_out = error == httplib::Error::ConnectionTimeout ||
+                      ((error == httplib::Error::Read || error == httplib::Error::Write) &&
+                       Clock::now() + std::chrono::milliseconds(10) >= job.deadline);
+    reply.error = reply.timed_out ? "no reply within " + std::to_string(remaining.count()) + " ms"
+                                  : httplib::to_string(error);
+    return reply;
+}
+
+MonitorGateway::MonitorGateway() {
+}
+
+MonitorGateway::~MonitorGateway() {
+    Stop();
+}
+
+bool MonitorGateway::Start(const GatewaySettings& new_settings) {
+    Stop();
+    if (!new_settings.IsEnabled()) {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<HostLink>> new_links;
+    for (const GatewayHost& host : new_settings.hosts) {
+        new_links.push_back(std::make_shared<HostLink>(host));
+    }
+    std::lock_guard<std::mutex> lock(gateway_mutex);
+    settings = new_settings;
+    links = std::move(new_links);
+    return true;
+}
+
+void MonitorGateway::Stop() {
+    std::vector<std::shared_ptr<HostLink>> old_links;
+    {
+        std::lock_guard<std::mutex> lock(gateway_mutex);
+        old_links.swap(links);
+        settings = GatewaySettings();
+    }
+    // A fan-out still holding a link gets "gateway stopped" from it
+    for (const auto& link : old_links) {
+        link->Stop();
+    }
+}
+
+bool MonitorGateway::IsRunning() {
+    std::lock_guard<std::mutex> lock(gateway_mutex);
+    return !links.empty();
+}
+
+GatewaySettings MonitorGateway::GetSettings() {
+    std::lock_guard<std::mutex> lock(gateway_mutex);
+    return settings;
+}
+
+std::vector<GatewayReply> MonitorGateway::FanOut(const GatewayRequest& request) {
+    std::vector<std::shared_ptr<HostLink>> targets;
+    std::vector<GatewayReply> unknown;
+    int timeout_ms;
+    {
+        std::lock_guard<std::mutex> lock(gateway_mutex);
+        timeout_ms = request.timeout_ms > 0 ? request.timeout_ms : settings.timeout_ms;
+
+        std::vector<bool> selected(links.size(), request.hosts.empty());
+        for (const std::string& name : request.hosts) {
+            bool found = false;
+            for (size_t i = 0; i < links.size(); i++) {
+                const GatewayHost& host = links[i]->GetHost();
+                if (name == host.name || name == host.host) {
+                    selected[i] = true;
+                    found = true;
+                }
+            }
+            if (!found) {
+                GatewayReply reply;
+                reply.host = name;
+                reply.error = "not a gateway host";
+                unknown.push_back(reply);
+            }
+        }
+        for (size_t i = 0; i < links.size(); i++) {
+            if (selected[i]) {
+                targets.push_back(links[i]);
+            }
+        }
+    }
+    timeout_ms = std::min(std::max(timeout_ms, 1), GATEWAY_MAX_TIMEOUT_MS);
+
+    // Queue on every link before waiting on any, so the hosts work in parallel
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::milliseconds(timeout_ms);
+    std::vector<std::future<GatewayReply>> futures;
+    for (const auto& link : targets) {
+        auto promise = std::make_shared<std::promise<GatewayReply>>();
+        futures.push_back(promise->get_future());
+        link->Submit(request, start, deadline, [promise](const GatewayReply& reply) {
+            promise->set_value(reply);
+        });
+    }
+
+    std::vector<GatewayReply> replies;
+    for (size_t i = 0; i < futures.size(); i++) {
+        if (futures[i].wait_until(deadline + std::chrono::milliseconds(GATEWAY_REPLY_GRACE_MS)) ==
+            std::future_status::ready) {
+            replies.push_back(futures[i].get());
+        } else {
+            GatewayReply reply;
+            reply.host = targets[i]->GetHost().name;
+            reply.timed_out = true;
+            reply.error = "no reply within " + std::to_string(timeout_ms) + " ms";
+            reply.elapsed_ms = MillisecondsSince(start);
+            replies.push_back(reply);
+        }
+    }
+    replies.insert(replies.end(), unknown.begin(), unknown.end());
+    return replies;
+}
+
+std::vector<GatewayHostStats> MonitorGateway::GetHostStats() {
+    std::vector<std::shared_ptr<HostLink>> current;
+    {
+        std::lock_guard<std::mutex> lock(gateway_mutex);
+        current = links;
+    }
+    std::vector<GatewayHostStats> stats;
+    for (const auto& link : current) {
+        stats.push_back(link->GetStats());
+    }
+    return stats;
+}
@@ -0,0 +1,521 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "monitor_profiles.h"
+#include "config_parser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+std::mutex DisplayProfiles::profiles_mutex;
+std::vector<std::shared_ptr<const MonitorProfile>> DisplayProfiles::profiles;
+
+static void PutLe(uint8_t* out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint32_t GetLe(const uint8_t* in, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+// Copy into a fixed-size, NUL-terminated field
+static void CopyName(char* out, size_t size, const char* text) {
+    strncpy(out, text, size - 1);
+    out[size - 1] = '\0';
+}
+
+static uint32_t ProfileKey(uint16_t manufacturer, uint16_t product) {
+    return (static_cast<uint32_t>(manufacturer) << 16) | product;
+}
+
+static uint32_t BucketHash(uint32_t key) {
+    key ^= key >> 16;
+    key *= 0x45D9F3Bu;
+    key ^= key >> 16;
+    return key;
+}
+
+// Record layout (PROFILE_RECORD_SIZE bytes):
+//   0 u16 manufacturer, 2 u16 product, 4 char model[32],
+//   36 u8 input register, 37 u8 input code, 38 u8 input count, 39 reserved,
+//   40 u16 brightness min, 42 u16 brightness max, 44 u16 contrast min, 46 u16 contrast max,
+//   48 u16 input quiet ms, 50 reserved[2],
+//   52 inputs[8]: char name[15], u8 value
+static void EncodeProfile(const MonitorProfile& profile, uint8_t* out) {
+    memset(out, 0, PROFILE_RECORD_SIZE);
+    PutLe(out, profile.manufacturer, 2);
+    PutLe(out + 2, profile.product, 2);
+    memcpy(out + 4, profile.model, PROFILE_MODEL_SIZE - 1);
+    out[36] = profile.input_register;
+    out[37] = profile.input_code;
+    out[38] = static_cast<uint8_t>(profile.input_count);
+    PutLe(out + 40, profile.brightness_min, 2);
+    PutLe(out + 42, profile.brightness_max, 2);
+    PutLe(out + 44, profile.contrast_min, 2);
+    PutLe(out + 46, profile.contrast_max, 2);
+    PutLe(out + 48, profile.input_quiet_ms, 2);
+    for (int i = 0; i < profile.input_count; i++) {
+        uint8_t* input = out + 52 + i * (PROFILE_INPUT_NAME_SIZE + 1);
+        memcpy(input, profile.inputs[i].name, PROFILE_INPUT_NAME_SIZE);
+        input[PROFILE_INPUT_NAME_SIZE] = profile.inputs[i].value;
+    }
+}
+
+static void DecodeProfile(const uint8_t* in, MonitorProfile& profile) {
+    profile = MonitorProfile();
+    profile.manufacturer = static_cast<uint16_t>(GetLe(in, 2));
+    profile.product = static_cast<uint16_t>(GetLe(in + 2, 2));
+    memcpy(profile.model, in + 4, PROFILE_MODEL_SIZE - 1);
+    profile.input_register = in[36];
+    profile.input_code = in[37];
+    profile.input_count = std::min<int>(in[38], MAX_PROFILE_INPUTS);
+    profile.brightness_min = static_cast<uint16_t>(GetLe(in + 40, 2));
+    profile.brightness_max = static_cast<uint16_t>(GetLe(in + 42, 2));
+    profile.contrast_min = static_cast<uint16_t>(GetLe(in + 44, 2));
+    profile.contrast_max = static_cast<uint16_t>(GetLe(in + 46, 2));
+    profile.input_quiet_ms = static_cast<uint16_t>(GetLe(in + 48, 2));
+    for (int i = 0; i < profile.input_count; i++) {
+        const uint8_t* input = in + 52 + i * (PROFILE_INPUT_NAME_SIZE + 1);
+        memcpy(profile.inputs[i].name, input, PROFILE_INPUT_NAME_SIZE);
+        profile.inputs[i].value = input[PROFILE_INPUT_NAME_SIZE];
+    }
+}
+
+const ProfileInput* MonitorProfile::FindInput(int api_value) const {
+    return (api_value >= 1 && api_value <= input_count) ? &inputs[api_value - 1] : nullptr;
+}
+
+int MonitorProfile::FindApiValue(uint16_t raw_value) const {
+    for (int i = 0; i < input_count; i++) {
+        if (inputs[i].value == raw_value) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+const MonitorProfile& BuiltInMonitorProfile() {
+    static const MonitorProfile profile = []() {
+        MonitorProfile built_in;
+        CopyName(built_in.model, sizeof(built_in.model), "LG Ultragear (built-in)");
+        built_in.input_count = INPUT_SOURCE_COUNT;
+        for (int i = 0; i < INPUT_SOURCE_COUNT; i++) {
+            CopyName(built_in.inputs[i].name, sizeof(built_in.inputs[i].name), INPUT_SOURCES[i].name);
+            built_in.inputs[i].value = INPUT_SOURCES[i].input_value;
+        }
+        return built_in;
+    }();
+    return profile;
+}
+
+bool ParseEdidId(const uint8_t* edid, size_t size, EdidId& id) {
+    static const uint8_t EDID_HEADER[8] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+    if (size < 128 || memcmp(edid, EDID_HEADER, sizeof(EDID_HEADER)) != 0) {
+        return false;
+    }
+    id.manufacturer = static_cast<uint16_t>((edid[8] << 8) | edid[9]);    // Big-endian
+    id.product = static_cast<uint16_t>(edid[10] | (edid[11] << 8));      // Little-endian
+    return true;
+}
+
+std::string ManufacturerCode(uint16_t manufacturer) {
+    std::string code(3, '?');
+    for (int i = 0; i < 3; i++) {
+        int letter = (manufacturer >> (10 - 5 * i)) & 0x1F;
+        if (letter >= 1 && letter <= 26) {
+            code[i] = static_cast<char>('A' + letter - 1);
+        }
+    }
+    return code;
+}
+
+bool ParseManufacturerCode(const std::string& code, uint16_t& manufacturer) {
+    if (code.size() != 3) {
+        return false;
+    }
+    manufacturer = 0;
+    for (char c : code) {
+        if (c < 'A' || c > 'Z') {
+            return false;
+        }
+        manufacturer = static_cast<uint16_t>((manufacturer << 5) | (c - 'A' + 1));
+    }
+    return true;
+}
+
+std::string FormatEdidId(uint16_t manufacturer, uint16_t product) {
+    if (product == MONITOR_PROFILE_ANY_PRODUCT) {
+        return ManufacturerCode(manufacturer) + ":*";
+    }
+    char text[16];
+    snprintf(text, sizeof(text), "%s:%04X", ManufacturerCode(manufacturer).c_str(), product);
+    return text;
+}
+
+static bool ParseNumber(const std::string& text, unsigned long maximum, unsigned long& value) {
+    try {
+        size_t used = 0;
+        value = std::stoul(text, &used, 0);
+        return text.find_first_not_of(" \t", used) == std::string::npos && value <= maximum;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool ParseRange(const std::string& text, uint16_t& minimum, uint16_t& maximum) {
+    size_t dash = text.find('-');
+    unsigned long low, high;
+    if (dash == std::string::npos || !ParseNumber(text.substr(0, dash), 0xFFFF, low) ||
+        !ParseNumber(text.substr(dash + 1), 0xFFFF, high) || low >= high) {
+        return false;
+    }
+    minimum = static_cast<uint16_t>(low);
+    maximum = static_cast<uint16_t>(high);
+    return true;
+}
+
+static std::string Trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    return text.substr(start, text.find_last_not_of(" \t") - start + 1);
+}
+
+// Names end up in JSON responses and GUI labels unescaped
+static bool IsPlainName(const std::string& name) {
+    return name.find_first_of("\"\\") == std::string::npos &&
+           std::all_of(name.begin(), name.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x20; });
+}
+
+// "HDMI 1:0x90, DisplayPort:0xD0"
+static bool ParseInputs(const std::string& text, MonitorProfile& profile) {
+    profile.input_count = 0;
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        size_t colon = item.rfind(':');
+        unsigned long value;
+        if (colon == std::string::npos || profile.input_count == MAX_PROFILE_INPUTS ||
+            !ParseNumber(item.substr(colon + 1), 0xFF, value)) {
+            return false;
+        }
+        std::string name = Trim(item.substr(0, colon));
+        if (name.empty() || name.size() > PROFILE_INPUT_NAME_SIZE || !IsPlainName(name) ||
+            profile.FindApiValue(value) != 0) {
+            return false;
+        }
+        ProfileInput& input = profile.inputs[profile.input_count++];
+        CopyName(input.name, sizeof(input.name), name.c_str());
+        input.value = static_cast<uint8_t>(value);
+    }
+    return profile.input_count > 0;
+}
+
+static bool ParseProfileEdid(const std::string& text, MonitorProfile& profile) {
+    size_t colon = text.find(':');
+    unsigned long product;
+    if (colon == std::string::npos || !ParseManufacturerCode(text.substr(0, colon), profile.manufacturer)) {
+        return false;
+    }
+    std::string product_text = text.substr(colon + 1);
+    if (product_text == "*") {
+        profile.product = MONITOR_PROFILE_ANY_PRODUCT;
+        return true;
+    }
+    // Product codes are written in hex, as tools and /api/profiles show them
+    if (!ParseNumber("0x" + product_text, 0xFFFE, product)) {
+        return false;
+    }
+    profile.product = static_cast<uint16_t>(product);
+    return true;
+}
+
+static bool ParseProfileField(const std::string& field, const std::string& value, MonitorProfile& profile,
+                              bool& has_edid) {
+    unsigned long number;
+    if (field == "edid") {
+        has_edid = ParseProfileEdid(value, profile);
+        return has_edid;
+    }
+    if (field == "model") {
+        if (value.empty() || value.size() >= PROFILE_MODEL_SIZE || !IsPlainName(value)) {
+            return false;
+        }
+        CopyName(profile.model, sizeof(profile.model), value.c_str());
+        return true;
+    }
+    if (field == "input_register" && ParseNumber(value, 0xFF, number)) {
+        profile.input_register = static_cast<uint8_t>(number);
+        return true;
+    }
+    if (field == "input_code" && ParseNumber(value, 0xFF, number)) {
+        profile.input_code = static_cast<uint8_t>(number);
+        return true;
+    }
+    if (field == "input_quiet_ms" && ParseNumber(value, 0xFFFF, number)) {
+        profile.input_quiet_ms = static_cast<uint16_t>(number);
+        return true;
+    }
+    if (field == "inputs") {
+        return ParseInputs(value, profile);
+    }
+    if (field == "brightness") {
+        return ParseRange(value, profile.brightness_min, profile.brightness_max);
+    }
+    if (field == "contrast") {
+        return ParseRange(value, profile.contrast_min, profile.contrast_max);
+    }
+    return false;
+}
+
+bool LoadProfileSource(const std::string& path, std::vector<MonitorProfile>& profiles, std::string& error) {
+    profiles.clear();
+    ConfigParser parser;
+    if (!parser.LoadFromFile(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    // Unset fields keep the built-in values
+    std::map<std::string, MonitorProfile> by_id;
+    std::map<std::string, bool> has_edid;
+    for (const std::string& key : parser.GetKeys()) {
+        size_t dot = key.find('.');
+        if (dot == std::string::npos || dot == 0) {
+            error = key + ": expected <id>.<field>";
+            return false;
+        }
+        std::string id = key.substr(0, dot);
+        if (!std::all_of(id.begin(), id.end(), [](char c) {
+                return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+            })) {
+            error = key + ": profile ids may only contain letters, digits, '-' and '_'";
+            return false;
+        }
+        if (by_id.find(id) == by_id.end()) {
+            by_id[id] = BuiltInMonitorProfile();
+            by_id[id].model[0] = '\0';
+            has_edid[id] = false;
+        }
+        if (!ParseProfileField(key.substr(dot + 1), parser.GetString(key), by_id[id], has_edid[id])) {
+            error = key + ": invalid value \"" + parser.GetString(key) + "\"";
+            return false;
+        }
+    }
+
+    for (auto& entry : by_id) {
+        if (!has_edid[entry.first]) {
+            error = entry.first + ": missing " + entry.first + ".edid";
+            return false;
+        }
+        if (entry.second.model[0] == '\0') {
+            CopyName(entry.second.model, sizeof(entry.second.model), entry.first.c_str());
+        }
+        profiles.push_back(entry.second);
+    }
+    return true;
+}
+
+bool WriteProfileDb(const std::string& path, const std::vector<MonitorProfile>& profiles, std::string& error) {
+    // At most half full, so a probe sequence stays short
+    uint32_t bucket_count = 2;
+    while (bucket_count < profiles.size() * 2) {
+        bucket_count *= 2;
+    }
+    std::vector<uint32_t> buckets(bucket_count, 0);
+    for (size_t i = 0; i < profiles.size(); i++) {
+        uint32_t key = ProfileKey(profiles[i].manufacturer, profiles[i].product);
+        uint32_t bucket = BucketHash(key) & (bucket_count - 1);
+        while (buckets[bucket] != 0) {
+            const MonitorProfile& other = profiles[buckets[bucket] - 1];
+            if (ProfileKey(other.manufacturer, other.product) == key) {
+                error = "two profiles for " + FormatEdidId(other.manufacturer, other.product) + " (" +
+                        other.model + ", " + profiles[i].model + ")";
+                return false;
+            }
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        buckets[bucket] = static_cast<uint32_t>(i + 1);
+    }
+
+    std::vector<uint8_t> bytes(PROFILE_DB_HEADER_SIZE + bucket_count * 4 + profiles.size() * PROFILE_RECORD_SIZE, 0);
+    memcpy(bytes.data(), PROFILE_DB_MAGIC, sizeof(PROFILE_DB_MAGIC));
+    PutLe(&bytes[8], PROFILE_DB_VERSION, 4);
+    PutLe(&bytes[12], PROFILE_RECORD_SIZE, 4);
+    PutLe(&bytes[16], bucket_count, 4);
+    PutLe(&bytes[20], static_cast<uint32_t>(profiles.size()), 4);
+    for (uint32_t i = 0; i < bucket_count; i++) {
+        PutLe(&bytes[PROFILE_DB_HEADER_SIZE + i * 4], buckets[i], 4);
+    }
+    uint8_t* records = &bytes[PROFILE_DB_HEADER_SIZE + bucket_count * 4];
+    for (size_t i = 0; i < profiles.size(); i++) {
+        EncodeProfile(profiles[i], records + i * PROFILE_RECORD_SIZE);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "cannot create " + path;
+        return false;
+    }
+    bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        error = "failed to write " + path;
+    }
+    return written;
+}
+
+MonitorProfileDb::MonitorProfileDb()
+    : data(nullptr), size(0), bucket_count(0), record_count(0)
+#ifdef _WIN32
+    , file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr)
+#endif
+{
+}
+
+MonitorProfileDb::~MonitorProfileDb() {
+    Close();
+}
+
+bool MonitorProfileDb::Open(const std::string& path, std::string& error) {
+    Close();
+
+#ifdef _WIN32
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        error = "cannot open " + path;
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    size = static_cast<size_t>(file_size.QuadPart);
+    mapping_handle = size > 0 ? CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (mapping_handle) {
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    size = static_cast<size_t>(file_stat.st_size);
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(mapped);
+    }
+    close(fd);
+#endif
+
+    if (!data || size < PROFILE_DB_HEADER_SIZE || memcmp(data, PROFILE_DB_MAGIC, sizeof(PROFILE_DB_MAGIC)) != 0) {
+        Close();
+        error = path + " is not a monitor profile database";
+        return false;
+    }
+    bucket_count = GetLe(data + 16, 4);
+    record_count = GetLe(data + 20, 4);
+    bool valid = GetLe(data + 8, 4) == PROFILE_DB_VERSION && GetLe(data + 12, 4) == PROFILE_RECORD_SIZE &&
+                 bucket_count != 0 && (bucket_count & (bucket_count - 1)) == 0 && record_count < bucket_count &&
+                 size >= PROFILE_DB_HEADER_SIZE + static_cast<size_t>(bucket_count) * 4 +
+                         static_cast<size_t>(record_count) * PROFILE_RECORD_SIZE;
+    if (!valid) {
+        Close();
+        error = path + " is damaged or was compiled by an incompatible version";
+        return false;
+    }
+    return true;
+}
+
+void MonitorProfileDb::Close() {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+        file_handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+    bucket_count = 0;
+    record_count = 0;
+}
+
+bool MonitorProfileDb::FindExact(uint32_t key, MonitorProfile& profile) const {
+    const uint8_t* buckets = data + PROFILE_DB_HEADER_SIZE;
+    const uint8_t* records = buckets + static_cast<size_t>(bucket_count) * 4;
+    uint32_t bucket = BucketHash(key) & (bucket_count - 1);
+    // The table is never full, so an empty bucket always ends the probe
+    for (uint32_t probes = 0; probes < bucket_count; probes++) {
+        uint32_t entry = GetLe(buckets + bucket * 4, 4);
+        if (entry == 0 || entry > record_count) {
+            return false;
+        }
+        const uint8_t* record = records + static_cast<size_t>(entry - 1) * PROFILE_RECORD_SIZE;
+        if (ProfileKey(static_cast<uint16_t>(GetLe(record, 2)), static_cast<uint16_t>(GetLe(record + 2, 2))) == key) {
+            DecodeProfile(record, profile);
+            return true;
+        }
+        bucket = (bucket + 1) & (bucket_count - 1);
+    }
+    return false;
+}
+
+bool MonitorProfileDb::Find(uint16_t manufacturer, uint16_t product, MonitorProfile& profile) const {
+    if (!data) {
+        return false;
+    }
+    return FindExact(ProfileKey(manufacturer, product), profile) ||
+           FindExact(ProfileKey(manufacturer, MONITOR_PROFILE_ANY_PRODUCT), profile);
+}
+
+void DisplayProfiles::Set(int display_index, const MonitorProfile& profile) {
+    if (display_index < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    if (profiles.size() <= static_cast<size_t>(display_index)) {
+        profiles.resize(display_index + 1);
+    }
+    profiles[display_index] = std::make_shared<const MonitorProfile>(profile);
+}
+
+std::shared_ptr<const MonitorProfile> DisplayProfiles::Get(int display_index) {
+    {
+        std::lock_guard<std::mutex> lock(profiles_mutex);
+        if (display_index >= 0 && static_cast<size_t>(display_index) < profiles.size() && profiles[display_index]) {
+            return profiles[display_index];
+        }
+    }
+    static const std::shared_ptr<const MonitorProfile> built_in =
+        std::make_shared<const MonitorProfile>(BuiltInMonitorProfile());
+    return built_in;
+}
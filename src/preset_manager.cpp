@@ -0,0 +1,237 @@
+#include "preset_manager.h"
+#include "config_parser.h"
+#include "vcp_commands.h"
+#include "monitor_profiles.h"
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+
+int DisplaySettings::Get(VcpSetting setting) const {
+    switch (setting) {
+    case VcpSetting::Brightness: return brightness;
+    case VcpSetting::Contrast:   return contrast;
+    case VcpSetting::Input:      return input;
+    }
+    return VCP_VALUE_UNSET;
+}
+
+void DisplaySettings::Set(VcpSetting setting, int value) {
+    switch (setting) {
+    case VcpSetting::Brightness: brightness = value; break;
+    case VcpSetting::Contrast:   contrast = value; break;
+    case VcpSetting::Input:      input = value; break;
+    }
+}
+
+bool DisplaySettings::IsEmpty() const {
+    return brightness == VCP_VALUE_UNSET && contrast == VCP_VALUE_UNSET && input == VCP_VALUE_UNSET;
+}
+
+static const char* SettingKey(VcpSetting setting) {
+    switch (setting) {
+    case VcpSetting::Brightness: return "brightness";
+    case VcpSetting::Contrast:   return "contrast";
+    case VcpSetting::Input:      return "input";
+    }
+    return "";
+}
+
+static bool ParseSettingKey(const std::string& key, VcpSetting& setting) {
+    const VcpSetting all[] = { VcpSetting::Brightness, VcpSetting::Contrast, VcpSetting::Input };
+    for (VcpSetting candidate : all) {
+        if (key == SettingKey(candidate)) {
+            setting = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Find or append the entry for a display
+static PresetEntry& EntryForDisplay(Preset& preset, int display_index) {
+    for (PresetEntry& entry : preset.displays) {
+        if (entry.display_index == display_index) {
+            return entry;
+        }
+    }
+    PresetEntry entry;
+    entry.display_index = display_index;
+    preset.displays.push_back(entry);
+    return preset.displays.back();
+}
+
+PresetManager::PresetManager() {
+}
+
+bool PresetManager::IsValidName(const std::string& name) {
+    if (name.empty() || name.length() > 64) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+    });
+}
+
+bool PresetManager::ValidatePreset(const Preset& preset, std::string& error) {
+    if (!IsValidName(preset.name)) {
+        error = "Preset name may only contain letters, digits, '-' and '_'";
+        return false;
+    }
+    if (preset.displays.empty()) {
+        error = "Preset has no display settings";
+        return false;
+    }
+    for (const PresetEntry& entry : preset.displays) {
+        const DisplaySettings& s = entry.settings;
+        if (entry.display_index < 0) {
+            error = "Display index must not be negative";
+            return false;
+        }
+        if ((s.brightness != VCP_VALUE_UNSET && (s.brightness < 0 || s.brightness > 100)) ||
+            (s.contrast != VCP_VALUE_UNSET && (s.contrast < 0 || s.contrast > 100))) {
+            error = "Brightness and contrast must be between 0 and 100";
+            return false;
+        }
+        // The display's profile decides which inputs exist; checked when the preset is applied
+        if (s.input != VCP_VALUE_UNSET && (s.input < 1 || s.input > MAX_PROFILE_INPUTS)) {
+            error = "Input must be between 1 and " + std::to_string(MAX_PROFILE_INPUTS);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PresetManager::LoadFromFile(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(presets_mutex);
+    file_path = filename;
+    presets.clear();
+
+    ConfigParser parser;
+    if (!parser.LoadFromFile(filename)) {
+        // No presets file yet - start from the GUI's built-in quick presets on display 0
+        for (int i = 0; i < QUICK_PRESET_COUNT; i++) {
+            Preset preset;
+            preset.name = QUICK_PRESETS[i].name;
+            std::transform(preset.name.begin(), preset.name.end(), preset.name.begin(), ::tolower);
+            PresetEntry& entry = EntryForDisplay(preset, 0);
+            entry.settings.brightness = QUICK_PRESETS[i].brightness;
+            entry.settings.contrast = QUICK_PRESETS[i].contrast;
+            presets[preset.name] = preset;
+        }
+        return false;
+    }
+
+    for (const std::string& key : parser.GetKeys()) {
+        // <name>.<display>.<setting>
+        size_t first_dot = key.find('.');
+        size_t second_dot = (first_dot == std::string::npos) ? std::string::npos : key.find('.', first_dot + 1);
+        if (second_dot == std::string::npos) {
+            continue; // Skip malformed keys
+        }
+
+        std::string name = key.substr(0, first_dot);
+        std::string display_str = key.substr(first_dot + 1, second_dot - first_dot - 1);
+        VcpSetting setting;
+        if (!IsValidName(name) || !ParseSettingKey(key.substr(second_dot + 1), setting)) {
+            continue;
+        }
+
+        int display_index;
+        try {
+            display_index = std::stoi(display_str);
+        } catch (...) {
+            continue;
+        }
+
+        Preset& preset = presets[name];
+        preset.name = name;
+        EntryForDisplay(preset, display_index).settings.Set(setting, parser.GetInt(key, VCP_VALUE_UNSET));
+    }
+
+    // Drop presets that don't pass validation rather than applying bad values later
+    for (auto it = presets.begin(); it != presets.end();) {
+        std::string error;
+        if (!ValidatePreset(it->second, error)) {
+            it = presets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return true;
+}
+
+bool PresetManager::GetPreset(const std::string& name, Preset& preset) {
+    std::lock_guard<std::mutex> lock(presets_mutex);
+    auto it = presets.find(name);
+    if (it == presets.end()) {
+        return false;
+    }
+    preset = it->second;
+    return true;
+}
+
+std::vector<Preset> PresetManager::ListPresets() {
+    std::lock_guard<std::mutex> lock(presets_mutex);
+    std::vector<Preset> result;
+    result.reserve(presets.size());
+    for (const auto& entry : presets) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+bool PresetManager::SavePreset(const Preset& preset, std::string& error) {
+    if (!ValidatePreset(preset, error)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(presets_mutex);
+    presets[preset.name] = preset;
+    if (!SaveLocked()) {
+        error = "Failed to write presets file";
+        return false;
+    }
+    return true;
+}
+
+bool PresetManager::DeletePreset(const std::string& name) {
+    std::lock_guard<std::mutex> lock(presets_mutex);
+    if (presets.erase(name) == 0) {
+        return false;
+    }
+    return SaveLocked();
+}
+
+bool PresetManager::SaveLocked() {
+    if (file_path.empty()) {
+        return false;
+    }
+
+    std::ofstream file(file_path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file << "# Monitor Control named presets\n";
+    file << "# Format: <name>.<display_index>.<brightness|contrast|input>=<value>\n";
+    file << "# Written by monitor_control_gui - edits are kept, comments are not\n";
+
+    const VcpSetting settings[] = { VcpSetting::Brightness, VcpSetting::Contrast, VcpSetting::Input };
+    for (const auto& item : presets) {
+        const Preset& preset = item.second;
+        file << "\n";
+        for (const PresetEntry& entry : preset.displays) {
+            for (VcpSetting setting : settings) {
+                int value = entry.settings.Get(setting);
+                if (value != VCP_VALUE_UNSET) {
+                    file << preset.name << "." << entry.display_index << "." << SettingKey(setting)
+                         << "=" << value << "\n";
+                }
+            }
+        }
+    }
+
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,122 @@
+// Compile monitor profiles (monitor_profiles.env) into the binary database
+// the app maps at startup (PROFILE_DB in config.env)
+//
+// Usage: profile_compiler <source.env> <output.bin>
+//        profile_compiler --lookup <database.bin> <MFG:PRODUCT>
+//        profile_compiler --bench [profiles]
+//
+// --lookup shows the profile a monitor with that EDID ID would get (the
+// ID of each attached display is listed by GET /api/profiles). --bench
+// compiles a database of synthetic models (default 1000) to a temporary file
+// and times opening it and looking every model up, i.e. the startup cost.
+
+#include "monitor_profiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+static void Print(const MonitorProfile& profile) {
+    printf("%s (%s)\n", profile.model, FormatEdidId(profile.manufacturer, profile.product).c_str());
+    printf("  input register 0x%02X, code 0x%02X, quiet %u ms\n", profile.input_register, profile.input_code,
+           profile.input_quiet_ms);
+    for (int i = 0; i < profile.input_count; i++) {
+        printf("  input %d: %-15s 0x%02X\n", i + 1, profile.inputs[i].name, profile.inputs[i].value);
+    }
+    printf("  brightness %u-%u, contrast %u-%u\n", profile.brightness_min, profile.brightness_max,
+           profile.contrast_min, profile.contrast_max);
+}
+
+static int Lookup(const char* path, const char* id) {
+    std::string text = id;
+    size_t colon = text.find(':');
+    uint16_t manufacturer = 0;
+    unsigned long product = 0;
+    if (colon == std::string::npos || !ParseManufacturerCode(text.substr(0, colon), manufacturer)) {
+        printf("Expected an EDID ID such as GSM:5BBF\n");
+        return 2;
+    }
+    product = strtoul(text.c_str() + colon + 1, nullptr, 16);
+
+    MonitorProfileDb db;
+    std::string error;
+    if (!db.Open(path, error)) {
+        printf("%s\n", error.c_str());
+        return 2;
+    }
+    MonitorProfile profile;
+    if (!db.Find(manufacturer, static_cast<uint16_t>(product), profile)) {
+        printf("No profile for %s; the built-in profile is used:\n", id);
+        Print(BuiltInMonitorProfile());
+        return 1;
+    }
+    Print(profile);
+    return 0;
+}
+
+static int Bench(int count) {
+    std::vector<MonitorProfile> profiles;
+    for (int i = 0; i < count; i++) {
+        MonitorProfile profile = BuiltInMonitorProfile();
+        profile.manufacturer = static_cast<uint16_t>(((1 + i % 26) << 10) | ((1 + i / 26 % 26) << 5) | 1);
+        profile.product = static_cast<uint16_t>(i / 676);
+        snprintf(profile.model, sizeof(profile.model), "Synthetic %d", i);
+        profiles.push_back(profile);
+    }
+
+    std::string path = "profile_bench.bin";
+    std::string error;
+    if (!WriteProfileDb(path, profiles, error)) {
+        printf("%s\n", error.c_str());
+        return 2;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    MonitorProfileDb db;
+    bool opened = db.Open(path, error);
+    auto opened_at = Clock::now();
+    int found = 0;
+    MonitorProfile profile;
+    for (const MonitorProfile& expected : profiles) {
+        found += db.Find(expected.manufacturer, expected.product, profile) ? 1 : 0;
+    }
+    auto done = Clock::now();
+    db.Close();
+    remove(path.c_str());
+
+    if (!opened) {
+        printf("%s\n", error.c_str());
+        return 2;
+    }
+    printf("%d profiles: open %.1f us, %d lookups %.1f us (%.3f us each)\n", count,
+           std::chrono::duration<double, std::micro>(opened_at - start).count(), count,
+           std::chrono::duration<double, std::micro>(done - opened_at).count(),
+           std::chrono::duration<double, std::micro>(done - opened_at).count() / count);
+    return found == count ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "--lookup") == 0) {
+        return Lookup(argv[2], argv[3]);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        int count = argc >= 3 ? atoi(argv[2]) : 1000;
+        return Bench(count > 0 ? count : 1000);
+    }
+    if (argc != 3 || argv[1][0] == '-') {
+        printf("Usage: profile_compiler <source.env> <output.bin>\n");
+        printf("       profile_compiler --lookup <database.bin> <MFG:PRODUCT>\n");
+        printf("       profile_compiler --bench [profiles]\n");
+        return 2;
+    }
+
+    std::vector<MonitorProfile> profiles;
+    std::string error;
+    if (!LoadProfileSource(argv[1], profiles, error) || !WriteProfileDb(argv[2], profiles, error)) {
+        printf("%s\n", error.c_str());
+        return 1;
+    }
+    printf("Compiled %zu profiles into %s\n", profiles.size(), argv[2]);
+    return 0;
+}
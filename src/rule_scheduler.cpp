@@ -0,0 +1,544 @@
+#include "rule_scheduler.h"
+#include "thread_safe_control.h"
+#include "http_api_server.h"
+#include "config_parser.h"
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// How far ahead rules are searched (covers Feb 29 rules)
+static const int MAX_SEARCH_DAYS = 4 * 366;
+
+static const double PI = 3.14159265358979323846;
+
+static bool ToLocalTm(time_t t, std::tm& out) {
+#ifdef _WIN32
+    return localtime_s(&out, &t) == 0;
+#else
+    return localtime_r(&t, &out) != nullptr;
+#endif
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t DaysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static bool SameLocalDay(time_t t, const std::tm& day) {
+    std::tm local;
+    return ToLocalTm(t, local) && local.tm_year == day.tm_year && local.tm_yday == day.tm_yday;
+}
+
+// Sunrise/sunset using the "Almanac for Computers" algorithm (official zenith 90.833 deg)
+bool ComputeSunEvent(time_t day, double latitude, double longitude, bool sunrise, time_t& event_time) {
+    std::tm local;
+    if (!ToLocalTm(day, local)) {
+        return false;
+    }
+
+    auto deg_sin = [](double d) { return std::sin(d * PI / 180.0); };
+    auto deg_cos = [](double d) { return std::cos(d * PI / 180.0); };
+    auto normalize = [](double value, double range) {
+        value = std::fmod(value, range);
+        return value < 0 ? value + range : value;
+    };
+
+    const double zenith = 90.833;
+    const int day_of_year = local.tm_yday + 1;
+    const double lng_hour = longitude / 15.0;
+    const double t = day_of_year + ((sunrise ? 6.0 : 18.0) - lng_hour) / 24.0;
+
+    const double mean_anomaly = 0.9856 * t - 3.289;
+    const double true_longitude = normalize(mean_anomaly + 1.916 * deg_sin(mean_anomaly) +
+                                            0.020 * deg_sin(2 * mean_anomaly) + 282.634, 360.0);
+
+    double right_ascension = normalize(std::atan(0.91764 * std::tan(true_longitude * PI / 180.0)) * 180.0 / PI, 360.0);
+    right_ascension += std::floor(true_longitude / 90.0) * 90.0 - std::floor(right_ascension / 90.0) * 90.0;
+    right_ascension /= 15.0;
+
+    const double sin_dec = 0.39782 * deg_sin(true_longitude);
+    const double cos_dec = std::cos(std::asin(sin_dec));
+    const double cos_h = (deg_cos(zenith) - sin_dec * deg_sin(latitude)) / (cos_dec * deg_cos(latitude));
+    if (cos_h > 1.0 || cos_h < -1.0) {
+        return false; // Sun never rises / never sets on this day
+    }
+
+    double hour_angle = std::acos(cos_h) * 180.0 / PI;
+    if (sunrise) {
+        hour_angle = 360.0 - hour_angle;
+    }
+    hour_angle /= 15.0;
+
+    const double local_mean_time = hour_angle + right_ascension - 0.06571 * t - 6.622;
+    const double ut_hours = normalize(local_mean_time - lng_hour, 24.0);
+
+    // UT on the local calendar date, then shift by a day if the time zone moved it
+    int64_t utc_midnight = DaysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 86400;
+    time_t candidate = static_cast<time_t>(utc_midnight + static_cast<int64_t>(ut_hours * 3600.0));
+    for (int attempt = 0; attempt < 2 && !SameLocalDay(candidate, local); attempt++) {
+        std::tm candidate_tm;
+        ToLocalTm(candidate, candidate_tm);
+        bool candidate_later = (candidate_tm.tm_year > local.tm_year) ||
+                               (candidate_tm.tm_year == local.tm_year && candidate_tm.tm_yday > local.tm_yday);
+        candidate += candidate_later ? -86400 : 86400;
+    }
+
+    event_time = candidate;
+    return SameLocalDay(candidate, local);
+}
+
+// Parse one cron field ("*", "5", "1-5", "*/15", "0-30/10", "1,15") into a bitmask
+static bool ParseCronField(const std::string& field, int min_value, int max_value, uint64_t& mask, bool& any) {
+    mask = 0;
+    any = (field == "*");
+
+    std::stringstream list(field);
+    std::string part;
+    while (std::getline(list, part, ',')) {
+        int step = 1;
+        size_t slash = part.find('/');
+        if (slash != std::string::npos) {
+            try {
+                step = std::stoi(part.substr(slash + 1));
+            } catch (...) {
+                return false;
+            }
+            if (step <= 0) return false;
+            part = part.substr(0, slash);
+        }
+
+        int low, high;
+        try {
+            if (part == "*") {
+                low = min_value;
+                high = max_value;
+            } else {
+                size_t dash = part.find('-');
+                low = std::stoi(part.substr(0, dash));
+                high = (dash == std::string::npos) ? low : std::stoi(part.substr(dash + 1));
+                if (dash == std::string::npos && slash != std::string::npos) {
+                    high = max_value; // "5/10" means from 5 to the end in steps of 10
+                }
+            }
+        } catch (...) {
+            return false;
+        }
+
+        if (low < min_value || high > max_value || low > high) {
+            return false;
+        }
+        for (int value = low; value <= high; value += step) {
+            mask |= 1ull << value;
+        }
+    }
+    return mask != 0;
+}
+
+bool ParseRuleTrigger(const std::string& text, RuleTrigger& trigger, std::string& error) {
+    std::istringstream in(text);
+    std::string kind;
+    in >> kind;
+
+    if (kind == "cron") {
+        std::string fields[5];
+        for (int i = 0; i < 5; i++) {
+            if (!(in >> fields[i])) {
+                error = "cron trigger needs 5 fields: minute hour day month weekday";
+                return false;
+            }
+        }
+
+        uint64_t mask;
+        bool any;
+        trigger.type = RuleTrigger::Type::Cron;
+        if (!ParseCronField(fields[0], 0, 59, mask, any)) { error = "invalid cron minute field"; return false; }
+        trigger.minutes = mask;
+        if (!ParseCronField(fields[1], 0, 23, mask, any)) { error = "invalid cron hour field"; return false; }
+        trigger.hours = static_cast<uint32_t>(mask);
+        if (!ParseCronField(fields[2], 1, 31, mask, any)) { error = "invalid cron day field"; return false; }
+        trigger.days = static_cast<uint32_t>(mask);
+        trigger.any_day = any;
+        if (!ParseCronField(fields[3], 1, 12, mask, any)) { error = "invalid cron month field"; return false; }
+        trigger.months = static_cast<uint16_t>(mask);
+        if (!ParseCronField(fields[4], 0, 7, mask, any)) { error = "invalid cron weekday field"; return false; }
+        if (mask & (1ull << 7)) mask |= 1;   // 7 = Sunday as well
+        trigger.weekdays = static_cast<uint8_t>(mask & 0x7F);
+        trigger.any_weekday = any;
+        return true;
+    }
+
+    if (kind == "sunrise" || kind == "sunset") {
+        trigger.type = (kind == "sunrise") ? RuleTrigger::Type::Sunrise : RuleTrigger::Type::Sunset;
+        trigger.offset_minutes = 0;
+        std::string offset;
+        if (in >> offset) {
+            try {
+                trigger.offset_minutes = std::stoi(offset);
+            } catch (...) {
+                error = "sun trigger offset must be a number of minutes, e.g. sunset -30";
+                return false;
+            }
+        }
+        if (trigger.offset_minutes < -720 || trigger.offset_minutes > 720) {
+            error = "sun trigger offset must be within +/-720 minutes";
+            return false;
+        }
+        return true;
+    }
+
+    error = "trigger must start with cron, sunrise or sunset";
+    return false;
+}
+
+bool ParseRuleAction(const std::string& text, RuleAction& action, std::string& error) {
+    std::istringstream in(text);
+    std::string kind, argument;
+    in >> kind >> argument;
+
+    if (argument.empty()) {
+        error = "action needs an argument, e.g. 'preset dark' or 'brightness 30'";
+        return false;
+    }
+
+    if (kind == "preset") {
+        action.type = RuleAction::Type::Preset;
+        action.preset = argument;
+        if (!PresetManager::IsValidName(argument)) {
+            error = "invalid preset name";
+            return false;
+        }
+        return true;
+    }
+
+    try {
+        action.value = std::stoi(argument);
+    } catch (...) {
+        error = "action value must be a number";
+        return false;
+    }
+
+    if (kind == "brightness" || kind == "contrast") {
+        action.type = (kind == "brightness") ? RuleAction::Type::Brightness : RuleAction::Type::Contrast;
+        if (action.value < 0 || action.value > 100) {
+            error = "brightness/contrast must be between 0 and 100";
+            return false;
+        }
+        return true;
+    }
+    if (kind == "input") {
+        action.type = RuleAction::Type::Input;
+        if (action.value < 1 || action.value > MAX_PROFILE_INPUTS) {
+            error = "input must be between 1 and " + std::to_string(MAX_PROFILE_INPUTS);
+            return false;
+        }
+        return true;
+    }
+
+    error = "action must be preset, brightness, contrast or input";
+    return false;
+}
+
+RuleScheduler::RuleScheduler(ThreadSafeMonitorControl* control, PresetManager* presets)
+    : monitor_control(control), preset_manager(presets), stopping(false), running(false),
+      wheel(static_cast<uint64_t>(time(nullptr))), latitude(0.0), longitude(0.0), has_location(false) {
+}
+
+RuleScheduler::~RuleScheduler() {
+    Stop();
+}
+
+bool RuleScheduler::LoadFromFile(const std::string& filename, double lat, double lon, bool location_known) {
+    ConfigParser parser;
+    bool loaded = parser.LoadFromFile(filename);
+
+    // Rule names are the key prefixes that have a ".trigger" entry
+    std::vector<ScheduleRule> loaded_rules;
+    const std::string trigger_suffix = ".trigger";
+    for (const std::string& key : parser.GetKeys()) {
+        if (key.length() <= trigger_suffix.length() ||
+            key.compare(key.length() - trigger_suffix.length(), trigger_suffix.length(), trigger_suffix) != 0) {
+            continue;
+        }
+
+        ScheduleRule rule;
+        rule.name = key.substr(0, key.length() - trigger_suffix.length());
+        rule.trigger_text = parser.GetString(key);
+        rule.action_text = parser.GetString(rule.name + ".action");
+
+        std::string error;
+        if (!PresetManager::IsValidName(rule.name)) {
+            ServerLogger::Log("WARN", "Schedule rule '%s' skipped: invalid name", rule.name.c_str());
+            continue;
+        }
+        if (!ParseRuleTrigger(rule.trigger_text, rule.trigger, error) ||
+            !ParseRuleAction(rule.action_text, rule.action, error)) {
+            ServerLogger::Log("WARN", "Schedule rule '%s' skipped: %s", rule.name.c_str(), error.c_str());
+            continue;
+        }
+        if (rule.trigger.type != RuleTrigger::Type::Cron && !location_known) {
+            ServerLogger::Log("WARN", "Schedule rule '%s' skipped: LATITUDE/LONGITUDE not configured", rule.name.c_str());
+            continue;
+        }
+
+        rule.action.display_index = parser.GetInt(rule.name + ".display", 0);
+        rule.action.duration_ms = parser.GetInt(rule.name + ".duration_ms", 0);
+        std::string easing = parser.GetString(rule.name + ".easing", "linear");
+        if (!ParseEasing(easing, rule.action.easing)) {
+            ServerLogger::Log("WARN", "Schedule rule '%s': unknown easing '%s', using linear", rule.name.c_str(), easing.c_str());
+        }
+        rule.enabled = parser.GetBool(rule.name + ".enabled", true);
+        loaded_rules.push_back(rule);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        rules = loaded_rules;
+        latitude = lat;
+        longitude = lon;
+        has_location = location_known;
+
+        time_t now = time(nullptr);
+        wheel.Reset(static_cast<uint64_t>(now));
+        for (size_t i = 0; i < rules.size(); i++) {
+            ScheduleNext(i, now);
+        }
+    }
+    scheduler_cv.notify_one();
+
+    ServerLogger::Log("INFO", "Loaded %d schedule rules from %s", (int)loaded_rules.size(), filename.c_str());
+    return loaded;
+}
+
+time_t RuleScheduler::NextFireTime(const RuleTrigger& trigger, time_t after) const {
+    std::tm start;
+    if (!ToLocalTm(after, start)) {
+        return 0;
+    }
+
+    for (int day_offset = 0; day_offset <= MAX_SEARCH_DAYS; day_offset++) {
+        // Local midnight of the candidate day (mktime normalizes day overflow and DST)
+        std::tm day = start;
+        day.tm_mday += day_offset;
+        day.tm_hour = 0;
+        day.tm_min = 0;
+        day.tm_sec = 0;
+        day.tm_isdst = -1;
+        time_t midnight = mktime(&day);
+        if (midnight == (time_t)-1) {
+            return 0;
+        }
+
+        if (trigger.type != RuleTrigger::Type::Cron) {
+            time_t event_time;
+            if (ComputeSunEvent(midnight + 12 * 3600, latitude, longitude,
+                                trigger.type == RuleTrigger::Type::Sunrise, event_time)) {
+                event_time += trigger.offset_minutes * 60;
+                if (event_time > after) {
+                    return event_time;
+                }
+            }
+            if (day_offset > 366) {
+                return 0;
+            }
+            continue;
+        }
+
+        // Cron: month must match, then day-of-month / weekday (OR'ed when both are restricted)
+        if (!(trigger.months & (1u << (day.tm_mon + 1)))) {
+            continue;
+        }
+        bool day_match = (trigger.days & (1u << day.tm_mday)) != 0;
+        bool weekday_match = (trigger.weekdays & (1u << day.tm_wday)) != 0;
+        bool matches = (trigger.any_day || trigger.any_weekday) ? (day_match && weekday_match)
+                                                                : (day_match || weekday_match);
+        if (!matches) {
+            continue;
+        }
+
+        for (int hour = 0; hour < 24; hour++) {
+            if (!(trigger.hours & (1u << hour))) continue;
+            for (int minute = 0; minute < 60; minute++) {
+                if (!(trigger.minutes & (1ull << minute))) continue;
+
+                std::tm candidate = day;
+                candidate.tm_hour = hour;
+                candidate.tm_min = minute;
+                candidate.tm_sec = 0;
+                candidate.tm_isdst = -1;
+                time_t fire = mktime(&candidate);
+                if (fire != (time_t)-1 && fire > after) {
+                    return fire;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void RuleScheduler::ScheduleNext(size_t index, time_t after) {
+    ScheduleRule& rule = rules[index];
+    rule.next_fire = rule.enabled ? NextFireTime(rule.trigger, after) : 0;
+    if (rule.next_fire != 0) {
+        wheel.Schedule(index, static_cast<uint64_t>(rule.next_fire));
+    } else {
+        wheel.Cancel(index);
+    }
+}
+
+bool RuleScheduler::RunAction(const RuleAction& action, DisplayExecutor::Lane lane) {
+    if (!monitor_control->IsInitialized()) {
+        return false;
+    }
+
+    switch (action.type) {
+    case RuleAction::Type::Preset: {
+        Preset preset;
+        if (!preset_manager->GetPreset(action.preset, preset)) {
+            ServerLogger::Log("WARN", "Scheduled preset '%s' not found", action.preset.c_str());
+            return false;
+        }
+        return monitor_control->ApplyPreset(preset, DisplayExecutor::NO_DEADLINE, lane).writes_failed == 0;
+    }
+    case RuleAction::Type::Brightness:
+    case RuleAction::Type::Contrast: {
+        VcpSetting setting = (action.type == RuleAction::Type::Brightness) ? VcpSetting::Brightness : VcpSetting::Contrast;
+        if (action.duration_ms > 0) {
+            return monitor_control->StartTransition(action.display_index, setting, action.value,
+                                                    action.duration_ms, action.easing);
+        }
+        VcpWrite write;
+        write.lane = lane;
+        return MakeVcpWrite(action.display_index, setting, action.value, write) && monitor_control->Write(write);
+    }
+    case RuleAction::Type::Input: {
+        VcpWrite write;
+        write.lane = lane;
+        return MakeVcpWrite(action.display_index, VcpSetting::Input, action.value, write) && monitor_control->Write(write);
+    }
+    }
+    return false;
+}
+
+void RuleScheduler::Start() {
+    std::lock_guard<std::mutex> lock(scheduler_mutex);
+    if (running) {
+        return;
+    }
+    stopping = false;
+    running = true;
+    scheduler_thread = std::thread(&RuleScheduler::SchedulerThreadFunc, this);
+}
+
+void RuleScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        stopping = true;
+    }
+    scheduler_cv.notify_one();
+
+    if (scheduler_thread.joinable()) {
+        scheduler_thread.join();
+    }
+    running = false;
+}
+
+std::vector<ScheduleRule> RuleScheduler::ListRules() {
+    std::lock_guard<std::mutex> lock(scheduler_mutex);
+    return rules;
+}
+
+bool RuleScheduler::TriggerRule(const std::string& name, std::string& error) {
+    RuleAction action;
+    {
+        std::lock_guard<std::mutex> lock(scheduler_mutex);
+        auto it = std::find_if(rules.begin(), rules.end(), [&name](const ScheduleRule& rule) { return rule.name == name; });
+        if (it == rules.end()) {
+            error = "Rule not found";
+            return false;
+        }
+        action = it->action;
+    }
+
+    bool result = RunAction(action, DisplayExecutor::Lane::Interactive);
+
+    std::lock_guard<std::mutex> lock(scheduler_mutex);
+    for (ScheduleRule& rule : rules) {
+        if (rule.name == name) {
+            rule.last_fire = time(nullptr);
+            rule.last_result = result;
+            rule.fire_count++;
+        }
+    }
+    if (!result) {
+        error = "Rule action failed";
+    }
+    return result;
+}
+
+void RuleScheduler::SchedulerThreadFunc() {
+    ServerLogger::Log("INFO", "Rule scheduler started");
+
+    std::unique_lock<std::mutex> lock(scheduler_mutex);
+    while (!stopping) {
+        time_t now = time(nullptr);
+
+        // Wall clock moved backwards (manual change, NTP step): rebuild the wheel
+        if (static_cast<uint64_t>(now) + 1 < wheel.CurrentTick()) {
+            ServerLogger::Log("WARN", "System clock moved backwards, rescheduling %d rules", (int)rules.size());
+            wheel.Reset(static_cast<uint64_t>(now));
+            for (size_t i = 0; i < rules.size(); i++) {
+                ScheduleNext(i, now);
+            }
+        }
+
+        std::vector<uint64_t> expired;
+        wheel.Advance(static_cast<uint64_t>(now), expired);
+
+        if (!expired.empty()) {
+            std::vector<std::pair<std::string, RuleAction>> to_run;
+            for (uint64_t id : expired) {
+                if (id >= rules.size()) continue;
+                ScheduleRule& rule = rules[id];
+                to_run.push_back(std::make_pair(rule.name, rule.action));
+                ScheduleNext(static_cast<size_t>(id), now);
+            }
+
+            // Run actions without holding the lock - they wait on the I2C bus
+            lock.unlock();
+            std::vector<bool> results;
+            for (const auto& item : to_run) {
+                bool result = RunAction(item.second, DisplayExecutor::Lane::Bulk);
+                ServerLogger::Log(result ? "INFO" : "WARN", "Schedule rule '%s' fired: %s",
+                                  item.first.c_str(), result ? "success" : "failed");
+                results.push_back(result);
+            }
+            lock.lock();
+
+            for (size_t i = 0; i < to_run.size(); i++) {
+                for (ScheduleRule& rule : rules) {
+                    if (rule.name == to_run[i].first) {
+                        rule.last_fire = now;
+                        rule.last_result = results[i];
+                        rule.fire_count++;
+                    }
+                }
+            }
+            continue;
+        }
+
+        uint64_t next = wheel.NextExpiry();
+        if (next == UINT64_MAX) {
+            scheduler_cv.wait(lock);
+        } else {
+            scheduler_cv.wait_until(lock, std::chrono::system_clock::from_time_t(static_cast<time_t>(next)));
+        }
+    }
+
+    ServerLogger::Log("INFO", "Rule scheduler stopped");
+}
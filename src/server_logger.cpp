@@ -0,0 +1,93 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <chrono>
+#include <time.h>
+#endif
+
+#include "server_logger.h"
+#include <stdio.h>
+#include <cstdarg>
+#include <cstring>
+
+// ServerLogger implementation (kept out of http_api_server.cpp and free of
+// Windows-only headers so tools such as udp_bench and ambient_sim can log
+// without linking the HTTP server, on any platform)
+std::ofstream ServerLogger::log_file;
+std::mutex ServerLogger::log_mutex;
+std::atomic<int> ServerLogger::min_level(1);
+
+// Local time as "YYYY-MM-DD hh:mm:ss.mmm"
+static void FormatTimestamp(char* timestamp, size_t size) {
+#ifdef _WIN32
+    SYSTEMTIME st;
+    GetLocalTime(&st);
+    snprintf(timestamp, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+             st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
+#else
+    auto now = std::chrono::system_clock::now();
+    time_t seconds = std::chrono::system_clock::to_time_t(now);
+    int milliseconds = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        now.time_since_epoch()).count() % 1000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    snprintf(timestamp, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+             local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec,
+             milliseconds);
+#endif
+}
+
+static int LogLevelRank(const char* level) {
+    if (strcmp(level, "DEBUG") == 0) return 0;
+    if (strcmp(level, "WARN") == 0) return 2;
+    if (strcmp(level, "ERROR") == 0) return 3;
+    return 1; // INFO and anything unknown
+}
+
+void ServerLogger::SetLevel(const std::string& level) {
+    min_level = LogLevelRank(level.c_str());
+}
+
+void ServerLogger::Init(const std::string& log_path) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log_file.is_open()) {
+        log_file.close();
+    }
+    log_file.open(log_path, std::ios::out | std::ios::app);
+    if (log_file.is_open()) {
+        // Write startup marker
+        char timestamp[64];
+        FormatTimestamp(timestamp, sizeof(timestamp));
+        log_file << "\n=== Log started at " << timestamp << " ===" << std::endl;
+    }
+}
+
+void ServerLogger::Log(const char* level, const char* format, ...) {
+    if (LogLevelRank(level) < min_level) return;
+
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (!log_file.is_open()) return;
+
+    // Get timestamp
+    char timestamp[64];
+    FormatTimestamp(timestamp, sizeof(timestamp));
+
+    // Format message
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    log_file << "[" << timestamp << "] [" << level << "] " << message << std::endl;
+    log_file.flush();
+}
+
+void ServerLogger::Close() {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log_file.is_open()) {
+        log_file << "=== Log closed ===" << std::endl;
+        log_file.close();
+    }
+}
@@ -0,0 +1,61 @@
+#include "startup_profile.h"
+#include <algorithm>
+
+static double MillisecondsBetween(StartupProfile::Clock::time_point from, StartupProfile::Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+StartupProfile::Timer::Timer(StartupProfile* profile, const std::string& name)
+    : profile(profile), name(name), start(Clock::now()), ended(false) {
+}
+
+StartupProfile::Timer::~Timer() {
+    End();
+}
+
+void StartupProfile::Timer::End(bool ok, const std::string& detail) {
+    if (ended) {
+        return;
+    }
+    ended = true;
+    if (profile) {
+        profile->Record(name, start, Clock::now(), ok, detail);
+    }
+}
+
+StartupProfile::StartupProfile() : start(Clock::now()) {
+}
+
+void StartupProfile::Record(const std::string& name, Clock::time_point phase_start, Clock::time_point phase_end,
+                            bool ok, const std::string& detail) {
+    Phase phase;
+    phase.name = name;
+    phase.start_ms = MillisecondsBetween(start, phase_start);
+    phase.duration_ms = MillisecondsBetween(phase_start, phase_end);
+    phase.ok = ok;
+    phase.detail = detail;
+
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    phases.push_back(phase);
+}
+
+std::vector<StartupProfile::Phase> StartupProfile::GetPhases() {
+    std::vector<Phase> result;
+    {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        result = phases;
+    }
+    std::stable_sort(result.begin(), result.end(), [](const Phase& a, const Phase& b) {
+        return a.start_ms < b.start_ms;
+    });
+    return result;
+}
+
+double StartupProfile::GetElapsedMs() {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    double elapsed = 0.0;
+    for (const Phase& phase : phases) {
+        elapsed = std::max(elapsed, phase.start_ms + phase.duration_ms);
+    }
+    return elapsed;
+}
@@ -0,0 +1,196 @@
+// Startup phase timing over many runs, without monitors or NvAPI
+//
+// Usage: startup_sim [runs] [displays]
+//
+// Runs the portable part of startup the given number of times (default 20)
+// and records each run in a StartupProfile, as the GUI does for the real
+// one (GET /api/diagnostics/startup): config.env is parsed, a simulated
+// transport and queue is created per display (default 4), each display is
+// probed with a VCP read as enumeration does, and the HTTP listener's socket
+// phases run on loopback up to serving one request. The simulated bus has
+// the usual ~50 ms transactions with an occasional 250 ms spike, so the
+// enumeration phases show what a slow monitor does to the spread. Prints
+// min, median, p95, max and mean of every phase and of the whole startup.
+// Exits with 1 if any phase failed.
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#define closesocket close
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#endif
+
+#include "startup_profile.h"
+#include "display_executor.h"
+#include "config_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <thread>
+
+// Loopback phases of the HTTP listener: resolve, bind and listen, then serve
+// one request from a client thread
+static bool RunListenerPhases(StartupProfile& profile) {
+    StartupProfile::Timer gai_timer(&profile, "getaddrinfo");
+    struct addrinfo hints = {}, *resolved = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    if (getaddrinfo("127.0.0.1", "0", &hints, &resolved) != 0) {
+        gai_timer.End(false, "127.0.0.1 did not resolve");
+        return false;
+    }
+    gai_timer.End();
+
+    StartupProfile::Timer bind_timer(&profile, "HTTP bind");
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    bool bound = listener != INVALID_SOCKET &&
+                 bind(listener, resolved->ai_addr, static_cast<int>(resolved->ai_addrlen)) == 0 &&
+                 listen(listener, 4) == 0;
+    freeaddrinfo(resolved);
+    sockaddr_in address = {};
+    socklen_t address_length = sizeof(address);
+    bound = bound && getsockname(listener, reinterpret_cast<sockaddr*>(&address), &address_length) == 0;
+    if (!bound) {
+        bind_timer.End(false, "bind or listen failed");
+        if (listener != INVALID_SOCKET) {
+            closesocket(listener);
+        }
+        return false;
+    }
+    bind_timer.End();
+
+    // The phase ends when the client has the response, as for a real client
+    auto listening = StartupProfile::Clock::now();
+    bool served = false;
+    std::thread client([&address, &served]() {
+        SOCKET connection = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        const char request[] = "GET /health HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        char response[256];
+        served = connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+                 send(connection, request, static_cast<int>(strlen(request)), 0) > 0 &&
+                 recv(connection, response, sizeof(response), 0) > 0;
+        closesocket(connection);
+    });
+    SOCKET accepted = accept(listener, nullptr, nullptr);
+    if (accepted != INVALID_SOCKET) {
+        char request[256];
+        const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 15\r\n\r\n{\"status\":\"ok\"}";
+        recv(accepted, request, sizeof(request), 0);
+        send(accepted, response, static_cast<int>(strlen(response)), 0);
+        closesocket(accepted);
+    }
+    client.join();
+    closesocket(listener);
+    profile.Record("first request served", listening, StartupProfile::Clock::now(), served);
+    return served;
+}
+
+static bool RunStartup(StartupProfile& profile, int run, int displays) {
+    bool ok = true;
+    {
+        StartupProfile::Timer timer(&profile, "config load");
+        ConfigParser parser;
+        bool loaded = parser.LoadFromFile("config.env");
+        timer.End(true, loaded ? "config.env" : "no config.env, defaults");
+    }
+
+    SimulatedFaults faults;
+    faults.spike_rate = 0.05;
+    faults.spike_ms = 250;
+    std::vector<std::unique_ptr<DisplayExecutor>> executors;
+    {
+        StartupProfile::Timer timer(&profile, "transport init");
+        for (int i = 0; i < displays; i++) {
+            auto* bus = new SimulatedTransport(static_cast<uint32_t>(run * 64 + i + 1));
+            bus->SetFaults(faults);
+            executors.push_back(std::make_unique<DisplayExecutor>(i, std::unique_ptr<DdcTransport>(bus)));
+        }
+    }
+
+    for (int i = 0; i < displays; i++) {
+        StartupProfile::Timer timer(&profile, "enumerate display " + std::to_string(i));
+        uint16_t current = 0, maximum = 0;
+        bool probed = executors[i]->SubmitRead(0x10, DDC_VCP_REGISTER, &current, &maximum).get();
+        timer.End(probed);
+        ok = ok && probed;
+    }
+
+#ifdef _WIN32
+    {
+        StartupProfile::Timer timer(&profile, "WSAStartup");
+        WSADATA wsa;
+        int result = WSAStartup(MAKEWORD(2, 2), &wsa);
+        timer.End(result == 0, result == 0 ? "" : "error " + std::to_string(result));
+        ok = ok && result == 0;
+    }
+#endif
+    ok = RunListenerPhases(profile) && ok;
+    return ok;
+}
+
+static double Percentile(const std::vector<double>& sorted, double fraction) {
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void PrintRow(const std::string& name, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    printf("%-24s %9.2f %9.2f %9.2f %9.2f %9.2f\n", name.c_str(), samples.front(), Percentile(samples, 0.5),
+           Percentile(samples, 0.95), samples.back(), sum / samples.size());
+}
+
+int main(int argc, char* argv[]) {
+    int runs = argc >= 2 ? atoi(argv[1]) : 20;
+    int displays = argc >= 3 ? atoi(argv[2]) : 4;
+    if (runs <= 0 || displays <= 0 || displays > 16) {
+        printf("Usage: startup_sim [runs] [displays (1-16)]\n");
+        return 2;
+    }
+
+    // Phase durations by name, in the order phases first appear
+    std::vector<std::string> names;
+    std::map<std::string, std::vector<double>> durations;
+    std::vector<double> totals;
+    int failed_runs = 0;
+    for (int run = 0; run < runs; run++) {
+        StartupProfile profile;
+        if (!RunStartup(profile, run, displays)) {
+            failed_runs++;
+        }
+        for (const StartupProfile::Phase& phase : profile.GetPhases()) {
+            if (!durations.count(phase.name)) {
+                names.push_back(phase.name);
+            }
+            durations[phase.name].push_back(phase.duration_ms);
+        }
+        totals.push_back(profile.GetElapsedMs());
+    }
+
+    printf("%d startups, %d displays (ms)\n", runs, displays);
+    printf("%-24s %9s %9s %9s %9s %9s\n", "phase", "min", "median", "p95", "max", "mean");
+    for (const std::string& name : names) {
+        PrintRow(name, durations[name]);
+    }
+    PrintRow("total", totals);
+    if (failed_runs > 0) {
+        printf("%d runs had a failed phase\n", failed_runs);
+    }
+    return failed_runs == 0 ? 0 : 1;
+}
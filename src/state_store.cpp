@@ -0,0 +1,209 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "state_store.h"
+#include <cstring>
+
+static void PutLe(uint8_t* out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint32_t GetLe(const uint8_t* in, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+static uint32_t Fnv1a(const uint8_t* bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Start writing a range of the mapping back to the file without waiting
+static void FlushRange(uint8_t* base, size_t offset, size_t length) {
+#ifdef _WIN32
+    FlushViewOfFile(base + offset, length);
+#else
+    // msync needs a page-aligned start, and the whole file is one or two pages
+    msync(base, offset + length, MS_ASYNC);
+#endif
+}
+
+StateStore::StateStore()
+    : data(nullptr), size(0)
+#ifdef _WIN32
+    , file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr)
+#endif
+{
+}
+
+StateStore::~StateStore() {
+    Close();
+}
+
+bool StateStore::Open(const std::string& path, std::string& error) {
+    Close();
+
+    bool resized = false;
+#ifdef _WIN32
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        error = "cannot open " + path;
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    if (file_size.QuadPart != static_cast<LONGLONG>(STATE_FILE_SIZE)) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(STATE_FILE_SIZE);
+        resized = SetFilePointerEx(file_handle, end, nullptr, FILE_BEGIN) && SetEndOfFile(file_handle);
+        if (!resized) {
+            Close();
+            error = "cannot resize " + path;
+            return false;
+        }
+    }
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    if (mapping_handle) {
+        data = static_cast<uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_WRITE, 0, 0, 0));
+    }
+#else
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    if (static_cast<size_t>(file_stat.st_size) != STATE_FILE_SIZE) {
+        resized = ftruncate(fd, static_cast<off_t>(STATE_FILE_SIZE)) == 0;
+        if (!resized) {
+            close(fd);
+            error = "cannot resize " + path;
+            return false;
+        }
+    }
+    void* mapped = mmap(nullptr, STATE_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    data = mapped == MAP_FAILED ? nullptr : static_cast<uint8_t*>(mapped);
+    close(fd);
+#endif
+    if (!data) {
+        Close();
+        error = "cannot map " + path;
+        return false;
+    }
+    size = STATE_FILE_SIZE;
+
+    // A file of the wrong size, another format or another version is
+    // started afresh rather than trusted
+    bool valid = !resized && memcmp(data, STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC)) == 0 &&
+                 GetLe(data + 8, 4) == STATE_FILE_VERSION && GetLe(data + 12, 4) == STATE_MAX_DISPLAYS;
+    if (!valid) {
+        memset(data, 0, size);
+        memcpy(data, STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC));
+        PutLe(data + 8, STATE_FILE_VERSION, 4);
+        PutLe(data + 12, STATE_MAX_DISPLAYS, 4);
+        FlushRange(data, 0, size);
+    }
+    return true;
+}
+
+void StateStore::Close() {
+#ifdef _WIN32
+    if (data) {
+        FlushViewOfFile(data, size);
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+        file_handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (data) {
+        msync(data, size, MS_ASYNC);
+        munmap(data, size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+uint8_t* StateStore::Record(int display_index, int slot) const {
+    return data + STATE_FILE_HEADER_SIZE + (static_cast<size_t>(display_index) * 2 + slot) * STATE_RECORD_SIZE;
+}
+
+int StateStore::NewestSlot(int display_index, uint32_t& sequence) const {
+    int newest = -1;
+    sequence = 0;
+    for (int slot = 0; slot < 2; slot++) {
+        const uint8_t* record = Record(display_index, slot);
+        uint32_t slot_sequence = GetLe(record, 4);
+        if (slot_sequence != 0 && GetLe(record + 24, 4) == Fnv1a(record, 24) &&
+            (newest < 0 || slot_sequence > sequence)) {
+            newest = slot;
+            sequence = slot_sequence;
+        }
+    }
+    return newest;
+}
+
+bool StateStore::Load(int display_index, DisplaySettings& settings, time_t& saved_at) const {
+    if (!data || display_index < 0 || display_index >= STATE_MAX_DISPLAYS) {
+        return false;
+    }
+    uint32_t sequence;
+    int slot = NewestSlot(display_index, sequence);
+    if (slot < 0) {
+        return false;
+    }
+    const uint8_t* record = Record(display_index, slot);
+    settings.brightness = static_cast<int32_t>(GetLe(record + 4, 4));
+    settings.contrast = static_cast<int32_t>(GetLe(record + 8, 4));
+    settings.input = static_cast<int32_t>(GetLe(record + 12, 4));
+    saved_at = static_cast<time_t>(GetLe(record + 16, 4) | static_cast<uint64_t>(GetLe(record + 20, 4)) << 32);
+    return true;
+}
+
+bool StateStore::Save(int display_index, const DisplaySettings& settings) {
+    if (!data || display_index < 0 || display_index >= STATE_MAX_DISPLAYS) {
+        return false;
+    }
+    uint32_t sequence;
+    int newest = NewestSlot(display_index, sequence);
+    uint8_t* record = Record(display_index, newest == 0 ? 1 : 0);
+
+    // The sequence goes in last: until it does, the slot still holds its
+    // old sequence and fails its checksum, so the other slot stays newest
+    uint8_t bytes[STATE_RECORD_SIZE] = {};
+    uint64_t now = static_cast<uint64_t>(time(nullptr));
+    PutLe(bytes, sequence + 1, 4);
+    PutLe(bytes + 4, static_cast<uint32_t>(settings.brightness), 4);
+    PutLe(bytes + 8, static_cast<uint32_t>(settings.contrast), 4);
+    PutLe(bytes + 12, static_cast<uint32_t>(settings.input), 4);
+    PutLe(bytes + 16, static_cast<uint32_t>(now), 4);
+    PutLe(bytes + 20, static_cast<uint32_t>(now >> 32), 4);
+    PutLe(bytes + 24, Fnv1a(bytes, 24), 4);
+    memcpy(record + 4, bytes + 4, STATE_RECORD_SIZE - 4);
+    memcpy(record, bytes, 4);
+
+    FlushRange(data, static_cast<size_t>(record - data), STATE_RECORD_SIZE);
+    return true;
+}
@@ -1,6 +1,8 @@
 #include "thread_safe_control.h"
 #include "monitor_control.h"
+#include "ddc_log.h"
 #include <stdio.h>
+#include <algorithm>
 
 // AppState definition (must match monitor_control_gui.cpp)
 struct AppState {
@@ -15,98 +17,784 @@ struct AppState {
     char status_message[256] = "Ready";
 };
 
-// LG Ultragear input source mappings
-const InputSourceMapping ThreadSafeMonitorControl::input_mappings[4] = {
-    {1, "HDMI 1",      0x90, 0xF4, 0x50},
-    {2, "HDMI 2",      0x91, 0xF4, 0x50},
-    {3, "DisplayPort", 0xD0, 0xF4, 0x50},
-    {4, "USB-C",       0xD1, 0xF4, 0x50}
-};
+static uint16_t ScaleToRange(int percent, uint16_t minimum, uint16_t maximum) {
+    return static_cast<uint16_t>(minimum + (percent * (maximum - minimum) + 50) / 100);
+}
+
+// Inverse of ScaleToRange, for values read back; raw values outside the range are clamped
+static int PercentFromRange(uint16_t raw, uint16_t minimum, uint16_t maximum) {
+    if (maximum <= minimum) {
+        return VCP_VALUE_UNSET;
+    }
+    int span = maximum - minimum;
+    int offset = std::min(std::max(static_cast<int>(raw) - minimum, 0), span);
+    return (offset * 100 + span / 2) / span;
+}
+
+// Raw value read from a setting's VCP code -> the value MakeVcpWrite takes, or VCP_VALUE_UNSET
+static int SettingFromRaw(const MonitorProfile& profile, VcpSetting setting, uint16_t raw) {
+    switch (setting) {
+    case VcpSetting::Brightness:
+        return PercentFromRange(raw, profile.brightness_min, profile.brightness_max);
+    case VcpSetting::Contrast:
+        return PercentFromRange(raw, profile.contrast_min, profile.contrast_max);
+    case VcpSetting::Input: {
+        // Input values are the low byte of the standard input code
+        int api_value = profile.FindApiValue(raw & 0xFF);
+        return api_value != 0 ? api_value : VCP_VALUE_UNSET;
+    }
+    }
+    return VCP_VALUE_UNSET;
+}
+
+static uint8_t SettingBit(VcpSetting setting) {
+    return static_cast<uint8_t>(1u << static_cast<int>(setting));
+}
+
+bool MakeVcpWrite(int display_index, VcpSetting setting, int value, VcpWrite& write) {
+    write.display_index = display_index;
+    write.setting = setting;
+    write.value = value;
+
+    // Percentages are scaled onto the model's raw range; inputs come from its table
+    std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(display_index);
+    switch (setting) {
+    case VcpSetting::Brightness:
+        if (value < 0 || value > 100) return false;
+        write.packet = MakeDdcPacket(VCP_BRIGHTNESS, ScaleToRange(value, profile->brightness_min, profile->brightness_max));
+        return true;
+    case VcpSetting::Contrast:
+        if (value < 0 || value > 100) return false;
+        write.packet = MakeDdcPacket(VCP_CONTRAST, ScaleToRange(value, profile->contrast_min, profile->contrast_max));
+        return true;
+    case VcpSetting::Input: {
+        const ProfileInput* input = profile->FindInput(value);
+        if (!input) return false;
+        write.packet = MakeDdcPacket(profile->input_code, input->value, profile->input_register);
+        return true;
+    }
+    }
+    return false;
+}
 
 ThreadSafeMonitorControl::ThreadSafeMonitorControl(AppState* state)
-    : app_state(state) {
+    : app_state(state), state_version(1), wake_generation(0), shutting_down(false) {
+    transitions = std::make_unique<TransitionEngine>(this);
+    sequences = std::make_unique<SequenceRunner>();
 }
 
-bool ThreadSafeMonitorControl::SetBrightness(float brightness) {
-    if (brightness < 0.0f || brightness > 100.0f) {
-        return false;
+ThreadSafeMonitorControl::~ThreadSafeMonitorControl() {
+    Shutdown(-1);
+    {
+        std::lock_guard<std::mutex> lock(executor_mutex);
+        executors.clear();
+    }
+    transitions.reset();
+}
+
+std::vector<DisplayHealth> ThreadSafeMonitorControl::GetDisplayHealth() {
+    std::vector<DisplayHealth> health;
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    for (const auto& executor : executors) {
+        if (executor) {
+            DisplayHealth display;
+            display.display_index = executor->GetDisplayIndex();
+            display.breaker = executor->GetBreakerState();
+            display.stats = executor->GetStats();
+            health.push_back(display);
+        }
+    }
+    return health;
+}
+
+void ThreadSafeMonitorControl::SetDisplayGroups(const std::map<std::string, std::vector<int>>& groups) {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    display_groups = groups;
+}
+
+std::map<std::string, std::vector<int>> ThreadSafeMonitorControl::GetDisplayGroups() {
+    std::lock_guard<std::mutex> lock(groups_mutex);
+    return display_groups;
+}
+
+bool ThreadSafeMonitorControl::CommitGroup(const std::string& group, VcpSetting setting, int value,
+                                           GroupCommitResult& result, DisplayExecutor::Deadline deadline,
+                                           DisplayExecutor::Lane lane) {
+    std::vector<int> members;
+    {
+        std::lock_guard<std::mutex> lock(groups_mutex);
+        auto it = display_groups.find(group);
+        if (it == display_groups.end()) {
+            return false;
+        }
+        members = it->second;
+    }
+
+    // Encode every member's packet before anything is queued
+    std::vector<VcpWrite> writes(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        if (!MakeVcpWrite(members[i], setting, value, writes[i])) {
+            return false;
+        }
+        writes[i].deadline = deadline;
+        writes[i].lane = lane;
+        transitions->Cancel(members[i], setting);
+    }
+
+    auto barrier = std::make_shared<CommitBarrier>(static_cast<int>(writes.size()), GROUP_BARRIER_TIMEOUT_MS);
+    for (size_t i = 0; i < writes.size(); i++) {
+        int member = static_cast<int>(i);
+        DisplayExecutor* executor = GetExecutor(writes[i].display_index);
+        if (!executor) {
+            barrier->Finish(member, false);
+            continue;
+        }
+        const VcpWrite& write = writes[i];
+        executor->SubmitGroupMember(write.packet, barrier, member, [this, write, barrier, member](bool ok) {
+            if (ok) {
+                RecordWrite(write);
+            }
+            barrier->Finish(member, ok);
+        }, write.deadline, write.lane);
+    }
+
+    result = barrier->Wait();
+    NotifyStateChanged();
+    return true;
+}
+
+int ThreadSafeMonitorControl::IdentifyDisplays(const MonitorProfileDb& db) {
+    std::vector<NvDisplayHandle> displays;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (app_state->nvapi_initialized) {
+            displays.assign(app_state->displays, app_state->displays + app_state->display_count);
+        }
+    }
+
+    std::vector<DisplayProfileInfo> identified;
+    int matched = 0;
+    for (size_t i = 0; i < displays.size(); i++) {
+        DisplayProfileInfo info;
+        info.display_index = static_cast<int>(i);
+        MonitorProfile profile = BuiltInMonitorProfile();
+
+        NvPhysicalGpuHandle gpu = nullptr;
+        NvU32 output_id = 0;
+        NvU8 edid[NV_EDID_DATA_SIZE];
+        NvU32 edid_size = 0;
+        info.edid_read = GetGpuFromDisplay(displays[i], &gpu, &output_id) &&
+                         ReadDisplayEdid(gpu, output_id, edid, &edid_size) &&
+                         ParseEdidId(edid, edid_size, info.edid);
+        if (info.edid_read && db.Find(info.edid.manufacturer, info.edid.product, profile)) {
+            info.matched = true;
+            matched++;
+        }
+
+        DisplayProfiles::Set(info.display_index, profile);
+        info.profile = DisplayProfiles::Get(info.display_index);
+        identified.push_back(info);
     }
 
     std::lock_guard<std::mutex> lock(state_mutex);
+    display_profiles = identified;
+    return matched;
+}
 
-    if (!app_state->nvapi_initialized) {
+std::vector<DisplayProfileInfo> ThreadSafeMonitorControl::GetDisplayProfiles() {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    return display_profiles;
+}
+
+bool ThreadSafeMonitorControl::StartRecording(const std::string& path) {
+    auto log = std::make_shared<DdcRecorder>();
+    if (!log->Open(path)) {
         return false;
     }
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    recorder = log;
+    return true;
+}
+
+ShutdownReport ThreadSafeMonitorControl::Shutdown(int timeout_ms) {
+    ShutdownReport report;
+    if (shutting_down.exchange(true)) {
+        return report;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = timeout_ms < 0 ? std::chrono::steady_clock::time_point::max()
+                                   : start + std::chrono::milliseconds(timeout_ms);
+
+    // Stop issuing transition steps first; queued steps still complete into the engine
+    transitions->Stop();
+    sequences->Stop();  // Sequences in a delay fail now; the rest fail at their next step
+    {
+        std::lock_guard<std::mutex> lock(latest_mutex);
+        latest_stopping = true; // Pending latest values are dropped, not resubmitted
+    }
+
+    // Executors are kept alive (callers may still hold pointers) but stop
+    // accepting work; all of them drain in parallel before any is joined
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    for (const auto& executor : executors) {
+        if (executor) {
+            executor->RequestStop(deadline);
+        }
+    }
+    for (auto& executor : executors) {
+        if (executor) {
+            bool joined = executor->Stop(deadline);
+            report.displays++;
+            report.failed_commands += executor->GetStats().failed_on_stop;
+            if (!joined) {
+                // Its worker is still inside the transport and uses the
+                // executor when the call returns, so it is never freed
+                executor.release();
+                report.abandoned++;
+            }
+        }
+    }
 
-    BYTE value = (BYTE)brightness;
-    BOOL result = WriteValueToMonitor(app_state->current_gpu, app_state->current_output_id,
-                                     value, 0x10, 0x51); // 0x10 = brightness VCP code
+    auto finished = std::chrono::steady_clock::now();
+    report.elapsed_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(finished - start).count());
+    report.met_deadline = report.abandoned == 0 && finished <= deadline;
+    return report;
+}
+
+DisplayExecutor* ThreadSafeMonitorControl::GetExecutor(int display_index) {
+    if (shutting_down) {
+        return nullptr;
+    }
+
+    NvDisplayHandle display = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (!app_state->nvapi_initialized || display_index < 0 || display_index >= app_state->display_count) {
+            return nullptr;
+        }
+        display = app_state->displays[display_index];
+    }
+
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    if (shutting_down) {
+        return nullptr; // Shutdown() ran while the display handle was looked up
+    }
+    if ((int)executors.size() <= display_index) {
+        executors.resize(display_index + 1);
+    }
+    if (!executors[display_index]) {
+        NvPhysicalGpuHandle gpu = nullptr;
+        NvU32 output_id = 0;
+        if (!GetGpuFromDisplay(display, &gpu, &output_id)) {
+            return nullptr;
+        }
+        std::unique_ptr<DdcTransport> transport = std::make_unique<NvApiTransport>(gpu, output_id);
+        if (recorder) {
+            transport = std::make_unique<RecordingTransport>(display_index, std::move(transport), recorder);
+        }
+        std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(display_index);
+        InputSwitchCommand input_switch;
+        input_switch.register_address = profile->input_register;
+        input_switch.command_code = profile->input_code;
+        input_switch.quiet_ms = profile->input_quiet_ms;
+        executors[display_index] = std::make_unique<DisplayExecutor>(display_index, std::move(transport), input_switch);
+    }
+    return executors[display_index].get();
+}
+
+void ThreadSafeMonitorControl::RecordWrite(const VcpWrite& write) {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    SetKnownValueLocked(write.display_index, write.setting, write.value);
+}
+
+void ThreadSafeMonitorControl::SetKnownValueLocked(int display_index, VcpSetting setting, int value) {
+    if ((int)known_state.size() <= display_index) {
+        known_state.resize(display_index + 1);
+        unverified.resize(display_index + 1, 0);
+    }
+    known_state[display_index].Set(setting, value);
+    unverified[display_index] &= static_cast<uint8_t>(~SettingBit(setting));
+    state_store.Save(display_index, known_state[display_index]);
+
+    // Keep the GUI's view of the selected display in sync
+    if (display_index == app_state->selected_display) {
+        if (setting == VcpSetting::Brightness) {
+            app_state->brightness = (float)value;
+        } else if (setting == VcpSetting::Contrast) {
+            app_state->contrast = (float)value;
+        }
+    }
+}
+
+bool ThreadSafeMonitorControl::Write(const VcpWrite& write) {
+    transitions->Cancel(write.display_index, write.setting);
+
+    DisplayExecutor* executor = GetExecutor(write.display_index);
+    if (!executor) {
+        return false;
+    }
 
+    bool result = executor->Submit(write.packet, write.deadline, write.lane).get();
     if (result) {
-        app_state->brightness = brightness;
-        snprintf(app_state->status_message, sizeof(app_state->status_message),
-                "Brightness set to %.0f%% via API", brightness);
-        return true;
-    } else {
+        RecordWrite(write);
+    }
+    NotifyStateChanged();   // A failure changes the display's health
+    return result;
+}
+
+void ThreadSafeMonitorControl::SubmitWrite(const VcpWrite& write, DisplayExecutor::Completion on_complete) {
+    DisplayExecutor* executor = GetExecutor(write.display_index);
+    if (!executor) {
+        on_complete(false);
+        return;
+    }
+
+    executor->Submit(write.packet, [this, write, on_complete](bool result) {
+        if (result) {
+            RecordWrite(write);
+        }
+        on_complete(result);
+        NotifyStateChanged();   // After on_complete: a finished transition is no longer counted
+    }, write.deadline, write.lane);
+}
+
+bool ThreadSafeMonitorControl::StartTransition(int display_index, VcpSetting setting, int target,
+                                               int duration_ms, Easing easing) {
+    VcpWrite probe;
+    if (setting == VcpSetting::Input || !IsInitialized()) {
+        return false; // Only continuous settings can be interpolated
+    }
+
+    if (display_index < 0 || display_index >= GetDisplayCount() ||
+        !MakeVcpWrite(display_index, setting, target, probe)) {
+        return false;
+    }
+
+    int current = GetKnownSettings(display_index).Get(setting);
+    transitions->Start(display_index, setting, current, target, duration_ms, easing);
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
         snprintf(app_state->status_message, sizeof(app_state->status_message),
-                "Failed to set brightness via API");
+                "Display %d %s transition to %d%% over %d ms", display_index,
+                setting == VcpSetting::Brightness ? "brightness" : "contrast", target, duration_ms);
+    }
+    NotifyStateChanged();
+    return true;
+}
+
+bool ThreadSafeMonitorControl::MatchSettingWrite(int display_index, uint8_t command_code, uint16_t value,
+                                                 uint8_t register_address, VcpWrite& write) {
+    if (register_address == DDC_VCP_REGISTER && command_code == VCP_BRIGHTNESS) {
+        return MakeVcpWrite(display_index, VcpSetting::Brightness, value, write);
+    }
+    if (register_address == DDC_VCP_REGISTER && command_code == VCP_CONTRAST) {
+        return MakeVcpWrite(display_index, VcpSetting::Contrast, value, write);
+    }
+    std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(display_index);
+    if (register_address == profile->input_register && command_code == profile->input_code) {
+        int api_value = profile->FindApiValue(value);
+        return api_value != 0 && MakeVcpWrite(display_index, VcpSetting::Input, api_value, write);
+    }
+    return false;
+}
+
+bool ThreadSafeMonitorControl::WriteRaw(int display_index, uint8_t command_code, uint16_t value,
+                                        uint8_t register_address, DisplayExecutor::Deadline deadline,
+                                        DisplayExecutor::Lane lane) {
+    VcpWrite write;
+    if (MatchSettingWrite(display_index, command_code, value, register_address, write)) {
+        write.deadline = deadline;
+        write.lane = lane;
+        return Write(write);
+    }
+
+    DisplayExecutor* executor = GetExecutor(display_index);
+    if (!executor) {
         return false;
     }
+    return executor->Submit(MakeDdcPacket(command_code, value, register_address), deadline, lane).get();
 }
 
-bool ThreadSafeMonitorControl::SetContrast(float contrast) {
-    if (contrast < 0.0f || contrast > 100.0f) {
+bool ThreadSafeMonitorControl::ReadRaw(int display_index, uint8_t command_code, uint8_t register_address,
+                                       uint16_t& current_value, uint16_t& maximum_value,
+                                       DisplayExecutor::Deadline deadline, DisplayExecutor::Lane lane) {
+    DisplayExecutor* executor = GetExecutor(display_index);
+    if (!executor) {
         return false;
     }
+    return executor->SubmitRead(command_code, register_address, &current_value, &maximum_value, deadline, lane).get();
+}
+
+bool ThreadSafeMonitorControl::RunSequence(int display_index, const std::vector<SequenceStep>& steps,
+                                           SequenceResult& result, DisplayExecutor::Deadline deadline,
+                                           DisplayExecutor::Lane lane) {
+    auto program = std::make_shared<DdcProgram>();
+    CompileDdcSequence(steps, *program);
+    return RunProgram(program, display_index, result, deadline, lane);
+}
+
+bool ThreadSafeMonitorControl::RunProgram(std::shared_ptr<const DdcProgram> program, int display_index,
+                                          SequenceResult& result, DisplayExecutor::Deadline deadline,
+                                          DisplayExecutor::Lane lane) {
+    // Every display is checked before the first step, so a macro never
+    // stops halfway for a display that was not there to begin with
+    std::vector<int> displays = program->displays;
+    if (program->uses_default_display) {
+        displays.push_back(display_index);
+    }
+    // The executors are looked up now: GetExecutor returns null once shutdown
+    // begins, which can be before the macro first reaches a display. An
+    // executor stays allocated after shutdown and fails what it is given.
+    std::map<int, DisplayExecutor*> resolved;
+    for (int display : displays) {
+        DisplayExecutor* executor = GetExecutor(display);
+        if (!executor) {
+            return false;
+        }
+        resolved[display] = executor;
+    }
 
-    std::lock_guard<std::mutex> lock(state_mutex);
+    // Reads go straight to the queue; writes of a known setting go through
+    // SubmitWrite like WriteRaw so the known state stays accurate
+    SequenceRunner::BusFor buses = [this, resolved, deadline, lane](int display) {
+        auto found = resolved.find(display);
+        DisplayExecutor* executor = found == resolved.end() ? nullptr : found->second;
+        SequenceRunner::Bus bus = SequenceRunner::ExecutorBus(executor, deadline, lane);
+        if (!executor) {
+            return bus;
+        }
+        bus.write = [this, executor, display, deadline, lane](const DdcPacket& packet,
+                                                              DisplayExecutor::Completion on_complete) {
+            VcpWrite write;
+            if (MatchSettingWrite(display, packet.CommandCode(), packet.Value(), packet.register_address, write)) {
+                write.deadline = deadline;
+                write.lane = lane;
+                transitions->Cancel(display, write.setting);
+                SubmitWrite(write, std::move(on_complete));
+            } else {
+                executor->Submit(packet, std::move(on_complete), deadline, lane);
+            }
+        };
+        return bus;
+    };
 
-    if (!app_state->nvapi_initialized) {
+    result = sequences->Run(buses, program, display_index).get();
+    NotifyStateChanged();
+    return true;
+}
+
+void ThreadSafeMonitorControl::SetConfigMacros(const std::map<std::string, std::string>& sources) {
+    std::lock_guard<std::mutex> lock(macros_mutex);
+    for (auto it = macros.begin(); it != macros.end();) {
+        it = it->second.from_config ? macros.erase(it) : std::next(it);
+    }
+    for (const auto& source : sources) {
+        auto program = std::make_shared<DdcProgram>();
+        std::string error;
+        if (CompileDdcMacro(source.second, *program, error)) {
+            StoredMacro& macro = macros[source.first];
+            macro.name = source.first;
+            macro.source = source.second;
+            macro.from_config = true;
+            macro.program = program;
+        }
+    }
+}
+
+bool ThreadSafeMonitorControl::StoreMacro(const std::string& name, const std::string& source, std::string& error) {
+    auto program = std::make_shared<DdcProgram>();
+    if (!CompileDdcMacro(source, *program, error)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(macros_mutex);
+    auto found = macros.find(name);
+    if (found != macros.end() && found->second.from_config) {
+        error = "Macro is defined in config.env";
         return false;
     }
+    StoredMacro& macro = macros[name];
+    macro.name = name;
+    macro.source = source;
+    macro.from_config = false;
+    macro.program = program;
+    return true;
+}
 
-    BYTE value = (BYTE)contrast;
-    BOOL result = WriteValueToMonitor(app_state->current_gpu, app_state->current_output_id,
-                                     value, 0x12, 0x51); // 0x12 = contrast VCP code
+bool ThreadSafeMonitorControl::DeleteMacro(const std::string& name) {
+    std::lock_guard<std::mutex> lock(macros_mutex);
+    auto found = macros.find(name);
+    if (found == macros.end() || found->second.from_config) {
+        return false;
+    }
+    macros.erase(found);
+    return true;
+}
 
-    if (result) {
-        app_state->contrast = contrast;
-        snprintf(app_state->status_message, sizeof(app_state->status_message),
-                "Contrast set to %.0f%% via API", contrast);
-        return true;
-    } else {
-        snprintf(app_state->status_message, sizeof(app_state->status_message),
-                "Failed to set contrast via API");
+bool ThreadSafeMonitorControl::GetMacro(const std::string& name, StoredMacro& macro) {
+    std::lock_guard<std::mutex> lock(macros_mutex);
+    auto found = macros.find(name);
+    if (found == macros.end()) {
         return false;
     }
+    macro = found->second;
+    return true;
+}
+
+std::vector<StoredMacro> ThreadSafeMonitorControl::GetMacros() {
+    std::lock_guard<std::mutex> lock(macros_mutex);
+    std::vector<StoredMacro> result;
+    for (const auto& macro : macros) {
+        result.push_back(macro.second);
+    }
+    return result;
+}
+
+bool ThreadSafeMonitorControl::WriteLatest(const VcpWrite& write, DisplayExecutor::Completion on_complete) {
+    transitions->Cancel(write.display_index, write.setting);
+
+    {
+        std::lock_guard<std::mutex> lock(latest_mutex);
+        LatestSlot& slot = latest_slots[std::make_pair(write.display_index, write.setting)];
+        if (slot.in_flight) {
+            bool replaced = slot.has_pending;
+            slot.pending = write;
+            slot.pending_done = std::move(on_complete);
+            slot.has_pending = true;
+            return !replaced;
+        }
+        slot.in_flight = true;
+    }
+
+    SendLatest(write, std::move(on_complete));
+    return true;
+}
+
+void ThreadSafeMonitorControl::SendLatest(const VcpWrite& write, DisplayExecutor::Completion on_complete) {
+    SubmitWrite(write, [this, write, on_complete](bool result) {
+        if (on_complete) {
+            on_complete(result);
+        }
+
+        VcpWrite next;
+        DisplayExecutor::Completion next_done;
+        {
+            std::lock_guard<std::mutex> lock(latest_mutex);
+            LatestSlot& slot = latest_slots[std::make_pair(write.display_index, write.setting)];
+            if (!slot.has_pending || latest_stopping) {
+                slot.in_flight = false;
+                slot.has_pending = false;
+                slot.pending_done = nullptr;
+                return;
+            }
+            next = slot.pending;
+            next_done = std::move(slot.pending_done);
+            slot.pending_done = nullptr;
+            slot.has_pending = false;
+        }
+        SendLatest(next, std::move(next_done));
+    });
+}
+
+int ThreadSafeMonitorControl::GetActiveTransitionCount() {
+    return transitions->GetActiveCount();
+}
+
+InputSwitchStatus ThreadSafeMonitorControl::GetInputSwitchStatus() {
+    InputSwitchStatus status;
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    for (const auto& executor : executors) {
+        if (!executor) {
+            continue;
+        }
+        if (executor->GetLinkState() == DisplayExecutor::LinkState::Switching) {
+            status.switching_displays++;
+        }
+        DisplayExecutor::Stats stats = executor->GetStats();
+        status.totals.input_switches += stats.input_switches;
+        status.totals.switches_skipped += stats.switches_skipped;
+        status.totals.commands_deferred += stats.commands_deferred;
+        if (stats.last_settle_ms > status.totals.last_settle_ms) {
+            status.totals.last_settle_ms = stats.last_settle_ms;
+        }
+    }
+    return status;
+}
+
+ApplyResult ThreadSafeMonitorControl::ApplyWrites(const std::vector<VcpWrite>& writes) {
+    ApplyResult result;
+
+    for (const VcpWrite& write : writes) {
+        transitions->Cancel(write.display_index, write.setting);
+    }
+
+    // Diff against the known state; unknown and unverified values always get written
+    std::vector<const VcpWrite*> pending;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        for (const VcpWrite& write : writes) {
+            if (write.display_index < (int)known_state.size() &&
+                known_state[write.display_index].Get(write.setting) == write.value &&
+                !(unverified[write.display_index] & SettingBit(write.setting))) {
+                result.writes_skipped++;
+            } else {
+                pending.push_back(&write);
+            }
+        }
+    }
+
+    // Queue everything first so each display's worker runs concurrently
+    std::vector<std::future<bool>> futures;
+    std::vector<const VcpWrite*> submitted;
+    for (const VcpWrite* write : pending) {
+        DisplayExecutor* executor = GetExecutor(write->display_index);
+        if (!executor) {
+            result.writes_failed++;
+            continue;
+        }
+        futures.push_back(executor->Submit(write->packet, write->deadline, write->lane));
+        submitted.push_back(write);
+    }
+
+    for (size_t i = 0; i < futures.size(); i++) {
+        if (futures[i].get()) {
+            RecordWrite(*submitted[i]);
+            result.writes_sent++;
+        } else {
+            result.writes_failed++;
+        }
+    }
+    if (!futures.empty()) {
+        NotifyStateChanged();
+    }
+
+    return result;
+}
+
+ApplyResult ThreadSafeMonitorControl::ApplyPreset(const Preset& preset, DisplayExecutor::Deadline deadline,
+                                                  DisplayExecutor::Lane lane) {
+    const VcpSetting settings[] = { VcpSetting::Brightness, VcpSetting::Contrast, VcpSetting::Input };
+
+    std::vector<VcpWrite> writes;
+    for (const PresetEntry& entry : preset.displays) {
+        for (VcpSetting setting : settings) {
+            int value = entry.settings.Get(setting);
+            VcpWrite write;
+            write.deadline = deadline;
+            write.lane = lane;
+            if (value != VCP_VALUE_UNSET && MakeVcpWrite(entry.display_index, setting, value, write)) {
+                writes.push_back(write);
+            }
+        }
+    }
+
+    ApplyResult result = ApplyWrites(writes);
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        snprintf(app_state->status_message, sizeof(app_state->status_message),
+                "Preset %s applied via API (%d sent, %d unchanged, %d failed)", preset.name.c_str(),
+                result.writes_sent, result.writes_skipped, result.writes_failed);
+    }
+    NotifyStateChanged();
+    return result;
 }
 
-bool ThreadSafeMonitorControl::SetInputSource(int source) {
-    if (source < 1 || source > 4) {
+bool ThreadSafeMonitorControl::SetBrightness(float brightness, DisplayExecutor::Deadline deadline,
+                                             DisplayExecutor::Lane lane) {
+    if (brightness < 0.0f || brightness > 100.0f) {
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(state_mutex);
+    if (!IsInitialized()) {
+        return false;
+    }
+
+    VcpWrite write;
+    MakeVcpWrite(GetSelectedDisplay(), VcpSetting::Brightness, (int)brightness, write);
+    write.deadline = deadline;
+    write.lane = lane;
 
-    if (!app_state->nvapi_initialized) {
+    bool result = Write(write);
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (result) {
+            app_state->brightness = brightness;
+            snprintf(app_state->status_message, sizeof(app_state->status_message),
+                    "Brightness set to %.0f%% via API", brightness);
+        } else {
+            snprintf(app_state->status_message, sizeof(app_state->status_message),
+                    "Failed to set brightness via API");
+        }
+    }
+    NotifyStateChanged();
+    return result;
+}
+
+bool ThreadSafeMonitorControl::SetContrast(float contrast, DisplayExecutor::Deadline deadline,
+                                           DisplayExecutor::Lane lane) {
+    if (contrast < 0.0f || contrast > 100.0f) {
+        return false;
+    }
+
+    if (!IsInitialized()) {
         return false;
     }
 
-    const InputSourceMapping& mapping = input_mappings[source - 1];
+    VcpWrite write;
+    MakeVcpWrite(GetSelectedDisplay(), VcpSetting::Contrast, (int)contrast, write);
+    write.deadline = deadline;
+    write.lane = lane;
 
-    BOOL result = WriteValueToMonitor(app_state->current_gpu, app_state->current_output_id,
-                                     mapping.input_value, mapping.command_code,
-                                     mapping.register_address);
+    bool result = Write(write);
 
-    if (result) {
-        snprintf(app_state->status_message, sizeof(app_state->status_message),
-                "Input switched to %s via API", mapping.name);
-        return true;
-    } else {
-        snprintf(app_state->status_message, sizeof(app_state->status_message),
-                "Failed to switch to %s via API", mapping.name);
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (result) {
+            app_state->contrast = contrast;
+            snprintf(app_state->status_message, sizeof(app_state->status_message),
+                    "Contrast set to %.0f%% via API", contrast);
+        } else {
+            snprintf(app_state->status_message, sizeof(app_state->status_message),
+                    "Failed to set contrast via API");
+        }
+    }
+    NotifyStateChanged();
+    return result;
+}
+
+bool ThreadSafeMonitorControl::SetInputSource(int source, DisplayExecutor::Deadline deadline,
+                                              DisplayExecutor::Lane lane) {
+    int display_index = GetSelectedDisplay();
+    std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(display_index);
+    const ProfileInput* input = profile->FindInput(source);
+    VcpWrite write;
+    if (!input || !MakeVcpWrite(display_index, VcpSetting::Input, source, write)) {
+        return false;
+    }
+    write.deadline = deadline;
+    write.lane = lane;
+
+    if (!IsInitialized()) {
         return false;
     }
+
+    bool result = Write(write);
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (result) {
+            snprintf(app_state->status_message, sizeof(app_state->status_message),
+                    "Input switched to %s via API", input->name);
+        } else {
+            snprintf(app_state->status_message, sizeof(app_state->status_message),
+                    "Failed to switch to %s via API", input->name);
+        }
+    }
+    NotifyStateChanged();
+    return result;
 }
 
 float ThreadSafeMonitorControl::GetBrightness() {
@@ -124,6 +812,11 @@ int ThreadSafeMonitorControl::GetSelectedDisplay() {
     return app_state->selected_display;
 }
 
+int ThreadSafeMonitorControl::GetDisplayCount() {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    return app_state->display_count;
+}
+
 bool ThreadSafeMonitorControl::IsInitialized() {
     std::lock_guard<std::mutex> lock(state_mutex);
     return app_state->nvapi_initialized;
@@ -133,3 +826,151 @@ std::string ThreadSafeMonitorControl::GetStatusMessage() {
     std::lock_guard<std::mutex> lock(state_mutex);
     return std::string(app_state->status_message);
 }
+
+void ThreadSafeMonitorControl::SetStatusMessage(const std::string& message) {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        snprintf(app_state->status_message, sizeof(app_state->status_message), "%s", message.c_str());
+    }
+    NotifyStateChanged();
+}
+
+void ThreadSafeMonitorControl::NotifyStateChanged() {
+    {
+        std::lock_guard<std::mutex> lock(version_mutex);
+        state_version++;
+    }
+    version_cv.notify_all();
+}
+
+uint64_t ThreadSafeMonitorControl::GetStateVersion() {
+    std::lock_guard<std::mutex> lock(version_mutex);
+    return state_version;
+}
+
+uint64_t ThreadSafeMonitorControl::WaitForStateChange(uint64_t version, std::chrono::steady_clock::time_point until) {
+    std::unique_lock<std::mutex> lock(version_mutex);
+    uint64_t generation = wake_generation;
+    version_cv.wait_until(lock, until, [this, version, generation] {
+        return state_version != version || wake_generation != generation;
+    });
+    return state_version;
+}
+
+void ThreadSafeMonitorControl::WakeStateWaiters() {
+    {
+        std::lock_guard<std::mutex> lock(version_mutex);
+        wake_generation++;
+    }
+    version_cv.notify_all();
+}
+
+DisplaySettings ThreadSafeMonitorControl::GetKnownSettings(int display_index) {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if (display_index < 0 || display_index >= (int)known_state.size()) {
+        return DisplaySettings();
+    }
+    return known_state[display_index];
+}
+
+std::vector<VcpSetting> ThreadSafeMonitorControl::GetUnverifiedSettings(int display_index) {
+    std::vector<VcpSetting> settings;
+    std::lock_guard<std::mutex> lock(state_mutex);
+    if (display_index < 0 || display_index >= (int)unverified.size()) {
+        return settings;
+    }
+    for (VcpSetting setting : { VcpSetting::Brightness, VcpSetting::Contrast, VcpSetting::Input }) {
+        if (unverified[display_index] & SettingBit(setting)) {
+            settings.push_back(setting);
+        }
+    }
+    return settings;
+}
+
+int ThreadSafeMonitorControl::RestoreState(const std::string& path, std::string& error) {
+    int restored = 0;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (!state_store.Open(path, error)) {
+            return -1;
+        }
+        int count = std::min(app_state->display_count, STATE_MAX_DISPLAYS);
+        if ((int)known_state.size() < count) {
+            known_state.resize(count);
+            unverified.resize(count, 0);
+        }
+        for (int display = 0; display < count; display++) {
+            DisplaySettings saved;
+            time_t saved_at;
+            if (!state_store.Load(display, saved, saved_at)) {
+                continue;
+            }
+            // A value written since startup is newer than the file
+            for (VcpSetting setting : { VcpSetting::Brightness, VcpSetting::Contrast, VcpSetting::Input }) {
+                if (known_state[display].Get(setting) == VCP_VALUE_UNSET && saved.Get(setting) != VCP_VALUE_UNSET) {
+                    known_state[display].Set(setting, saved.Get(setting));
+                    unverified[display] |= SettingBit(setting);
+                }
+            }
+            restored++;
+        }
+
+        int selected = app_state->selected_display;
+        if (selected >= 0 && selected < (int)known_state.size()) {
+            const DisplaySettings& settings = known_state[selected];
+            if (settings.brightness != VCP_VALUE_UNSET) {
+                app_state->brightness = (float)settings.brightness;
+            }
+            if (settings.contrast != VCP_VALUE_UNSET) {
+                app_state->contrast = (float)settings.contrast;
+            }
+        }
+    }
+    NotifyStateChanged();
+    return restored;
+}
+
+int ThreadSafeMonitorControl::RefreshState() {
+    int queued = 0;
+    int count = GetDisplayCount();
+    for (int display = 0; display < count; display++) {
+        DisplayExecutor* executor = GetExecutor(display);
+        if (!executor) {
+            continue;
+        }
+
+        // Inputs behind a vendor register (the LG one) are write-only
+        std::shared_ptr<const MonitorProfile> profile = DisplayProfiles::Get(display);
+        std::vector<std::pair<VcpSetting, uint8_t>> reads = {
+            { VcpSetting::Brightness, VCP_BRIGHTNESS }, { VcpSetting::Contrast, VCP_CONTRAST } };
+        if (profile->input_register == DDC_VCP_REGISTER) {
+            reads.push_back({ VcpSetting::Input, profile->input_code });
+        }
+
+        for (const auto& read : reads) {
+            VcpSetting setting = read.first;
+            auto values = std::make_shared<std::pair<uint16_t, uint16_t>>(0, 0);
+            executor->SubmitRead(read.second, DDC_VCP_REGISTER, &values->first, &values->second,
+                                 [this, display, setting, profile, values](bool result) {
+                int value = result ? SettingFromRaw(*profile, setting, values->first) : VCP_VALUE_UNSET;
+                if (value == VCP_VALUE_UNSET) {
+                    return;     // Stays unverified until written
+                }
+                {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    // A value written since startup is already confirmed, and may be newer than this read
+                    bool confirmed = display < (int)known_state.size() &&
+                                     known_state[display].Get(setting) != VCP_VALUE_UNSET &&
+                                     !(unverified[display] & SettingBit(setting));
+                    if (confirmed) {
+                        return;
+                    }
+                    SetKnownValueLocked(display, setting, value);
+                }
+                NotifyStateChanged();
+            }, DisplayExecutor::NO_DEADLINE, DisplayExecutor::Lane::Bulk);
+            queued++;
+        }
+    }
+    return queued;
+}
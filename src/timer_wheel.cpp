@@ -0,0 +1,157 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+static uint64_t LevelSpan(int level) {
+    return 1ull << (TimerWheel::SLOT_BITS * level);
+}
+
+TimerWheel::TimerWheel(uint64_t start_tick) {
+    Reset(start_tick);
+}
+
+void TimerWheel::Reset(uint64_t start_tick) {
+    current_tick = start_tick;
+    for (int level = 0; level < LEVELS; level++) {
+        for (int slot = 0; slot < SLOTS; slot++) {
+            slots[level][slot].clear();
+        }
+        occupied[level] = 0;
+    }
+    due.clear();
+    active.clear();
+}
+
+bool TimerWheel::IsCurrent(const Entry& entry) const {
+    auto it = active.find(entry.id);
+    return it != active.end() && it->second == entry.expires;
+}
+
+void TimerWheel::Insert(const Entry& entry) {
+    if (entry.expires <= current_tick) {
+        due.push_back(entry);
+        return;
+    }
+
+    uint64_t delta = entry.expires - current_tick;
+    for (int level = 0; level < LEVELS; level++) {
+        bool last_level = (level == LEVELS - 1);
+        if (delta < LevelSpan(level + 1) || last_level) {
+            // Timers beyond the wheel's range park in the farthest slot and re-cascade
+            uint64_t placed = (last_level && delta >= LevelSpan(LEVELS))
+                ? current_tick + LevelSpan(LEVELS) - 1
+                : entry.expires;
+            int slot = static_cast<int>((placed >> (SLOT_BITS * level)) & (SLOTS - 1));
+            slots[level][slot].push_back(entry);
+            occupied[level] |= 1ull << slot;
+            return;
+        }
+    }
+}
+
+void TimerWheel::Schedule(uint64_t id, uint64_t expires) {
+    active[id] = expires; // Any older entry for id becomes stale
+    Insert(Entry{ id, expires });
+}
+
+void TimerWheel::Cancel(uint64_t id) {
+    active.erase(id);
+}
+
+void TimerWheel::Cascade(int level) {
+    int slot = static_cast<int>((current_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    if (!(occupied[level] & (1ull << slot))) {
+        return;
+    }
+
+    std::vector<Entry> entries;
+    entries.swap(slots[level][slot]);
+    occupied[level] &= ~(1ull << slot);
+
+    for (const Entry& entry : entries) {
+        if (IsCurrent(entry)) {
+            Insert(entry);
+        }
+    }
+}
+
+void TimerWheel::Collect(std::vector<Entry>& entries, std::vector<uint64_t>& expired) {
+    for (const Entry& entry : entries) {
+        if (IsCurrent(entry)) {
+            expired.push_back(entry.id);
+            active.erase(entry.id);
+        }
+    }
+    entries.clear();
+}
+
+void TimerWheel::Advance(uint64_t tick, std::vector<uint64_t>& expired) {
+    Collect(due, expired);
+
+    while (current_tick < tick) {
+        uint64_t next = current_tick + 1;
+
+        // Skip empty stretches: jump straight to the next boundary of the
+        // lowest level that still holds timers (or to the target tick)
+        if (occupied[0] == 0) {
+            int level = 1;
+            while (level < LEVELS && occupied[level] == 0) {
+                level++;
+            }
+            if (level == LEVELS) {
+                next = tick;
+            } else {
+                uint64_t boundary = (current_tick | (LevelSpan(level) - 1)) + 1;
+                next = std::min(boundary, tick);
+            }
+        }
+        current_tick = next;
+
+        // Cascade every level whose boundary we just crossed, coarsest first
+        int top = 0;
+        while (top + 1 < LEVELS && (current_tick & (LevelSpan(top + 1) - 1)) == 0) {
+            top++;
+        }
+        for (int level = top; level >= 1; level--) {
+            Cascade(level);
+        }
+
+        int slot = static_cast<int>(current_tick & (SLOTS - 1));
+        if (occupied[0] & (1ull << slot)) {
+            occupied[0] &= ~(1ull << slot);
+            Collect(slots[0][slot], expired);
+        }
+        Collect(due, expired);
+    }
+}
+
+uint64_t TimerWheel::NextExpiry() const {
+    if (!due.empty()) {
+        return current_tick;
+    }
+    if (active.empty()) {
+        return UINT64_MAX;
+    }
+
+    uint64_t best = UINT64_MAX;
+
+    // Level 0 slots map directly to the next 63 ticks
+    for (int i = 1; i < SLOTS; i++) {
+        if (occupied[0] & (1ull << ((current_tick + i) & (SLOTS - 1)))) {
+            best = current_tick + i;
+            break;
+        }
+    }
+
+    // Higher levels: the tick at which the next occupied slot gets cascaded
+    for (int level = 1; level < LEVELS; level++) {
+        uint64_t base = current_tick >> (SLOT_BITS * level);
+        for (int i = 1; i <= SLOTS; i++) {
+            if (occupied[level] & (1ull << ((base + i) & (SLOTS - 1)))) {
+                best = std::min(best, (base + i) << (SLOT_BITS * level));
+                break;
+            }
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,204 @@
+#include "transition_engine.h"
+#include "thread_safe_control.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// How often the engine re-evaluates a transition whose value hasn't changed yet
+static const auto TRANSITION_POLL_INTERVAL = std::chrono::milliseconds(10);
+
+bool ParseEasing(const std::string& name, Easing& easing) {
+    if (name == "linear") {
+        easing = Easing::Linear;
+    } else if (name == "ease-in") {
+        easing = Easing::EaseIn;
+    } else if (name == "ease-out") {
+        easing = Easing::EaseOut;
+    } else if (name == "ease-in-out") {
+        easing = Easing::EaseInOut;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* EasingName(Easing easing) {
+    switch (easing) {
+    case Easing::Linear:    return "linear";
+    case Easing::EaseIn:    return "ease-in";
+    case Easing::EaseOut:   return "ease-out";
+    case Easing::EaseInOut: return "ease-in-out";
+    }
+    return "linear";
+}
+
+static double ApplyEasing(Easing easing, double t) {
+    switch (easing) {
+    case Easing::Linear:    return t;
+    case Easing::EaseIn:    return t * t;
+    case Easing::EaseOut:   return 1.0 - (1.0 - t) * (1.0 - t);
+    case Easing::EaseInOut: return t * t * (3.0 - 2.0 * t);
+    }
+    return t;
+}
+
+TransitionEngine::TransitionEngine(ThreadSafeMonitorControl* monitor_control)
+    : control(monitor_control), next_generation(1), stopping(false) {
+    engine_thread = std::thread(&TransitionEngine::EngineThreadFunc, this);
+}
+
+TransitionEngine::~TransitionEngine() {
+    Stop();
+}
+
+int TransitionEngine::ValueAt(const Transition& transition, Clock::time_point now) {
+    if (now >= transition.end_time) {
+        return transition.target_value;
+    }
+    double total = std::chrono::duration<double>(transition.end_time - transition.start_time).count();
+    double elapsed = std::chrono::duration<double>(now - transition.start_time).count();
+    double t = (total > 0.0) ? std::min(std::max(elapsed / total, 0.0), 1.0) : 1.0;
+    double value = transition.start_value + (transition.target_value - transition.start_value) * ApplyEasing(transition.easing, t);
+    return static_cast<int>(std::lround(value));
+}
+
+void TransitionEngine::Start(int display_index, VcpSetting setting, int current_value, int target_value,
+                             int duration_ms, Easing easing) {
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        Clock::time_point now = Clock::now();
+        Key key(display_index, setting);
+
+        auto it = transitions.find(key);
+        if (it != transitions.end()) {
+            // Retarget from wherever the running transition is right now;
+            // an in-flight write stays in flight and is accounted for normally
+            it->second.start_value = ValueAt(it->second, now);
+        } else {
+            Transition transition;
+            transition.generation = next_generation++;
+            transition.last_sent = current_value;
+            // Without a known starting point there is nothing to interpolate from
+            transition.start_value = (current_value == VCP_VALUE_UNSET) ? target_value : current_value;
+            it = transitions.emplace(key, transition).first;
+        }
+
+        Transition& transition = it->second;
+        transition.target_value = target_value;
+        transition.start_time = now;
+        transition.end_time = now + std::chrono::milliseconds(std::max(duration_ms, 0));
+        transition.easing = easing;
+    }
+    engine_cv.notify_one();
+}
+
+void TransitionEngine::Cancel(int display_index, VcpSetting setting) {
+    std::lock_guard<std::mutex> lock(engine_mutex);
+    transitions.erase(Key(display_index, setting));
+}
+
+int TransitionEngine::GetCurrentValue(int display_index, VcpSetting setting) {
+    std::lock_guard<std::mutex> lock(engine_mutex);
+    auto it = transitions.find(Key(display_index, setting));
+    if (it == transitions.end()) {
+        return VCP_VALUE_UNSET;
+    }
+    return ValueAt(it->second, Clock::now());
+}
+
+int TransitionEngine::GetActiveCount() {
+    std::lock_guard<std::mutex> lock(engine_mutex);
+    return static_cast<int>(transitions.size());
+}
+
+void TransitionEngine::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        stopping = true;
+        transitions.clear();
+    }
+    engine_cv.notify_one();
+
+    if (engine_thread.joinable()) {
+        engine_thread.join();
+    }
+}
+
+void TransitionEngine::EngineThreadFunc() {
+    struct PendingStep {
+        Key key;
+        unsigned generation;
+        VcpWrite write;
+    };
+
+    std::unique_lock<std::mutex> lock(engine_mutex);
+    while (!stopping) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point wake = Clock::time_point::max();
+        std::vector<PendingStep> steps;
+
+        for (auto it = transitions.begin(); it != transitions.end();) {
+            Transition& transition = it->second;
+            if (transition.write_in_flight) {
+                ++it; // Completion callback wakes us up
+                continue;
+            }
+
+            // Always send the value for *now*: intermediate values are dropped when the bus is slow
+            int value = ValueAt(transition, now);
+            if (value != transition.last_sent) {
+                PendingStep step;
+                step.key = it->first;
+                step.generation = transition.generation;
+                if (MakeVcpWrite(it->first.first, it->first.second, value, step.write)) {
+                    step.write.lane = DisplayExecutor::Lane::Bulk;
+                    transition.write_in_flight = true;
+                    steps.push_back(step);
+                    ++it;
+                } else {
+                    it = transitions.erase(it);
+                }
+                continue;
+            }
+
+            if (now >= transition.end_time) {
+                it = transitions.erase(it); // Target reached
+                continue;
+            }
+
+            wake = std::min(wake, now + TRANSITION_POLL_INTERVAL);
+            ++it;
+        }
+
+        if (!steps.empty()) {
+            // Submit without holding engine_mutex - completions may run inline
+            lock.unlock();
+            for (const PendingStep& step : steps) {
+                Key key = step.key;
+                unsigned generation = step.generation;
+                int value = step.write.value;
+                control->SubmitWrite(step.write, [this, key, generation, value](bool ok) {
+                    std::lock_guard<std::mutex> completion_lock(engine_mutex);
+                    auto found = transitions.find(key);
+                    if (found != transitions.end() && found->second.generation == generation) {
+                        found->second.write_in_flight = false;
+                        if (ok) {
+                            found->second.last_sent = value;
+                        } else {
+                            transitions.erase(found); // Give up rather than hammer a failing bus
+                        }
+                    }
+                    engine_cv.notify_one();
+                });
+            }
+            lock.lock();
+            continue;
+        }
+
+        if (wake == Clock::time_point::max()) {
+            engine_cv.wait(lock);
+        } else {
+            engine_cv.wait_until(lock, wake);
+        }
+    }
+}
@@ -0,0 +1,179 @@
+// Latency comparison of the control API over loopback TCP and an AF_UNIX socket
+//
+// Usage:
+//   transport_bench [requests] --self-host
+//       Start in-process listeners on both transports with stub /health and
+//       /api/status handlers, so only transport cost is measured.
+//   transport_bench [requests] <host:port> <socket_path>
+//       Measure a running monitor_control_gui (UNIX_SOCKET set in config.env).
+//
+// The request mix alternates GET /health and GET /api/status (read-only, no
+// monitor I/O). Each transport is measured twice: with one keep-alive
+// connection, and with a new connection per request like curl-driven scripts.
+
+#include "httplib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+struct LatencyStats {
+    double mean_us = 0;
+    double p50_us = 0;
+    double p90_us = 0;
+    double p99_us = 0;
+    int failures = 0;
+};
+
+static LatencyStats Summarize(std::vector<double>& samples, int failures) {
+    LatencyStats stats;
+    stats.failures = failures;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) {
+        total += sample;
+    }
+    stats.mean_us = total / samples.size();
+    stats.p50_us = samples[samples.size() * 50 / 100];
+    stats.p90_us = samples[samples.size() * 90 / 100];
+    stats.p99_us = samples[samples.size() * 99 / 100];
+    return stats;
+}
+
+static std::unique_ptr<httplib::Client> MakeClient(bool use_unix, const std::string& host, int port,
+                                                   const std::string& socket_path, bool keep_alive) {
+    std::unique_ptr<httplib::Client> client;
+    if (use_unix) {
+        client = std::make_unique<httplib::Client>(socket_path);
+        client->set_address_family(AF_UNIX);
+    } else {
+        client = std::make_unique<httplib::Client>(host, port);
+        client->set_tcp_nodelay(true);
+    }
+    client->set_keep_alive(keep_alive);
+    return client;
+}
+
+static LatencyStats Measure(bool use_unix, bool keep_alive, int requests, const std::string& host, int port,
+                            const std::string& socket_path) {
+    static const char* const REQUEST_MIX[] = { "/health", "/api/status" };
+
+    std::vector<double> samples;
+    samples.reserve(requests);
+    int failures = 0;
+
+    std::unique_ptr<httplib::Client> client = MakeClient(use_unix, host, port, socket_path, keep_alive);
+    for (int i = 0; i < requests + requests / 10; i++) {
+        if (!keep_alive) {
+            client = MakeClient(use_unix, host, port, socket_path, false);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto result = client->Get(REQUEST_MIX[i % 2]);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        if (i < requests / 10) {
+            continue; // Warm-up
+        }
+        if (!result || result->status != 200) {
+            failures++;
+            continue;
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    return Summarize(samples, failures);
+}
+
+static void PrintRow(const char* transport, const char* mode, const LatencyStats& stats) {
+    printf("%-12s %-16s %9.1f %9.1f %9.1f %9.1f %8d\n", transport, mode,
+           stats.mean_us, stats.p50_us, stats.p90_us, stats.p99_us, stats.failures);
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    int requests = 2000;
+    int arg = 1;
+    if (arg < argc && atoi(argv[arg]) > 0) {
+        requests = atoi(argv[arg++]);
+    }
+
+    std::string host = "127.0.0.1";
+    int port = 45678;
+    std::string socket_path;
+    bool self_host = false;
+
+    if (arg < argc && std::string(argv[arg]) == "--self-host") {
+        self_host = true;
+        socket_path = "transport_bench.sock";
+    } else if (arg + 1 < argc) {
+        std::string host_port = argv[arg];
+        size_t colon = host_port.find(':');
+        host = host_port.substr(0, colon);
+        if (colon != std::string::npos) {
+            port = atoi(host_port.c_str() + colon + 1);
+        }
+        socket_path = argv[arg + 1];
+    } else {
+        printf("Usage: transport_bench [requests] --self-host\n");
+        printf("       transport_bench [requests] <host:port> <socket_path>\n");
+        return 1;
+    }
+
+    // Stub listeners returning bodies of the same size as the real handlers
+    httplib::Server tcp_server;
+    httplib::Server unix_server;
+    std::vector<std::thread> listeners;
+    if (self_host) {
+        for (httplib::Server* server : { &tcp_server, &unix_server }) {
+            server->Get("/health", [](const httplib::Request&, httplib::Response& res) {
+                res.set_content("{\"status\": \"ok\", \"version\": \"1.0.0\"}", "application/json");
+            });
+            server->Get("/api/status", [](const httplib::Request&, httplib::Response& res) {
+                res.set_content("{\"brightness\": 75, \"contrast\": 50, \"selected_display\": 0, \"display_count\": 1, "
+                                "\"nvapi_initialized\": true, \"active_transitions\": 0, "
+                                "\"status_message\": \"Brightness set to 75 via API\"}", "application/json");
+            });
+        }
+
+        // The port argument is ignored for AF_UNIX but must be non-zero
+        remove(socket_path.c_str());
+        unix_server.set_address_family(AF_UNIX);
+        tcp_server.set_tcp_nodelay(true);
+        port = tcp_server.bind_to_any_port(host);
+        if (port <= 0 || !unix_server.bind_to_port(socket_path, 1)) {
+            printf("Failed to bind benchmark listeners\n");
+            return 1;
+        }
+        listeners.emplace_back([&tcp_server]() { tcp_server.listen_after_bind(); });
+        listeners.emplace_back([&unix_server]() { unix_server.listen_after_bind(); });
+        tcp_server.wait_until_ready();
+        unix_server.wait_until_ready();
+    }
+
+    printf("%d requests per row (GET /health, GET /api/status alternating), latency in microseconds\n\n", requests);
+    printf("%-12s %-16s %9s %9s %9s %9s %8s\n", "transport", "connection", "mean", "p50", "p90", "p99", "failures");
+    PrintRow("tcp", "keep-alive", Measure(false, true, requests, host, port, socket_path));
+    PrintRow("unix", "keep-alive", Measure(true, true, requests, host, port, socket_path));
+    PrintRow("tcp", "per-request", Measure(false, false, requests, host, port, socket_path));
+    PrintRow("unix", "per-request", Measure(true, false, requests, host, port, socket_path));
+
+    if (self_host) {
+        tcp_server.stop();
+        unix_server.stop();
+        for (std::thread& listener : listeners) {
+            listener.join();
+        }
+        remove(socket_path.c_str());
+    }
+    return 0;
+}
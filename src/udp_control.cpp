@@ -0,0 +1,197 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define INVALID_SOCKET ((uintptr_t)-1)
+#define closesocket close
+#endif
+
+#include "udp_control.h"
+#include "server_logger.h"
+
+// Streams remembered by SequenceFilter before it starts over (bounds memory
+// if a sender keeps changing source ports)
+static const size_t MAX_SEQUENCE_STREAMS = 4096;
+
+static uint16_t ReadU16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+static uint32_t ReadU32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+bool ParseUdpControlPacket(const uint8_t* data, size_t length, UdpControlMessage& message) {
+    if (length != UDP_CONTROL_PACKET_SIZE || data[0] != 'M' || data[1] != 'C' || data[2] != UDP_CONTROL_VERSION) {
+        return false;
+    }
+    message.display_index = data[3];
+    message.vcp_code = data[4];
+    message.value = ReadU16(data + 6);
+    message.sequence = ReadU32(data + 8);
+    return true;
+}
+
+void EncodeUdpControlPacket(const UdpControlMessage& message, uint8_t* data) {
+    data[0] = 'M';
+    data[1] = 'C';
+    data[2] = UDP_CONTROL_VERSION;
+    data[3] = message.display_index;
+    data[4] = message.vcp_code;
+    data[5] = 0;
+    data[6] = static_cast<uint8_t>(message.value >> 8);
+    data[7] = static_cast<uint8_t>(message.value);
+    data[8] = static_cast<uint8_t>(message.sequence >> 24);
+    data[9] = static_cast<uint8_t>(message.sequence >> 16);
+    data[10] = static_cast<uint8_t>(message.sequence >> 8);
+    data[11] = static_cast<uint8_t>(message.sequence);
+}
+
+bool SequenceFilter::Accept(uint64_t sender, const UdpControlMessage& message) {
+    StreamKey key{ sender, message.display_index, message.vcp_code };
+    auto it = last_sequence.find(key);
+    if (it == last_sequence.end()) {
+        if (last_sequence.size() >= MAX_SEQUENCE_STREAMS) {
+            last_sequence.clear();
+        }
+        last_sequence.emplace(key, message.sequence);
+        return true;
+    }
+
+    // Newer in wrap-around order, or an explicit restart at 0
+    if (message.sequence == 0 || static_cast<int32_t>(message.sequence - it->second) > 0) {
+        it->second = message.sequence;
+        return true;
+    }
+    return false;
+}
+
+UdpControlServer::UdpControlServer(Handler h)
+    : handler(h), running(false), stopping(false), socket_handle(INVALID_SOCKET), bound_port(0),
+      received(0), accepted(0), stale(0), malformed(0) {
+}
+
+UdpControlServer::~UdpControlServer() {
+    Stop();
+}
+
+bool UdpControlServer::Start(const std::string& host, int port) {
+    if (running) {
+        return false;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        ServerLogger::Log("ERROR", "UDP control: invalid host %s", host.c_str());
+        return false;
+    }
+
+    uintptr_t sock = static_cast<uintptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    if (sock == static_cast<uintptr_t>(INVALID_SOCKET)) {
+        ServerLogger::Log("ERROR", "UDP control: socket() failed");
+        return false;
+    }
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ServerLogger::Log("ERROR", "UDP control: failed to bind %s:%d", host.c_str(), port);
+        closesocket(sock);
+        return false;
+    }
+
+    // Learn the actual port (port 0 picks a free one)
+    socklen_t addr_len = sizeof(addr);
+    getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    bound_port = ntohs(addr.sin_port);
+    bound_host = (addr.sin_addr.s_addr == htonl(INADDR_ANY)) ? "127.0.0.1" : host;
+
+    socket_handle = sock;
+    stopping = false;
+    running = true;
+    receive_thread = std::thread(&UdpControlServer::ReceiveThreadFunc, this);
+    ServerLogger::Log("INFO", "UDP control listening on %s:%d", host.c_str(), bound_port);
+    return true;
+}
+
+void UdpControlServer::Stop() {
+    if (!receive_thread.joinable()) {
+        return;
+    }
+
+    // Wake the blocking recvfrom with an empty datagram to our own port
+    stopping = true;
+    uintptr_t waker = static_cast<uintptr_t>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    if (waker != static_cast<uintptr_t>(INVALID_SOCKET)) {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(bound_port));
+        inet_pton(AF_INET, bound_host.c_str(), &addr.sin_addr);
+        sendto(waker, "", 0, 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        closesocket(waker);
+    }
+
+    receive_thread.join();
+    closesocket(socket_handle);
+    socket_handle = INVALID_SOCKET;
+    running = false;
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    ServerLogger::Log("INFO", "UDP control stopped");
+}
+
+UdpControlStats UdpControlServer::GetStats() const {
+    UdpControlStats stats;
+    stats.received = received;
+    stats.accepted = accepted;
+    stats.stale = stale;
+    stats.malformed = malformed;
+    return stats;
+}
+
+void UdpControlServer::ReceiveThreadFunc() {
+    SequenceFilter filter; // Only touched by this thread
+    uint8_t buffer[64];
+
+    while (!stopping) {
+        sockaddr_in from = {};
+        socklen_t from_len = sizeof(from);
+        int length = static_cast<int>(recvfrom(socket_handle, reinterpret_cast<char*>(buffer), sizeof(buffer), 0,
+                                               reinterpret_cast<sockaddr*>(&from), &from_len));
+        if (stopping) {
+            break;
+        }
+        if (length < 0) {
+            continue; // e.g. WSAECONNRESET from an earlier ICMP error; keep listening
+        }
+
+        received++;
+        UdpControlMessage message;
+        if (!ParseUdpControlPacket(buffer, static_cast<size_t>(length), message)) {
+            malformed++;
+            continue;
+        }
+
+        uint64_t sender = (static_cast<uint64_t>(ntohl(from.sin_addr.s_addr)) << 16) | ntohs(from.sin_port);
+        if (!filter.Accept(sender, message)) {
+            stale++;
+            continue;
+        }
+
+        accepted++;
+        handler(message);
+    }
+}
@@ -2,10 +2,240 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <windows.h>
 #include <tchar.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
 #include "nvapi.h"
 #include "monitor_control.h"
+#include "cli_batch.h"
+#include "cli_forward.h"
+
+// Display handles are enumerated once per process; the GPU handle and output
+// id of each display are looked up on first use and reused by later commands
+struct DisplayTarget {
+    bool resolved = false;
+    bool valid = false;
+    NvPhysicalGpuHandle gpu = NULL;
+    NvU32 output_id = 0;
+};
+
+static NvDisplayHandle g_displays[NVAPI_MAX_PHYSICAL_GPUS * NVAPI_MAX_DISPLAY_HEADS] = { 0 };
+static DisplayTarget g_targets[NVAPI_MAX_PHYSICAL_GPUS * NVAPI_MAX_DISPLAY_HEADS];
+static int g_display_count = 0;
+static bool g_displays_initialized = false;
+
+// Commands go to a running monitor_control_gui while it answers; the first
+// Unavailable result switches the rest of the run to direct NvAPI access
+static ServerForwarder g_forwarder;
+static bool g_forwarding = false;
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool InitializeDisplays() {
+    if (g_displays_initialized)
+    {
+        return true;
+    }
+
+    NvAPI_Status nvapiStatus = NVAPI_OK;
+
+    // Initialize NVAPI.
+    if ((nvapiStatus = NvAPI_Initialize()) != NVAPI_OK)
+    {
+        printf("NvAPI_Initialize() failed with status %d\n", nvapiStatus);
+        return false;
+    }
+
+    //
+    // Enumerate display handles
+    //
+    for (unsigned int i = 0; i < NVAPI_MAX_PHYSICAL_GPUS * NVAPI_MAX_DISPLAY_HEADS; i++)
+    {
+        nvapiStatus = NvAPI_EnumNvidiaDisplayHandle(i, &g_displays[i]);
+        if (nvapiStatus == NVAPI_END_ENUMERATION)
+        {
+            break;
+        }
+        if (nvapiStatus != NVAPI_OK)
+        {
+            printf("NvAPI_EnumNvidiaDisplayHandle() failed with status %d\n", nvapiStatus);
+            return false;
+        }
+        g_display_count++;
+    }
+
+    g_displays_initialized = true;
+    return true;
+}
+
+// Get GPU id and display output id for subsequent I2C calls (cached)
+static bool ResolveDisplay(int display_index, NvPhysicalGpuHandle* gpu, NvU32* output_id) {
+    if (display_index < 0 || display_index >= g_display_count)
+    {
+        printf("  Display index %d out of range (%d displays found)\n", display_index, g_display_count);
+        return false;
+    }
+
+    DisplayTarget& target = g_targets[display_index];
+    if (!target.resolved)
+    {
+        target.resolved = true;
+        target.valid = GetGpuFromDisplay(g_displays[display_index], &target.gpu, &target.output_id);
+    }
+
+    *gpu = target.gpu;
+    *output_id = target.output_id;
+    return target.valid;
+}
+
+static bool RunCommand(const CliCommand& command) {
+    if (command.type == CliCommand::Type::Delay)
+    {
+        Sleep(command.delay_ms);
+        return true;
+    }
+
+    if (g_forwarding)
+    {
+        uint16_t current = 0, maximum = 0;
+        std::string error;
+        ServerForwarder::Result result = g_forwarder.Send(command, current, maximum, error);
+        if (result == ServerForwarder::Result::Ok)
+        {
+            if (command.type == CliCommand::Type::Read)
+            {
+                printf("  current=0x%02X (%u) max=0x%02X (%u)\n", current, current, maximum, maximum);
+            }
+            return true;
+        }
+        if (result == ServerForwarder::Result::Failed)
+        {
+            // The server owns the bus; retrying directly could apply the write twice
+            printf("  Server command failed: %s\n", error.c_str());
+            return false;
+        }
+        printf("  %s, continuing with direct NvAPI access\n", error.c_str());
+        g_forwarding = false;
+    }
+
+    if (!InitializeDisplays())
+    {
+        return false;
+    }
+
+    NvPhysicalGpuHandle gpu = NULL;
+    NvU32 output_id = 0;
+    if (!ResolveDisplay(command.display_index, &gpu, &output_id))
+    {
+        return false;
+    }
+
+    if (command.type == CliCommand::Type::Read)
+    {
+        WORD current = 0, maximum = 0;
+        if (!ReadVcpFeature(gpu, output_id, command.command_code, &current, &maximum, command.register_address))
+        {
+            return false;
+        }
+        printf("  current=0x%02X (%u) max=0x%02X (%u)\n", current, current, maximum, maximum);
+        return true;
+    }
+
+    return WriteDdcPacket(gpu, output_id,
+                          MakeDdcPacket(command.command_code, command.value, command.register_address)) == TRUE;
+}
+
+// Run every command of a script after a single NvAPI initialization
+static int RunBatch(const char* script_path, bool keep_going) {
+    std::vector<CliCommand> commands;
+    std::string error;
+    bool parsed;
+    if (strcmp(script_path, "-") == 0)
+    {
+        parsed = ParseCliScript(std::cin, commands, error);
+    }
+    else
+    {
+        std::ifstream script(script_path);
+        if (!script.is_open())
+        {
+            printf("Cannot open script %s\n", script_path);
+            return 1;
+        }
+        parsed = ParseCliScript(script, commands, error);
+    }
+    if (!parsed)
+    {
+        printf("Script error, %s\n", error.c_str());
+        return 1;
+    }
+
+    auto batch_start = std::chrono::steady_clock::now();
+    if (g_forwarding)
+    {
+        printf("Forwarding to running server at %s (%.1f ms)\n", g_forwarder.Describe().c_str(),
+               MillisecondsSince(batch_start));
+    }
+    else
+    {
+        if (!InitializeDisplays())
+        {
+            return 1;
+        }
+        printf("Initialized NvAPI, %d displays (%.1f ms)\n", g_display_count, MillisecondsSince(batch_start));
+    }
+
+    int failures = 0;
+    for (const CliCommand& command : commands)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = RunCommand(command);
+        printf("line %3d  %-48s %-4s %8.1f ms\n", command.line, DescribeCliCommand(command).c_str(),
+               ok ? "OK" : "FAIL", MillisecondsSince(start));
+
+        if (!ok)
+        {
+            failures++;
+            if (!keep_going)
+            {
+                printf("Stopping at first failure (use --keep-going to continue)\n");
+                break;
+            }
+        }
+    }
+
+    printf("%d commands, %d failed, %.1f ms total\n", (int)commands.size(), failures, MillisecondsSince(batch_start));
+    return failures == 0 ? 0 : 1;
+}
+
+static void PrintUsage() {
+    printf("Arguments:\n");
+    printf("display_index   - Index assigned to monitor (0 for first screen)\n");
+    printf("input_value     - value to right to screen\n");
+    printf("command_code    - VCP code or other\n");
+    printf("register_address - Adress to write to, default 0x51 for VCP codes\n\n");
+
+    printf("Usage:\n");
+    printf("writeValueToScreen.exe [display_index] [input_value] [command_code]\n");
+    printf("OR\n");
+    printf("writeValueToScreen.exe [display_index] [input_value] [command_code] [register_address]\n");
+    printf("OR\n");
+    printf("writeValueToScreen.exe --batch [script_file | -] [--keep-going]\n\n");
+
+    printf("Commands are sent to a running monitor_control_gui (found via config.env) when\n");
+    printf("one answers; put --direct first to always talk to the display through NvAPI.\n\n");
+
+    printf("Batch scripts hold one command per line ('#' starts a comment, values in hex):\n");
+    printf("  write [display_index] [input_value] [command_code] [register_address]\n");
+    printf("  read [display_index] [command_code] [register_address]\n");
+    printf("  delay [milliseconds]\n");
+}
 
 
 int main(int argc, char* argv[]) {
@@ -15,6 +245,29 @@ int main(int argc, char* argv[]) {
     BYTE command_code = 0;  //VCP code or equivalent
     BYTE register_address = 0x51;
 
+    // Usage: writeValueToMonitor.exe --direct ...
+    // Skips the running-server probe, e.g. when the server itself is misbehaving
+    bool direct = (argc >= 2 && strcmp(argv[1], "--direct") == 0);
+    if (direct) {
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+    if (!direct && argc >= 2) {
+        g_forwarding = g_forwarder.Connect(argv[0]);
+    }
+
+    // Usage: writeValueToMonitor.exe --batch [script_file | -] [--keep-going]
+    // Initializes once and runs every command in the script (or stdin)
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0) {
+        bool keep_going = (argc == 4 && strcmp(argv[3], "--keep-going") == 0);
+        if (argc > 4 || (argc == 4 && !keep_going)) {
+            PrintUsage();
+            return 1;
+        }
+        return RunBatch(argv[2], keep_going);
+    }
+
     // Usage: writeValueToMonitor.exe [display_index] [input_value] [command_code]
     // Uses default register addres 0x51 used for VCP codes
     if (argc == 4) {
@@ -33,69 +286,37 @@ int main(int argc, char* argv[]) {
     }
     else {
         printf("Incorrect Number of arguments!\n\n");
-
-        printf("Arguments:\n");
-        printf("display_index   - Index assigned to monitor (0 for first screen)\n");
-        printf("input_value     - value to right to screen\n");
-        printf("command_code    - VCP code or other\n");
-        printf("register_address - Adress to write to, default 0x51 for VCP codes\n\n");
-
-        printf("Usage:\n");
-        printf("writeValueToScreen.exe [display_index] [input_value] [command_code]\n");
-        printf("OR\n");
-        printf("writeValueToScreen.exe [display_index] [input_value] [command_code] [register_address]\n");
-        return 1;
-    }
-    
-
-    //printf("%d, %ld, %d, %d", display_index, input_value, command_code, register_address);
-
-    NvAPI_Status nvapiStatus = NVAPI_OK;
-
-    // Initialize NVAPI.
-    if ((nvapiStatus = NvAPI_Initialize()) != NVAPI_OK)
-    {
-        printf("NvAPI_Initialize() failed with status %d\n", nvapiStatus);
+        PrintUsage();
         return 1;
     }
 
-
-    //
-    // Enumerate display handles
-    //
-    NvDisplayHandle hDisplay_a[NVAPI_MAX_PHYSICAL_GPUS * NVAPI_MAX_DISPLAY_HEADS] = { 0 };
-    for (unsigned int i = 0; nvapiStatus == NVAPI_OK; i++)
-    {
-        nvapiStatus = NvAPI_EnumNvidiaDisplayHandle(i, &hDisplay_a[i]);
-        
-        if (nvapiStatus != NVAPI_OK && nvapiStatus != NVAPI_END_ENUMERATION)
-        {
-            printf("NvAPI_EnumNvidiaDisplayHandle() failed with status %d\n", nvapiStatus);
+    if (g_forwarding) {
+        CliCommand command;
+        command.display_index = display_index;
+        command.value = input_value;
+        command.command_code = command_code;
+        command.register_address = register_address;
+        if (!RunCommand(command)) {
+            printf("Changing input failed\n");
             return 1;
         }
+        // If the server went away mid-command RunCommand already wrote directly
+        if (g_forwarding) {
+            printf("Sent via %s\n", g_forwarder.Describe().c_str());
+        }
+        return 0;
     }
 
-   
-    // Get GPU id assiciated with display ID
-    NvPhysicalGpuHandle hGpu = NULL;
-    NvU32 pGpuCount = 0;
-    nvapiStatus = NvAPI_GetPhysicalGPUsFromDisplay(hDisplay_a[display_index], &hGpu, &pGpuCount);
-    if (nvapiStatus != NVAPI_OK)
-    {
-        printf("NvAPI_GetPhysicalGPUFromDisplay() failed with status %d\n", nvapiStatus);
+    if (!InitializeDisplays()) {
         return 1;
     }
 
-    // Get the display id for subsequent I2C calls via NVAPI:
+    NvPhysicalGpuHandle hGpu = NULL;
     NvU32 outputID = 0;
-    nvapiStatus = NvAPI_GetAssociatedDisplayOutputId(hDisplay_a[display_index], &outputID);
-    if (nvapiStatus != NVAPI_OK)
-    {
-        printf("NvAPI_GetAssociatedDisplayOutputId() failed with status %d\n", nvapiStatus);
+    if (!ResolveDisplay(display_index, &hGpu, &outputID)) {
         return 1;
     }
 
-
     BOOL result = WriteValueToMonitor(hGpu, outputID, input_value, command_code, register_address);
     if (!result)
     {
@@ -105,5 +326,3 @@ int main(int argc, char* argv[]) {
 
 
 }
-
-